@@ -244,6 +244,20 @@ inline uint32_t bit_rotate_right(uint32_t x, int shift)
 }
 #endif
 
+// Returns (a * b) >> 32, keeping the high bits of the 128 bit product, for
+//  multiplying by a 32.32 fixed point scale
+inline uint64_t
+mul_fixed32(uint64_t a, uint64_t b)
+{
+#ifdef PLATFORM_WINDOWS
+   uint64_t high;
+   auto low = _umul128(a, b, &high);
+   return (high << 32) | (low >> 32);
+#else
+   return static_cast<uint64_t>((static_cast<unsigned __int128>(a) * b) >> 32);
+#endif
+}
+
 // Return number of bits in type
 template<typename Type>
 struct bit_width
@@ -0,0 +1,123 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+/**
+ * Low overhead timeline tracing.
+ *
+ * Every host thread records events into its own fixed size ring buffer, so
+ * recording never takes a lock. When tracing is disabled the cost of a zone
+ * is a single relaxed atomic load.
+ *
+ * Names and categories must be string literals or otherwise outlive the
+ * trace, use intern to get a stable copy of a dynamic string.
+ */
+
+namespace perftrace
+{
+
+enum class EventType : uint8_t
+{
+   Complete,
+   Counter,
+   Instant,
+};
+
+struct Event
+{
+   const char *category;
+   const char *name;
+
+   //! Start time in nanoseconds since the trace was enabled
+   uint64_t start;
+
+   //! Duration in nanoseconds of a Complete event
+   uint64_t duration;
+
+   //! Value of a Counter event
+   double value;
+
+   EventType type;
+};
+
+extern std::atomic<bool>
+gEnabled;
+
+inline bool
+isEnabled()
+{
+   return gEnabled.load(std::memory_order_relaxed);
+}
+
+void
+enable();
+
+void
+disable();
+
+uint64_t
+now();
+
+const char *
+intern(const std::string &str);
+
+void
+setThreadName(const char *name);
+
+void
+complete(const char *category,
+         const char *name,
+         uint64_t start);
+
+void
+counter(const char *category,
+        const char *name,
+        double value);
+
+void
+instant(const char *category,
+        const char *name);
+
+bool
+writeChromeTrace(const std::string &path);
+
+/**
+ * Records a Complete event covering the lifetime of the zone.
+ *
+ * The event is recorded when the zone ends, so a zone which is suspended on
+ * one host thread and resumed on another ends up on the latter's timeline.
+ */
+class Zone
+{
+public:
+   Zone(const char *category,
+        const char *name) :
+      mCategory(category),
+      mName(name),
+      mStart(isEnabled() ? now() : 0)
+   {
+   }
+
+   ~Zone()
+   {
+      if (mStart && isEnabled()) {
+         complete(mCategory, mName, mStart);
+      }
+   }
+
+   Zone(const Zone &) = delete;
+   Zone &operator=(const Zone &) = delete;
+
+private:
+   const char *mCategory;
+   const char *mName;
+   uint64_t mStart;
+};
+
+} // namespace perftrace
+
+#define PERFTRACE_CONCAT_(x, y) x##y
+#define PERFTRACE_CONCAT(x, y) PERFTRACE_CONCAT_(x, y)
+#define PERFTRACE_ZONE(category, name) \
+   perftrace::Zone PERFTRACE_CONCAT(perftraceZone, __LINE__) { category, name }
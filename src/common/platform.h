@@ -10,3 +10,7 @@
 #define PLATFORM_LINUX
 #define PLATFORM_POSIX
 #endif
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define PLATFORM_X86
+#endif
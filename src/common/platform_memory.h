@@ -21,6 +21,10 @@ static constexpr MapFileHandle InvalidMapFileHandle = -1;
 size_t
 getSystemPageSize();
 
+//! The most physical memory the process has used at once, in bytes
+size_t
+getPeakResidentSize();
+
 MapFileHandle
 createMemoryMappedFile(size_t size);
 
@@ -1,9 +1,33 @@
 #pragma once
+#include "platform.h"
+
+#include <chrono>
+#include <cstdint>
 #include <ctime>
 
+#ifdef PLATFORM_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
 namespace platform
 {
 
+//! Reads the host cycle counter, which is steady_clock nanoseconds on hosts
+//!  without a TSC.
+inline uint64_t
+readCycleCounter()
+{
+#ifdef PLATFORM_X86
+   return __rdtsc();
+#else
+   return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+}
+
 tm
 localtime(const std::time_t& time);
 
@@ -0,0 +1,274 @@
+#include "log.h"
+#include "perftrace.h"
+
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+namespace perftrace
+{
+
+//! Number of events each thread keeps, older events are overwritten
+static constexpr uint64_t BufferCapacity = 1 << 18;
+
+struct ThreadBuffer
+{
+   uint32_t id;
+   const char *name;
+   std::unique_ptr<Event[]> events;
+
+   //! Total number of events ever written, only written by the owning thread
+   std::atomic<uint64_t> writePos { 0 };
+};
+
+std::atomic<bool>
+gEnabled { false };
+
+static const auto
+sEpoch = std::chrono::steady_clock::now();
+
+//! Protects sBuffers and sStrings
+static std::mutex
+sMutex;
+
+//! Buffers are kept after their thread exits so their events can be written
+static std::vector<std::unique_ptr<ThreadBuffer>>
+sBuffers;
+
+static std::unordered_set<std::string>
+sStrings;
+
+static thread_local ThreadBuffer *
+tBuffer = nullptr;
+
+static thread_local const char *
+tThreadName = nullptr;
+
+static ThreadBuffer *
+getThreadBuffer()
+{
+   if (!tBuffer) {
+      auto buffer = std::make_unique<ThreadBuffer>();
+      buffer->name = tThreadName;
+      buffer->events = std::make_unique<Event[]>(BufferCapacity);
+
+      std::unique_lock<std::mutex> lock { sMutex };
+      buffer->id = static_cast<uint32_t>(sBuffers.size()) + 1;
+      tBuffer = buffer.get();
+      sBuffers.emplace_back(std::move(buffer));
+   }
+
+   return tBuffer;
+}
+
+static void
+record(const Event &event)
+{
+   auto buffer = getThreadBuffer();
+   auto pos = buffer->writePos.load(std::memory_order_relaxed);
+   buffer->events[pos % BufferCapacity] = event;
+   buffer->writePos.store(pos + 1, std::memory_order_release);
+}
+
+void
+enable()
+{
+   gEnabled.store(true);
+}
+
+void
+disable()
+{
+   gEnabled.store(false);
+}
+
+uint64_t
+now()
+{
+   auto elapsed = std::chrono::steady_clock::now() - sEpoch;
+   return std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+}
+
+const char *
+intern(const std::string &str)
+{
+   std::unique_lock<std::mutex> lock { sMutex };
+   return sStrings.insert(str).first->c_str();
+}
+
+void
+setThreadName(const char *name)
+{
+   tThreadName = name;
+
+   if (tBuffer) {
+      std::unique_lock<std::mutex> lock { sMutex };
+      tBuffer->name = name;
+   }
+}
+
+void
+complete(const char *category,
+         const char *name,
+         uint64_t start)
+{
+   auto event = Event { };
+   event.category = category;
+   event.name = name;
+   event.start = start;
+   event.duration = now() - start;
+   event.type = EventType::Complete;
+   record(event);
+}
+
+void
+counter(const char *category,
+        const char *name,
+        double value)
+{
+   if (!isEnabled()) {
+      return;
+   }
+
+   auto event = Event { };
+   event.category = category;
+   event.name = name;
+   event.start = now();
+   event.value = value;
+   event.type = EventType::Counter;
+   record(event);
+}
+
+void
+instant(const char *category,
+        const char *name)
+{
+   if (!isEnabled()) {
+      return;
+   }
+
+   auto event = Event { };
+   event.category = category;
+   event.name = name;
+   event.start = now();
+   event.type = EventType::Instant;
+   record(event);
+}
+
+static void
+writeString(std::ostream &out,
+            const char *str)
+{
+   out << '"';
+
+   for (auto c = str ? str : ""; *c; ++c) {
+      switch (*c) {
+      case '"':
+         out << "\\\"";
+         break;
+      case '\\':
+         out << "\\\\";
+         break;
+      case '\n':
+         out << "\\n";
+         break;
+      default:
+         if (static_cast<unsigned char>(*c) < 0x20) {
+            out << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+                << static_cast<int>(*c) << std::dec << std::setfill(' ');
+         } else {
+            out << *c;
+         }
+      }
+   }
+
+   out << '"';
+}
+
+static void
+writeTimestamp(std::ostream &out,
+               uint64_t ns)
+{
+   // Chrome traces are in microseconds
+   out << (ns / 1000) << '.' << std::setw(3) << std::setfill('0') << (ns % 1000)
+       << std::setfill(' ');
+}
+
+/**
+ * Writes every buffered event in the Chrome trace event format, which can be
+ * loaded by chrome://tracing and ui.perfetto.dev.
+ *
+ * Tracing should be disabled first, events recorded while writing may be torn.
+ */
+bool
+writeChromeTrace(const std::string &path)
+{
+   std::ofstream out { path, std::ofstream::out | std::ofstream::trunc };
+
+   if (!out.is_open()) {
+      gLog->error("Could not open {} to write trace", path);
+      return false;
+   }
+
+   std::unique_lock<std::mutex> lock { sMutex };
+   auto numEvents = uint64_t { 0 };
+   auto numDropped = uint64_t { 0 };
+   auto first = true;
+
+   out << "{\"traceEvents\":[\n";
+
+   for (auto &buffer : sBuffers) {
+      auto end = buffer->writePos.load(std::memory_order_acquire);
+      auto begin = end > BufferCapacity ? end - BufferCapacity : 0;
+      numDropped += begin;
+
+      if (buffer->name) {
+         out << (first ? "" : ",\n")
+             << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->id
+             << ",\"args\":{\"name\":";
+         writeString(out, buffer->name);
+         out << "}}";
+         first = false;
+      }
+
+      for (auto pos = begin; pos < end; ++pos) {
+         auto &event = buffer->events[pos % BufferCapacity];
+         out << (first ? "" : ",\n") << "{\"name\":";
+         writeString(out, event.name);
+         out << ",\"cat\":";
+         writeString(out, event.category);
+
+         switch (event.type) {
+         case EventType::Complete:
+            out << ",\"ph\":\"X\",\"dur\":";
+            writeTimestamp(out, event.duration);
+            break;
+         case EventType::Counter:
+            out << ",\"ph\":\"C\",\"args\":{\"value\":" << event.value << "}";
+            break;
+         case EventType::Instant:
+            out << ",\"ph\":\"i\",\"s\":\"t\"";
+            break;
+         }
+
+         out << ",\"ts\":";
+         writeTimestamp(out, event.start);
+         out << ",\"pid\":1,\"tid\":" << buffer->id << "}";
+         first = false;
+      }
+
+      numEvents += end - begin;
+   }
+
+   out << "\n]}\n";
+
+   gLog->info("Wrote {} trace events to {}, {} older events were dropped",
+              numEvents, path, numDropped);
+   return true;
+}
+
+} // namespace perftrace
@@ -8,6 +8,7 @@
 #include <errno.h>
 #include <fmt/format.h>
 #include <sys/mman.h>
+#include <sys/resource.h>
 #include <sys/types.h>
 #include <time.h>
 #include <unistd.h>
@@ -59,6 +60,24 @@ getSystemPageSize()
 }
 
 
+size_t
+getPeakResidentSize()
+{
+   struct rusage usage;
+
+   if (getrusage(RUSAGE_SELF, &usage) != 0) {
+      return 0;
+   }
+
+#ifdef PLATFORM_APPLE
+   // macOS reports bytes, Linux reports kilobytes
+   return static_cast<size_t>(usage.ru_maxrss);
+#else
+   return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+}
+
+
 MapFileHandle
 createMemoryMappedFile(size_t size)
 {
@@ -158,7 +177,8 @@ mapViewOfFile(MapFileHandle handle,
       return nullptr;
    }
 
-   if (result != dst) {
+   // Without a destination mmap is free to choose the address
+   if (dst && result != dst) {
       gLog->error("mapViewOfFile(offset: 0x{:X}, size: 0x{:X}, dst: {}) mmap returned unexpected address: {}",
                   offset, size, dst, result);
 
@@ -9,7 +9,7 @@ namespace platform
 
 bool socketWouldBlock(int result)
 {
-   return (result == EWOULDBLOCK);
+   return (result < 0 && (errno == EWOULDBLOCK || errno == EAGAIN));
 }
 
 int socketSetBlocking(Socket socket, bool blocking)
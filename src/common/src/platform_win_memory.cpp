@@ -7,6 +7,7 @@
 #include <map>
 #include <mutex>
 #include <Windows.h>
+#include <Psapi.h>
 
 namespace platform
 {
@@ -65,6 +66,19 @@ getSystemPageSize()
 }
 
 
+size_t
+getPeakResidentSize()
+{
+   PROCESS_MEMORY_COUNTERS counters;
+
+   if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+      return 0;
+   }
+
+   return static_cast<size_t>(counters.PeakWorkingSetSize);
+}
+
+
 MapFileHandle
 createMemoryMappedFile(size_t size)
 {
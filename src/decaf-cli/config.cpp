@@ -7,6 +7,7 @@ namespace system
 {
 
 int timeout_ms = 0;
+std::string trace_file = "";
 
 } // namespace system
 
@@ -14,6 +15,7 @@ bool
 loadFrontendToml(std::shared_ptr<cpptoml::table> config)
 {
    system::timeout_ms = config->get_qualified_as<int>("system.timeout_ms").value_or(system::timeout_ms);
+   system::trace_file = config->get_qualified_as<std::string>("system.trace_file").value_or(system::trace_file);
    return true;
 }
 
@@ -26,6 +28,7 @@ saveFrontendToml(std::shared_ptr<cpptoml::table> config)
    }
 
    system->insert("timeout_ms", system::timeout_ms);
+   system->insert("trace_file", system::trace_file);
    config->insert("system", system);
    return true;
 }
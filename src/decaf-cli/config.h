@@ -9,6 +9,7 @@ namespace system
 {
 
 extern int timeout_ms;
+extern std::string trace_file;
 
 } // namespace system
 
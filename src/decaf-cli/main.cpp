@@ -3,12 +3,14 @@
 
 #include <common/decaf_assert.h>
 #include <common/log.h>
+#include <common/perftrace.h>
 #include <common/platform_dir.h>
 #include <excmd.h>
 #include <iostream>
 #include <libconfig/config_excmd.h>
 #include <libconfig/config_toml.h>
 #include <libdecaf/decaf.h>
+#include <libdecaf/decaf_hlestats.h>
 
 std::shared_ptr<spdlog::logger>
 gCliLog;
@@ -42,7 +44,10 @@ getCommandLineParser()
                   value<std::string> {})
       .add_option("timeout_ms",
                   description { "How long to execute the game for before quitting." },
-                  value<uint32_t> {});
+                  value<uint32_t> {})
+      .add_option("trace_file",
+                  description { "Record a performance trace and write it to this file in the Chrome trace format." },
+                  value<std::string> {});
 
    auto config_options = config::getExcmdGroups(parser);
 
@@ -69,6 +74,32 @@ getPathBasename(const std::string &path)
    }
 }
 
+static void
+printHleStats()
+{
+   auto stats = decaf::getHleCallStats();
+   auto totalCycles = uint64_t { 0 };
+
+   for (auto &func : stats) {
+      totalCycles += func.cycles;
+   }
+
+   gCliLog->info("HLE function stats, sorted by total host cycles:");
+   gCliLog->info("{:<56} {:>10} {:>7} {:>14} {:>11} {:>10} {:>10}",
+                 "Function", "Calls", "Time %", "Total Cycles", "Cycles/Call", "p50", "p99");
+
+   for (auto &func : stats) {
+      gCliLog->info("{:<56} {:>10} {:>6.2f}% {:>14} {:>11} {:>10} {:>10}",
+                    func.module + "::" + func.name,
+                    func.calls,
+                    totalCycles ? 100.0 * func.cycles / totalCycles : 0.0,
+                    func.cycles,
+                    (func.cycles + func.calls / 2) / func.calls,
+                    decaf::getHleCallPercentile(func, 50.0),
+                    decaf::getHleCallPercentile(func, 99.0));
+   }
+}
+
 int
 start(excmd::parser &parser,
       excmd::option_state &options)
@@ -131,6 +162,10 @@ start(excmd::parser &parser,
       config::system::timeout_ms = options.get<uint32_t>("timeout_ms");
    }
 
+   if (options.has("trace_file")) {
+      config::system::trace_file = options.get<std::string>("trace_file");
+   }
+
    // Initialise libdecaf logger
    auto logFile = getPathBasename(gamePath);
    decaf::initialiseLogging(logFile + ".txt");
@@ -153,8 +188,23 @@ start(excmd::parser &parser,
       gCliLog->error("Failed to parse config {}: {}", configPath, configError);
    }
 
+   if (!config::system::trace_file.empty()) {
+      perftrace::enable();
+   }
+
    DecafCLI cli;
-   return cli.run(gamePath);
+   auto result = cli.run(gamePath);
+
+   if (!config::system::trace_file.empty()) {
+      perftrace::disable();
+      perftrace::writeChromeTrace(config::system::trace_file);
+   }
+
+   if (decaf::config::log::hle_stats) {
+      printHleStats();
+   }
+
+   return result;
 }
 
 int main(int argc, char **argv)
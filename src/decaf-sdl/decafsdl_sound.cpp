@@ -79,6 +79,7 @@ DecafSDLSound::output(int16_t *samples, unsigned numSamples)
 
    std::memcpy(&mOutputBuffer[mBufferWritePos], samples, numSamplesOut * 2);
    mBufferWritePos += numSamplesOut;
+   mOutputStarted.store(true);
 }
 
 void
@@ -87,6 +88,12 @@ DecafSDLSound::stop()
    SDL_CloseAudio();
 }
 
+uint64_t
+DecafSDLSound::getUnderrunCount()
+{
+   return mUnderrunCount.load();
+}
+
 void
 DecafSDLSound::sdlCallback(void *instance_, Uint8 *stream_, int size)
 {
@@ -101,6 +108,10 @@ DecafSDLSound::sdlCallback(void *instance_, Uint8 *stream_, int size)
       // Rather than outputting the partial frame, output a full frame of
       //  silence to give audio generation a chance to catch up.
       std::memset(stream, 0, size);
+
+      if (instance->mOutputStarted.load()) {
+         instance->mUnderrunCount++;
+      }
    } else {
       decaf_check(instance->mBufferReadPos + numSamples <= instance->mOutputBuffer.size());
       std::memcpy(stream, &instance->mOutputBuffer[instance->mBufferReadPos], size);
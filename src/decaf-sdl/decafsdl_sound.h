@@ -1,5 +1,6 @@
 #pragma once
 #include "libdecaf/decaf_sound.h"
+#include <atomic>
 #include <vector>
 #include <SDL.h>
 
@@ -21,6 +22,9 @@ public:
    virtual void
    stop();
 
+   virtual uint64_t
+   getUnderrunCount();
+
 private:
    unsigned mNumChannelsIn;  // Number of channels of data we receive in output()
    unsigned mNumChannelsOut; // Number of channels we send to the audio device
@@ -31,6 +35,9 @@ private:
    size_t mBufferWritePos; // Index of next sample (array element) to write
    size_t mBufferReadPos;  // Index of next sample (array element) to read
 
+   std::atomic<bool> mOutputStarted { false }; // Set by the first call to output()
+   std::atomic<uint64_t> mUnderrunCount { 0 }; // Frames of silence output after output started
+
    static void
    sdlCallback(void *instance_, Uint8 *stream_, int size);
 };
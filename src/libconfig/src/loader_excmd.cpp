@@ -54,6 +54,14 @@ getExcmdGroups(excmd::parser &parser)
                   value<std::string> {})
       .add_option("log-file",
                   description { "Enable logging to file." })
+      .add_option("log-hle-stats",
+                  description { "Collect call counts and timings for every HLE function." })
+      .add_option("log-profile",
+                  description { "Sample guest stacks on every core and write them to this file as folded stacks." },
+                  value<std::string> {})
+      .add_option("log-profile-rate",
+                  description { "Number of guest stack samples to take per second on each core." },
+                  default_value<unsigned> { decaf::config::log::profile_rate })
       .add_option("log-stdout",
                   description { "Enable logging to stdout." })
       .add_option("log-level",
@@ -86,7 +94,17 @@ getExcmdGroups(excmd::parser &parser)
                   value<std::string> {})
       .add_option("time-scale",
                   description { "Time scale factor for emulated clock." },
-                  default_value<double> { 1.0 });
+                  default_value<double> { 1.0 })
+      .add_option("idle-fast-forward",
+                  description { "Skip ahead to the next alarm when every core is idle, for headless runs." })
+      .add_option("deterministic",
+                  description { "Interleave the cores deterministically and count time in retired instructions." })
+      .add_option("metrics-port",
+                  description { "Serve Prometheus metrics over HTTP on this port on localhost." },
+                  value<unsigned> {})
+      .add_option("metrics-socket",
+                  description { "Serve Prometheus metrics over HTTP on this Unix socket." },
+                  value<std::string> {});
    groups.push_back(sys_options.group);
 
    return groups;
@@ -191,6 +209,18 @@ loadFromExcmd(excmd::option_state &options)
       decaf::config::log::async = true;
    }
 
+   if (options.has("log-hle-stats")) {
+      decaf::config::log::hle_stats = true;
+   }
+
+   if (options.has("log-profile")) {
+      decaf::config::log::profile_file = options.get<std::string>("log-profile");
+   }
+
+   if (options.has("log-profile-rate")) {
+      decaf::config::log::profile_rate = options.get<unsigned>("log-profile-rate");
+   }
+
    if (options.has("log-level")) {
       decaf::config::log::level = options.get<std::string>("log-level");
    }
@@ -231,6 +261,22 @@ loadFromExcmd(excmd::option_state &options)
       decaf::config::system::time_scale = options.get<double>("time-scale");
    }
 
+   if (options.has("idle-fast-forward")) {
+      cpu::config::timing::idle_fast_forward = true;
+   }
+
+   if (options.has("deterministic")) {
+      cpu::config::timing::deterministic = true;
+   }
+
+   if (options.has("metrics-port")) {
+      decaf::config::system::metrics_port = options.get<unsigned>("metrics-port");
+   }
+
+   if (options.has("metrics-socket")) {
+      decaf::config::system::metrics_socket = options.get<std::string>("metrics-socket");
+   }
+
    return true;
 }
 
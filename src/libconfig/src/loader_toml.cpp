@@ -19,6 +19,8 @@ loadFromTOML(std::shared_ptr<cpptoml::table> config)
    readValue(config, "gpu.debug", gpu::config::debug);
    readArray(config, "gpu.debug_filters", gpu::config::debug_filters);
    readValue(config, "gpu.dump_shaders", gpu::config::dump_shaders);
+   readValue(config, "gpu.write_tracking", gpu::config::write_tracking);
+   readValue(config, "gpu.compute_untile", gpu::config::compute_untile);
 
    readValue(config, "gx2.dump_textures", decaf::config::gx2::dump_textures);
    readValue(config, "gx2.dump_shaders", decaf::config::gx2::dump_shaders);
@@ -30,12 +32,18 @@ loadFromTOML(std::shared_ptr<cpptoml::table> config)
    readValue(config, "jit.data_cache_size_mb", cpu::config::jit::data_cache_size_mb);
    readArray(config, "jit.opt_flags", cpu::config::jit::opt_flags);
    readValue(config, "jit.rodata_read_only", cpu::config::jit::rodata_read_only);
+   readValue(config, "timing.idle_fast_forward", cpu::config::timing::idle_fast_forward);
+   readValue(config, "timing.deterministic", cpu::config::timing::deterministic);
+   readValue(config, "timing.use_tsc", cpu::config::timing::use_tsc);
 
    readValue(config, "log.async", decaf::config::log::async);
    readValue(config, "log.branch_trace", decaf::config::log::branch_trace);
    readValue(config, "log.directory", decaf::config::log::directory);
    readValue(config, "log.kernel_trace", decaf::config::log::kernel_trace);
    readValue(config, "log.kernel_trace_res", decaf::config::log::kernel_trace_res);
+   readValue(config, "log.hle_stats", decaf::config::log::hle_stats);
+   readValue(config, "log.profile_file", decaf::config::log::profile_file);
+   readValue(config, "log.profile_rate", decaf::config::log::profile_rate);
    readArray(config, "log.kernel_trace_filters", decaf::config::log::kernel_trace_filters);
    readValue(config, "log.level", decaf::config::log::level);
    readValue(config, "log.to_file", decaf::config::log::to_file);
@@ -51,6 +59,8 @@ loadFromTOML(std::shared_ptr<cpptoml::table> config)
    readValue(config, "system.content_path", decaf::config::system::content_path);
    readValue(config, "system.time_scale", decaf::config::system::time_scale);
    readArray(config, "system.lle_modules", decaf::config::system::lle_modules);
+   readValue(config, "system.metrics_port", decaf::config::system::metrics_port);
+   readValue(config, "system.metrics_socket", decaf::config::system::metrics_socket);
    return true;
 }
 
@@ -77,6 +87,8 @@ saveToTOML(std::shared_ptr<cpptoml::table> config)
 
    gpu->insert("debug", gpu::config::debug);
    gpu->insert("dump_shaders", gpu::config::dump_shaders);
+   gpu->insert("write_tracking", gpu::config::write_tracking);
+   gpu->insert("compute_untile", gpu::config::compute_untile);
 
    auto debug_filters = cpptoml::make_array();
    for (auto &filter : gpu::config::debug_filters) {
@@ -117,6 +129,17 @@ saveToTOML(std::shared_ptr<cpptoml::table> config)
    jit->insert("opt_flags", opt_flags);
    config->insert("jit", jit);
 
+   // timing
+   auto timing = config->get_table("timing");
+   if (!timing) {
+      timing = cpptoml::make_table();
+   }
+
+   timing->insert("idle_fast_forward", cpu::config::timing::idle_fast_forward);
+   timing->insert("deterministic", cpu::config::timing::deterministic);
+   timing->insert("use_tsc", cpu::config::timing::use_tsc);
+   config->insert("timing", timing);
+
    // log
    auto log = config->get_table("log");
    if (!log) {
@@ -128,6 +151,9 @@ saveToTOML(std::shared_ptr<cpptoml::table> config)
    log->insert("directory", decaf::config::log::directory);
    log->insert("kernel_trace", decaf::config::log::kernel_trace);
    log->insert("kernel_trace_res", decaf::config::log::kernel_trace_res);
+   log->insert("hle_stats", decaf::config::log::hle_stats);
+   log->insert("profile_file", decaf::config::log::profile_file);
+   log->insert("profile_rate", decaf::config::log::profile_rate);
    log->insert("level", decaf::config::log::level);
    log->insert("to_file", decaf::config::log::to_file);
    log->insert("to_stdout", decaf::config::log::to_stdout);
@@ -162,6 +188,8 @@ saveToTOML(std::shared_ptr<cpptoml::table> config)
    system->insert("slc_path", decaf::config::system::slc_path);
    system->insert("content_path", decaf::config::system::content_path);
    system->insert("time_scale", decaf::config::system::time_scale);
+   system->insert("metrics_port", decaf::config::system::metrics_port);
+   system->insert("metrics_socket", decaf::config::system::metrics_socket);
 
    auto lle_modules = cpptoml::make_array();
    for (auto &name : decaf::config::system::lle_modules) {
@@ -20,6 +20,7 @@ const uint32_t DBGBREAK_INTERRUPT = 1 << 3;
 const uint32_t GPU_RETIRE_INTERRUPT = 1 << 4;
 const uint32_t GPU_FLIP_INTERRUPT = 1 << 5;
 const uint32_t IPC_INTERRUPT = 1 << 6;
+const uint32_t PROFILER_INTERRUPT = 1 << 7;
 const uint32_t INTERRUPT_MASK = 0xFFFFFFFF;
 const uint32_t NONMASKABLE_INTERRUPTS = SRESET_INTERRUPT;
 
@@ -38,6 +39,8 @@ using InterruptHandler = void (*)(uint32_t interrupt_flags);
 using SegfaultHandler = void(*)(uint32_t address);
 using IllInstHandler = void(*)();
 using BranchTraceHandler = void(*)(uint32_t target);
+using InstructionCacheInvalidateHandler = void(*)(uint32_t address, uint32_t size);
+using HostSyncHandler = void(*)();
 using KernelCallFunction = void(*)(Core *state, void *userData);
 
 struct KernelCallEntry
@@ -74,6 +77,14 @@ setIllInstHandler(IllInstHandler handler);
 void
 setBranchTraceHandler(BranchTraceHandler handler);
 
+void
+setInstructionCacheInvalidateHandler(InstructionCacheInvalidateHandler handler);
+
+//! Called at every hand over in deterministic mode, must wait for host
+//!  threads to finish the work the guest has given them so far
+void
+setHostSyncHandler(HostSyncHandler handler);
+
 uint32_t
 registerKernelCall(const KernelCallEntry &entry);
 
@@ -89,6 +100,10 @@ halt();
 std::chrono::steady_clock::time_point
 tbToTimePoint(uint64_t ticks);
 
+//! Calibrates the host clock used for Core::tb(), done by initialise()
+void
+initialiseTimebase();
+
 using Tracer = ::Tracer;
 
 Tracer *
@@ -101,6 +116,10 @@ void
 interrupt(int core_idx,
           uint32_t flags);
 
+//! Raises PROFILER_INTERRUPT on every busy core at this interval, zero to stop
+void
+setProfilerInterval(std::chrono::nanoseconds interval);
+
 namespace this_core
 {
 
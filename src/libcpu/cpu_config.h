@@ -35,6 +35,24 @@ extern bool rodata_read_only;
 
 } // namespace jit
 
+namespace timing
+{
+
+//! When every core is idle waiting for an interrupt, skip the emulated clock
+//!  ahead to the next alarm instead of waiting for it in real time.
+extern bool idle_fast_forward;
+
+//! Run one core at a time in fixed quanta with a timebase counted from
+//!  retired instructions, so that runs can be reproduced. Always uses the
+//!  interpreter.
+extern bool deterministic;
+
+//! Read the timebase from the host TSC when it is invariant, which is much
+//!  cheaper than reading steady_clock
+extern bool use_tsc;
+
+} // namespace timing
+
 } // namespace config
 
 } // namespace cpu
@@ -46,6 +46,10 @@ struct CodeBlock
    //! Size of compiled code.
    uint32_t codeSize;
 
+   //! Number of guest instructions in the block, only set in deterministic
+   //!  mode where every block ends at its first branch.
+   uint32_t numInstructions;
+
    //! Profiling data.
    CodeBlockProfileData profileData;
 
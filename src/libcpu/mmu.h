@@ -93,6 +93,24 @@ bool
 virtualToPhysicalAddress(VirtualAddress virtualAddress,
                          PhysicalAddress &out);
 
+//! Size of the pages which write tracking works on.
+static constexpr uint32_t WriteTrackingPageSize = 4096;
+
+uint32_t
+trackMemoryWrites(VirtualAddress address,
+                  uint32_t size);
+
+bool
+isMemoryWritten(VirtualAddress address,
+                uint32_t size,
+                uint32_t sequence);
+
+//! Records a host write through the physical mapping, which write tracking
+//!  can not see, on every virtual mapping of the range.
+void
+markPhysicalMemoryWritten(PhysicalAddress address,
+                          uint32_t size);
+
 template<typename Type>
 inline VirtualAddress
 translate(Type *pointer)
@@ -1,6 +1,7 @@
 #include "cpu.h"
 #include "cpu_config.h"
 #include "cpu_internal.h"
+#include "cpu_timebase.h"
 #include "espresso/espresso_instructionset.h"
 #include "interpreter/interpreter.h"
 #include "jit/jit.h"
@@ -12,6 +13,9 @@
 #include <cfenv>
 #include <chrono>
 #include <common/decaf_assert.h>
+#include <common/log.h>
+#include <common/perftrace.h>
+#include <common/platform_compiler.h>
 #include <common/platform_exception.h>
 #include <common/platform_thread.h>
 #include <condition_variable>
@@ -27,6 +31,11 @@ gRunning;
 std::chrono::time_point<std::chrono::steady_clock>
 sStartupTime;
 
+//! Nanoseconds the emulated clock has been moved ahead of the host clock by
+//!  idle fast forward.
+std::atomic<int64_t>
+gSkippedTime { 0 };
+
 EntrypointHandler
 gCoreEntryPointHandler;
 
@@ -39,6 +48,9 @@ gIllInstHandler;
 BranchTraceHandler
 gBranchTraceHandler;
 
+static InstructionCacheInvalidateHandler
+sInstructionCacheInvalidateHandler;
+
 jit_mode
 gJitMode = jit_mode::disabled;
 
@@ -66,9 +78,15 @@ sSegfaultAddr = 0;
 void
 initialise()
 {
+   gDeterministic = config::timing::deterministic;
+
    // Setup config options
    if (config::jit::enabled) {
-      if (config::jit::verify) {
+      if (config::jit::verify && gDeterministic) {
+         // Verification runs blocks outside the deterministic dispatch loop
+         gLog->warn("JIT verification is not supported in deterministic mode");
+         gJitMode = jit_mode::enabled;
+      } else if (config::jit::verify) {
          gJitMode = jit_mode::verify;
          gJitVerifyAddress = config::jit::verify_addr;
       } else {
@@ -92,7 +110,13 @@ initialise()
       jit::setBackend(backend);
    }
 
-   sStartupTime = std::chrono::steady_clock::now();
+   initialiseTimebase();
+}
+
+void
+initialiseTimebase()
+{
+   calibrateTimebase(sStartupTime);
 }
 
 void
@@ -106,6 +130,10 @@ invalidateInstructionCache(uint32_t address,
                            uint32_t size)
 {
    cpu::jit::clearCache(address, size);
+
+   if (sInstructionCacheInvalidateHandler) {
+      sInstructionCacheInvalidateHandler(address, size);
+   }
 }
 
 void
@@ -141,11 +169,6 @@ exceptionHandler(platform::Exception *exception)
       return platform::UnhandledException;
    }
 
-   // Only handle exceptions from the CPU cores
-   if (this_core::id() >= 0xFF) {
-      return platform::UnhandledException;
-   }
-
    // Retreive the exception information
    auto info = reinterpret_cast<platform::AccessViolationException *>(exception);
    auto address = info->address;
@@ -156,6 +179,17 @@ exceptionHandler(platform::Exception *exception)
       return platform::UnhandledException;
    }
 
+   // Writes to write tracked pages can come from any thread, not just the
+   //  CPU cores, so these are checked first.
+   if (address != 0 && handleWriteTrackingFault(VirtualAddress { static_cast<uint32_t>(address - memBase) })) {
+      return platform::HandledException;
+   }
+
+   // Only handle exceptions from the CPU cores
+   if (this_core::id() >= 0xFF) {
+      return platform::UnhandledException;
+   }
+
    sSegfaultAddr = static_cast<uint32_t>(address - memBase);
    return coreSegfaultEntry;
 }
@@ -170,11 +204,24 @@ installExceptionHandler()
    }
 }
 
+static const std::string
+sCoreNames[] = { "Core #0", "Core #1", "Core #2" };
+
 void
 coreEntryPoint(Core *core)
 {
    tCurrentCore = core;
+   perftrace::setThreadName(sCoreNames[core->id].c_str());
+
+   if (gDeterministic) {
+      deterministicStart(core);
+   }
+
    gCoreEntryPointHandler();
+
+   if (gDeterministic) {
+      deterministicExit(core);
+   }
 }
 
 void
@@ -194,12 +241,14 @@ start()
       core->next_alarm = std::chrono::steady_clock::time_point::max();
       gCore[i] = core;
 
-      static const std::string coreNames[] = { "Core #0", "Core #1", "Core #2" };
-      platform::setThreadName(&core->thread, coreNames[i]);
+      platform::setThreadName(&core->thread, sCoreNames[i]);
    }
 
-   gTimerThread = std::thread { timerEntryPoint };
-   platform::setThreadName(&gTimerThread, "Timer Thread");
+   // Alarms are raised by the cores themselves in deterministic mode
+   if (!gDeterministic) {
+      gTimerThread = std::thread { timerEntryPoint };
+      platform::setThreadName(&gTimerThread, "Timer Thread");
+   }
 }
 
 void
@@ -221,6 +270,10 @@ join()
    if (gTimerThread.joinable()) {
       gTimerThread.join();
    }
+
+   if (gDeterministic) {
+      deterministicReport();
+   }
 }
 
 void
@@ -255,6 +308,29 @@ setBranchTraceHandler(BranchTraceHandler handler)
    gBranchTraceHandler = handler;
 }
 
+void
+setInstructionCacheInvalidateHandler(InstructionCacheInvalidateHandler handler)
+{
+   sInstructionCacheInvalidateHandler = handler;
+}
+
+std::chrono::steady_clock::time_point
+emulatedClockNow()
+{
+   if (gDeterministic) {
+      return tbToTimePoint(deterministicTimebase());
+   }
+
+   auto skipped = std::chrono::nanoseconds { gSkippedTime.load(std::memory_order_relaxed) };
+
+   if (gUseTsc) {
+      return tbToTimePoint(tscTimebase()) + skipped;
+   }
+
+   return std::chrono::steady_clock::now() + skipped;
+}
+
+// Returns a time point on the emulated clock, see emulatedClockNow
 std::chrono::steady_clock::time_point
 tbToTimePoint(uint64_t ticks)
 {
@@ -263,10 +339,31 @@ tbToTimePoint(uint64_t ticks)
    return sStartupTime + nanos;
 }
 
+uint64_t
+timePointToTb(std::chrono::steady_clock::time_point time)
+{
+   return std::chrono::duration_cast<TimerDuration>(time - sStartupTime).count();
+}
+
 uint64_t
 Core::tb()
 {
-   auto now = std::chrono::steady_clock::now();
+   if (gDeterministic) {
+      return deterministicTimebase();
+   }
+
+   if (LIKELY(gUseTsc)) {
+      auto ticks = tscTimebase();
+      auto skipped = gSkippedTime.load(std::memory_order_relaxed);
+
+      if (UNLIKELY(skipped)) {
+         ticks += std::chrono::duration_cast<TimerDuration>(std::chrono::nanoseconds { skipped }).count();
+      }
+
+      return ticks;
+   }
+
+   auto now = emulatedClockNow();
    auto ticks = std::chrono::duration_cast<TimerDuration>(now - sStartupTime);
    return ticks.count();
 }
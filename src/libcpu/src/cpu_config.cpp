@@ -32,6 +32,15 @@ std::vector<std::string> opt_flags =
 
 } // namespace jit
 
+namespace timing
+{
+
+bool idle_fast_forward = false;
+bool deterministic = false;
+bool use_tsc = true;
+
+} // namespace timing
+
 } // namespace config
 
 } // namespace cpu
@@ -0,0 +1,282 @@
+#include "cpu.h"
+#include "cpu_internal.h"
+
+#include <array>
+#include <atomic>
+#include <common/log.h>
+#include <condition_variable>
+#include <mutex>
+
+/**
+ * Deterministic execution mode.
+ *
+ * Only one core executes at a time. A core keeps the turn for a fixed
+ * quantum of retired work and then passes it to the next core, round
+ * robin. Retired work is counted in instructions, the interpreter counts
+ * every instruction and the JIT counts whole blocks, which end at their
+ * first branch in this mode so they always run straight through.
+ *
+ * The timebase counts retired work instead of host time. Alarms are raised
+ * when the turn changes hands rather than by the timer thread. Interrupts
+ * raised from host threads, such as the GPU, are held back and only
+ * delivered when the turn changes hands, after the host sync handler has
+ * waited for those threads to finish the work the guest gave them. That
+ * way an interrupt is delivered at the same hand over in every run, no
+ * matter how long the host took to raise it.
+ *
+ * A hash of the state of each core at every hand over is logged on exit. Two
+ * runs with the same hash executed the same way.
+ */
+
+namespace cpu
+{
+
+//! Instructions a core retires before passing the turn on
+static constexpr uint32_t QuantumSize = 20000;
+
+//! Instructions per timebase tick, one instruction per core clock cycle
+static constexpr uint64_t InstructionsPerTick = coreClockSpeed / timerClockSpeed;
+
+bool
+gDeterministic = false;
+
+static std::mutex
+sTurnMutex;
+
+static std::condition_variable
+sTurnCondition;
+
+//! Core which is allowed to run, protected by sTurnMutex
+static uint32_t
+sTurn = 0;
+
+//! Cores whose thread has exited, protected by sTurnMutex
+static std::array<bool, 3>
+sExited = { };
+
+//! Whether this host thread currently holds the turn
+static thread_local bool
+tHoldsTurn = false;
+
+//! Total instructions retired by every core, only written by the turn holder
+static std::atomic<uint64_t>
+sRetired { 0 };
+
+//! Instructions retired in the current quantum
+static uint32_t
+sQuantumRetired = 0;
+
+//! Number of consecutive turns handed over by idle cores
+static uint32_t
+sIdleTurns = 0;
+
+//! Interrupts raised by host threads which have not been delivered yet,
+//!  protected by gInterruptMutex
+static std::array<uint32_t, 3>
+sHeldInterrupts = { };
+
+static HostSyncHandler
+sHostSyncHandler = nullptr;
+
+static uint64_t
+sRunHash = 0xcbf29ce484222325ull;
+
+static void
+hashValue(uint64_t value)
+{
+   for (auto i = 0; i < 8; ++i) {
+      sRunHash ^= (value >> (i * 8)) & 0xFF;
+      sRunHash *= 0x100000001b3ull;
+   }
+}
+
+static uint32_t
+numLiveCores()
+{
+   auto count = 0u;
+
+   for (auto exited : sExited) {
+      if (!exited) {
+         ++count;
+      }
+   }
+
+   return count;
+}
+
+// Delivers held interrupts and due alarms, called with the turn held
+static void
+deliverInterrupts()
+{
+   if (sHostSyncHandler) {
+      sHostSyncHandler();
+   }
+
+   checkAlarms();
+
+   std::unique_lock<std::mutex> lock { gInterruptMutex };
+
+   for (auto i = 0u; i < sHeldInterrupts.size(); ++i) {
+      if (sHeldInterrupts[i]) {
+         gCore[i]->interrupt.fetch_or(sHeldInterrupts[i]);
+         sHeldInterrupts[i] = 0;
+      }
+   }
+}
+
+static void
+waitForTurn(std::unique_lock<std::mutex> &lock,
+            uint32_t id)
+{
+   sTurnCondition.wait(lock, [id]() { return sTurn == id; });
+   tHoldsTurn = true;
+}
+
+static void
+passTurn(Core *core)
+{
+   hashValue(core->id);
+   hashValue(core->nia);
+   hashValue(core->gpr[1]);
+   hashValue(core->gpr[3]);
+   hashValue(sRetired.load(std::memory_order_relaxed));
+   sQuantumRetired = 0;
+
+   std::unique_lock<std::mutex> lock { sTurnMutex };
+   auto next = core->id;
+
+   do {
+      next = (next + 1) % static_cast<uint32_t>(sExited.size());
+   } while (sExited[next] && next != core->id);
+
+   if (next != core->id) {
+      tHoldsTurn = false;
+      sTurn = next;
+      sTurnCondition.notify_all();
+      waitForTurn(lock, core->id);
+   }
+
+   lock.unlock();
+   deliverInterrupts();
+}
+
+void
+setHostSyncHandler(HostSyncHandler handler)
+{
+   sHostSyncHandler = handler;
+}
+
+void
+deterministicStart(Core *core)
+{
+   std::unique_lock<std::mutex> lock { sTurnMutex };
+   waitForTurn(lock, core->id);
+}
+
+void
+deterministicExit(Core *core)
+{
+   std::unique_lock<std::mutex> lock { sTurnMutex };
+   sExited[core->id] = true;
+   tHoldsTurn = false;
+
+   for (auto i = 1u; i <= sExited.size(); ++i) {
+      auto next = (core->id + i) % static_cast<uint32_t>(sExited.size());
+
+      if (!sExited[next]) {
+         sTurn = next;
+         break;
+      }
+   }
+
+   sTurnCondition.notify_all();
+}
+
+void
+deterministicRetire(Core *core,
+                    uint32_t units)
+{
+   sRetired.store(sRetired.load(std::memory_order_relaxed) + units,
+                  std::memory_order_relaxed);
+   sQuantumRetired += units;
+
+   if (sQuantumRetired >= QuantumSize) {
+      sIdleTurns = 0;
+      passTurn(core);
+   }
+}
+
+bool
+deterministicInterrupt(int core_idx,
+                       uint32_t flags)
+{
+   if (tHoldsTurn) {
+      return false;
+   }
+
+   // Called with gInterruptMutex held
+   sHeldInterrupts[core_idx] |= flags;
+   gInterruptCondition.notify_all();
+   return true;
+}
+
+void
+deterministicIdle(Core *core)
+{
+   // Handling an interrupt since our last turn counts as doing something
+   if (sQuantumRetired) {
+      sIdleTurns = 0;
+   }
+
+   if (++sIdleTurns < numLiveCores()) {
+      passTurn(core);
+      return;
+   }
+
+   // Every core has had a turn and found nothing to do, so jump to the next
+   //  alarm or failing that wait for a host thread to raise an interrupt.
+   sIdleTurns = 0;
+
+   auto next = checkAlarms();
+
+   if (next != std::chrono::steady_clock::time_point::max()) {
+      auto retired = (timePointToTb(next) + 1) * InstructionsPerTick;
+
+      if (retired > sRetired.load(std::memory_order_relaxed)) {
+         sRetired.store(retired, std::memory_order_relaxed);
+      }
+
+      checkAlarms();
+   } else {
+      std::unique_lock<std::mutex> lock { gInterruptMutex };
+      gInterruptCondition.wait(lock, []() {
+         // An interrupt the core has masked would not wake it
+         for (auto i = 0u; i < sHeldInterrupts.size(); ++i) {
+            auto mask = gCore[i]->interrupt_mask | NONMASKABLE_INTERRUPTS;
+
+            if ((sHeldInterrupts[i] | gCore[i]->interrupt.load()) & mask) {
+               return true;
+            }
+         }
+
+         return false;
+      });
+   }
+
+   passTurn(core);
+}
+
+uint64_t
+deterministicTimebase()
+{
+   return sRetired.load(std::memory_order_relaxed) / InstructionsPerTick;
+}
+
+void
+deterministicReport()
+{
+   gLog->info("Deterministic run hash {:016X} after {} instructions",
+              sRunHash, sRetired.load());
+}
+
+} // namespace cpu
@@ -3,7 +3,9 @@
 #include "mem.h"
 
 #include <array>
+#include <chrono>
 #include <condition_variable>
+#include <mutex>
 
 namespace cpu
 {
@@ -29,12 +31,56 @@ gJitMode;
 extern uint32_t
 gJitVerifyAddress;
 
+extern std::mutex
+gInterruptMutex;
+
+extern std::condition_variable
+gInterruptCondition;
+
 extern std::condition_variable
 gTimerCondition;
 
 extern std::thread
 gTimerThread;
 
+extern std::atomic<int64_t>
+gSkippedTime;
+
+extern bool
+gDeterministic;
+
+std::chrono::steady_clock::time_point
+emulatedClockNow();
+
+uint64_t
+timePointToTb(std::chrono::steady_clock::time_point time);
+
+std::chrono::steady_clock::time_point
+checkAlarms();
+
+void
+deterministicStart(Core *core);
+
+void
+deterministicExit(Core *core);
+
+void
+deterministicRetire(Core *core,
+                    uint32_t units);
+
+bool
+deterministicInterrupt(int core_idx,
+                       uint32_t flags);
+
+void
+deterministicIdle(Core *core);
+
+uint64_t
+deterministicTimebase();
+
+void
+deterministicReport();
+
 void
 timerEntryPoint();
 
@@ -44,6 +90,9 @@ getKernelCall(uint32_t id);
 bool
 initialiseMemory();
 
+bool
+handleWriteTrackingFault(VirtualAddress address);
+
 namespace this_core
 {
 
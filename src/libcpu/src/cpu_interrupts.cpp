@@ -1,10 +1,13 @@
 #include "cpu.h"
 #include "cpu_breakpoints.h"
+#include "cpu_config.h"
 #include "cpu_internal.h"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <common/decaf_assert.h>
 #include <condition_variable>
-#include <atomic>
 
 namespace cpu
 {
@@ -27,6 +30,22 @@ gTimerCondition;
 std::thread
 gTimerThread;
 
+//! Cores blocked in waitForInterrupt, protected by gInterruptMutex.
+static std::array<bool, 3>
+sCoreIdle = { };
+
+//! Number of cores set in sCoreIdle, read by the timer thread without the lock
+static std::atomic<uint32_t>
+sIdleCores { 0 };
+
+//! Interval between profiler samples, zero when not profiling, protected by gTimerMutex
+static std::chrono::nanoseconds
+sProfilerInterval { 0 };
+
+//! Host time of the next profiler sample, protected by gTimerMutex
+static std::chrono::steady_clock::time_point
+sNextProfilerSample;
+
 void
 setInterruptHandler(InterruptHandler handler)
 {
@@ -37,33 +56,127 @@ void
 interrupt(int core_idx, uint32_t flags)
 {
    std::unique_lock<std::mutex> lock { gInterruptMutex };
+
+   if (gDeterministic && deterministicInterrupt(core_idx, flags)) {
+      return;
+   }
+
    gCore[core_idx]->interrupt.fetch_or(flags);
+
+   // Mark the core busy now rather than when it wakes so the timer thread
+   //  can not skip time again in between
+   if (sCoreIdle[core_idx]) {
+      sCoreIdle[core_idx] = false;
+      --sIdleCores;
+   }
+
    gInterruptCondition.notify_all();
 }
 
+// Raises ALARM_INTERRUPT on cores whose alarm is due and returns the time of
+//  the next alarm, must be called with gTimerMutex held.
+static std::chrono::steady_clock::time_point
+triggerAlarms(std::chrono::steady_clock::time_point now)
+{
+   auto next = std::chrono::steady_clock::time_point::max();
+
+   for (auto i = 0; i < 3; ++i) {
+      auto core = gCore[i];
+
+      if (core->next_alarm <= now) {
+         core->next_alarm = std::chrono::steady_clock::time_point::max();
+         cpu::interrupt(i, ALARM_INTERRUPT);
+      } else if (core->next_alarm < next) {
+         next = core->next_alarm;
+      }
+   }
+
+   return next;
+}
+
+// Raises PROFILER_INTERRUPT on cores which are running when a sample is due and
+//  returns the host time of the next sample, must be called with gTimerMutex held.
+static std::chrono::steady_clock::time_point
+triggerProfilerSamples()
+{
+   // Host timed interrupts would change the course of a deterministic run
+   if (sProfilerInterval.count() == 0 || gDeterministic) {
+      return std::chrono::steady_clock::time_point::max();
+   }
+
+   auto now = std::chrono::steady_clock::now();
+
+   if (now >= sNextProfilerSample) {
+      std::unique_lock<std::mutex> lock { gInterruptMutex };
+
+      for (auto i = 0u; i < gCore.size(); ++i) {
+         // Waking an idle core would only sample its wait loop
+         if (!sCoreIdle[i]) {
+            gCore[i]->interrupt.fetch_or(PROFILER_INTERRUPT);
+         }
+      }
+
+      sNextProfilerSample += sProfilerInterval;
+
+      // Drop any samples we were too late for rather than raise them at once
+      if (sNextProfilerSample <= now) {
+         sNextProfilerSample = now + sProfilerInterval;
+      }
+   }
+
+   return sNextProfilerSample;
+}
+
+void
+setProfilerInterval(std::chrono::nanoseconds interval)
+{
+   std::unique_lock<std::mutex> lock { gTimerMutex };
+   sProfilerInterval = interval;
+   sNextProfilerSample = std::chrono::steady_clock::now() + interval;
+   gTimerCondition.notify_all();
+}
+
+std::chrono::steady_clock::time_point
+checkAlarms()
+{
+   std::unique_lock<std::mutex> lock { gTimerMutex };
+   return triggerAlarms(emulatedClockNow());
+}
+
 void
 timerEntryPoint()
 {
    while (gRunning.load()) {
       std::unique_lock<std::mutex> lock{ gTimerMutex };
-      auto now = std::chrono::steady_clock::now();
-      auto next = std::chrono::steady_clock::time_point::max();
-      bool timedWait = false;
-
-      for (auto i = 0; i < 3; ++i) {
-         auto core = gCore[i];
-
-         if (core->next_alarm <= now) {
-            core->next_alarm = std::chrono::steady_clock::time_point::max();
-            cpu::interrupt(i, ALARM_INTERRUPT);
-         } else if (core->next_alarm < next) {
-            next = core->next_alarm;
-            timedWait = true;
-         }
+      auto now = emulatedClockNow();
+      auto next = triggerAlarms(now);
+      auto nextSample = triggerProfilerSamples();
+      auto timedWait = (next != std::chrono::steady_clock::time_point::max());
+
+      if (timedWait && config::timing::idle_fast_forward && sIdleCores.load() == gCore.size()) {
+         // Nothing can run until an interrupt arrives, so rather than wait for
+         //  the alarm jump the emulated clock straight to it.  Interrupts from
+         //  the GPU may still be pending, we just let time pass faster for them.
+         auto skip = std::chrono::duration_cast<std::chrono::nanoseconds>(next - now);
+         gSkippedTime.fetch_add(skip.count());
+         continue;
       }
 
       if (timedWait) {
-         gTimerCondition.wait_until(lock, next);
+         // Alarms are on the emulated clock, which may be driven by the TSC
+         //  rather than steady_clock, so wait for how far away the alarm is on
+         //  the emulated clock instead of until a steady_clock time point.
+         //  Otherwise any difference in rate between the two clocks would add
+         //  up over the uptime.
+         auto wait = next - now;
+
+         if (nextSample != std::chrono::steady_clock::time_point::max()) {
+            wait = std::min(wait, nextSample - std::chrono::steady_clock::now());
+         }
+
+         gTimerCondition.wait_for(lock, wait);
+      } else if (nextSample != std::chrono::steady_clock::time_point::max()) {
+         gTimerCondition.wait_until(lock, nextSample);
       } else {
          gTimerCondition.wait(lock);
       }
@@ -101,8 +214,9 @@ checkInterrupts()
    auto mask = core->interrupt_mask | NONMASKABLE_INTERRUPTS;
    auto flags = core->interrupt.fetch_and(~mask);
 
+   // Interrupts outside the mask stay pending, so do not pass them on
    if (flags & mask) {
-      cpu::gInterruptHandler(flags);
+      cpu::gInterruptHandler(flags & mask);
    }
 }
 
@@ -122,11 +236,42 @@ waitForInterrupt()
 
       if (flags & mask) {
          lock.unlock();
-         gInterruptHandler(flags);
+         gInterruptHandler(flags & mask);
          lock.lock();
-      } else {
+         continue;
+      }
+
+      if (gDeterministic) {
+         // Rather than block, let the other cores run until we have an interrupt
+         lock.unlock();
+         deterministicIdle(core);
+         lock.lock();
+         continue;
+      }
+
+      sCoreIdle[core->id] = true;
+      auto idleCores = ++sIdleCores;
+
+      if (config::timing::idle_fast_forward && idleCores == gCore.size()) {
+         // Wake the timer thread so it can skip ahead to the next alarm, we
+         //  must not hold gInterruptMutex while taking gTimerMutex.
+         lock.unlock();
+         {
+            std::unique_lock<std::mutex> timerLock { gTimerMutex };
+            gTimerCondition.notify_all();
+         }
+         lock.lock();
+      }
+
+      // An interrupt may have arrived while we did not hold the lock
+      if (!(core->interrupt.load() & mask)) {
          gInterruptCondition.wait(lock);
       }
+
+      if (sCoreIdle[core->id]) {
+         sCoreIdle[core->id] = false;
+         --sIdleCores;
+      }
    }
 }
 
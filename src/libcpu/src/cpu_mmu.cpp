@@ -1,12 +1,61 @@
+#include "cpu_internal.h"
 #include "mmu.h"
 #include "memorymap.h"
 
+#include <algorithm>
+#include <atomic>
+#include <common/platform_memory.h>
+#include <memory>
+#include <mutex>
+
 namespace cpu
 {
 
 static MemoryMap
 sMemoryMap;
 
+enum WriteTrackingState : uint8_t
+{
+   //! Page is writable, any writes to it are not being tracked.
+   Unprotected,
+
+   //! Page is write protected, the next write will fault.
+   Protected,
+
+   //! Page has been written and is currently being unprotected.
+   Unprotecting,
+};
+
+static constexpr uint32_t
+NumWriteTrackingPages = static_cast<uint32_t>(0x100000000ull / WriteTrackingPageSize);
+
+struct WriteTrackingPages
+{
+   std::unique_ptr<std::atomic<uint8_t>[]> state;
+   std::unique_ptr<std::atomic<uint32_t>[]> lastWrite;
+};
+
+static std::once_flag
+sWriteTrackingOnce;
+
+static std::atomic<WriteTrackingPages *>
+sWriteTracking { nullptr };
+
+static std::atomic<uint32_t>
+sWriteSequence { 0 };
+
+//! Page and lastWrite of the last fault this thread retried after finding
+//!  the page already unprotected, used to detect a genuine write fault.
+static thread_local uint32_t
+tRetriedPage = 0xFFFFFFFF;
+
+static thread_local uint32_t
+tRetriedPageWrite = 0;
+
+static void
+resetWriteTracking(VirtualAddress address,
+                   uint32_t size);
+
 bool
 initialiseMemory()
 {
@@ -48,6 +97,7 @@ mapMemory(VirtualAddress virtualAddress,
           uint32_t size,
           MapPermission permission)
 {
+   resetWriteTracking(virtualAddress, size);
    return sMemoryMap.mapMemory(virtualAddress, physicalAddress, size, permission);
 }
 
@@ -55,6 +105,7 @@ bool
 unmapMemory(VirtualAddress virtualAddress,
             uint32_t size)
 {
+   resetWriteTracking(virtualAddress, size);
    return sMemoryMap.unmapMemory(virtualAddress, size);
 }
 
@@ -78,4 +129,196 @@ virtualToPhysicalAddress(VirtualAddress virtualAddress,
    return sMemoryMap.virtualToPhysicalAddress(virtualAddress, out);
 }
 
+
+/*
+ * Write tracking works by write protecting the host pages which back guest
+ * memory, the first write to a page faults and handleWriteTrackingFault
+ * records the write and makes the page writable again.
+ *
+ * Every recorded write increments a sequence number, so a caller can tell
+ * whether a range has been written since it last called trackMemoryWrites
+ * even if somebody else has since re-protected the same pages.
+ *
+ * trackMemoryWrites is expected to only be called from a single thread.
+ *
+ * Only the virtual mapping is protected, the host writes to guest memory
+ * through the physical mapping, such as IOS file reads, do not fault and must
+ * be recorded with markPhysicalMemoryWritten.
+ */
+static WriteTrackingPages *
+getWriteTracking()
+{
+   std::call_once(sWriteTrackingOnce, []() {
+      if (platform::getSystemPageSize() != WriteTrackingPageSize) {
+         return;
+      }
+
+      auto pages = new WriteTrackingPages { };
+      pages->state.reset(new std::atomic<uint8_t>[NumWriteTrackingPages]);
+      pages->lastWrite.reset(new std::atomic<uint32_t>[NumWriteTrackingPages]);
+
+      for (auto i = 0u; i < NumWriteTrackingPages; ++i) {
+         pages->state[i].store(Unprotected, std::memory_order_relaxed);
+         pages->lastWrite[i].store(0, std::memory_order_relaxed);
+      }
+
+      sWriteTracking.store(pages);
+   });
+
+   return sWriteTracking.load();
+}
+
+static void
+resetWriteTracking(VirtualAddress address,
+                   uint32_t size)
+{
+   auto pages = sWriteTracking.load();
+
+   if (!pages || !size) {
+      return;
+   }
+
+   // Mapping memory resets the page protection, treat the pages as written
+   auto first = address.getAddress() / WriteTrackingPageSize;
+   auto last = (address.getAddress() + (size - 1)) / WriteTrackingPageSize;
+   auto sequence = ++sWriteSequence;
+
+   for (auto page = first; page <= last; ++page) {
+      pages->lastWrite[page].store(sequence);
+      pages->state[page].store(Unprotected);
+   }
+}
+
+uint32_t
+trackMemoryWrites(VirtualAddress address,
+                  uint32_t size)
+{
+   auto pages = getWriteTracking();
+   auto sequence = sWriteSequence.load();
+
+   if (!pages || !size) {
+      return sequence;
+   }
+
+   auto first = address.getAddress() / WriteTrackingPageSize;
+   auto last = (address.getAddress() + (size - 1)) / WriteTrackingPageSize;
+
+   for (auto page = first; page <= last; ++page) {
+      if (pages->state[page].load() != Unprotected) {
+         continue;
+      }
+
+      auto pageAddress = VirtualAddress { page * WriteTrackingPageSize };
+
+      // Never track read only memory as we would make it writable again
+      if (queryVirtualAddress(pageAddress) != VirtualMemoryType::MappedReadWrite) {
+         continue;
+      }
+
+      // The state must be set before protecting, otherwise a write could
+      //  fault on a page which the fault handler does not think is protected.
+      pages->state[page].store(Protected);
+      platform::protectMemory(getBaseVirtualAddress() + pageAddress.getAddress(),
+                              WriteTrackingPageSize,
+                              platform::ProtectFlags::ReadOnly);
+   }
+
+   return sequence;
+}
+
+bool
+isMemoryWritten(VirtualAddress address,
+                uint32_t size,
+                uint32_t sequence)
+{
+   auto pages = sWriteTracking.load();
+
+   if (!pages) {
+      return true;
+   }
+
+   auto first = address.getAddress() / WriteTrackingPageSize;
+   auto last = (address.getAddress() + (std::max(size, 1u) - 1)) / WriteTrackingPageSize;
+
+   for (auto page = first; page <= last; ++page) {
+      if (pages->state[page].load() != Protected) {
+         return true;
+      }
+
+      // Careful with wraparound, this is signed(lastWrite - sequence) > 0
+      auto diff = pages->lastWrite[page].load() - sequence;
+
+      if (diff != 0 && diff <= 0x7FFFFFFF) {
+         return true;
+      }
+   }
+
+   return false;
+}
+
+bool
+handleWriteTrackingFault(VirtualAddress address)
+{
+   auto pages = sWriteTracking.load();
+
+   if (!pages) {
+      return false;
+   }
+
+   auto page = address.getAddress() / WriteTrackingPageSize;
+   auto expected = static_cast<uint8_t>(Protected);
+
+   if (!pages->state[page].compare_exchange_strong(expected, Unprotecting)) {
+      if (expected == Unprotecting) {
+         // Another thread is already unprotecting the page, we just need to
+         //  retry the write once it has finished.
+         return true;
+      }
+
+      // Another thread may have unprotected the page between our write
+      //  faulting and us getting here, in which case the write can just be
+      //  retried. If the retry faults again with no write recorded in between
+      //  then the page was never writable and this is a genuine fault.
+      auto lastWrite = pages->lastWrite[page].load();
+
+      if (tRetriedPage == page && tRetriedPageWrite == lastWrite) {
+         tRetriedPage = 0xFFFFFFFF;
+         return false;
+      }
+
+      tRetriedPage = page;
+      tRetriedPageWrite = lastWrite;
+      return true;
+   }
+
+   pages->lastWrite[page].store(++sWriteSequence);
+   platform::protectMemory(getBaseVirtualAddress() + page * WriteTrackingPageSize,
+                           WriteTrackingPageSize,
+                           platform::ProtectFlags::ReadWrite);
+   pages->state[page].store(Unprotected);
+   return true;
+}
+
+void
+markPhysicalMemoryWritten(PhysicalAddress address,
+                          uint32_t size)
+{
+   auto pages = sWriteTracking.load();
+
+   if (!pages || !size) {
+      return;
+   }
+
+   auto sequence = ++sWriteSequence;
+
+   for (auto &range : sMemoryMap.physicalToVirtualRanges(address, size)) {
+      auto first = range.start.getAddress() / WriteTrackingPageSize;
+      auto last = (range.start.getAddress() + (range.size - 1)) / WriteTrackingPageSize;
+
+      for (auto page = first; page <= last; ++page) {
+         pages->lastWrite[page].store(sequence);
+      }
+   }
+}
+
 } // namespace cpu
@@ -0,0 +1,115 @@
+#include "cpu_config.h"
+#include "cpu_timebase.h"
+#include "state.h"
+
+#include <cmath>
+#include <common/log.h>
+#include <thread>
+
+#if defined(PLATFORM_X86) && !defined(_MSC_VER)
+#include <cpuid.h>
+#endif
+
+namespace cpu
+{
+
+bool
+gUseTsc = false;
+
+uint64_t
+gTscStart = 0;
+
+uint64_t
+gTscScale = 0;
+
+static bool
+hasInvariantTsc()
+{
+#ifndef PLATFORM_X86
+   return false;
+#elif defined(_MSC_VER)
+   int regs[4];
+   __cpuid(regs, 0x80000000);
+
+   if (static_cast<uint32_t>(regs[0]) < 0x80000007) {
+      return false;
+   }
+
+   __cpuid(regs, 0x80000007);
+   return !!(regs[3] & (1 << 8));
+#else
+   unsigned int eax, ebx, ecx, edx;
+
+   if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx)) {
+      return false;
+   }
+
+   return !!(edx & (1 << 8));
+#endif
+}
+
+//! Measured TSC frequency, kept so only the first calibration has to wait
+static double
+sTscFrequency = 0.0;
+
+static double
+measureTscFrequency(std::chrono::milliseconds interval)
+{
+   auto start = std::chrono::steady_clock::now();
+   auto tscStart = platform::readCycleCounter();
+   std::this_thread::sleep_for(interval);
+   auto end = std::chrono::steady_clock::now();
+   auto tscEnd = platform::readCycleCounter();
+
+   auto seconds = std::chrono::duration<double> { end - start }.count();
+   return static_cast<double>(tscEnd - tscStart) / seconds;
+}
+
+/**
+ * Reading steady_clock and converting it to timebase ticks costs far more
+ * than reading the TSC and multiplying it by a fixed point scale, which adds
+ * up for games which poll the timebase in busy loops.
+ *
+ * We only use the TSC when the CPU reports it as invariant and it ticks at
+ * the same rate over two consecutive measurements, otherwise the timebase
+ * falls back to steady_clock. The two measurements are the only way we have
+ * to spot a TSC which does not tick at a constant rate, so they are taken
+ * once per process and reused by later calibrations. 50ms is small next to
+ * loading a title, and a shorter interval makes the 0.1% agreement check
+ * fail on scheduler noise alone.
+ *
+ * The TSC frequency is only known to within that 0.1%, which is why the
+ * timer thread measures how long to wait on the emulated clock.
+ */
+void
+calibrateTimebase(std::chrono::steady_clock::time_point &startupTime)
+{
+   gUseTsc = false;
+
+   if (!config::timing::use_tsc) {
+      gLog->info("Using steady_clock for the timebase");
+   } else if (!hasInvariantTsc()) {
+      gLog->info("Using steady_clock for the timebase, host TSC is not invariant");
+   } else if (sTscFrequency > 0.0) {
+      gUseTsc = true;
+   } else {
+      auto interval = std::chrono::milliseconds { 25 };
+      auto first = measureTscFrequency(interval);
+      auto second = measureTscFrequency(interval);
+
+      if (first > 0.0 && std::abs(first - second) / first < 0.001) {
+         sTscFrequency = (first + second) / 2.0;
+         gTscScale = static_cast<uint64_t>(timerClockSpeed * 4294967296.0 / sTscFrequency);
+         gUseTsc = true;
+         gLog->info("Using {:.2f} MHz host TSC for the timebase", sTscFrequency / 1000000.0);
+      } else {
+         gLog->warn("Using steady_clock for the timebase, host TSC measured {} and {} Hz",
+                    first, second);
+      }
+   }
+
+   startupTime = std::chrono::steady_clock::now();
+   gTscStart = platform::readCycleCounter();
+}
+
+} // namespace cpu
@@ -0,0 +1,31 @@
+#pragma once
+#include <chrono>
+#include <common/bitutils.h>
+#include <common/platform_time.h>
+#include <cstdint>
+
+namespace cpu
+{
+
+//! Set when the timebase is read from a calibrated invariant TSC
+extern bool
+gUseTsc;
+
+//! TSC value at sStartupTime
+extern uint64_t
+gTscStart;
+
+//! Timebase ticks per TSC tick as 32.32 fixed point
+extern uint64_t
+gTscScale;
+
+inline uint64_t
+tscTimebase()
+{
+   return mul_fixed32(platform::readCycleCounter() - gTscStart, gTscScale);
+}
+
+void
+calibrateTimebase(std::chrono::steady_clock::time_point &startupTime);
+
+} // namespace cpu
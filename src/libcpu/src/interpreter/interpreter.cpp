@@ -111,6 +111,10 @@ resume()
    while (core->nia != cpu::CALLBACK_ADDR) {
       this_core::checkInterrupts();
       core = step_one(this_core::state());
+
+      if (gDeterministic) {
+         deterministicRetire(core, 1);
+      }
    }
 }
 
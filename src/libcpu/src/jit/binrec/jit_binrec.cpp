@@ -11,6 +11,7 @@
 #include <common/bitutils.h>
 #include <common/decaf_assert.h>
 #include <common/log.h>
+#include <common/perftrace.h>
 #include <cstdlib>
 #include <fmt/format.h>
 
@@ -153,7 +154,8 @@ BinrecBackend::createBinrecHandle()
 
    handle->set_optimization_flags(mOptFlags.common, mOptFlags.guest, mOptFlags.host);
    handle->enable_branch_exit_test(true);
-   handle->enable_chaining(mOptFlags.useChaining);
+   // Chained blocks would not return to the dispatch loop to be counted
+   handle->enable_chaining(mOptFlags.useChaining && !gDeterministic);
 
    if (gJitMode == jit_mode::verify && gJitVerifyAddress == 0) {
       handle->set_pre_insn_callback(brVerifyPreHandler);
@@ -167,6 +169,46 @@ BinrecBackend::createBinrecHandle()
    return handle;
 }
 
+/**
+ * Returns the number of bytes of code from address up to and including the
+ * first instruction which can leave the block, at most limit bytes.
+ *
+ * In deterministic mode blocks are cut there so they always run straight
+ * through: we know exactly how many instructions each one retires, and a
+ * loop always goes back through the dispatch loop where the turn can be
+ * passed on.
+ */
+static uint32_t
+getStraightLineSize(uint32_t address,
+                    uint32_t limit)
+{
+   for (auto offset = 0u; offset < limit; offset += 4) {
+      auto instr = mem::read<espresso::Instruction>(address + offset);
+      auto data = espresso::decodeInstruction(instr);
+
+      if (!data) {
+         return offset + 4;
+      }
+
+      switch (data->id) {
+      case espresso::InstructionID::b:
+      case espresso::InstructionID::bc:
+      case espresso::InstructionID::bcctr:
+      case espresso::InstructionID::bclr:
+      case espresso::InstructionID::kc:
+      case espresso::InstructionID::rfi:
+      case espresso::InstructionID::sc:
+      case espresso::InstructionID::tw:
+      case espresso::InstructionID::twi:
+         return offset + 4;
+      default:
+         break;
+      }
+   }
+
+   return limit;
+}
+
 CodeBlock *
 BinrecBackend::checkForCodeBlockTrampoline(uint32_t address)
 {
@@ -242,11 +284,16 @@ BinrecBackend::getCodeBlock(BinrecCore *core, uint32_t address)
       return nullptr;
    }
 
-   // Check for possible branch trampoline
-   if (auto block = checkForCodeBlockTrampoline(address)) {
-      return block;
+   // Check for possible branch trampoline, which would skip counting the
+   //  branch in deterministic mode.
+   if (!gDeterministic) {
+      if (auto block = checkForCodeBlockTrampoline(address)) {
+         return block;
+      }
    }
 
+   PERFTRACE_ZONE("jit", "translate");
+
    auto handle = mHandles[core->id];
    if (!handle) {
       handle = createBinrecHandle();
@@ -271,8 +318,12 @@ BinrecBackend::getCodeBlock(BinrecCore *core, uint32_t address)
    auto size = long { 0 };
    void *buffer = nullptr;
 
+   if (gDeterministic) {
+      limit = getStraightLineSize(address, limit);
+   }
+
    while (!handle->translate(core, address, address + limit - 1, &buffer, &size)) {
-      limit /= 2;
+      limit = (limit / 2) & ~3u;
 
       if (limit < 256) {
          gLog->warn("Failed to translate code at 0x{:X}", address);
@@ -295,7 +346,8 @@ BinrecBackend::getCodeBlock(BinrecCore *core, uint32_t address)
    auto unwindSize = size_t { 0 };
 #endif
 
-   auto block = mCodeCache.registerCodeBlock(address, code, codeSize, unwindInfo, unwindSize);
+   auto numInstructions = gDeterministic ? limit / 4 : 0u;
+   auto block = mCodeCache.registerCodeBlock(address, code, codeSize, unwindInfo, unwindSize, numInstructions);
    decaf_check(block);
    free(buffer);
 
@@ -412,6 +464,10 @@ BinrecBackend::resumeExecution()
             block->profileData.count++;
          }
       }
+
+      if (UNLIKELY(gDeterministic)) {
+         deterministicRetire(core, block ? block->numInstructions : 1);
+      }
    } while (core->nia != CALLBACK_ADDR);
 }
 
@@ -132,7 +132,8 @@ public:
                      void *code,
                      size_t size,
                      void *unwindInfo,
-                     size_t unwindSize);
+                     size_t unwindSize,
+                     uint32_t numInstructions = 0);
 
 
 private:
@@ -323,6 +323,34 @@ MemoryMap::virtualToPhysicalAddress(VirtualAddress virtualAddress,
    return false;
 }
 
+
+/**
+ * Returns the parts of every virtual mapping which map the physical range,
+ * physical memory can be mapped at more than one virtual address.
+ */
+std::vector<VirtualAddressRange>
+MemoryMap::physicalToVirtualRanges(PhysicalAddress physicalAddress,
+                                   uint32_t size)
+{
+   auto ranges = std::vector<VirtualAddressRange> { };
+   auto physicalEnd = physicalAddress + (size - 1);
+
+   for (auto &mapping : mMappedMemory) {
+      auto mappingEnd = mapping.physicalAddress + (mapping.size - 1);
+
+      if (mapping.physicalAddress > physicalEnd || mappingEnd < physicalAddress) {
+         continue;
+      }
+
+      auto start = std::max(mapping.physicalAddress, physicalAddress);
+      auto end = std::min(mappingEnd, physicalEnd);
+      ranges.emplace_back(mapping.virtualAddress + (start - mapping.physicalAddress),
+                          static_cast<uint32_t>(end - start + 1));
+   }
+
+   return ranges;
+}
+
 bool
 MemoryMap::allocateVirtualAddress(VirtualAddress start,
                                   uint32_t size)
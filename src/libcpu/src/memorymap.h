@@ -60,6 +60,10 @@ public:
    virtualToPhysicalAddress(VirtualAddress virtualAddress,
                             PhysicalAddress &out);
 
+   std::vector<VirtualAddressRange>
+   physicalToVirtualRanges(PhysicalAddress physicalAddress,
+                           uint32_t size);
+
    bool
    mapMemory(VirtualAddress virtualAddress,
              PhysicalAddress physicalAddress,
@@ -61,6 +61,15 @@ extern bool kernel_trace;
 //! Enable logging for all HLE function call results
 extern bool kernel_trace_res;
 
+//! Collect call counts and timings for every HLE function
+extern bool hle_stats;
+
+//! Path to write folded guest stack samples to for flamegraphs, empty to disable
+extern std::string profile_file;
+
+//! Number of guest stack samples to take per second on each core
+extern unsigned profile_rate;
+
 //! Enable logging of every branch which targets a known symbol
 extern bool branch_trace;
 
@@ -104,6 +113,12 @@ extern double time_scale;
 //! List of system modules to load LLE instead of HLE.
 extern std::vector<std::string> lle_modules;
 
+//! Port on localhost to serve Prometheus metrics over HTTP on, 0 to disable
+extern unsigned metrics_port;
+
+//! Path of a Unix socket to serve Prometheus metrics over HTTP on, empty to disable
+extern std::string metrics_socket;
+
 } // namespace system
 
 } // namespace config
@@ -0,0 +1,42 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace decaf
+{
+
+struct HleCallStats
+{
+   std::string module;
+   std::string name;
+
+   //! Number of times the function was called
+   uint64_t calls;
+
+   //! Host cycles spent in the function, excluding time rescheduled away
+   uint64_t cycles;
+
+   //! Calls which took [2^N, 2^(N+1)) host cycles are counted in bucket N
+   std::array<uint64_t, 32> histogram;
+};
+
+/**
+ * Returns the stats of every HLE function which has been called, sorted by
+ * total cycles spent in the function, most first.
+ *
+ * Stats are only collected when config::log::hle_stats is enabled.
+ */
+std::vector<HleCallStats>
+getHleCallStats();
+
+void
+resetHleCallStats();
+
+//! Estimates the given percentile of call time, in host cycles
+uint64_t
+getHleCallPercentile(const HleCallStats &stats,
+                     double percentile);
+
+} // namespace decaf
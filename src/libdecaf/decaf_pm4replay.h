@@ -1,6 +1,11 @@
 #pragma once
 #include <array>
+#include <common/platform_memory.h>
 #include <cstdint>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
 
 namespace decaf
 {
@@ -13,6 +18,36 @@ static const std::array<char, 4> CaptureMagic =
    'D', 'P', 'M', '4'
 };
 
+//! Magic of a capture whose packets are stored in zlib compressed chunks
+static const std::array<char, 4> CaptureMagicCompressed =
+{
+   'D', 'P', 'M', 'Z'
+};
+
+//! Magic of an indexed capture, which can be memory mapped
+static const std::array<char, 4> CaptureMagicIndexed =
+{
+   'D', 'P', 'M', 'X'
+};
+
+static const uint32_t CaptureIndexedVersion = 2;
+
+//! Alignment of every payload in an indexed capture
+static const uint32_t CapturePageSize = 4096;
+
+/**
+ * A compressed capture is the magic followed by a sequence of chunks. Each
+ * chunk is this header followed by compressedSize bytes of zlib data.
+ *
+ * The decompressed chunks joined together form the same packet stream as an
+ * uncompressed capture, a packet may be split across two chunks.
+ */
+struct CaptureChunk
+{
+   uint32_t compressedSize;
+   uint32_t uncompressedSize;
+};
+
 struct CapturePacket
 {
    enum Type : uint32_t
@@ -22,6 +57,8 @@ struct CapturePacket
       MemoryLoad,
       RegisterSnapshot,
       SetBuffer,
+      MemoryBlob,
+      MemoryLoadBlob,
    };
 
    Type type;
@@ -51,6 +88,31 @@ struct CaptureMemoryLoad
    uint32_t address;
 };
 
+/**
+ * Total size of the memory blobs the recorder and reader remember.
+ *
+ * When a new blob would take the blobs remembered since the last reset over
+ * this size both sides forget all of them before adding it, the recorder then
+ * writes a blob again the next time it is loaded. Both sides see the same
+ * blobs in the same order so they always agree on which blobs are known.
+ */
+static const uint64_t CaptureMaxBlobBytes = 256 * 1024 * 1024;
+
+//! Memory contents identified by their hash, followed by the data. A blob is
+//!  only written again once it has been forgotten, see CaptureMaxBlobBytes.
+struct CaptureMemoryBlob
+{
+   uint64_t hash[2];
+};
+
+//! A memory load whose data is in an earlier MemoryBlob packet
+struct CaptureMemoryLoadBlob
+{
+   CaptureMemoryLoad::MemoryType type;
+   uint32_t address;
+   uint64_t hash[2];
+};
+
 struct CaptureSetBuffer
 {
    enum Type : uint32_t
@@ -70,6 +132,161 @@ struct CaptureSetBuffer
    uint32_t height;
 };
 
+/**
+ * An indexed capture starts with this header. It is followed by the packet
+ * payloads, each aligned to CapturePageSize, then the packet index, then the
+ * frame index and finally a CaptureIndexFooter at the very end of the file.
+ *
+ * Payloads are stored exactly as they are used so a command buffer can be
+ * handed to the GPU straight from the mapped file. Memory loads only store
+ * the memory itself, identical loads share the same payload.
+ */
+struct CaptureIndexedHeader
+{
+   std::array<char, 4> magic;
+   uint32_t version;
+   uint32_t pageSize;
+   uint32_t reserved;
+};
+
+struct CaptureIndexPacket
+{
+   CapturePacket::Type type;
+
+   //! Type of memory for a MemoryLoad
+   CaptureMemoryLoad::MemoryType memoryType;
+
+   //! Destination address for a MemoryLoad
+   uint32_t address;
+
+   uint32_t size;
+   uint64_t offset;
+};
+
+//! A frame is every packet up to and including the command buffer which
+//!  contains the DECAF_SWAP_BUFFERS packet.
+struct CaptureIndexFrame
+{
+   uint32_t firstPacket;
+   uint32_t numPackets;
+};
+
+struct CaptureIndexFooter
+{
+   uint64_t packetsOffset;
+   uint64_t framesOffset;
+   uint32_t numPackets;
+   uint32_t numFrames;
+   uint32_t version;
+   std::array<char, 4> magic;
+};
+
+/**
+ * Memory maps an indexed capture, any frame can be read without reading the
+ * ones before it.
+ */
+class IndexedCapture
+{
+public:
+   ~IndexedCapture();
+
+   bool
+   open(const std::string &path);
+
+   void
+   close();
+
+   uint32_t
+   numFrames() const
+   {
+      return mFooter.numFrames;
+   }
+
+   uint32_t
+   numPackets() const
+   {
+      return mFooter.numPackets;
+   }
+
+   const CaptureIndexFrame &
+   frame(uint32_t index) const
+   {
+      return mFrames[index];
+   }
+
+   const CaptureIndexPacket &
+   packet(uint32_t index) const
+   {
+      return mPackets[index];
+   }
+
+   //! Pointer to the payload of a packet inside the mapped file
+   const uint8_t *
+   payload(const CaptureIndexPacket &packet) const
+   {
+      return mView + packet.offset;
+   }
+
+private:
+   platform::MapFileHandle mHandle = platform::InvalidMapFileHandle;
+   uint8_t *mView = nullptr;
+   size_t mSize = 0;
+   CaptureIndexFooter mFooter = { };
+   const CaptureIndexPacket *mPackets = nullptr;
+   const CaptureIndexFrame *mFrames = nullptr;
+};
+
+/**
+ * Reads the packets of an uncompressed, compressed or indexed capture in
+ * order.
+ *
+ * MemoryBlob packets are kept by the reader and MemoryLoadBlob packets are
+ * returned as MemoryLoad packets, so users only see the packet types of an
+ * uncompressed capture.
+ */
+class CaptureReader
+{
+public:
+   bool
+   open(const std::string &path);
+
+   //! Reads the next packet, data is everything which follows the header
+   bool
+   readPacket(CapturePacket &packet,
+              std::vector<uint8_t> &data);
+
+   bool
+   eof() const
+   {
+      return mEof;
+   }
+
+private:
+   bool
+   read(void *buffer,
+        size_t size);
+
+   bool
+   readChunk();
+
+private:
+   std::ifstream mFile;
+   IndexedCapture mIndexed;
+   bool mIsIndexed = false;
+   uint32_t mIndexedPacket = 0;
+   bool mCompressed = false;
+   bool mEof = false;
+   std::vector<uint8_t> mChunk;
+   size_t mChunkPos = 0;
+   std::map<std::array<uint64_t, 2>, std::vector<uint8_t>> mBlobs;
+   uint64_t mBlobBytes = 0;
+};
+
+//! Writes any capture out as an indexed capture
+bool
+convertToIndexedCapture(const std::string &src,
+                        const std::string &dst);
+
 void
 injectCommandBuffer(void *buffer,
                     uint32_t bytes);
@@ -25,6 +25,13 @@ public:
 
    virtual void
    stop() = 0;
+
+   // Number of times the output device has run out of samples to play.
+   virtual uint64_t
+   getUnderrunCount()
+   {
+      return 0;
+   }
 };
 
 void
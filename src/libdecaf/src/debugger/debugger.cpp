@@ -1,10 +1,13 @@
 #include "debugger.h"
+#include "debugger_analysis.h"
 #include "debugger_controller.h"
 #include "debugger_server_gdb.h"
 #include "debugger_ui.h"
 #include "debugger_ui_manager.h"
 #include "decaf.h"
 
+#include <libcpu/cpu.h>
+
 namespace debugger
 {
 
@@ -23,6 +26,7 @@ initialise(const std::string &config,
            ClipboardTextSetCallback setClipboardFn)
 {
    sUiManager.load(config, getClipboardFn, setClipboardFn);
+   cpu::setInstructionCacheInvalidateHandler(&analysis::invalidate);
 
    if (decaf::config::debugger::enabled
     && decaf::config::debugger::gdb_stub) {
@@ -35,6 +39,9 @@ shutdown()
 {
    // Force resume any paused cores.
    sController.resume();
+
+   cpu::setInstructionCacheInvalidateHandler(nullptr);
+   analysis::shutdown();
 }
 
 void
@@ -1,12 +1,22 @@
 #include "debugger_analysis.h"
 #include "debugger_branchcalc.h"
+#include "libcpu/cpu.h"
+#include "libcpu/cpu_breakpoints.h"
 #include "libcpu/espresso/espresso_instructionset.h"
 #include "libcpu/mem.h"
+#include "kernel/kernel.h"
 #include "kernel/kernel_loader.h"
 
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
 #include <fmt/format.h>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <unordered_map>
+#include <unordered_set>
 
 namespace debugger
 {
@@ -14,51 +24,168 @@ namespace debugger
 namespace analysis
 {
 
+static constexpr uint32_t PageShift = 12;
+static constexpr uint32_t PageSize = 1u << PageShift;
+
+struct BranchEntry
+{
+   uint32_t target;
+   uint32_t source;
+};
+
+static bool
+operator <(const BranchEntry &lhs, const BranchEntry &rhs)
+{
+   if (lhs.target != rhs.target) {
+      return lhs.target < rhs.target;
+   }
+
+   return lhs.source < rhs.source;
+}
+
+struct PageData
+{
+   //! Branches which originate from an instruction on this page.
+   std::vector<BranchEntry> outgoing;
+
+   //! Branches which target an instruction on this page, sorted by target.
+   std::vector<BranchEntry> incoming;
+
+   //! Whether the instructions on this page have been scanned.
+   bool scanned = false;
+};
+
+//! Protects sFuncData and sPages.
+static std::mutex
+sDataMutex;
+
 static std::map<uint32_t, FuncData, std::greater<uint32_t>>
 sFuncData;
 
-static std::unordered_map<uint32_t, InstrData>
-sInstrData;
+static std::unordered_map<uint32_t, std::unique_ptr<PageData>>
+sPages;
+
+//! Protects the work queue below.
+static std::mutex
+sQueueMutex;
+
+static std::condition_variable
+sQueueCondition;
+
+//! Pages waiting to be scanned by the worker thread, in order.
+static std::deque<uint32_t>
+sQueuedPages;
+
+//! Set of the pages in sQueuedPages, used to avoid queueing a page twice.
+static std::unordered_set<uint32_t>
+sQueuedPageSet;
+
+//! Every page which has ever been queued, invalidations of other pages
+//!  are not interesting to us.
+static std::unordered_set<uint32_t>
+sTrackedPages;
+
+//! Whether the worker thread should mark the loaded modules' symbols as
+//!  functions before it scans any more pages.
+static bool
+sMarkSymbolsQueued = false;
+
+static bool
+sWorkerBusy = false;
+
+//! Set by shutdown, after which no more work is queued and the worker
+//!  thread is never started again.
+static bool
+sWorkerStop = false;
+
+static std::thread
+sWorkerThread;
+
+static espresso::Instruction
+readInstruction(uint32_t address)
+{
+   // Read through any breakpoints so they do not affect the analysis
+   return cpu::getBreakpointSavedCode(address);
+}
+
+static PageData &
+getPage(uint32_t page)
+{
+   auto &data = sPages[page];
+
+   if (!data) {
+      data = std::make_unique<PageData>();
+   }
+
+   return *data;
+}
+
+static FuncData *
+findContainingFunction(uint32_t address)
+{
+   if (sFuncData.empty()) {
+      return nullptr;
+   }
+
+   auto funcIter = sFuncData.lower_bound(address);
+
+   if (funcIter == sFuncData.end()) {
+      return nullptr;
+   }
+
+   auto &func = funcIter->second;
+
+   if (address >= func.start && address < func.end) {
+      // The function needs to have an end, or be the first two instructions
+      //  since we apply some special display logic to the first two instructions
+      //  in a never-ending function...
+      if (func.end != 0xFFFFFFFF || (address == func.start || address == func.start + 4)) {
+         return &func;
+      }
+   }
+
+   return nullptr;
+}
 
-FuncData *
+std::optional<FuncData>
 getFunction(uint32_t address)
 {
+   std::unique_lock<std::mutex> lock { sDataMutex };
    auto funcIter = sFuncData.find(address);
 
    if (funcIter != sFuncData.end()) {
-      return &funcIter->second;
+      return funcIter->second;
    }
 
-   return nullptr;
+   return { };
 }
 
 InstrInfo
 get(uint32_t address)
 {
-   auto info = InstrInfo { 0 };
-   auto instrIter = sInstrData.find(address);
-
-   if (instrIter != sInstrData.end()) {
-      info.instr = &instrIter->second;
-   }
+   std::unique_lock<std::mutex> lock { sDataMutex };
+   auto info = InstrInfo { };
+   auto pageIter = sPages.find(address >> PageShift);
 
-   if (sFuncData.size() > 0) {
-      auto funcIter = sFuncData.lower_bound(address);
+   if (pageIter != sPages.end()) {
+      auto &incoming = pageIter->second->incoming;
+      auto itr = std::lower_bound(incoming.begin(), incoming.end(), BranchEntry { address, 0 });
 
-      if (funcIter != sFuncData.end()) {
-         auto &func = funcIter->second;
+      if (itr != incoming.end() && itr->target == address) {
+         auto instr = InstrData { };
 
-         if (address >= func.start && address < func.end) {
-            // The function needs to have an end, or be the first two instructions
-            //  since we apply some special display logic to the first two instructions
-            //  in a never-ending function...
-            if (func.end != 0xFFFFFFFF || (address == func.start || address == func.start + 4)) {
-               info.func = &func;
-            }
+         for (; itr != incoming.end() && itr->target == address; ++itr) {
+            instr.sourceBranches.push_back(itr->source);
          }
+
+         info.instr = std::move(instr);
       }
    }
 
+   if (auto func = findContainingFunction(address)) {
+      info.func = *func;
+   }
+
    return info;
 }
 
@@ -75,7 +202,7 @@ findFunctionEnd(uint32_t start)
          break;
       }
 
-      auto instr = mem::read<espresso::Instruction>(addr);
+      auto instr = readInstruction(addr);
       auto data = espresso::decodeInstruction(instr);
 
       if (!data) {
@@ -127,23 +254,38 @@ findFunctionEnd(uint32_t start)
    return fnEnd;
 }
 
-void
-markAsFunction(uint32_t address,
-               const std::string &name)
+static void
+markAsFunctionNoLock(uint32_t address,
+                     uint32_t end,
+                     const std::string &name)
 {
-   // We use get instead of searching the sFuncData directly
-   //  because we can't set a function in the middle of a function
-   auto info = get(address);
-
-   if (!info.func) {
+   // We can't set a function in the middle of a function
+   if (!findContainingFunction(address)) {
       FuncData func;
       func.start = address;
-      func.end = findFunctionEnd(address);
+      func.end = end;
       func.name = name;
       sFuncData.emplace(func.start, func);
    }
 }
 
+static void
+markAsFunction(uint32_t address,
+               const std::string &name)
+{
+   {
+      std::unique_lock<std::mutex> lock { sDataMutex };
+
+      if (findContainingFunction(address)) {
+         return;
+      }
+   }
+
+   auto end = findFunctionEnd(address);
+   std::unique_lock<std::mutex> lock { sDataMutex };
+   markAsFunctionNoLock(address, end, name);
+}
+
 void
 markAsFunction(uint32_t address)
 {
@@ -153,25 +295,98 @@ markAsFunction(uint32_t address)
 void
 toggleAsFunction(uint32_t address)
 {
-   auto fIter = sFuncData.find(address);
+   {
+      std::unique_lock<std::mutex> lock { sDataMutex };
+      auto fIter = sFuncData.find(address);
 
-   if (fIter != sFuncData.end()) {
-      sFuncData.erase(fIter);
-   } else {
-      markAsFunction(address);
+      if (fIter != sFuncData.end()) {
+         sFuncData.erase(fIter);
+         return;
+      }
    }
+
+   markAsFunction(address);
 }
 
-void
-analyse(uint32_t start,
-        uint32_t end)
+static void
+scanPage(uint32_t page)
 {
-   auto testStart = 0x025B81F4u;
-   auto testEnd = 0x25B8374u + 4;
+   auto start = page << PageShift;
+   auto end = start + PageSize;
+   auto outgoing = std::vector<BranchEntry> { };
+   auto calls = std::vector<FuncData> { };
+
+   // Decode the page without holding the lock so the UI is never stalled
+   //  waiting for us.
+   if (cpu::isValidAddress(cpu::VirtualAddress { start })) {
+      for (auto addr = start; addr < end; addr += 4) {
+         auto instr = readInstruction(addr);
+         auto data = espresso::decodeInstruction(instr);
+
+         if (!data || !isBranchInstr(data)) {
+            continue;
+         }
+
+         auto meta = getBranchMeta(addr, instr, data, nullptr);
+
+         if (!meta.isCall && !meta.isVariable) {
+            outgoing.push_back(BranchEntry { meta.target, addr });
+         }
+
+         // If this is a call, and its not variable, we should mark
+         //  the target as a function, since it likely is...
+         if (meta.isCall && !meta.isVariable) {
+            FuncData func;
+            func.start = meta.target;
+            func.end = findFunctionEnd(meta.target);
+            func.name = fmt::format("sub_{:08x}", meta.target);
+            calls.emplace_back(std::move(func));
+         }
+      }
+   }
+
+   std::unique_lock<std::mutex> lock { sDataMutex };
+   auto &data = getPage(page);
+
+   // Remove the results of any previous scan of this page
+   for (auto &branch : data.outgoing) {
+      auto &incoming = getPage(branch.target >> PageShift).incoming;
+      auto itr = std::lower_bound(incoming.begin(), incoming.end(), branch);
+
+      if (itr != incoming.end() && itr->target == branch.target && itr->source == branch.source) {
+         incoming.erase(itr);
+      }
+   }
 
-   // Scan through all our symbols and mark them as functions.
-   // We do this first as they will not receive names if they are
-   //  detected by the analysis pass due to its naming system.
+   for (auto &branch : outgoing) {
+      auto &incoming = getPage(branch.target >> PageShift).incoming;
+      incoming.insert(std::upper_bound(incoming.begin(), incoming.end(), branch), branch);
+   }
+
+   // Code on this page may have changed, so refresh the end of any function
+   //  which we previously found starting here.
+   if (data.scanned) {
+      for (auto funcIter = sFuncData.lower_bound(end - 4);
+           funcIter != sFuncData.end() && funcIter->first >= start;
+           ++funcIter) {
+         funcIter->second.end = findFunctionEnd(funcIter->first);
+      }
+   }
+
+   for (auto &func : calls) {
+      markAsFunctionNoLock(func.start, func.end, func.name);
+   }
+
+   data.outgoing = std::move(outgoing);
+   data.scanned = true;
+}
+
+static void
+markModuleSymbols()
+{
+   // Copy the symbols out so we do not hold the loader lock while looking
+   //  for the end of every function.
+   auto symbols = std::vector<std::pair<uint32_t, std::string>> { };
    kernel::loader::lockLoader();
    const auto &modules = kernel::loader::getLoadedModules();
 
@@ -190,36 +405,190 @@ analyse(uint32_t start,
       for (auto &sym : mod.second->symbols) {
          if (sym.second.type == kernel::loader::SymbolType::Function) {
             if (sym.second.address >= codeRangeStart && sym.second.address < codeRangeEnd) {
-               markAsFunction(sym.second.address, sym.first);
+               symbols.emplace_back(sym.second.address, sym.first);
             }
          }
       }
+
+      for (auto &exp : mod.second->exports) {
+         if (exp.second >= codeRangeStart && exp.second < codeRangeEnd) {
+            symbols.emplace_back(exp.second, exp.first);
+         }
+      }
    }
 
    kernel::loader::unlockLoader();
 
-   for (auto addr = start; addr < end; addr += 4) {
-      auto instr = mem::read<espresso::Instruction>(addr);
-      auto data = espresso::decodeInstruction(instr);
+   for (auto &symbol : symbols) {
+      markAsFunction(symbol.first, symbol.second);
+   }
+}
 
-      if (!data) {
-         continue;
+static void
+workerThread()
+{
+   while (true) {
+      auto page = uint32_t { 0 };
+      auto markSymbols = false;
+
+      {
+         std::unique_lock<std::mutex> lock { sQueueMutex };
+         sWorkerBusy = false;
+         sQueueCondition.wait(lock, [] {
+            return sWorkerStop || sMarkSymbolsQueued || !sQueuedPages.empty();
+         });
+
+         if (sWorkerStop) {
+            break;
+         }
+
+         // Symbols are marked first as functions found by scanning pages
+         //  only get a sub_ name.
+         if (sMarkSymbolsQueued) {
+            sMarkSymbolsQueued = false;
+            markSymbols = true;
+         } else {
+            page = sQueuedPages.front();
+            sQueuedPages.pop_front();
+            sQueuedPageSet.erase(page);
+         }
+
+         sWorkerBusy = true;
       }
 
-      if (isBranchInstr(data)) {
-         auto meta = getBranchMeta(addr, instr, data, nullptr);
+      if (markSymbols) {
+         markModuleSymbols();
+      } else {
+         scanPage(page);
+      }
+   }
+}
 
-         if (!meta.isCall && !meta.isVariable) {
-            sInstrData[meta.target].sourceBranches.push_back(addr);
+// Must be called with sQueueMutex held
+static void
+startWorker()
+{
+   if (!sWorkerThread.joinable()) {
+      sWorkerThread = std::thread { workerThread };
+   }
+
+   sQueueCondition.notify_all();
+}
+
+static void
+queueMarkSymbols()
+{
+   std::unique_lock<std::mutex> lock { sQueueMutex };
+
+   if (sWorkerStop) {
+      return;
+   }
+
+   sMarkSymbolsQueued = true;
+   startWorker();
+}
+
+static void
+queuePages(uint32_t start,
+           uint32_t end,
+           bool onlyTracked)
+{
+   if (end <= start) {
+      return;
+   }
+
+   std::unique_lock<std::mutex> lock { sQueueMutex };
+
+   if (sWorkerStop || (onlyTracked && sTrackedPages.empty())) {
+      return;
+   }
+
+   for (auto page = start >> PageShift; page <= ((end - 1) >> PageShift); ++page) {
+      if (onlyTracked) {
+         if (sTrackedPages.find(page) == sTrackedPages.end()) {
+            continue;
          }
+      } else {
+         sTrackedPages.insert(page);
+      }
 
-         // If this is a call, and its not variable, we should mark
-         //  the target as a function, since it likely is...
-         if (meta.isCall && !meta.isVariable) {
-            markAsFunction(meta.target);
+      if (sQueuedPageSet.insert(page).second) {
+         sQueuedPages.push_back(page);
+      }
+   }
+
+   startWorker();
+}
+
+void
+analyse(uint32_t start,
+        uint32_t end)
+{
+   // Everything is analysed in the background
+   queueMarkSymbols();
+   queuePages(start, end, false);
+}
+
+void
+analyseLoadedModules()
+{
+   auto ranges = std::vector<std::pair<uint32_t, uint32_t>> { };
+   queueMarkSymbols();
+   kernel::loader::lockLoader();
+
+   for (auto &mod : kernel::loader::getLoadedModules()) {
+      for (auto &sec : mod.second->sections) {
+         if (sec.type == kernel::loader::LoadedSectionType::Code) {
+            ranges.emplace_back(sec.start, sec.end);
          }
       }
    }
+
+   kernel::loader::unlockLoader();
+
+   // Queue the primary user module first so it is ready soonest
+   auto userModule = kernel::getUserModule();
+   std::stable_partition(ranges.begin(), ranges.end(),
+                         [&](auto &range) {
+                            return userModule && userModule->findAddressSection(range.first);
+                         });
+
+   for (auto &range : ranges) {
+      queuePages(range.first, range.second, false);
+   }
+}
+
+bool
+isAnalysing()
+{
+   std::unique_lock<std::mutex> lock { sQueueMutex };
+   return sWorkerBusy || sMarkSymbolsQueued || !sQueuedPages.empty();
+}
+
+void
+invalidate(uint32_t address,
+           uint32_t size)
+{
+   queuePages(address, address + size, true);
+}
+
+void
+shutdown()
+{
+   {
+      std::unique_lock<std::mutex> lock { sQueueMutex };
+      sWorkerStop = true;
+      sMarkSymbolsQueued = false;
+      sQueuedPages.clear();
+      sQueuedPageSet.clear();
+      sTrackedPages.clear();
+   }
+
+   sQueueCondition.notify_all();
+
+   if (sWorkerThread.joinable()) {
+      sWorkerThread.join();
+   }
 }
 
 } // namespace analysis
@@ -1,5 +1,6 @@
 #pragma once
 #include <cstdint>
+#include <optional>
 #include <string>
 #include <vector>
 
@@ -26,17 +27,23 @@ struct InstrData
    std::string comments;
 };
 
+// Analysis runs on a background thread, so lookups return a copy of
+//  whatever has been discovered so far rather than pointers into it.
 struct InstrInfo
 {
-   FuncData *func;
-   InstrData *instr;
+   std::optional<FuncData> func;
+   std::optional<InstrData> instr;
 };
 
-FuncData* getFunction(uint32_t address);
+std::optional<FuncData> getFunction(uint32_t address);
 InstrInfo get(uint32_t address);
 void markAsFunction(uint32_t address);
 void toggleAsFunction(uint32_t address);
 void analyse(uint32_t start, uint32_t end);
+void analyseLoadedModules();
+bool isAnalysing();
+void invalidate(uint32_t address, uint32_t size);
+void shutdown();
 
 } // namespace analysis
 
@@ -5,6 +5,7 @@
 #include "debugger_threadutils.h"
 #include "debugger_ui_manager.h"
 #include "debugger_ui_window_disassembly.h"
+#include "debugger_ui_window_hlestats.h"
 #include "debugger_ui_window_info.h"
 #include "debugger_ui_window_memory.h"
 #include "debugger_ui_window_registers.h"
@@ -168,6 +169,10 @@ void Manager::load(const std::string &configPath,
    addWindow(WindowID::PerformanceWindow,
              PerformanceWindow::create("Performance"),
              { KeyboardKey::LeftControl, KeyboardKey::O });
+
+   addWindow(WindowID::HleStatsWindow,
+             new HleStatsWindow { "HLE Stats" },
+             { KeyboardKey::LeftControl, KeyboardKey::H });
 }
 
 void Manager::draw(unsigned width, unsigned height)
@@ -236,13 +241,8 @@ void Manager::onFirstActivation()
 {
    auto userModule = kernel::getUserModule();
 
-   // Automatically analyse the primary user module
-   for (auto &sec : userModule->sections) {
-      if (sec.name.compare(".text") == 0) {
-         analysis::analyse(sec.start, sec.end);
-         break;
-      }
-   }
+   // Start analysing the loaded code in the background
+   analysis::analyseLoadedModules();
 
    // Place the views somewhere sane to start in case pausing did not place it somewhere
    if (!mDebugger->paused()) {
@@ -385,6 +385,10 @@ void Manager::drawMenu()
          decaf::config::log::kernel_trace = !decaf::config::log::kernel_trace;
       }
 
+      if (ImGui::MenuItem("HLE Stats Enabled", nullptr, decaf::config::log::hle_stats, true)) {
+         decaf::config::log::hle_stats = !decaf::config::log::hle_stats;
+      }
+
       auto pm4Enable = false;
       auto pm4Status = false;
 
@@ -34,6 +34,7 @@ enum class WindowID
    ThreadsWindow,
    VoicesWindow,
    PerformanceWindow,
+   HleStatsWindow,
 };
 
 struct HotKey
@@ -484,6 +484,12 @@ DisassemblyWindow::draw()
    }
 
    ImGui::PopItemWidth();
+
+   if (analysis::isAnalysing()) {
+      ImGui::SameLine();
+      ImGui::Text("Analysing...");
+   }
+
    ImGui::End();
 }
 
@@ -0,0 +1,127 @@
+#include "debugger_ui_window_hlestats.h"
+#include "decaf_config.h"
+
+#include <array>
+#include <cfloat>
+#include <cinttypes>
+#include <imgui.h>
+
+namespace debugger
+{
+
+namespace ui
+{
+
+//! Most functions to list, sorted by total cycles
+static constexpr auto MaxListedFunctions = 100u;
+
+HleStatsWindow::HleStatsWindow(const std::string &name) :
+   Window(name)
+{
+}
+
+void
+HleStatsWindow::update()
+{
+   mLastUpdate = std::chrono::system_clock::now();
+   mStats = decaf::getHleCallStats();
+   mTotalCycles = 0;
+
+   for (auto &stats : mStats) {
+      mTotalCycles += stats.cycles;
+   }
+
+   if (mStats.size() > MaxListedFunctions) {
+      mStats.resize(MaxListedFunctions);
+   }
+}
+
+void
+HleStatsWindow::draw()
+{
+   ImGui::SetNextWindowSize(ImVec2 { 700, 400 }, ImGuiSetCond_FirstUseEver);
+
+   if (!ImGui::Begin(mName.c_str(), &mVisible)) {
+      ImGui::End();
+      return;
+   }
+
+   if (!decaf::config::log::hle_stats) {
+      ImGui::Text("HLE stats are disabled, enable them from the Debug menu.");
+   }
+
+   // Update the list every second
+   auto dt = std::chrono::system_clock::now() - mLastUpdate;
+
+   if (std::chrono::duration_cast<std::chrono::seconds>(dt).count() >= 1) {
+      update();
+   }
+
+   if (ImGui::Button("Reset")) {
+      decaf::resetHleCallStats();
+      update();
+   }
+
+   // Draw the call time histogram of the selected function
+   for (auto &stats : mStats) {
+      if (stats.module + "::" + stats.name != mSelected) {
+         continue;
+      }
+
+      auto values = std::array<float, 32> { };
+
+      for (auto i = 0u; i < stats.histogram.size(); ++i) {
+         values[i] = static_cast<float>(stats.histogram[i]);
+      }
+
+      ImGui::PlotHistogram("Cycles (log2)", values.data(), static_cast<int>(values.size()),
+                           0, mSelected.c_str(), 0.0f, FLT_MAX, ImVec2 { 0, 80 });
+   }
+
+   ImGui::Columns(7, "hleStatsList", false);
+   ImGui::SetColumnOffset(0, ImGui::GetWindowWidth() * 0.00f);
+   ImGui::SetColumnOffset(1, ImGui::GetWindowWidth() * 0.40f);
+   ImGui::SetColumnOffset(2, ImGui::GetWindowWidth() * 0.50f);
+   ImGui::SetColumnOffset(3, ImGui::GetWindowWidth() * 0.58f);
+   ImGui::SetColumnOffset(4, ImGui::GetWindowWidth() * 0.72f);
+   ImGui::SetColumnOffset(5, ImGui::GetWindowWidth() * 0.81f);
+   ImGui::SetColumnOffset(6, ImGui::GetWindowWidth() * 0.90f);
+
+   ImGui::Text("Function"); ImGui::NextColumn();
+   ImGui::Text("Calls"); ImGui::NextColumn();
+   ImGui::Text("Time %%"); ImGui::NextColumn();
+   ImGui::Text("Total Cycles"); ImGui::NextColumn();
+   ImGui::Text("Cycles/Call"); ImGui::NextColumn();
+   ImGui::Text("p50"); ImGui::NextColumn();
+   ImGui::Text("p99"); ImGui::NextColumn();
+   ImGui::Separator();
+
+   for (auto &stats : mStats) {
+      auto name = stats.module + "::" + stats.name;
+
+      if (ImGui::Selectable(name.c_str(), name == mSelected)) {
+         mSelected = name;
+      }
+      ImGui::NextColumn();
+
+      ImGui::Text("%" PRIu64, stats.calls);
+      ImGui::NextColumn();
+      ImGui::Text("%.2f%%", mTotalCycles ? 100.0 * stats.cycles / mTotalCycles : 0.0);
+      ImGui::NextColumn();
+      ImGui::Text("%" PRIu64, stats.cycles);
+      ImGui::NextColumn();
+      ImGui::Text("%" PRIu64, (stats.cycles + stats.calls / 2) / stats.calls);
+      ImGui::NextColumn();
+      ImGui::Text("<%" PRIu64, decaf::getHleCallPercentile(stats, 50.0));
+      ImGui::NextColumn();
+      ImGui::Text("<%" PRIu64, decaf::getHleCallPercentile(stats, 99.0));
+      ImGui::NextColumn();
+   }
+
+   ImGui::Columns(1);
+   ImGui::End();
+}
+
+} // namespace ui
+
+} // namespace debugger
@@ -0,0 +1,36 @@
+#pragma once
+#include "debugger_ui_window.h"
+#include "decaf_hlestats.h"
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace debugger
+{
+
+namespace ui
+{
+
+class HleStatsWindow : public Window
+{
+public:
+   HleStatsWindow(const std::string &name);
+   virtual ~HleStatsWindow() = default;
+
+   virtual void
+   draw() override;
+
+   void
+   update();
+
+private:
+   std::chrono::time_point<std::chrono::system_clock> mLastUpdate;
+   std::vector<decaf::HleCallStats> mStats;
+   uint64_t mTotalCycles = 0;
+   std::string mSelected;
+};
+
+} // namespace ui
+
+} // namespace debugger
@@ -65,6 +65,26 @@ void PerformanceWindowGL::draw()
    drawTextAndValue("Surfaces:", mInfo->numSurfaces);
    drawTextAndValue("Data Buffers:", mInfo->numDataBuffers);
 
+   ImGui::Columns(1);
+   ImGui::Separator();
+   ImGui::Text("\tPer Frame:\n");
+
+   ImGui::Columns(3);
+
+   drawTextAndValue("Register Writes:", mInfo->numRegisterWrites);
+   drawTextAndValue("Redundant Writes:", mInfo->numRedundantRegisterWrites);
+
+   ImGui::NextColumn();
+
+   drawTextAndValue("State Applies:", mInfo->numStateGroupApplies);
+   drawTextAndValue("Redundant Applies:", mInfo->numRedundantStateGroupApplies);
+
+   ImGui::NextColumn();
+
+   drawTextAndValue("Draws:", mInfo->numDraws);
+   drawTextAndValue("Merged Draws:", mInfo->numMergedDraws);
+   drawTextAndValue("Multi Draws:", mInfo->numDrawBatches);
+
    ImGui::End();
 }
 
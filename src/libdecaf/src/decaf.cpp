@@ -2,6 +2,7 @@
 #include "decaf_config.h"
 #include "decaf_graphics.h"
 #include "decaf_input.h"
+#include "decaf_metrics.h"
 #include "decaf_sound.h"
 #include "debugger/debugger.h"
 #include "debugger/debugger_ui.h"
@@ -10,6 +11,7 @@
 #include "kernel/kernel.h"
 #include "kernel/kernel_filesystem.h"
 #include "kernel/kernel_hlefunction.h"
+#include "kernel/kernel_profiler.h"
 #include "libcpu/cpu.h"
 #include "libcpu/mem.h"
 #include "modules/coreinit/coreinit_fs.h"
@@ -153,6 +155,7 @@ initialise(const std::string &gamePath)
    auto path = fs::HostPath { gamePath };
    auto volPath = fs::HostPath { };
    auto rpxPath = fs::HostPath { };
+   auto imagePath = fs::HostPath { };
 
    if (platform::isDirectory(path.path())) {
       if (platform::isFile(path.join("code").join("cos.xml").path())) {
@@ -172,6 +175,9 @@ initialise(const std::string &gamePath)
       } else if (path.extension().compare("rpx") == 0) {
          // Found file.rpx
          rpxPath = path.path();
+      } else if (path.extension().compare("dci") == 0) {
+         // Found file.dci
+         imagePath = path.path();
       }
    }
 
@@ -179,6 +185,17 @@ initialise(const std::string &gamePath)
       filesystem->mountHostFolder("/vol/code", volPath.join("code"), fs::Permissions::Read);
       filesystem->mountHostFolder("/vol/content", volPath.join("content"), fs::Permissions::Read);
       filesystem->mountHostFolder("/vol/meta", volPath.join("meta"), fs::Permissions::Read);
+   } else if (!imagePath.path().empty()) {
+      auto image = fs::ImageArchive::open(imagePath.path());
+
+      if (!image) {
+         gLog->error("Could not open image {}", imagePath.path());
+         return false;
+      }
+
+      filesystem->mountImageFolder("/vol/code", image, "code");
+      filesystem->mountImageFolder("/vol/content", image, "content");
+      filesystem->mountImageFolder("/vol/meta", image, "meta");
    } else if (!rpxPath.path().empty()) {
       auto volCodePath = rpxPath.parentPath();
       filesystem->mountHostFolder("/vol/code", volCodePath, fs::Permissions::Read);
@@ -235,6 +252,14 @@ start()
 {
    cpu::start();
 
+   if (config::system::metrics_port || !config::system::metrics_socket.empty()) {
+      metrics::startServer();
+   }
+
+   if (!config::log::profile_file.empty()) {
+      kernel::profilerStart(config::log::profile_rate);
+   }
+
    volatile int zero = 0;
    if (zero) {
       tracePrint(nullptr, 0, 0);
@@ -266,6 +291,9 @@ waitForExit()
 void
 shutdown()
 {
+   // Stop metrics server before the drivers it samples go away
+   metrics::stopServer();
+
    // Shut down debugger
    debugger::shutdown();
 
@@ -275,6 +303,12 @@ shutdown()
    // Wait for CPU to finish
    cpu::join();
 
+   // Write out guest profile while the loader's symbols are still around
+   if (!config::log::profile_file.empty()) {
+      kernel::profilerStop();
+      kernel::profilerWriteFolded(config::log::profile_file);
+   }
+
    // Stop any kernel threads
    kernel::shutdown();
 
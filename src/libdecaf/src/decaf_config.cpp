@@ -35,6 +35,9 @@ std::string level = "debug";
 std::string directory = ".";
 bool kernel_trace = false;
 bool kernel_trace_res = false;
+bool hle_stats = false;
+std::string profile_file = {};
+unsigned profile_rate = 1000;
 bool branch_trace = false;
 
 std::vector<std::string> kernel_trace_filters =
@@ -70,6 +73,8 @@ std::string content_path = {};
 std::string resources_path = "resources";
 double time_scale = 1.0;
 std::vector<std::string> lle_modules;
+unsigned metrics_port = 0;
+std::string metrics_socket = {};
 
 } // namespace system
 
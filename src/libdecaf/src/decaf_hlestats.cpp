@@ -0,0 +1,82 @@
+#include "decaf_hlestats.h"
+#include "kernel/kernel_hle.h"
+#include "kernel/kernel_hlefunction.h"
+
+#include <algorithm>
+
+namespace decaf
+{
+
+static_assert(std::tuple_size<decltype(HleCallStats::histogram)>::value == kernel::HleStatsHistogramSize,
+              "HleCallStats::histogram must match kernel::HleFunctionStats::histogram");
+
+std::vector<HleCallStats>
+getHleCallStats()
+{
+   auto result = std::vector<HleCallStats> { };
+
+   for (auto func : kernel::getHleFunctions()) {
+      auto calls = func->stats.calls.load(std::memory_order_relaxed);
+
+      if (!calls) {
+         continue;
+      }
+
+      auto stats = HleCallStats { };
+      stats.module = func->module;
+      stats.name = func->name;
+      stats.calls = calls;
+      stats.cycles = func->stats.cycles.load(std::memory_order_relaxed);
+
+      for (auto i = 0u; i < stats.histogram.size(); ++i) {
+         stats.histogram[i] = func->stats.histogram[i].load(std::memory_order_relaxed);
+      }
+
+      result.emplace_back(std::move(stats));
+   }
+
+   std::sort(result.begin(), result.end(),
+             [](const HleCallStats &a, const HleCallStats &b) { return a.cycles > b.cycles; });
+
+   return result;
+}
+
+void
+resetHleCallStats()
+{
+   for (auto func : kernel::getHleFunctions()) {
+      func->stats.calls.store(0, std::memory_order_relaxed);
+      func->stats.cycles.store(0, std::memory_order_relaxed);
+
+      for (auto &bucket : func->stats.histogram) {
+         bucket.store(0, std::memory_order_relaxed);
+      }
+   }
+}
+
+uint64_t
+getHleCallPercentile(const HleCallStats &stats,
+                     double percentile)
+{
+   auto total = uint64_t { 0 };
+
+   for (auto count : stats.histogram) {
+      total += count;
+   }
+
+   auto target = static_cast<uint64_t>(total * percentile / 100.0);
+   auto seen = uint64_t { 0 };
+
+   // Report the upper bound of the bucket the percentile falls in
+   for (auto i = 0u; i < stats.histogram.size(); ++i) {
+      seen += stats.histogram[i];
+
+      if (seen > target) {
+         return uint64_t { 1 } << (i + 1);
+      }
+   }
+
+   return uint64_t { 1 } << stats.histogram.size();
+}
+
+} // namespace decaf
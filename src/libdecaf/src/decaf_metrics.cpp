@@ -0,0 +1,597 @@
+#include "decaf_config.h"
+#include "decaf_game.h"
+#include "decaf_graphics.h"
+#include "decaf_metrics.h"
+#include "decaf_sound.h"
+#include "kernel/kernel_ipc.h"
+#include "modules/coreinit/coreinit_scheduler.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <common/log.h>
+#include <common/platform.h>
+#include <common/platform_socket.h>
+#include <common/platform_thread.h>
+#include <cstring>
+#include <fmt/format.h>
+#include <libcpu/jit_stats.h>
+#include <libgpu/gpu_ringbuffer.h>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifndef PLATFORM_WINDOWS
+#include <sys/select.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+/**
+ * Serves performance counters in the Prometheus text exposition format.
+ *
+ * A single host thread answers plain HTTP GET requests on localhost, and
+ * optionally on a Unix socket. Every request is answered with a fresh sample
+ * of the counters and the connection is then closed.
+ */
+
+namespace decaf
+{
+
+namespace metrics
+{
+
+static constexpr platform::Socket
+InvalidSocket = static_cast<platform::Socket>(-1);
+
+//! Number of recent frames the frame time quantiles are calculated over
+static constexpr size_t
+FrameHistorySize = 256;
+
+//! Largest request we will read before giving up on a client
+static constexpr size_t
+MaxRequestSize = 4096;
+
+//! Longest a client may take to send its request and receive the response,
+//!  clients are served one at a time so a slow one delays every other.
+static constexpr std::chrono::milliseconds
+RequestTimeout { 1000 };
+
+#ifdef MSG_NOSIGNAL
+static constexpr int
+SendFlags = MSG_NOSIGNAL;
+#else
+static constexpr int
+SendFlags = 0;
+#endif
+
+struct FrameTimes
+{
+   std::mutex mutex;
+   std::chrono::steady_clock::time_point lastFrame;
+   std::array<double, FrameHistorySize> history;
+   size_t historyPos = 0;
+   uint64_t count = 0;
+   double sum = 0.0;
+};
+
+static FrameTimes
+sFrameTimes;
+
+static std::thread
+sServerThread;
+
+static std::atomic<bool>
+sServerRunning { false };
+
+static platform::Socket
+sTcpSocket = InvalidSocket;
+
+static platform::Socket
+sUnixSocket = InvalidSocket;
+
+//! Path sUnixSocket is bound to, removed again when the server stops
+static std::string
+sUnixSocketPath;
+
+
+/**
+ * Called by gx2 every time the game swaps its scan buffers.
+ */
+void
+recordFrame()
+{
+   auto now = std::chrono::steady_clock::now();
+   std::unique_lock<std::mutex> lock { sFrameTimes.mutex };
+
+   if (sFrameTimes.lastFrame != std::chrono::steady_clock::time_point { }) {
+      auto seconds = std::chrono::duration<double> { now - sFrameTimes.lastFrame }.count();
+      sFrameTimes.history[sFrameTimes.historyPos % FrameHistorySize] = seconds;
+      sFrameTimes.historyPos++;
+      sFrameTimes.count++;
+      sFrameTimes.sum += seconds;
+   }
+
+   sFrameTimes.lastFrame = now;
+}
+
+static std::string
+escapeLabel(const std::string &value)
+{
+   auto result = std::string { };
+   result.reserve(value.size());
+
+   for (auto c : value) {
+      switch (c) {
+      case '\\':
+         result += "\\\\";
+         break;
+      case '"':
+         result += "\\\"";
+         break;
+      case '\n':
+         result += "\\n";
+         break;
+      default:
+         result += c;
+      }
+   }
+
+   return result;
+}
+
+static void
+writeHeader(fmt::MemoryWriter &out,
+            const char *name,
+            const char *type,
+            const char *help)
+{
+   out.write("# HELP {} {}\n", name, help);
+   out.write("# TYPE {} {}\n", name, type);
+}
+
+template<typename Type>
+static void
+writeMetric(fmt::MemoryWriter &out,
+            const char *name,
+            const char *type,
+            const char *help,
+            Type value)
+{
+   writeHeader(out, name, type, help);
+   out.write("{} {}\n", name, value);
+}
+
+static void
+writeFrameMetrics(fmt::MemoryWriter &out)
+{
+   auto recent = std::vector<double> { };
+   auto count = uint64_t { 0 };
+   auto sum = 0.0;
+
+   {
+      std::unique_lock<std::mutex> lock { sFrameTimes.mutex };
+      auto size = std::min(sFrameTimes.historyPos, FrameHistorySize);
+      recent.assign(sFrameTimes.history.begin(), sFrameTimes.history.begin() + size);
+      count = sFrameTimes.count;
+      sum = sFrameTimes.sum;
+   }
+
+   writeMetric(out, "decaf_frames_total", "counter",
+               "Number of frames the game has presented.", count);
+
+   auto fps = 0.0;
+   auto recentSum = 0.0;
+
+   for (auto time : recent) {
+      recentSum += time;
+   }
+
+   if (recentSum > 0.0) {
+      fps = recent.size() / recentSum;
+   }
+
+   writeMetric(out, "decaf_fps", "gauge",
+               "Frames per second the game presented over its recent frames.", fps);
+
+   writeHeader(out, "decaf_frame_time_seconds", "summary",
+               "Time between frames presented by the game, quantiles are over recent frames.");
+   std::sort(recent.begin(), recent.end());
+
+   for (auto quantile : { 0.5, 0.9, 0.99 }) {
+      auto value = 0.0;
+
+      if (!recent.empty()) {
+         auto index = static_cast<size_t>(quantile * (recent.size() - 1) + 0.5);
+         value = recent[index];
+      }
+
+      out.write("decaf_frame_time_seconds{{quantile=\"{}\"}} {}\n", quantile, value);
+   }
+
+   out.write("decaf_frame_time_seconds_sum {}\n", sum);
+   out.write("decaf_frame_time_seconds_count {}\n", count);
+}
+
+/**
+ * Samples every counter and returns them in the Prometheus text format.
+ */
+std::string
+format()
+{
+   fmt::MemoryWriter out;
+   auto &game = getGameInfo();
+
+   writeHeader(out, "decaf_info", "gauge", "Title which is currently running.");
+   out.write("decaf_info{{title_id=\"{:016X}\",title=\"{}\"}} 1\n",
+             game.app.title_id,
+             escapeLabel(game.meta.longnames[Language::English]));
+
+   writeFrameMetrics(out);
+
+   if (auto graphicsDriver = getGraphicsDriver()) {
+      writeMetric(out, "decaf_graphics_driver_fps", "gauge",
+                  "Frames per second presented by the host graphics driver.",
+                  graphicsDriver->getAverageFPS());
+   }
+
+   auto jitStats = cpu::jit::JitStats { };
+
+   if (cpu::jit::sampleStats(jitStats)) {
+      writeMetric(out, "decaf_jit_code_cache_bytes", "gauge",
+                  "Bytes of the JIT code cache in use.", jitStats.usedCodeCacheSize);
+      writeMetric(out, "decaf_jit_data_cache_bytes", "gauge",
+                  "Bytes of the JIT data cache in use.", jitStats.usedDataCacheSize);
+      writeMetric(out, "decaf_jit_blocks", "gauge",
+                  "Number of blocks the JIT has compiled.", jitStats.compiledBlocks.size());
+   }
+
+   auto ipcStats = kernel::ipcGetQueueStats();
+   writeMetric(out, "decaf_ipc_pending_requests", "gauge",
+               "IPC requests waiting to be dispatched to IOS.", ipcStats.pendingRequests);
+   writeMetric(out, "decaf_ipc_pending_responses", "gauge",
+               "IPC replies waiting to be delivered to a core.", ipcStats.pendingResponses);
+   writeMetric(out, "decaf_ipc_requests_total", "counter",
+               "IPC requests dispatched to IOS.", ipcStats.dispatchedRequests);
+
+   auto lockStats = coreinit::internal::getSchedulerLockStats();
+   writeMetric(out, "decaf_scheduler_lock_acquires_total", "counter",
+               "Times the guest scheduler lock has been taken.", lockStats.acquires);
+   writeMetric(out, "decaf_scheduler_lock_contended_total", "counter",
+               "Times the guest scheduler lock was already held when taking it.", lockStats.contended);
+   writeMetric(out, "decaf_scheduler_lock_spins_total", "counter",
+               "Iterations spent spinning on the guest scheduler lock.", lockStats.spins);
+
+   writeMetric(out, "decaf_gpu_ring_pending_items", "gauge",
+               "Command buffers queued for the GPU which it has not started.",
+               gpu::ringbuffer::getPendingItems());
+   writeMetric(out, "decaf_gpu_ring_pending_words", "gauge",
+               "Words in the command buffers queued for the GPU.",
+               gpu::ringbuffer::getPendingWords());
+
+   if (auto soundDriver = getSoundDriver()) {
+      writeMetric(out, "decaf_audio_underruns_total", "counter",
+                  "Times the host audio device needed samples before they were ready.",
+                  soundDriver->getUnderrunCount());
+   }
+
+   return out.str();
+}
+
+/**
+ * Waits for the socket to become readable, or writable, before the deadline.
+ */
+static bool
+waitForSocket(platform::Socket socket,
+              bool write,
+              std::chrono::steady_clock::time_point deadline)
+{
+   auto remaining = std::chrono::duration_cast<std::chrono::microseconds>(deadline - std::chrono::steady_clock::now()).count();
+
+   if (remaining <= 0) {
+      return false;
+   }
+
+   fd_set fds;
+   auto tv = timeval { };
+   tv.tv_sec = static_cast<decltype(tv.tv_sec)>(remaining / 1000000);
+   tv.tv_usec = static_cast<decltype(tv.tv_usec)>(remaining % 1000000);
+   FD_ZERO(&fds);
+   FD_SET(socket, &fds);
+
+   return select(static_cast<int>(socket) + 1,
+                 write ? NULL : &fds,
+                 write ? &fds : NULL,
+                 NULL, &tv) > 0;
+}
+
+static void
+sendAll(platform::Socket socket,
+        const std::string &data,
+        std::chrono::steady_clock::time_point deadline)
+{
+   auto sent = size_t { 0 };
+
+   while (sent < data.size()) {
+      if (!waitForSocket(socket, true, deadline)) {
+         return;
+      }
+
+      auto result = send(socket, data.data() + sent,
+                         static_cast<int>(data.size() - sent), SendFlags);
+
+      if (platform::socketWouldBlock(static_cast<int>(result))) {
+         continue;
+      }
+
+      if (result <= 0) {
+         return;
+      }
+
+      sent += static_cast<size_t>(result);
+   }
+}
+
+static void
+sendResponse(platform::Socket socket,
+             std::chrono::steady_clock::time_point deadline,
+             const char *status,
+             const std::string &body)
+{
+   auto response = fmt::format("HTTP/1.0 {}\r\n"
+                                "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                                "Content-Length: {}\r\n"
+                                "Connection: close\r\n"
+                                "\r\n",
+                                status, body.size());
+   sendAll(socket, response, deadline);
+   sendAll(socket, body, deadline);
+}
+
+static void
+handleClient(platform::Socket socket)
+{
+   auto request = std::string { };
+   auto deadline = std::chrono::steady_clock::now() + RequestTimeout;
+
+   // Non blocking so a client which stops reading cannot stall a send
+   platform::socketSetBlocking(socket, false);
+
+   // Read until the end of the request headers, the body is ignored
+   while (request.find("\r\n\r\n") == std::string::npos &&
+          request.find("\n\n") == std::string::npos) {
+      if (!waitForSocket(socket, false, deadline)) {
+         return;
+      }
+
+      char buffer[512];
+      auto result = recv(socket, buffer, sizeof(buffer), 0);
+
+      if (platform::socketWouldBlock(static_cast<int>(result))) {
+         continue;
+      }
+
+      if (result <= 0) {
+         return;
+      }
+
+      request.append(buffer, static_cast<size_t>(result));
+
+      if (request.size() > MaxRequestSize) {
+         sendResponse(socket, deadline, "413 Request Entity Too Large", "");
+         return;
+      }
+   }
+
+   auto lineEnd = request.find_first_of("\r\n");
+   auto requestLine = request.substr(0, lineEnd);
+   auto methodEnd = requestLine.find(' ');
+   auto pathEnd = requestLine.find(' ', methodEnd + 1);
+
+   if (methodEnd == std::string::npos) {
+      sendResponse(socket, deadline, "400 Bad Request", "");
+      return;
+   }
+
+   auto method = requestLine.substr(0, methodEnd);
+   auto path = requestLine.substr(methodEnd + 1, pathEnd - methodEnd - 1);
+
+   if (method != "GET") {
+      sendResponse(socket, deadline, "405 Method Not Allowed", "");
+   } else if (path != "/" && path != "/metrics") {
+      sendResponse(socket, deadline, "404 Not Found", "");
+   } else {
+      sendResponse(socket, deadline, "200 OK", format());
+   }
+}
+
+static void
+closeSockets()
+{
+   if (sTcpSocket != InvalidSocket) {
+      platform::socketClose(sTcpSocket);
+      sTcpSocket = InvalidSocket;
+   }
+
+   if (sUnixSocket != InvalidSocket) {
+      platform::socketClose(sUnixSocket);
+      sUnixSocket = InvalidSocket;
+#ifndef PLATFORM_WINDOWS
+      unlink(sUnixSocketPath.c_str());
+#endif
+      sUnixSocketPath.clear();
+   }
+}
+
+static platform::Socket
+listenTcp(unsigned port)
+{
+   auto listenSocket = socket(PF_INET, SOCK_STREAM, 0);
+
+   if (listenSocket < 0) {
+      gLog->error("Metrics server failed to create socket");
+      return InvalidSocket;
+   }
+
+   // Set socket to SO_REUSEADDR so it can always bind on the same port
+   auto sockOpt = 1;
+
+   if (setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR,
+                  reinterpret_cast<const char *>(&sockOpt),
+                  sizeof(sockOpt)) < 0) {
+      gLog->error("Metrics server failed to set SO_REUSEADDR on socket");
+      platform::socketClose(listenSocket);
+      return InvalidSocket;
+   }
+
+   // Only ever listen on localhost, these metrics are not meant to be public
+   auto bindAddress = sockaddr_in { 0 };
+   bindAddress.sin_family = AF_INET;
+   bindAddress.sin_port = htons(static_cast<uint16_t>(port));
+   bindAddress.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+   if (bind(listenSocket,
+            reinterpret_cast<const sockaddr*>(&bindAddress),
+            sizeof(sockaddr_in)) < 0) {
+      gLog->error("Metrics server failed to bind on port {}", port);
+      platform::socketClose(listenSocket);
+      return InvalidSocket;
+   }
+
+   if (listen(listenSocket, 4) < 0) {
+      gLog->error("Metrics server failed to listen on port {}", port);
+      platform::socketClose(listenSocket);
+      return InvalidSocket;
+   }
+
+   gLog->info("Serving metrics on http://127.0.0.1:{}/metrics", port);
+   return listenSocket;
+}
+
+static platform::Socket
+listenUnix(const std::string &path)
+{
+#ifdef PLATFORM_WINDOWS
+   gLog->warn("Metrics server does not support Unix sockets on Windows, ignoring {}", path);
+   return InvalidSocket;
+#else
+   auto bindAddress = sockaddr_un { 0 };
+
+   if (path.size() >= sizeof(bindAddress.sun_path)) {
+      gLog->error("Metrics socket path {} is too long", path);
+      return InvalidSocket;
+   }
+
+   auto listenSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+
+   if (listenSocket < 0) {
+      gLog->error("Metrics server failed to create Unix socket");
+      return InvalidSocket;
+   }
+
+   // Remove the socket left behind by a previous run
+   unlink(path.c_str());
+
+   bindAddress.sun_family = AF_UNIX;
+   std::strncpy(bindAddress.sun_path, path.c_str(), sizeof(bindAddress.sun_path) - 1);
+
+   if (bind(listenSocket,
+            reinterpret_cast<const sockaddr*>(&bindAddress),
+            sizeof(sockaddr_un)) < 0) {
+      gLog->error("Metrics server failed to bind on {}", path);
+      platform::socketClose(listenSocket);
+      return InvalidSocket;
+   }
+
+   if (listen(listenSocket, 4) < 0) {
+      gLog->error("Metrics server failed to listen on {}", path);
+      platform::socketClose(listenSocket);
+      unlink(path.c_str());
+      return InvalidSocket;
+   }
+
+   gLog->info("Serving metrics on Unix socket {}", path);
+   return listenSocket;
+#endif
+}
+
+static void
+serverEntry()
+{
+   while (sServerRunning.load()) {
+      fd_set readfds;
+      auto nfds = 0;
+      auto tv = timeval { 0, 250 * 1000 };
+      FD_ZERO(&readfds);
+
+      for (auto listenSocket : { sTcpSocket, sUnixSocket }) {
+         if (listenSocket != InvalidSocket) {
+            FD_SET(listenSocket, &readfds);
+            nfds = std::max(nfds, static_cast<int>(listenSocket));
+         }
+      }
+
+      if (select(nfds + 1, &readfds, NULL, NULL, &tv) <= 0) {
+         continue;
+      }
+
+      for (auto listenSocket : { sTcpSocket, sUnixSocket }) {
+         if (listenSocket == InvalidSocket || !FD_ISSET(listenSocket, &readfds)) {
+            continue;
+         }
+
+         auto clientSocket = accept(listenSocket, NULL, NULL);
+
+         if (clientSocket < 0) {
+            gLog->warn("Metrics server failed to accept on socket");
+            continue;
+         }
+
+         handleClient(clientSocket);
+         platform::socketClose(clientSocket);
+      }
+   }
+}
+
+bool
+startServer()
+{
+   if (sServerRunning.load()) {
+      return true;
+   }
+
+   if (config::system::metrics_port) {
+      sTcpSocket = listenTcp(config::system::metrics_port);
+   }
+
+   if (!config::system::metrics_socket.empty()) {
+      // The config can change while we run, remember what we bound to
+      sUnixSocketPath = config::system::metrics_socket;
+      sUnixSocket = listenUnix(sUnixSocketPath);
+   }
+
+   if (sTcpSocket == InvalidSocket && sUnixSocket == InvalidSocket) {
+      return false;
+   }
+
+   sServerRunning.store(true);
+   sServerThread = std::thread { serverEntry };
+   platform::setThreadName(&sServerThread, "Metrics Server");
+   return true;
+}
+
+void
+stopServer()
+{
+   if (!sServerRunning.exchange(false)) {
+      return;
+   }
+
+   sServerThread.join();
+   closeSockets();
+}
+
+} // namespace metrics
+
+} // namespace decaf
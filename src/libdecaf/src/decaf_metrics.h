@@ -0,0 +1,24 @@
+#pragma once
+#include <string>
+
+namespace decaf
+{
+
+namespace metrics
+{
+
+bool
+startServer();
+
+void
+stopServer();
+
+void
+recordFrame();
+
+std::string
+format();
+
+} // namespace metrics
+
+} // namespace decaf
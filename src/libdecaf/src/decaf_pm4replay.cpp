@@ -1,12 +1,467 @@
 #include "decaf_pm4replay.h"
 #include "modules/gx2/gx2_internal_cbpool.h"
 
+#include <algorithm>
+#include <common/align.h>
+#include <common/byte_swap.h>
+#include <common/log.h>
+#include <common/murmur3.h>
+#include <cstring>
+#include <libgpu/latte/latte_pm4.h>
+#include <zlib.h>
+
 namespace decaf
 {
 
 namespace pm4
 {
 
+IndexedCapture::~IndexedCapture()
+{
+   close();
+}
+
+bool
+IndexedCapture::open(const std::string &path)
+{
+   close();
+   mHandle = platform::openMemoryMappedFile(path, platform::ProtectFlags::ReadOnly, &mSize);
+
+   if (mHandle == platform::InvalidMapFileHandle) {
+      return false;
+   }
+
+   if (mSize < sizeof(CaptureIndexedHeader) + sizeof(CaptureIndexFooter)) {
+      close();
+      return false;
+   }
+
+   mView = reinterpret_cast<uint8_t *>(platform::mapViewOfFile(mHandle, platform::ProtectFlags::ReadOnly, 0, mSize));
+
+   if (!mView) {
+      close();
+      return false;
+   }
+
+   auto header = reinterpret_cast<CaptureIndexedHeader *>(mView);
+   std::memcpy(&mFooter, mView + mSize - sizeof(CaptureIndexFooter), sizeof(CaptureIndexFooter));
+
+   // Not an indexed capture, callers fall back to the other formats
+   if (header->magic != CaptureMagicIndexed) {
+      close();
+      return false;
+   }
+
+   if (mFooter.magic != CaptureMagicIndexed ||
+       header->version != CaptureIndexedVersion ||
+       mFooter.version != CaptureIndexedVersion) {
+      gLog->error("Unsupported indexed pm4 capture version");
+      close();
+      return false;
+   }
+
+   auto packetsEnd = mFooter.packetsOffset + uint64_t { mFooter.numPackets } * sizeof(CaptureIndexPacket);
+   auto framesEnd = mFooter.framesOffset + uint64_t { mFooter.numFrames } * sizeof(CaptureIndexFrame);
+
+   if (packetsEnd > mSize || framesEnd > mSize ||
+       (mFooter.packetsOffset % alignof(CaptureIndexPacket)) ||
+       (mFooter.framesOffset % alignof(CaptureIndexFrame))) {
+      gLog->error("Indexed pm4 capture has an invalid index");
+      close();
+      return false;
+   }
+
+   mPackets = reinterpret_cast<const CaptureIndexPacket *>(mView + mFooter.packetsOffset);
+   mFrames = reinterpret_cast<const CaptureIndexFrame *>(mView + mFooter.framesOffset);
+
+   for (auto i = 0u; i < mFooter.numPackets; ++i) {
+      if (mPackets[i].offset + mPackets[i].size > mSize) {
+         gLog->error("Indexed pm4 capture packet {} is outside of the file", i);
+         close();
+         return false;
+      }
+   }
+
+   for (auto i = 0u; i < mFooter.numFrames; ++i) {
+      if (uint64_t { mFrames[i].firstPacket } + mFrames[i].numPackets > mFooter.numPackets) {
+         gLog->error("Indexed pm4 capture frame {} is outside of the packet index", i);
+         close();
+         return false;
+      }
+   }
+
+   return true;
+}
+
+void
+IndexedCapture::close()
+{
+   if (mView) {
+      platform::unmapViewOfFile(mView, mSize);
+      mView = nullptr;
+   }
+
+   if (mHandle != platform::InvalidMapFileHandle) {
+      platform::closeMemoryMappedFile(mHandle);
+      mHandle = platform::InvalidMapFileHandle;
+   }
+
+   mSize = 0;
+   mFooter = { };
+   mPackets = nullptr;
+   mFrames = nullptr;
+}
+
+bool
+CaptureReader::open(const std::string &path)
+{
+   mIsIndexed = false;
+   mIndexedPacket = 0;
+   mEof = false;
+
+   if (mIndexed.open(path)) {
+      mIsIndexed = true;
+      return true;
+   }
+
+   mFile.open(path, std::ifstream::binary);
+
+   if (!mFile.is_open()) {
+      return false;
+   }
+
+   std::array<char, 4> magic;
+   mFile.read(magic.data(), magic.size());
+
+   if (!mFile) {
+      return false;
+   }
+
+   if (magic == CaptureMagicCompressed) {
+      mCompressed = true;
+   } else if (magic != CaptureMagic) {
+      return false;
+   }
+
+   mEof = false;
+   mChunk.clear();
+   mChunkPos = 0;
+   mBlobs.clear();
+   mBlobBytes = 0;
+   return true;
+}
+
+bool
+CaptureReader::readChunk()
+{
+   auto chunk = CaptureChunk { };
+   mFile.read(reinterpret_cast<char *>(&chunk), sizeof(CaptureChunk));
+
+   if (!mFile) {
+      return false;
+   }
+
+   auto compressed = std::vector<uint8_t>(chunk.compressedSize);
+   mFile.read(reinterpret_cast<char *>(compressed.data()), compressed.size());
+
+   if (!mFile) {
+      return false;
+   }
+
+   auto size = uLongf { chunk.uncompressedSize };
+   mChunk.resize(chunk.uncompressedSize);
+   mChunkPos = 0;
+
+   if (uncompress(mChunk.data(), &size, compressed.data(), chunk.compressedSize) != Z_OK ||
+       size != chunk.uncompressedSize) {
+      gLog->error("Failed to decompress pm4 capture chunk");
+      mChunk.clear();
+      return false;
+   }
+
+   return true;
+}
+
+bool
+CaptureReader::read(void *buffer,
+                    size_t size)
+{
+   if (!mCompressed) {
+      mFile.read(reinterpret_cast<char *>(buffer), size);
+      return !!mFile;
+   }
+
+   auto dst = reinterpret_cast<uint8_t *>(buffer);
+
+   while (size) {
+      if (mChunkPos == mChunk.size() && !readChunk()) {
+         return false;
+      }
+
+      auto count = std::min(size, mChunk.size() - mChunkPos);
+      std::memcpy(dst, mChunk.data() + mChunkPos, count);
+      mChunkPos += count;
+      dst += count;
+      size -= count;
+   }
+
+   return true;
+}
+
+bool
+CaptureReader::readPacket(CapturePacket &packet,
+                          std::vector<uint8_t> &data)
+{
+   if (mIsIndexed) {
+      if (mIndexedPacket >= mIndexed.numPackets()) {
+         mEof = true;
+         return false;
+      }
+
+      auto &entry = mIndexed.packet(mIndexedPacket++);
+      auto payload = mIndexed.payload(entry);
+      packet.type = entry.type;
+      packet.size = entry.size;
+
+      if (entry.type == CapturePacket::MemoryLoad) {
+         auto load = CaptureMemoryLoad { };
+         load.type = entry.memoryType;
+         load.address = entry.address;
+         packet.size += sizeof(CaptureMemoryLoad);
+
+         data.resize(packet.size);
+         std::memcpy(data.data(), &load, sizeof(CaptureMemoryLoad));
+         std::memcpy(data.data() + sizeof(CaptureMemoryLoad), payload, entry.size);
+      } else {
+         data.assign(payload, payload + entry.size);
+      }
+
+      return true;
+   }
+
+   while (true) {
+      if (!read(&packet, sizeof(CapturePacket))) {
+         mEof = true;
+         return false;
+      }
+
+      data.resize(packet.size);
+
+      if (!read(data.data(), data.size())) {
+         mEof = true;
+         return false;
+      }
+
+      if (packet.type == CapturePacket::MemoryBlob) {
+         auto blob = reinterpret_cast<CaptureMemoryBlob *>(data.data());
+         auto key = std::array<uint64_t, 2> { blob->hash[0], blob->hash[1] };
+         auto size = data.size() - sizeof(CaptureMemoryBlob);
+
+         // Must match Recorder::writeMemoryLoad
+         if (mBlobBytes + size > CaptureMaxBlobBytes) {
+            mBlobs.clear();
+            mBlobBytes = 0;
+         }
+
+         mBlobBytes += size;
+         mBlobs[key].assign(data.begin() + sizeof(CaptureMemoryBlob), data.end());
+         continue;
+      }
+
+      if (packet.type == CapturePacket::MemoryLoadBlob) {
+         auto loadBlob = *reinterpret_cast<CaptureMemoryLoadBlob *>(data.data());
+         auto key = std::array<uint64_t, 2> { loadBlob.hash[0], loadBlob.hash[1] };
+         auto itr = mBlobs.find(key);
+
+         if (itr == mBlobs.end()) {
+            gLog->error("pm4 capture references missing memory blob {:016X}{:016X}", key[0], key[1]);
+            continue;
+         }
+
+         auto load = CaptureMemoryLoad { };
+         load.type = loadBlob.type;
+         load.address = loadBlob.address;
+
+         packet.type = CapturePacket::MemoryLoad;
+         packet.size = static_cast<uint32_t>(sizeof(CaptureMemoryLoad) + itr->second.size());
+         data.resize(packet.size);
+         std::memcpy(data.data(), &load, sizeof(CaptureMemoryLoad));
+         std::memcpy(data.data() + sizeof(CaptureMemoryLoad), itr->second.data(), itr->second.size());
+      }
+
+      return true;
+   }
+}
+
+// Only looks at the top level buffer, swaps are never in an indirect buffer
+static bool
+containsSwap(const uint8_t *data,
+             size_t size)
+{
+   auto words = reinterpret_cast<const uint32_t *>(data);
+   auto numWords = size / 4;
+
+   for (auto pos = size_t { 0u }; pos < numWords; ) {
+      auto header = latte::pm4::Header::get(byte_swap(words[pos]));
+      auto packetSize = size_t { 0u };
+
+      switch (header.type()) {
+      case latte::pm4::PacketType::Type0:
+         packetSize = latte::pm4::HeaderType0::get(header.value).count() + 1;
+         break;
+      case latte::pm4::PacketType::Type3:
+      {
+         auto header3 = latte::pm4::HeaderType3::get(header.value);
+
+         if (header3.opcode() == latte::pm4::IT_OPCODE::DECAF_SWAP_BUFFERS) {
+            return true;
+         }
+
+         packetSize = header3.size() + 1;
+         break;
+      }
+      case latte::pm4::PacketType::Type2:
+         break;
+      case latte::pm4::PacketType::Type1:
+      default:
+         packetSize = numWords;
+         break;
+      }
+
+      pos += packetSize + 1;
+   }
+
+   return false;
+}
+
+static void
+padTo(std::ofstream &out,
+      uint64_t alignment)
+{
+   static const std::array<char, CapturePageSize> zeroes = { };
+   auto pos = static_cast<uint64_t>(out.tellp());
+   out.write(zeroes.data(), align_up(pos, alignment) - pos);
+}
+
+bool
+convertToIndexedCapture(const std::string &src,
+                        const std::string &dst)
+{
+   CaptureReader reader;
+
+   if (!reader.open(src)) {
+      gLog->error("Could not open pm4 capture {}", src);
+      return false;
+   }
+
+   std::ofstream out { dst, std::ofstream::binary };
+
+   if (!out.is_open()) {
+      gLog->error("Could not open {} for writing", dst);
+      return false;
+   }
+
+   auto header = CaptureIndexedHeader { };
+   header.magic = CaptureMagicIndexed;
+   header.version = CaptureIndexedVersion;
+   header.pageSize = CapturePageSize;
+   out.write(reinterpret_cast<const char *>(&header), sizeof(CaptureIndexedHeader));
+
+   auto packets = std::vector<CaptureIndexPacket> { };
+   auto frames = std::vector<CaptureIndexFrame> { };
+   auto memoryOffsets = std::map<std::array<uint64_t, 2>, uint64_t> { };
+   auto frame = CaptureIndexFrame { 0, 0 };
+   auto packet = CapturePacket { };
+   auto data = std::vector<uint8_t> { };
+
+   while (reader.readPacket(packet, data)) {
+      auto entry = CaptureIndexPacket { };
+      auto payload = data.data();
+      auto size = data.size();
+      auto isSwap = false;
+      entry.type = packet.type;
+
+      switch (packet.type) {
+      case CapturePacket::CommandBuffer:
+         isSwap = containsSwap(payload, size);
+         break;
+      case CapturePacket::MemoryLoad:
+      {
+         auto load = CaptureMemoryLoad { };
+         std::memcpy(&load, payload, sizeof(CaptureMemoryLoad));
+         entry.memoryType = load.type;
+         entry.address = load.address;
+         payload += sizeof(CaptureMemoryLoad);
+         size -= sizeof(CaptureMemoryLoad);
+         break;
+      }
+      case CapturePacket::RegisterSnapshot:
+      case CapturePacket::SetBuffer:
+         break;
+      default:
+         continue;
+      }
+
+      entry.size = static_cast<uint32_t>(size);
+
+      if (packet.type == CapturePacket::MemoryLoad) {
+         auto hash = std::array<uint64_t, 2> { };
+         MurmurHash3_x64_128(payload, static_cast<int>(size), 0, hash.data());
+
+         auto itr = memoryOffsets.find(hash);
+
+         if (itr != memoryOffsets.end()) {
+            entry.offset = itr->second;
+         } else {
+            padTo(out, CapturePageSize);
+            entry.offset = static_cast<uint64_t>(out.tellp());
+            memoryOffsets.emplace(hash, entry.offset);
+            out.write(reinterpret_cast<const char *>(payload), size);
+         }
+      } else {
+         padTo(out, CapturePageSize);
+         entry.offset = static_cast<uint64_t>(out.tellp());
+         out.write(reinterpret_cast<const char *>(payload), size);
+      }
+
+      packets.push_back(entry);
+      frame.numPackets++;
+
+      if (isSwap) {
+         frames.push_back(frame);
+         frame.firstPacket = static_cast<uint32_t>(packets.size());
+         frame.numPackets = 0;
+      }
+   }
+
+   if (frame.numPackets) {
+      frames.push_back(frame);
+   }
+
+   auto footer = CaptureIndexFooter { };
+   footer.numPackets = static_cast<uint32_t>(packets.size());
+   footer.numFrames = static_cast<uint32_t>(frames.size());
+   footer.version = CaptureIndexedVersion;
+   footer.magic = CaptureMagicIndexed;
+
+   padTo(out, alignof(CaptureIndexPacket));
+   footer.packetsOffset = static_cast<uint64_t>(out.tellp());
+   out.write(reinterpret_cast<const char *>(packets.data()), packets.size() * sizeof(CaptureIndexPacket));
+
+   padTo(out, alignof(CaptureIndexFrame));
+   footer.framesOffset = static_cast<uint64_t>(out.tellp());
+   out.write(reinterpret_cast<const char *>(frames.data()), frames.size() * sizeof(CaptureIndexFrame));
+   out.write(reinterpret_cast<const char *>(&footer), sizeof(CaptureIndexFooter));
+
+   if (!out) {
+      gLog->error("Failed to write indexed pm4 capture {}", dst);
+      return false;
+   }
+
+   gLog->info("Wrote {} packets in {} frames to {}", packets.size(), frames.size(), dst);
+   return true;
+}
+
 void
 injectCommandBuffer(void *buffer,
                     uint32_t bytes)
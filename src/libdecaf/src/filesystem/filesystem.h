@@ -4,6 +4,8 @@
 #include "filesystem_filehandle.h"
 #include "filesystem_host_folder.h"
 #include "filesystem_host_path.h"
+#include "filesystem_image_archive.h"
+#include "filesystem_image_folder.h"
 #include "filesystem_link_file.h"
 #include "filesystem_link_folder.h"
 #include "filesystem_path.h"
@@ -11,7 +13,11 @@
 #include "filesystem_virtual_folder.h"
 
 #include <common/log.h>
+#include <cstdint>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
 
 namespace fs
 {
@@ -47,7 +53,9 @@ public:
       }
 
       auto folder = reinterpret_cast<Folder *>(parent);
-      return folder->remove(path.filename());
+      auto result = folder->remove(path.filename());
+      invalidatePathCache();
+      return result;
    }
 
    Result<Error>
@@ -69,11 +77,11 @@ public:
       }
 
       // For now we only support moving within HostFolder
-      if (srcParent->type() != Node::FolderNode && srcParent->deviceType() != Node::HostDevice) {
+      if (srcParent->type() != Node::FolderNode || srcParent->deviceType() != Node::HostDevice) {
          return Error::UnsupportedOperation;
       }
 
-      if (dstParent->type() != Node::FolderNode && dstParent->deviceType() != Node::HostDevice) {
+      if (dstParent->type() != Node::FolderNode || dstParent->deviceType() != Node::HostDevice) {
          return Error::UnsupportedOperation;
       }
 
@@ -81,7 +89,9 @@ public:
       auto srcFolder = reinterpret_cast<HostFolder *>(srcParent);
       auto dstFolder = reinterpret_cast<HostFolder *>(dstParent);
 
-      return HostFolder::move(srcFolder, src.filename(), dstFolder, dst.filename());
+      auto moveResult = HostFolder::move(srcFolder, src.filename(), dstFolder, dst.filename());
+      invalidatePathCache();
+      return moveResult;
    }
 
    Result<Node *>
@@ -133,6 +143,7 @@ public:
          dstNode = folder->addChild(dstNode);
       }
 
+      invalidatePathCache();
       return dstNode;
    }
 
@@ -156,7 +167,42 @@ public:
       gLog->debug("Mount {} to {}", src.path(), dst.path());
       auto folder = reinterpret_cast<VirtualFolder *>(parent);
       auto name = dst.filename();
-      return folder->addChild(new HostFolder { src, name, permissions });
+      auto node = folder->addChild(new HostFolder { src, name, permissions });
+      invalidatePathCache();
+      return node;
+   }
+
+   Result<Node *>
+   mountImageFolder(Path dst,
+                    std::shared_ptr<ImageArchive> image,
+                    const std::string &imagePath)
+   {
+      if (!imagePath.empty()) {
+         auto entry = image->findEntry(imagePath);
+
+         if (!entry || entry->type != ImageEntryType::Folder) {
+            return { Error::NotFound };
+         }
+      }
+
+      auto result = createPath(dst.parentPath());
+
+      if (!result) {
+         return result;
+      }
+
+      auto parent = result.value();
+
+      if (parent->type() != Node::FolderNode || parent->deviceType() != Node::VirtualDevice) {
+         return { Error::NotDirectory };
+      }
+
+      gLog->debug("Mount image folder {} to {}", imagePath, dst.path());
+      auto folder = reinterpret_cast<VirtualFolder *>(parent);
+      auto name = dst.filename();
+      auto node = folder->addChild(new ImageFolder { image, imagePath, name, Permissions::Read });
+      invalidatePathCache();
+      return node;
    }
 
    Result<Node *>
@@ -177,7 +223,9 @@ public:
       }
 
       auto folder = reinterpret_cast<VirtualFolder *>(parent);
-      return folder->addChild(new HostFile { src, dst.filename(), permissions });
+      auto node = folder->addChild(new HostFile { src, dst.filename(), permissions });
+      invalidatePathCache();
+      return node;
    }
 
    Result<FileHandle>
@@ -190,6 +238,33 @@ public:
          return Error::NotFound;
       }
 
+      if (mode & (File::Write | File::Append | File::Update)) {
+         // Opening for write may create the file or change its size
+         auto folder = reinterpret_cast<Folder *>(parent);
+         auto result = folder->openFile(path.filename(), mode);
+         invalidatePathCache();
+         return result;
+      } else if (parent->deviceType() == Node::HostDevice ||
+                 parent->deviceType() == Node::ImageDevice) {
+         // For read only opens we can resolve the file itself through the
+         // path cache instead of asking the folder to look it up again.
+         if (!(parent->permissions() & Permissions::Read)) {
+            return Error::InvalidPermission;
+         }
+
+         auto node = findNode(path);
+
+         if (!node) {
+            return Error::NotFound;
+         }
+
+         if (node->type() != Node::FileNode) {
+            return Error::NotFile;
+         }
+
+         return reinterpret_cast<File *>(node)->open(mode);
+      }
+
       auto folder = reinterpret_cast<Folder *>(parent);
       return folder->openFile(path.filename(), mode);
    }
@@ -257,9 +332,25 @@ public:
       }
 
       node->setPermissions(permissions, flags);
+      invalidatePathCache();
       return true;
    }
 
+   /**
+    * Drop every cached path lookup.
+    *
+    * Links mean a node can be reachable from several paths, so rather than
+    * trying to track which cached paths a change affects we simply flush the
+    * whole cache whenever the tree is modified.
+    */
+   void
+   invalidatePathCache()
+   {
+      std::unique_lock<std::mutex> lock { mPathCacheMutex };
+      mPathCache.clear();
+      mPathCacheGeneration++;
+   }
+
 protected:
    Node *
    followLink(Node *node)
@@ -275,14 +366,60 @@ protected:
       return node;
    }
 
+   /**
+    * Returns true if the result of findChild on folder can be cached.
+    *
+    * Virtual folders are only modified through FileSystem, which invalidates
+    * the cache, images are immutable and read only host folders are assumed
+    * to not change on the host underneath us. Writable host folders always go
+    * to the host.
+    */
+   bool
+   isCacheableFolder(Node *node)
+   {
+      while (node && node->deviceType() == Node::LinkDevice && node->type() == Node::FolderNode) {
+         node = reinterpret_cast<FolderLink *>(node)->getLink();
+      }
+
+      if (!node) {
+         return false;
+      }
+
+      if (node->deviceType() == Node::VirtualDevice ||
+          node->deviceType() == Node::ImageDevice) {
+         return true;
+      }
+
+      if (node->deviceType() == Node::HostDevice) {
+         return !(node->permissions() & Permissions::Write);
+      }
+
+      return false;
+   }
+
    Node *
    findNode(const Path &path)
    {
+      auto generation = uint64_t { 0 };
+
+      {
+         std::unique_lock<std::mutex> lock { mPathCacheMutex };
+         auto itr = mPathCache.find(path.path());
+
+         if (itr != mPathCache.end()) {
+            return itr->second;
+         }
+
+         generation = mPathCacheGeneration;
+      }
+
       auto node = reinterpret_cast<Node *>(&mRoot);
+      auto cacheable = true;
 
       for (auto dir : path) {
          if (!node || node->type() != Node::FolderNode) {
-            return nullptr;
+            node = nullptr;
+            break;
          }
 
          // Skip root directory
@@ -290,11 +427,25 @@ protected:
             continue;
          }
 
+         cacheable = cacheable && isCacheableFolder(node);
+
          auto folder = reinterpret_cast<Folder *>(node);
          node = folder->findChild(dir);
       }
 
-      return followLink(node);
+      node = followLink(node);
+
+      if (cacheable) {
+         // Both found and not found results are cached, but only if nothing
+         // invalidated the cache whilst we were walking the tree.
+         std::unique_lock<std::mutex> lock { mPathCacheMutex };
+
+         if (generation == mPathCacheGeneration) {
+            mPathCache.emplace(path.path(), node);
+         }
+      }
+
+      return node;
    }
 
    Result<Node *>
@@ -302,6 +453,9 @@ protected:
    {
       auto node = reinterpret_cast<Node *>(&mRoot);
 
+      // Any folder we create might have been cached as not found
+      invalidatePathCache();
+
       for (auto dir : path) {
          if (!node || node->type() != Node::FolderNode) {
             return { Error::NotDirectory };
@@ -328,6 +482,15 @@ protected:
 
 private:
    VirtualFolder mRoot;
+
+   //! Protects mPathCache and mPathCacheGeneration.
+   std::mutex mPathCacheMutex;
+
+   //! Map of full path to resolved node, nullptr for cached negative lookups.
+   std::unordered_map<std::string, Node *> mPathCache;
+
+   //! Incremented on every invalidation.
+   uint64_t mPathCacheGeneration = 0;
 };
 
 } // namespace fs
@@ -0,0 +1,321 @@
+#include "filesystem_image_archive.h"
+
+#include <algorithm>
+#include <common/decaf_assert.h>
+#include <common/log.h>
+#include <cstring>
+#include <zlib.h>
+
+namespace fs
+{
+
+ImageArchive::~ImageArchive()
+{
+   if (mView) {
+      platform::unmapViewOfFile(const_cast<uint8_t *>(mView), mSize);
+   }
+
+   if (mFile != platform::InvalidMapFileHandle) {
+      platform::closeMemoryMappedFile(mFile);
+   }
+}
+
+
+std::shared_ptr<ImageArchive>
+ImageArchive::open(const std::string &path,
+                   size_t cacheSize)
+{
+   auto archive = std::shared_ptr<ImageArchive> { new ImageArchive() };
+   archive->mCacheSize = cacheSize;
+   archive->mFile = platform::openMemoryMappedFile(path, platform::ProtectFlags::ReadOnly, &archive->mSize);
+
+   if (archive->mFile == platform::InvalidMapFileHandle) {
+      gLog->error("Failed to open image {}", path);
+      return nullptr;
+   }
+
+   auto view = platform::mapViewOfFile(archive->mFile, platform::ProtectFlags::ReadOnly, 0, archive->mSize);
+
+   if (!view) {
+      gLog->error("Failed to map image {}", path);
+      return nullptr;
+   }
+
+   archive->mView = reinterpret_cast<const uint8_t *>(view);
+
+   if (!archive->validate()) {
+      gLog->error("Invalid image {}", path);
+      return nullptr;
+   }
+
+   return archive;
+}
+
+
+bool
+ImageArchive::validate()
+{
+   if (mSize < sizeof(ImageHeader)) {
+      return false;
+   }
+
+   mHeader = reinterpret_cast<const ImageHeader *>(mView);
+
+   if (mHeader->magic != ImageMagic || mHeader->version != ImageVersion) {
+      return false;
+   }
+
+   if (mHeader->compression != ImageCompression::None &&
+       mHeader->compression != ImageCompression::Zlib) {
+      return false;
+   }
+
+   if (mHeader->chunkSize == 0) {
+      return false;
+   }
+
+   auto inBounds =
+      [this](uint64_t offset, uint64_t count, uint64_t size) {
+         return offset <= mSize && count <= (mSize - offset) / size;
+      };
+
+   if (!inBounds(mHeader->chunkTableOffset, mHeader->numChunks, sizeof(ImageChunk)) ||
+       !inBounds(mHeader->entryTableOffset, mHeader->numEntries, sizeof(ImageEntry)) ||
+       !inBounds(mHeader->stringTableOffset, mHeader->stringTableSize, 1)) {
+      return false;
+   }
+
+   mChunks = reinterpret_cast<const ImageChunk *>(mView + mHeader->chunkTableOffset);
+   mEntries = reinterpret_cast<const ImageEntry *>(mView + mHeader->entryTableOffset);
+   mStrings = reinterpret_cast<const char *>(mView + mHeader->stringTableOffset);
+
+   for (auto i = 0u; i < mHeader->numChunks; ++i) {
+      if (!inBounds(mChunks[i].offset, mChunks[i].size, 1)) {
+         return false;
+      }
+   }
+
+   for (auto i = 0u; i < mHeader->numEntries; ++i) {
+      auto &entry = mEntries[i];
+
+      if (entry.pathOffset > mHeader->stringTableSize ||
+          entry.pathLength > mHeader->stringTableSize - entry.pathOffset) {
+         return false;
+      }
+
+      if (entry.type == ImageEntryType::File) {
+         auto numChunks = (entry.size + mHeader->chunkSize - 1) / mHeader->chunkSize;
+
+         if (entry.firstChunk > mHeader->numChunks ||
+             numChunks > mHeader->numChunks - entry.firstChunk) {
+            return false;
+         }
+      }
+   }
+
+   return true;
+}
+
+
+const char *
+ImageArchive::getEntryPathData(const ImageEntry *entry) const
+{
+   return mStrings + entry->pathOffset;
+}
+
+
+std::string
+ImageArchive::getEntryPath(const ImageEntry *entry) const
+{
+   return { getEntryPathData(entry), entry->pathLength };
+}
+
+
+std::string
+ImageArchive::getEntryName(const ImageEntry *entry) const
+{
+   auto path = getEntryPath(entry);
+   auto pos = path.find_last_of('/');
+
+   if (pos == std::string::npos) {
+      return path;
+   }
+
+   return path.substr(pos + 1);
+}
+
+
+static int
+comparePath(const char *lhs,
+            size_t lhsLength,
+            const std::string &rhs)
+{
+   auto result = std::memcmp(lhs, rhs.data(), std::min(lhsLength, rhs.size()));
+
+   if (result != 0) {
+      return result;
+   }
+
+   if (lhsLength < rhs.size()) {
+      return -1;
+   } else if (lhsLength > rhs.size()) {
+      return 1;
+   }
+
+   return 0;
+}
+
+
+const ImageEntry *
+ImageArchive::findEntry(const std::string &path) const
+{
+   auto begin = mEntries;
+   auto end = mEntries + mHeader->numEntries;
+   auto itr = std::lower_bound(begin, end, path,
+      [this](const ImageEntry &entry, const std::string &path) {
+         return comparePath(getEntryPathData(&entry), entry.pathLength, path) < 0;
+      });
+
+   if (itr == end || comparePath(getEntryPathData(itr), itr->pathLength, path) != 0) {
+      return nullptr;
+   }
+
+   return itr;
+}
+
+
+std::vector<const ImageEntry *>
+ImageArchive::findChildren(const std::string &path) const
+{
+   auto result = std::vector<const ImageEntry *> { };
+   auto prefix = path.empty() ? path : path + "/";
+   auto begin = mEntries;
+   auto end = mEntries + mHeader->numEntries;
+   auto itr = std::lower_bound(begin, end, prefix,
+      [this](const ImageEntry &entry, const std::string &prefix) {
+         return comparePath(getEntryPathData(&entry), entry.pathLength, prefix) < 0;
+      });
+
+   // Every descendant of path shares the prefix so they are contiguous
+   for (; itr != end; ++itr) {
+      auto data = getEntryPathData(itr);
+
+      if (itr->pathLength <= prefix.size() ||
+          std::memcmp(data, prefix.data(), prefix.size()) != 0) {
+         break;
+      }
+
+      // Skip anything which is not a direct child
+      if (std::memchr(data + prefix.size(), '/', itr->pathLength - prefix.size())) {
+         continue;
+      }
+
+      result.push_back(itr);
+   }
+
+   return result;
+}
+
+
+size_t
+ImageArchive::read(const ImageEntry *entry,
+                   size_t offset,
+                   uint8_t *buffer,
+                   size_t size)
+{
+   if (entry->type != ImageEntryType::File || offset >= entry->size) {
+      return 0;
+   }
+
+   auto chunkSize = mHeader->chunkSize;
+   auto bytesRead = size_t { 0 };
+   size = std::min<size_t>(size, entry->size - offset);
+
+   while (bytesRead < size) {
+      auto chunkIndex = entry->firstChunk + offset / chunkSize;
+      auto chunkOffset = offset % chunkSize;
+      auto chunk = getChunk(chunkIndex);
+
+      if (!chunk || chunkOffset >= chunk->size()) {
+         break;
+      }
+
+      auto copySize = std::min(size - bytesRead, chunk->size() - chunkOffset);
+      std::memcpy(buffer + bytesRead, chunk->data() + chunkOffset, copySize);
+      bytesRead += copySize;
+      offset += copySize;
+   }
+
+   return bytesRead;
+}
+
+
+ImageArchive::ChunkData
+ImageArchive::getChunk(uint64_t index)
+{
+   {
+      std::unique_lock<std::mutex> lock { mCacheMutex };
+      auto itr = mCache.find(index);
+
+      if (itr != mCache.end()) {
+         mCacheOrder.splice(mCacheOrder.begin(), mCacheOrder, itr->second.second);
+         return itr->second.first;
+      }
+   }
+
+   // Decompress outside of the lock so handles can read other chunks
+   auto chunk = decompressChunk(index);
+
+   if (!chunk) {
+      return nullptr;
+   }
+
+   std::unique_lock<std::mutex> lock { mCacheMutex };
+   auto itr = mCache.find(index);
+
+   if (itr != mCache.end()) {
+      // Somebody else decompressed this chunk whilst we were
+      return itr->second.first;
+   }
+
+   mCacheOrder.push_front(index);
+   mCache.emplace(index, std::make_pair(chunk, mCacheOrder.begin()));
+   mCacheUsed += chunk->size();
+
+   while (mCacheUsed > mCacheSize && mCacheOrder.size() > 1) {
+      auto evict = mCache.find(mCacheOrder.back());
+      mCacheUsed -= evict->second.first->size();
+      mCache.erase(evict);
+      mCacheOrder.pop_back();
+   }
+
+   return chunk;
+}
+
+
+ImageArchive::ChunkData
+ImageArchive::decompressChunk(uint64_t index)
+{
+   decaf_check(index < mHeader->numChunks);
+   auto &chunk = mChunks[index];
+   auto src = mView + chunk.offset;
+
+   if (mHeader->compression == ImageCompression::None ||
+       (chunk.flags & ImageChunkFlags::Stored)) {
+      return std::make_shared<const std::vector<uint8_t>>(src, src + chunk.size);
+   }
+
+   auto data = std::make_shared<std::vector<uint8_t>>(mHeader->chunkSize);
+   auto size = static_cast<uLongf>(data->size());
+   auto ret = uncompress(data->data(), &size, src, chunk.size);
+
+   if (ret != Z_OK) {
+      gLog->error("Failed to decompress image chunk {}, uncompress returned {}", index, ret);
+      return nullptr;
+   }
+
+   data->resize(size);
+   return data;
+}
+
+} // namespace fs
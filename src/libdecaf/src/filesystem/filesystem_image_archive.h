@@ -0,0 +1,95 @@
+#pragma once
+#include "filesystem_image_format.h"
+
+#include <common/platform_memory.h>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace fs
+{
+
+/**
+ * A memory mapped .dci image.
+ *
+ * The image is shared between every node and handle opened from it, which
+ * means they also share a single cache of decompressed chunks.
+ */
+class ImageArchive
+{
+   using ChunkData = std::shared_ptr<const std::vector<uint8_t>>;
+
+public:
+   static constexpr size_t DefaultCacheSize = 32 * 1024 * 1024;
+
+   ~ImageArchive();
+
+   static std::shared_ptr<ImageArchive>
+   open(const std::string &path,
+        size_t cacheSize = DefaultCacheSize);
+
+   const ImageEntry *
+   findEntry(const std::string &path) const;
+
+   std::vector<const ImageEntry *>
+   findChildren(const std::string &path) const;
+
+   std::string
+   getEntryPath(const ImageEntry *entry) const;
+
+   std::string
+   getEntryName(const ImageEntry *entry) const;
+
+   size_t
+   read(const ImageEntry *entry,
+        size_t offset,
+        uint8_t *buffer,
+        size_t size);
+
+private:
+   ImageArchive() = default;
+
+   bool
+   validate();
+
+   const char *
+   getEntryPathData(const ImageEntry *entry) const;
+
+   ChunkData
+   getChunk(uint64_t index);
+
+   ChunkData
+   decompressChunk(uint64_t index);
+
+private:
+   platform::MapFileHandle mFile = platform::InvalidMapFileHandle;
+   const uint8_t *mView = nullptr;
+   size_t mSize = 0;
+
+   const ImageHeader *mHeader = nullptr;
+   const ImageChunk *mChunks = nullptr;
+   const ImageEntry *mEntries = nullptr;
+   const char *mStrings = nullptr;
+
+   //! Protects the decompressed chunk cache.
+   std::mutex mCacheMutex;
+
+   //! Chunk indices in least recently used order, most recent at front.
+   std::list<uint64_t> mCacheOrder;
+
+   //! Decompressed chunks, and their position in mCacheOrder.
+   std::unordered_map<uint64_t, std::pair<ChunkData, std::list<uint64_t>::iterator>> mCache;
+
+   //! Total uncompressed size of the chunks in mCache.
+   size_t mCacheUsed = 0;
+
+   //! Maximum uncompressed size of the chunks in mCache.
+   size_t mCacheSize = DefaultCacheSize;
+};
+
+} // namespace fs
@@ -0,0 +1,55 @@
+#pragma once
+#include "filesystem_file.h"
+#include "filesystem_image_archive.h"
+#include "filesystem_image_filehandle.h"
+
+#include <memory>
+#include <string>
+
+namespace fs
+{
+
+class ImageFile : public File
+{
+public:
+   ImageFile(std::shared_ptr<ImageArchive> archive,
+             const ImageEntry *entry,
+             const std::string &name,
+             Permissions permissions) :
+      File(DeviceType::ImageDevice, permissions, name),
+      mArchive(std::move(archive)),
+      mEntry(entry)
+   {
+      setSize(static_cast<size_t>(entry->size));
+   }
+
+   virtual ~ImageFile() override = default;
+
+   virtual FileHandle
+   open(OpenMode mode) override
+   {
+      // Images are always read only
+      if ((mode & File::Write) || (mode & File::Append)) {
+         return nullptr;
+      }
+
+      if (!checkOpenPermissions(mode)) {
+         return nullptr;
+      }
+
+      auto handle = new ImageFileHandle { mArchive, mEntry };
+
+      if (!handle->open()) {
+         delete handle;
+         return nullptr;
+      }
+
+      return FileHandle { handle };
+   }
+
+private:
+   std::shared_ptr<ImageArchive> mArchive;
+   const ImageEntry *mEntry;
+};
+
+} // namespace fs
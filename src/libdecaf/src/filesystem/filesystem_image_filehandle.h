@@ -0,0 +1,99 @@
+#pragma once
+#include "filesystem_filehandle.h"
+#include "filesystem_image_archive.h"
+
+#include <memory>
+
+namespace fs
+{
+
+struct ImageFileHandle : public IFileHandle
+{
+   ImageFileHandle(std::shared_ptr<ImageArchive> archive,
+                   const ImageEntry *entry) :
+      mArchive(std::move(archive)),
+      mEntry(entry)
+   {
+   }
+
+   virtual ~ImageFileHandle() override = default;
+
+   virtual bool
+   open() override
+   {
+      mPosition = 0;
+      return !!mEntry;
+   }
+
+   virtual void
+   close() override
+   {
+      mEntry = nullptr;
+   }
+
+   virtual bool
+   eof() override
+   {
+      return mPosition >= mEntry->size;
+   }
+
+   virtual bool
+   flush() override
+   {
+      return false;
+   }
+
+   virtual bool
+   seek(size_t position) override
+   {
+      mPosition = position;
+      return true;
+   }
+
+   virtual size_t
+   size() override
+   {
+      return static_cast<size_t>(mEntry->size);
+   }
+
+   virtual size_t
+   tell() override
+   {
+      return mPosition;
+   }
+
+   virtual size_t
+   truncate() override
+   {
+      return 0;
+   }
+
+   virtual size_t
+   read(uint8_t *data,
+        size_t size,
+        size_t count) override
+   {
+      if (size == 0) {
+         return 0;
+      }
+
+      auto bytesRead = mArchive->read(mEntry, mPosition, data, size * count);
+      mPosition += bytesRead;
+      return bytesRead / size;
+   }
+
+   virtual size_t
+   write(const uint8_t *data,
+         size_t size,
+         size_t count) override
+   {
+      return 0;
+   }
+
+private:
+   std::shared_ptr<ImageArchive> mArchive;
+   const ImageEntry *mEntry;
+   size_t mPosition = 0;
+};
+
+} // namespace fs
@@ -0,0 +1,140 @@
+#pragma once
+#include "filesystem_folder.h"
+#include "filesystem_image_archive.h"
+#include "filesystem_image_file.h"
+#include "filesystem_image_folderhandle.h"
+#include "filesystem_virtual_folder.h"
+
+#include <memory>
+#include <string>
+
+namespace fs
+{
+
+/**
+ * A read only folder inside of an ImageArchive.
+ *
+ * Child nodes are created on first lookup and owned by mVirtual, the same
+ * way HostFolder registers the host files it has found.
+ */
+class ImageFolder : public Folder
+{
+public:
+   ImageFolder(std::shared_ptr<ImageArchive> archive,
+               const std::string &path,
+               const std::string &name,
+               Permissions permissions) :
+      Folder(DeviceType::ImageDevice, permissions, name),
+      mArchive(std::move(archive)),
+      mPath(path),
+      mVirtual(permissions, name)
+   {
+   }
+
+   virtual ~ImageFolder() override = default;
+
+   virtual Result<Folder *>
+   addFolder(const std::string &name) override
+   {
+      auto child = findChild(name);
+
+      if (child) {
+         if (child->type() != fs::Node::FolderNode) {
+            return { Error::AlreadyExists, nullptr };
+         }
+
+         return { Error::AlreadyExists, reinterpret_cast<Folder *>(child) };
+      }
+
+      return Error::InvalidPermission;
+   }
+
+   virtual Result<Error>
+   remove(const std::string &name) override
+   {
+      if (!findChild(name)) {
+         return Error::NotFound;
+      }
+
+      return Error::InvalidPermission;
+   }
+
+   virtual Node *
+   findChild(const std::string &name) override
+   {
+      if (auto child = mVirtual.findChild(name)) {
+         return child;
+      }
+
+      auto path = mPath.empty() ? name : mPath + "/" + name;
+      auto entry = mArchive->findEntry(path);
+
+      if (!entry) {
+         return nullptr;
+      }
+
+      if (entry->type == ImageEntryType::Folder) {
+         return mVirtual.addChild(new ImageFolder { mArchive, path, name, mPermissions });
+      } else {
+         return mVirtual.addChild(new ImageFile { mArchive, entry, name, mPermissions });
+      }
+   }
+
+   virtual Result<FileHandle>
+   openFile(const std::string &name,
+            File::OpenMode mode) override
+   {
+      if ((mode & File::Write) || (mode & File::Append)) {
+         return Error::InvalidPermission;
+      }
+
+      if (!checkPermission(Permissions::Read)) {
+         return Error::InvalidPermission;
+      }
+
+      auto child = findChild(name);
+
+      if (!child) {
+         return Error::NotFound;
+      }
+
+      if (child->type() != NodeType::FileNode) {
+         return Error::NotFile;
+      }
+
+      return reinterpret_cast<File *>(child)->open(mode);
+   }
+
+   virtual Result<FolderHandle>
+   openDirectory() override
+   {
+      if (!checkPermission(Permissions::Read)) {
+         return Error::InvalidPermission;
+      }
+
+      auto handle = new ImageFolderHandle { mArchive, mPath };
+
+      if (!handle->open()) {
+         delete handle;
+         return Error::UnsupportedOperation;
+      }
+
+      return FolderHandle { handle };
+   }
+
+   virtual void
+   setPermissions(Permissions permissions,
+                  PermissionFlags flags) override
+   {
+      // Images can never be written to
+      mPermissions = static_cast<Permissions>(permissions & Permissions::Read);
+      mVirtual.setPermissions(mPermissions, flags);
+   }
+
+private:
+   std::shared_ptr<ImageArchive> mArchive;
+   std::string mPath;
+   VirtualFolder mVirtual;
+};
+
+} // namespace fs
@@ -0,0 +1,73 @@
+#pragma once
+#include "filesystem_folderhandle.h"
+#include "filesystem_image_archive.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace fs
+{
+
+class ImageFolderHandle : public IFolderHandle
+{
+public:
+   ImageFolderHandle(std::shared_ptr<ImageArchive> archive,
+                     const std::string &path) :
+      mArchive(std::move(archive)),
+      mPath(path)
+   {
+   }
+
+   virtual ~ImageFolderHandle() override = default;
+
+   virtual bool
+   open() override
+   {
+      mChildren = mArchive->findChildren(mPath);
+      mPosition = 0;
+      return true;
+   }
+
+   virtual void
+   close() override
+   {
+      mChildren.clear();
+      mPosition = 0;
+   }
+
+   virtual bool
+   read(FolderEntry &entry) override
+   {
+      if (mPosition >= mChildren.size()) {
+         return false;
+      }
+
+      auto child = mChildren[mPosition++];
+      entry.name = mArchive->getEntryName(child);
+      entry.size = static_cast<size_t>(child->size);
+
+      if (child->type == ImageEntryType::Folder) {
+         entry.type = FolderEntry::Folder;
+      } else {
+         entry.type = FolderEntry::File;
+      }
+
+      return true;
+   }
+
+   virtual bool
+   rewind() override
+   {
+      mPosition = 0;
+      return true;
+   }
+
+private:
+   std::shared_ptr<ImageArchive> mArchive;
+   std::string mPath;
+   std::vector<const ImageEntry *> mChildren;
+   size_t mPosition = 0;
+};
+
+} // namespace fs
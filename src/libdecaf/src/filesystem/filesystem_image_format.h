@@ -0,0 +1,100 @@
+#pragma once
+#include <cstdint>
+
+namespace fs
+{
+
+/*
+ * Decaf compressed image (.dci) layout, all values are little endian:
+ *
+ *    ImageHeader
+ *    Compressed chunk data
+ *    ImageChunk[numChunks]       at chunkTableOffset
+ *    ImageEntry[numEntries]      at entryTableOffset, sorted by path
+ *    char[stringTableSize]       at stringTableOffset
+ *
+ * Every file is split into chunkSize sized chunks which are compressed
+ * individually so a read only has to decompress the chunks it touches. The
+ * chunks of a file are contiguous in the chunk table starting at firstChunk.
+ *
+ * Entry paths are relative to the image root, use '/' as a separator and do
+ * not have a leading '/'. Because entries are sorted by path every folder's
+ * descendants form a contiguous range in the entry table.
+ */
+
+static constexpr uint32_t ImageMagic = 0x49464344; // 'DCFI'
+static constexpr uint32_t ImageVersion = 1;
+static constexpr uint32_t ImageDefaultChunkSize = 64 * 1024;
+
+enum class ImageCompression : uint32_t
+{
+   None = 0,
+   Zlib = 1,
+};
+
+namespace ImageChunkFlags_
+{
+enum Value : uint32_t
+{
+   None = 0,
+
+   //! Chunk did not compress and is stored as is.
+   Stored = 1 << 0,
+};
+}
+using ImageChunkFlags = ImageChunkFlags_::Value;
+
+enum class ImageEntryType : uint32_t
+{
+   File = 0,
+   Folder = 1,
+};
+
+struct ImageHeader
+{
+   uint32_t magic;
+   uint32_t version;
+   uint32_t chunkSize;
+   ImageCompression compression;
+   uint64_t numChunks;
+   uint64_t chunkTableOffset;
+   uint64_t numEntries;
+   uint64_t entryTableOffset;
+   uint64_t stringTableOffset;
+   uint64_t stringTableSize;
+};
+static_assert(sizeof(ImageHeader) == 0x40, "ImageHeader has unexpected size");
+
+struct ImageChunk
+{
+   //! Offset of the compressed chunk data from start of the image.
+   uint64_t offset;
+
+   //! Size of the compressed chunk data.
+   uint32_t size;
+
+   //! ImageChunkFlags.
+   uint32_t flags;
+};
+static_assert(sizeof(ImageChunk) == 0x10, "ImageChunk has unexpected size");
+
+struct ImageEntry
+{
+   //! Offset of the path in the string table.
+   uint64_t pathOffset;
+
+   //! Length of the path, not including any null terminator.
+   uint32_t pathLength;
+
+   //! ImageEntryType.
+   ImageEntryType type;
+
+   //! Uncompressed size of the file, 0 for folders.
+   uint64_t size;
+
+   //! Index of the first chunk of the file in the chunk table.
+   uint64_t firstChunk;
+};
+static_assert(sizeof(ImageEntry) == 0x20, "ImageEntry has unexpected size");
+
+} // namespace fs
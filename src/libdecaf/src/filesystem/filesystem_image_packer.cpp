@@ -0,0 +1,215 @@
+#include "filesystem_host_folderhandle.h"
+#include "filesystem_host_path.h"
+#include "filesystem_image_packer.h"
+
+#include <algorithm>
+#include <common/log.h>
+#include <fstream>
+#include <vector>
+#include <zlib.h>
+
+namespace fs
+{
+
+struct PackEntry
+{
+   std::string path;
+   HostPath hostPath;
+   ImageEntryType type;
+   uint64_t size = 0;
+   uint64_t firstChunk = 0;
+};
+
+static bool
+collectEntries(const HostPath &hostPath,
+               const std::string &path,
+               std::vector<PackEntry> &entries)
+{
+   auto handle = HostFolderHandle { hostPath };
+   auto entry = FolderEntry { };
+
+   if (!handle.open()) {
+      gLog->error("Could not open folder {}", hostPath.path());
+      return false;
+   }
+
+   while (handle.read(entry)) {
+      auto packEntry = PackEntry { };
+      packEntry.path = path.empty() ? entry.name : path + "/" + entry.name;
+      packEntry.hostPath = hostPath.join(entry.name);
+
+      if (entry.type == FolderEntry::Folder) {
+         packEntry.type = ImageEntryType::Folder;
+         entries.push_back(packEntry);
+
+         if (!collectEntries(packEntry.hostPath, packEntry.path, entries)) {
+            return false;
+         }
+      } else if (entry.type == FolderEntry::File) {
+         packEntry.type = ImageEntryType::File;
+         packEntry.size = entry.size;
+         entries.push_back(packEntry);
+      }
+   }
+
+   return true;
+}
+
+static void
+alignStream(std::ofstream &out,
+            size_t alignment)
+{
+   auto pos = static_cast<size_t>(out.tellp());
+
+   while (pos % alignment) {
+      out.put(0);
+      ++pos;
+   }
+}
+
+static bool
+packFile(std::ofstream &out,
+         PackEntry &entry,
+         const ImagePackOptions &options,
+         std::vector<ImageChunk> &chunks)
+{
+   std::ifstream in { entry.hostPath.path(), std::ifstream::binary };
+
+   if (!in.is_open()) {
+      gLog->error("Could not open file {}", entry.hostPath.path());
+      return false;
+   }
+
+   auto buffer = std::vector<uint8_t>(options.chunkSize);
+   auto compressed = std::vector<uint8_t>(compressBound(options.chunkSize));
+   auto remaining = entry.size;
+   entry.firstChunk = chunks.size();
+
+   while (remaining > 0) {
+      auto size = static_cast<uint32_t>(std::min<uint64_t>(remaining, options.chunkSize));
+      in.read(reinterpret_cast<char *>(buffer.data()), size);
+
+      if (in.gcount() != size) {
+         gLog->error("Short read from {}", entry.hostPath.path());
+         return false;
+      }
+
+      auto chunk = ImageChunk { };
+      chunk.offset = static_cast<uint64_t>(out.tellp());
+      chunk.flags = ImageChunkFlags::None;
+
+      auto compressedSize = static_cast<uLongf>(compressed.size());
+
+      if (options.compression == ImageCompression::Zlib &&
+          compress2(compressed.data(), &compressedSize, buffer.data(), size, options.level) == Z_OK &&
+          compressedSize < size) {
+         chunk.size = static_cast<uint32_t>(compressedSize);
+         out.write(reinterpret_cast<const char *>(compressed.data()), compressedSize);
+      } else {
+         chunk.size = size;
+         chunk.flags = ImageChunkFlags::Stored;
+         out.write(reinterpret_cast<const char *>(buffer.data()), size);
+      }
+
+      chunks.push_back(chunk);
+      remaining -= size;
+   }
+
+   return true;
+}
+
+bool
+packImage(const std::string &src,
+          const std::string &dst,
+          const ImagePackOptions &options)
+{
+   if (options.chunkSize == 0) {
+      gLog->error("Invalid image chunk size");
+      return false;
+   }
+
+   auto entries = std::vector<PackEntry> { };
+
+   if (!collectEntries(HostPath { src }, {}, entries)) {
+      return false;
+   }
+
+   // The archive relies on entries being sorted by path for lookups
+   std::sort(entries.begin(), entries.end(),
+             [](const PackEntry &lhs, const PackEntry &rhs) {
+                return lhs.path < rhs.path;
+             });
+
+   std::ofstream out { dst, std::ofstream::binary };
+
+   if (!out.is_open()) {
+      gLog->error("Could not open {} for writing", dst);
+      return false;
+   }
+
+   auto header = ImageHeader { };
+   out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+   // Write chunk data
+   auto chunks = std::vector<ImageChunk> { };
+   auto totalSize = uint64_t { 0 };
+
+   for (auto &entry : entries) {
+      if (entry.type != ImageEntryType::File) {
+         continue;
+      }
+
+      if (!packFile(out, entry, options, chunks)) {
+         return false;
+      }
+
+      totalSize += entry.size;
+   }
+
+   // Write chunk table
+   alignStream(out, 16);
+   header.chunkTableOffset = static_cast<uint64_t>(out.tellp());
+   header.numChunks = chunks.size();
+   out.write(reinterpret_cast<const char *>(chunks.data()), chunks.size() * sizeof(ImageChunk));
+
+   // Write entry table
+   auto strings = std::string { };
+   header.entryTableOffset = static_cast<uint64_t>(out.tellp());
+   header.numEntries = entries.size();
+
+   for (auto &entry : entries) {
+      auto imageEntry = ImageEntry { };
+      imageEntry.pathOffset = strings.size();
+      imageEntry.pathLength = static_cast<uint32_t>(entry.path.size());
+      imageEntry.type = entry.type;
+      imageEntry.size = entry.size;
+      imageEntry.firstChunk = entry.firstChunk;
+      out.write(reinterpret_cast<const char *>(&imageEntry), sizeof(imageEntry));
+      strings.append(entry.path);
+   }
+
+   // Write string table
+   header.stringTableOffset = static_cast<uint64_t>(out.tellp());
+   header.stringTableSize = strings.size();
+   out.write(strings.data(), strings.size());
+
+   // Finally go back and write the header
+   header.magic = ImageMagic;
+   header.version = ImageVersion;
+   header.chunkSize = options.chunkSize;
+   header.compression = options.compression;
+
+   auto imageSize = static_cast<uint64_t>(out.tellp());
+   out.seekp(0);
+   out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+   if (!out.good()) {
+      gLog->error("Error writing {}", dst);
+      return false;
+   }
+
+   gLog->info("Packed {} entries, {} bytes into {} bytes", entries.size(), totalSize, imageSize);
+   return true;
+}
+
+} // namespace fs
@@ -0,0 +1,30 @@
+#pragma once
+#include "filesystem_image_format.h"
+
+#include <string>
+
+namespace fs
+{
+
+struct ImagePackOptions
+{
+   //! Uncompressed size of each chunk.
+   uint32_t chunkSize = ImageDefaultChunkSize;
+
+   //! Codec used for chunks, chunks which do not shrink are always stored.
+   ImageCompression compression = ImageCompression::Zlib;
+
+   //! zlib compression level.
+   int level = 9;
+};
+
+/**
+ * Packs every file and folder under the host folder src into a .dci image
+ * at dst, which can then be opened with ImageArchive.
+ */
+bool
+packImage(const std::string &src,
+          const std::string &dst,
+          const ImagePackOptions &options = { });
+
+} // namespace fs
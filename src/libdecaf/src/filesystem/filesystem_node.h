@@ -21,6 +21,7 @@ public:
       VirtualDevice,
       HostDevice,
       LinkDevice,
+      ImageDevice,
    };
 
    Node(NodeType type,
@@ -66,6 +67,12 @@ public:
       mSize = size;
    }
 
+   Permissions
+   permissions() const
+   {
+      return mPermissions;
+   }
+
    virtual void
    setPermissions(Permissions permissions,
                   PermissionFlags flags)
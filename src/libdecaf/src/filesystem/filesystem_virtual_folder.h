@@ -3,6 +3,7 @@
 #include "filesystem_node.h"
 #include "filesystem_virtual_folderhandle.h"
 #include <algorithm>
+#include <unordered_map>
 #include <vector>
 
 namespace fs
@@ -28,6 +29,7 @@ public:
    addChild(Node *node)
    {
       mChildren.push_back(node);
+      mChildIndex.emplace(node->name(), node);
       return node;
    }
 
@@ -41,6 +43,7 @@ public:
       }
 
       mChildren.erase(itr, mChildren.end());
+      unindexChild(node);
       delete node;
       return true;
    }
@@ -84,6 +87,7 @@ public:
       }
 
       mChildren.erase(std::remove(mChildren.begin(), mChildren.end(), node), mChildren.end());
+      unindexChild(node);
       delete node;
       return Error::OK;
    }
@@ -91,13 +95,13 @@ public:
    virtual Node *
    findChild(const std::string &name) override
    {
-      for (auto node : mChildren) {
-         if (node->name().compare(name) == 0) {
-            return node;
-         }
+      auto itr = mChildIndex.find(name);
+
+      if (itr == mChildIndex.end()) {
+         return nullptr;
       }
 
-      return nullptr;
+      return itr->second;
    }
 
    virtual Result<FolderHandle>
@@ -131,7 +135,33 @@ public:
    }
 
 private:
+   void
+   unindexChild(Node *node)
+   {
+      auto itr = mChildIndex.find(node->name());
+
+      if (itr == mChildIndex.end() || itr->second != node) {
+         return;
+      }
+
+      mChildIndex.erase(itr);
+
+      // Fall back to any other child which shares the same name, this matches
+      // the first-match behaviour of a linear search over mChildren.
+      for (auto child : mChildren) {
+         if (child->name() == node->name()) {
+            mChildIndex.emplace(child->name(), child);
+            break;
+         }
+      }
+   }
+
+private:
+   //! Children in insertion order, used for directory iteration.
    std::vector<Node *> mChildren;
+
+   //! Children indexed by name, used for lookups.
+   std::unordered_map<std::string, Node *> mChildIndex;
 };
 
 } // namespace fs
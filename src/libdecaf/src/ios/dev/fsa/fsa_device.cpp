@@ -2,6 +2,7 @@
 #include "kernel/kernel_filesystem.h"
 
 #include <cstring>
+#include <libcpu/mmu.h>
 
 namespace ios
 {
@@ -599,6 +600,9 @@ FSADevice::readFile(FSARequestReadFile *request,
 
    auto elemsRead = file->read(buffer, request->size, request->count);
    auto bytesRead = elemsRead * request->size;
+
+   // We read through the physical mapping, so write tracking did not see it
+   cpu::markPhysicalMemoryWritten(cpu::translatePhysical(buffer), bufferLen);
    return static_cast<FSAStatus>(bytesRead);
 }
 
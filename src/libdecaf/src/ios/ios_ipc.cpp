@@ -6,6 +6,7 @@
 #include "dev/socket/socket_device.h"
 #include "dev/usr_cfg/usr_cfg_device.h"
 
+#include <common/perftrace.h>
 #include <map>
 #include <string>
 #include <spdlog/fmt/fmt.h>
@@ -44,6 +45,7 @@ iosGetDevice(IOSHandle handle);
 void
 iosDispatchIpcRequest(IPCBuffer *buffer)
 {
+   PERFTRACE_ZONE("ipc", "iosDispatchIpcRequest");
    auto reply = IOSError::FailInternal;
 
    switch (buffer->command) {
@@ -7,6 +7,7 @@
 #include "kernel_ipc.h"
 #include "kernel_loader.h"
 #include "kernel_memory.h"
+#include "kernel_profiler.h"
 #include "kernel_filesystem.h"
 #include "ios/ios_ipc.h"
 #include "modules/coreinit/coreinit.h"
@@ -30,6 +31,7 @@
 #include "ppcutils/wfunc_call.h"
 #include "ppcutils/stackobject.h"
 
+#include <chrono>
 #include <common/decaf_assert.h>
 #include <common/platform_dir.h>
 #include <common/platform_fiber.h>
@@ -38,6 +40,8 @@
 #include <fmt/format.h>
 #include <libcpu/mem.h>
 #include <pugixml.hpp>
+#include <thread>
+#include <vector>
 
 namespace coreinit
 {
@@ -79,6 +83,12 @@ cpuIllInstHandler();
 static void
 cpuBranchTraceHandler(uint32_t target);
 
+static void
+flushBranchTrace();
+
+static void
+cpuHostSyncHandler();
+
 static bool
 launchGame();
 
@@ -109,6 +119,14 @@ sInterruptContext[3];
 static decaf::GameInfo
 sGameInfo;
 
+//! How long a deterministic hand over waits for the GPU and IOS
+static constexpr auto
+HostSyncTimeout = std::chrono::seconds { 1 };
+
+//! Set once the host failed to sync in time, only used by the turn holder
+static bool
+sHostSyncTimedOut = false;
+
 void
 setExecutableFilename(const std::string& name)
 {
@@ -126,6 +144,7 @@ initialise()
    cpu::setSegfaultHandler(&cpuSegfaultHandler);
    cpu::setIllInstHandler(&cpuIllInstHandler);
    cpu::setInterruptHandler(&cpuInterruptHandler);
+   cpu::setHostSyncHandler(&cpuHostSyncHandler);
 
    if (decaf::config::log::branch_trace) {
       cpu::setBranchTraceHandler(&cpuBranchTraceHandler);
@@ -147,15 +166,67 @@ getSystemHeap()
    return sSystemHeap;
 }
 
+/**
+ * Called at every hand over in deterministic mode, waits for the GPU and IOS
+ * to finish the work the guest has given them so the interrupts they raise
+ * are delivered at the same point in every run.
+ */
 static void
-cpuBranchTraceHandler(uint32_t target)
+cpuHostSyncHandler()
 {
-   auto symNamePtr = loader::findSymbolNameForAddress(target);
-   if (!symNamePtr) {
+   if (sHostSyncTimedOut) {
       return;
    }
 
-   gLog->debug("CPU branched to: {}", *symNamePtr);
+   auto deadline = std::chrono::steady_clock::now() + HostSyncTimeout;
+
+   while (!gx2::internal::isGpuIdle() || !ipcIsIdle()) {
+      if (std::chrono::steady_clock::now() >= deadline) {
+         // The GPU may be waiting on something the guest has not done yet,
+         //  rather than stall every hand over stop waiting altogether.
+         gLog->warn("Timed out waiting for the GPU and IOS, this deterministic run may not be reproducible");
+         sHostSyncTimedOut = true;
+         return;
+      }
+
+      std::this_thread::sleep_for(std::chrono::microseconds { 10 });
+   }
+}
+
+//! Branch targets waiting to be looked up by flushBranchTrace
+static thread_local std::vector<ppcaddr_t>
+tBranchTraceTargets;
+
+static void
+flushBranchTrace()
+{
+   if (tBranchTraceTargets.empty()) {
+      return;
+   }
+
+   auto names = loader::findSymbolNamesForAddresses(tBranchTraceTargets);
+
+   for (auto name : names) {
+      if (name) {
+         gLog->debug("CPU branched to: {}", *name);
+      }
+   }
+
+   tBranchTraceTargets.clear();
+}
+
+static void
+cpuBranchTraceHandler(uint32_t target)
+{
+   // Look up branch targets in batches, which share one sort of the targets
+   //  and one pass over the symbols. A partial batch is flushed when the
+   //  core goes idle or exits.
+   static constexpr size_t BatchSize = 64;
+   tBranchTraceTargets.push_back(target);
+
+   if (tBranchTraceTargets.size() >= BatchSize) {
+      flushBranchTrace();
+   }
 }
 
 static std::string
@@ -265,9 +336,13 @@ cpuInterruptHandler(uint32_t interrupt_flags)
       }
    }
 
-   auto unsafeInterrupts = cpu::NONMASKABLE_INTERRUPTS | cpu::DBGBREAK_INTERRUPT;
+   if (interrupt_flags & cpu::PROFILER_INTERRUPT) {
+      profilerSample();
+   }
+
+   auto unsafeInterrupts = cpu::NONMASKABLE_INTERRUPTS | cpu::DBGBREAK_INTERRUPT | cpu::PROFILER_INTERRUPT;
    if (!(interrupt_flags & ~unsafeInterrupts)) {
-      // Due to the fact that non-maskable interrupts are not able to be disabled
+      // Due to the fact that these interrupts are not disabled by OSDisableInterrupts
       // it is possible the application has the scheduler lock or something, so we
       // need to stop processing here or else bad things could happen.
       return;
@@ -352,8 +427,11 @@ cpuEntrypoint()
    // Run the scheduler loop, this is what will
    //   execute when there is nothing else to do.
    while (sRunning) {
+      flushBranchTrace();
       cpu::this_core::waitForInterrupt();
    }
+
+   flushBranchTrace();
 }
 
 static bool
@@ -1,10 +1,13 @@
 #include "kernel.h"
+#include "kernel_internal.h"
 #include <algorithm>
 #include <cfenv>
 #include "libcpu/cpu.h"
 #include "libcpu/mem.h"
+#include <common/perftrace.h>
 #include <common/platform_fiber.h>
 #include <common/platform_thread.h>
+#include <common/platform_time.h>
 #include "modules/coreinit/coreinit.h"
 #include "modules/coreinit/coreinit_core.h"
 #include "modules/coreinit/coreinit_ghs.h"
@@ -14,6 +17,9 @@
 #include "modules/coreinit/coreinit_systeminfo.h"
 #include "ppcutils/wfunc_call.h"
 
+#include <spdlog/fmt/fmt.h>
+#include <vector>
+
 namespace kernel
 {
 
@@ -29,11 +35,37 @@ sIdleFiber[3];
 static coreinit::OSContext
 sIdleContext[3];
 
+//! When the current context started running on each core, for tracing
+static uint64_t
+sContextStartTime[3];
+
+struct TraceZone
+{
+   const char *category;
+   const char *name;
+
+   //! When the zone last started or resumed running, 0 if tracing was off
+   uint64_t start;
+};
+
 struct Fiber
 {
    platform::Fiber *handle = nullptr;
    coreinit::OSContext *context = nullptr;
    cpu::Tracer *tracer = nullptr;
+
+   //! Host cycles spent switched out, used to exclude them from HLE stats
+   uint64_t suspendedCycles = 0;
+
+   //! Host cycles spent in HLE functions, used to exclude nested HLE calls
+   uint64_t hleCycles = 0;
+
+   //! Interned thread name for tracing, and the guest name it was made from
+   const char *traceName = nullptr;
+   const char *traceNameSource = nullptr;
+
+   //! Trace zones open in this context, innermost last
+   std::vector<TraceZone> traceZones;
 };
 
 static void
@@ -202,6 +234,9 @@ reallocateContextFiber(coreinit::OSContext *context,
    auto oldFiber = context->fiber->handle;
    auto newFiber = platform::createFiber(entry, nullptr);
    context->fiber->handle = newFiber;
+
+   // The old fiber's stack is abandoned along with any zones open on it
+   context->fiber->traceZones.clear();
    platform::swapToFiber(oldFiber, newFiber);
 }
 
@@ -280,6 +315,115 @@ getContextFiber(coreinit::OSContext *context)
    return context->fiber->handle;
 }
 
+// Records how long the context being switched out of ran for
+static void
+traceContextSwitch(uint32_t coreId,
+                   coreinit::OSContext *current)
+{
+   auto now = perftrace::now();
+   auto start = sContextStartTime[coreId];
+   sContextStartTime[coreId] = now;
+
+   if (!current) {
+      return;
+   }
+
+   // Close the zones open in this context so they nest inside its slice,
+   //  they are reopened when the context resumes, possibly on another core.
+   if (current->fiber) {
+      for (auto &zone : current->fiber->traceZones) {
+         if (zone.start) {
+            perftrace::complete(zone.category, zone.name, zone.start);
+         }
+      }
+   }
+
+   if (!start) {
+      return;
+   }
+
+   // Every context we schedule is the first member of an OSThread, intern
+   //  its name only when it changes as intern has to take a lock.
+   auto thread = reinterpret_cast<coreinit::OSThread *>(current);
+   auto fiber = current->fiber;
+   auto source = thread->name ? thread->name.get() : nullptr;
+
+   if (!fiber->traceName || fiber->traceNameSource != source) {
+      fiber->traceName = source
+         ? perftrace::intern(source)
+         : perftrace::intern(fmt::format("Thread {}", thread->id));
+      fiber->traceNameSource = source;
+   }
+
+   perftrace::complete("thread", fiber->traceName, start);
+}
+
+void
+beginTraceZone(const char *category,
+               const char *name)
+{
+   auto context = sCurrentContext[cpu::this_core::id()];
+
+   if (!context || !context->fiber) {
+      return;
+   }
+
+   auto start = perftrace::isEnabled() ? perftrace::now() : 0;
+   context->fiber->traceZones.push_back({ category, name, start });
+}
+
+void
+endTraceZone()
+{
+   auto context = sCurrentContext[cpu::this_core::id()];
+
+   if (!context || !context->fiber || context->fiber->traceZones.empty()) {
+      return;
+   }
+
+   auto &zones = context->fiber->traceZones;
+   auto zone = zones.back();
+   zones.pop_back();
+
+   if (zone.start && perftrace::isEnabled()) {
+      perftrace::complete(zone.category, zone.name, zone.start);
+   }
+}
+
+uint64_t
+getContextSuspendedCycles()
+{
+   auto context = sCurrentContext[cpu::this_core::id()];
+
+   if (!context || !context->fiber) {
+      return 0;
+   }
+
+   return context->fiber->suspendedCycles;
+}
+
+uint64_t
+getContextHleCycles()
+{
+   auto context = sCurrentContext[cpu::this_core::id()];
+
+   if (!context || !context->fiber) {
+      return 0;
+   }
+
+   return context->fiber->hleCycles;
+}
+
+void
+addContextHleCycles(uint64_t cycles)
+{
+   auto context = sCurrentContext[cpu::this_core::id()];
+
+   if (context && context->fiber) {
+      context->fiber->hleCycles += cycles;
+   }
+}
+
 void
 setContext(coreinit::OSContext *next)
 {
@@ -293,12 +437,29 @@ setContext(coreinit::OSContext *next)
    // Perform savage operations before the switch
    sleepCurrentContext();
 
+   if (perftrace::isEnabled()) {
+      traceContextSwitch(coreId, current);
+   }
+
    // Switch to the new fiber, note that coreId is no longer valid
    // after this point, as this context may have been switched to
    // a new core.
    sCurrentContext[coreId] = next;
+   auto suspendStart = platform::readCycleCounter();
    platform::swapToFiber(getContextFiber(current), getContextFiber(next));
 
+   if (current) {
+      current->fiber->suspendedCycles += platform::readCycleCounter() - suspendStart;
+
+      if (!current->fiber->traceZones.empty()) {
+         auto now = perftrace::isEnabled() ? perftrace::now() : 0;
+
+         for (auto &zone : current->fiber->traceZones) {
+            zone.start = now;
+         }
+      }
+   }
+
    // Perform restoral operations after the switch
    wakeCurrentContext();
 }
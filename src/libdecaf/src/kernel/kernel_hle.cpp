@@ -30,12 +30,75 @@
 #include "modules/vpad/vpad.h"
 #include "modules/zlib125/zlib125.h"
 
+#include <algorithm>
+#include <common/bitutils.h>
+#include <common/perftrace.h>
+#include <common/platform_time.h>
+#include <set>
+#include <vector>
+
 namespace kernel
 {
 
 static std::map<std::string, HleModule*>
 sHleModules;
 
+//! Traces an HLE call, see beginTraceZone
+class HleTraceZone
+{
+public:
+   HleTraceZone(HleFunction *func) :
+      mEnabled(perftrace::isEnabled())
+   {
+      if (mEnabled) {
+         beginTraceZone(func->module.c_str(), func->name.c_str());
+      }
+   }
+
+   ~HleTraceZone()
+   {
+      if (mEnabled) {
+         endTraceZone();
+      }
+   }
+
+   HleTraceZone(const HleTraceZone &) = delete;
+   HleTraceZone &operator=(const HleTraceZone &) = delete;
+
+private:
+   bool mEnabled;
+};
+
+static void
+callWithStats(HleFunction *func,
+              cpu::Core *state)
+{
+   HleTraceZone zone { func };
+   auto suspendedStart = getContextSuspendedCycles();
+   auto nestedStart = getContextHleCycles();
+   auto start = platform::readCycleCounter();
+
+   func->call(state);
+
+   // Do not count time the thread spent switched out, such as while blocked
+   //  waiting for a mutex, or time spent in HLE functions called from guest
+   //  code we called back into as they are counted on their own.
+   auto suspended = getContextSuspendedCycles() - suspendedStart;
+   auto nested = getContextHleCycles() - nestedStart;
+   auto cycles = platform::readCycleCounter() - start - suspended - nested;
+   auto bucket = 0ul;
+
+   addContextHleCycles(cycles);
+
+   if (cycles > 0) {
+      bit_scan_reverse(&bucket, static_cast<uint32_t>(std::min<uint64_t>(cycles, 0xFFFFFFFF)));
+   }
+
+   func->stats.calls.fetch_add(1, std::memory_order_relaxed);
+   func->stats.cycles.fetch_add(cycles, std::memory_order_relaxed);
+   func->stats.histogram[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
 static void
 kcstub(cpu::Core *state, void *data)
 {
@@ -59,7 +122,12 @@ kcstub(cpu::Core *state, void *data)
    mem::write(core->gpr[1], backchainSp);
 
    // Call our target
-   func->call(state);
+   if (decaf::config::log::hle_stats) {
+      callWithStats(func, state);
+   } else {
+      HleTraceZone zone { func };
+      func->call(state);
+   }
 
    // Grab the most recent core state as it may have changed.
    core = cpu::this_core::state();
@@ -109,6 +177,7 @@ registerHleModule(const std::string &name,
       auto symbol = pair.second;
 
       if (symbol->type == HleSymbol::Function) {
+         symbol->module = name;
          registerHleFunc(reinterpret_cast<HleFunction *>(symbol));
       }
    }
@@ -130,6 +199,30 @@ registerHleModuleAlias(const std::string &module,
    sHleModules.emplace(alias, itr->second);
 }
 
+std::vector<HleFunction *>
+getHleFunctions()
+{
+   auto functions = std::vector<HleFunction *> { };
+   auto modules = std::set<HleModule *> { };
+
+   for (auto &pair : sHleModules) {
+      // Skip module aliases
+      if (!modules.insert(pair.second).second) {
+         continue;
+      }
+
+      for (auto &symbolPair : pair.second->getSymbolMap()) {
+         auto symbol = symbolPair.second;
+
+         if (symbol->type == HleSymbol::Function) {
+            functions.push_back(reinterpret_cast<HleFunction *>(symbol));
+         }
+      }
+   }
+
+   return functions;
+}
+
 HleModule *
 findHleModule(const std::string &name)
 {
@@ -1,11 +1,13 @@
 #pragma once
 #include <cstdint>
 #include <string>
+#include <vector>
 
 namespace kernel
 {
 
 class HleModule;
+struct HleFunction;
 
 void
 initialiseHleMmodules();
@@ -13,6 +15,9 @@ initialiseHleMmodules();
 HleModule *
 findHleModule(const std::string &name);
 
+std::vector<HleFunction *>
+getHleFunctions();
+
 uint32_t
 registerUnimplementedHleFunc(const std::string &module,
                              const std::string &name);
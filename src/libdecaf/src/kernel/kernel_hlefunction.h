@@ -4,11 +4,29 @@
 #include "kernel_hlesymbol.h"
 #include "libcpu/state.h"
 #include "ppcutils/ppcinvoke.h"
+#include <array>
+#include <atomic>
 #include <cstdint>
 
 namespace kernel
 {
 
+//! Number of buckets in HleFunctionStats::histogram
+static constexpr auto HleStatsHistogramSize = 32;
+
+struct HleFunctionStats
+{
+   //! Number of times the function was called
+   std::atomic<uint64_t> calls { 0 };
+
+   //! Host cycles spent in the function, not counting time spent while the
+   //!  calling thread was rescheduled away
+   std::atomic<uint64_t> cycles { 0 };
+
+   //! Calls which took [2^N, 2^(N+1)) host cycles are counted in bucket N
+   std::array<std::atomic<uint64_t>, HleStatsHistogramSize> histogram = { };
+};
+
 struct HleFunction : HleSymbol
 {
    HleFunction() :
@@ -23,6 +41,9 @@ struct HleFunction : HleSymbol
    bool traceEnabled = true;
    uint32_t syscallID = 0;
    uint32_t vaddr = 0;
+
+   //! Only updated when decaf::config::log::hle_stats is enabled
+   HleFunctionStats stats;
 };
 
 namespace functions
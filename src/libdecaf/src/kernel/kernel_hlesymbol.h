@@ -31,7 +31,7 @@ struct HleSymbol
    //! Symbol name
    std::string name;
 
-   //! Module which this symbol comes from, this is only set for unimplemented symbols
+   //! Module which this symbol comes from, this is only set for functions
    std::string module;
 
    //! A pointer to the PPC allocated memory where this symbol lives
@@ -2,6 +2,7 @@
 #include "modules/coreinit/coreinit_thread.h"
 
 #include <common/platform_fiber.h>
+#include <cstdint>
 
 namespace kernel
 {
@@ -19,4 +20,29 @@ saveContext(coreinit::OSContext *context);
 void
 restoreContext(coreinit::OSContext *context);
 
+/**
+ * Opens a trace zone in the current context.
+ *
+ * Unlike perftrace::Zone the zone is split at every context switch, so it
+ * always nests inside the "thread" slice of the core it is running on.
+ */
+void
+beginTraceZone(const char *category,
+               const char *name);
+
+void
+endTraceZone();
+
+//! Host cycles the current context has spent switched out since it was created
+uint64_t
+getContextSuspendedCycles();
+
+//! Host cycles the current context has spent in HLE functions, excluding time
+//!  switched out
+uint64_t
+getContextHleCycles();
+
+void
+addContextHleCycles(uint64_t cycles);
+
 } // namespace kernel
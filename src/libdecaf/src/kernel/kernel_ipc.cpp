@@ -28,6 +28,14 @@ sIpcRequests;
 static std::queue<IPCBuffer *>
 sIpcResponses[3];
 
+//! Protected by sIpcMutex
+static uint64_t
+sIpcDispatchedRequests = 0;
+
+//! Requests whose response has been queued, protected by sIpcMutex
+static uint64_t
+sIpcCompletedRequests = 0;
+
 static void
 ipcThreadEntry();
 
@@ -113,6 +121,38 @@ ipcDriverKernelHandleInterrupt()
 }
 
 
+/**
+ * Sample the depth of the IPC queues.
+ */
+IpcQueueStats
+ipcGetQueueStats()
+{
+   std::unique_lock<std::mutex> lock { sIpcMutex };
+   auto stats = IpcQueueStats { };
+   stats.pendingRequests = static_cast<uint32_t>(sIpcRequests.size());
+   stats.pendingResponses = 0;
+
+   for (auto &responses : sIpcResponses) {
+      stats.pendingResponses += static_cast<uint32_t>(responses.size());
+   }
+
+   stats.dispatchedRequests = sIpcDispatchedRequests;
+   return stats;
+}
+
+
+/**
+ * Check whether every submitted request has been handled by IOS and had its
+ * response interrupt raised.
+ */
+bool
+ipcIsIdle()
+{
+   std::unique_lock<std::mutex> lock { sIpcMutex };
+   return sIpcRequests.empty() && sIpcCompletedRequests == sIpcDispatchedRequests;
+}
+
+
 /**
  * Main thread entry point for the IPC thread.
  *
@@ -130,6 +170,7 @@ ipcThreadEntry()
       if (!sIpcRequests.empty()) {
          auto request = sIpcRequests.front();
          sIpcRequests.pop();
+         sIpcDispatchedRequests++;
          lock.unlock();
          ios::iosDispatchIpcRequest(request);
          lock.lock();
@@ -150,6 +191,8 @@ ipcThreadEntry()
          default:
             decaf_abort("Unexpected cpu id");
          }
+
+         sIpcCompletedRequests++;
       }
 
       if (!sIpcThreadRunning.load()) {
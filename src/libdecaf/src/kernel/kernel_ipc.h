@@ -18,6 +18,18 @@ namespace kernel
 
 using IPCBuffer = ios::IPCBuffer;
 
+struct IpcQueueStats
+{
+   //! Requests waiting to be dispatched to IOS
+   uint32_t pendingRequests;
+
+   //! Replies waiting to be delivered back to each core
+   uint32_t pendingResponses;
+
+   //! Requests dispatched to IOS since startup
+   uint64_t dispatchedRequests;
+};
+
 void
 ipcStart();
 
@@ -30,6 +42,12 @@ ipcDriverKernelSubmitRequest(IPCBuffer *buffer);
 void
 ipcDriverKernelHandleInterrupt();
 
+IpcQueueStats
+ipcGetQueueStats();
+
+bool
+ipcIsIdle();
+
 /** @} */
 
 } // namespace kernel
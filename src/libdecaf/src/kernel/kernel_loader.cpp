@@ -13,18 +13,25 @@
 #include "modules/coreinit/coreinit_dynload.h"
 #include "modules/coreinit/coreinit_scheduler.h"
 
+#include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <common/align.h>
 #include <common/decaf_assert.h>
 #include <common/frameallocator.h>
 #include <common/teenyheap.h>
 #include <common/strutils.h>
+#include <deque>
 #include <fmt/format.h>
+#include <future>
 #include <gsl.h>
+#include <iterator>
 #include <libcpu/cpu.h>
 #include <libcpu/cpu_config.h>
 #include <libcpu/mem.h>
 #include <map>
+#include <memory>
+#include <thread>
 #include <unordered_map>
 #include <zlib.h>
 
@@ -40,15 +47,101 @@ using TrampolineMap = std::map<ppcaddr_t, ppcaddr_t>;
 using SectionList = std::vector<elf::Section>;
 using AddressRange = std::pair<ppcaddr_t, ppcaddr_t>;
 
+//! Deflated sections at least this large are inflated on a worker thread.
+static constexpr uint32_t ParallelInflateThreshold = 64 * 1024;
+
+//! Most worker threads used to inflate the sections of one module.
+static constexpr unsigned MaxInflateWorkers = 4;
+
+//! Measures the time spent in each stage of loading a module.
+class LoaderTimer
+{
+   using clock = std::chrono::high_resolution_clock;
+
+public:
+   using duration = std::chrono::duration<double, std::milli>;
+
+   LoaderTimer() :
+      mStart(clock::now()),
+      mLast(mStart)
+   {
+   }
+
+   //! Returns the time since the last call to lap.
+   duration
+   lap()
+   {
+      auto now = clock::now();
+      auto elapsed = now - mLast;
+      mLast = now;
+      return elapsed;
+   }
+
+   //! Returns the time since the timer was created.
+   duration
+   total() const
+   {
+      return clock::now() - mStart;
+   }
+
+private:
+   clock::time_point mStart;
+   clock::time_point mLast;
+};
+
+struct LoaderTimings
+{
+   LoaderTimer::duration sections;
+   LoaderTimer::duration exports;
+   LoaderTimer::duration imports;
+   LoaderTimer::duration symbols;
+   LoaderTimer::duration relocations;
+   LoaderTimer::duration finalise;
+};
+
 static coreinit::internal::IdLock
 sLoaderLock;
 
 static std::map<std::string, LoadedModule *>
 sLoadedModules;
 
-static std::map<ppcaddr_t, std::string, std::greater<ppcaddr_t>>
+//! A module file which is read in the background before being loaded.
+struct PrefetchJob
+{
+   std::string moduleName;
+   fs::FileHandle fh;
+
+   //! Set by whichever thread reads the file, a prefetch worker or the
+   //!  loader thread if it needs the module before any worker started it.
+   std::atomic<bool> claimed { false };
+
+   std::promise<std::vector<uint8_t>> data;
+   std::future<std::vector<uint8_t>> result;
+};
+
+//! Modules whose file is being read in the background before being loaded.
+static std::map<std::string, std::shared_ptr<PrefetchJob>>
+sPrefetchedModules;
+
+struct GlobalSymbol
+{
+   ppcaddr_t address;
+   const std::string *name;
+};
+
+//! Names of the symbols in sGlobalSymbolLookup, a deque so the pointers
+//!  handed out by the lookup functions stay valid as modules are loaded.
+static std::deque<std::string>
+sGlobalSymbolNames;
+
+//! Function symbols of every loaded RPL, sorted by address.
+static std::vector<GlobalSymbol>
 sGlobalSymbolLookup;
 
+//! Sections of every loaded module, sorted by start address.
+static std::vector<LoadedSection *>
+sGlobalSectionLookup;
+
 static ppcaddr_t
 sSyscallAddress = 0;
 
@@ -73,14 +166,39 @@ codeAlloc(uint32_t size,
 static LoadedModule *
 loadRPLNoLock(const std::string& name);
 
-// Read and decompress section data
+static std::vector<uint8_t>
+readModuleFile(fs::FileHandle fh);
+
+static std::shared_ptr<PrefetchJob>
+prefetchRPL(const std::string &name);
+
+// Get the size of a section's data once it has been decompressed
+static uint32_t
+getSectionDataSize(const gsl::span<uint8_t> &file,
+                   const elf::SectionHeader &header)
+{
+   if (header.size == 0) {
+      return 0;
+   }
+
+   if (header.type != elf::SHT_NOBITS && (header.flags & elf::SHF_DEFLATED)) {
+      auto deflatedHeader = reinterpret_cast<elf::DeflatedHeader *>(file.data() + header.offset);
+      return deflatedHeader->inflatedSize;
+   }
+
+   return header.size;
+}
+
+// Read and decompress section data into dst, which must be at least
+// getSectionDataSize bytes large
 static bool
-readSectionData(const gsl::span<uint8_t> &file,
-                const elf::SectionHeader &header,
-                std::vector<uint8_t> &data)
+readSectionDataInto(const gsl::span<uint8_t> &file,
+                    const elf::SectionHeader &header,
+                    uint8_t *dst,
+                    uint32_t dstSize)
 {
    if (header.type == elf::SHT_NOBITS || header.size == 0) {
-      data.clear();
+      std::memset(dst, 0, dstSize);
       return true;
    }
 
@@ -88,10 +206,8 @@ readSectionData(const gsl::span<uint8_t> &file,
       auto stream = z_stream {};
       auto ret = Z_OK;
 
-      // Read the deflated header
-      auto deflatedHeader = reinterpret_cast<elf::DeflatedHeader *>(file.data() + header.offset);
+      // Skip the deflated header
       auto deflatedData = file.data() + header.offset + sizeof(elf::DeflatedHeader);
-      data.resize(deflatedHeader->inflatedSize);
 
       // Inflate
       memset(&stream, 0, sizeof(stream));
@@ -103,30 +219,159 @@ readSectionData(const gsl::span<uint8_t> &file,
 
       if (ret != Z_OK) {
          gLog->error("Couldn't decompress .rpx section because inflateInit returned {}", ret);
-         data.clear();
-      } else {
-         stream.avail_in = header.size;
-         stream.next_in = const_cast<Bytef *>(deflatedData);
-         stream.avail_out = static_cast<uInt>(data.size());
-         stream.next_out = reinterpret_cast<Bytef *>(data.data());
+         return false;
+      }
 
-         ret = inflate(&stream, Z_FINISH);
+      stream.avail_in = header.size;
+      stream.next_in = const_cast<Bytef *>(deflatedData);
+      stream.avail_out = dstSize;
+      stream.next_out = reinterpret_cast<Bytef *>(dst);
 
-         if (ret != Z_OK && ret != Z_STREAM_END) {
-            gLog->error("Couldn't decompress .rpx section because inflate returned {}", ret);
-            data.clear();
-         }
+      ret = inflate(&stream, Z_FINISH);
+      inflateEnd(&stream);
 
-         inflateEnd(&stream);
+      if (ret != Z_OK && ret != Z_STREAM_END) {
+         gLog->error("Couldn't decompress .rpx section because inflate returned {}", ret);
+         return false;
       }
    } else {
-      data.resize(header.size);
-      std::memcpy(data.data(), file.data() + header.offset, header.size);
+      std::memcpy(dst, file.data() + header.offset, std::min<uint32_t>(header.size, dstSize));
+   }
+
+   return true;
+}
+
+// Read and decompress section data
+static bool
+readSectionData(const gsl::span<uint8_t> &file,
+                const elf::SectionHeader &header,
+                std::vector<uint8_t> &data)
+{
+   if (header.type == elf::SHT_NOBITS || header.size == 0) {
+      data.clear();
+      return true;
+   }
+
+   data.resize(getSectionDataSize(file, header));
+
+   if (!readSectionDataInto(file, header, data.data(), static_cast<uint32_t>(data.size()))) {
+      data.clear();
    }
 
    return data.size() > 0;
 }
 
+// Read and decompress the data of every section we need into its final
+// location, large deflated sections are inflated in parallel.
+static bool
+readSections(const gsl::span<uint8_t> &file,
+             SectionList &sections,
+             FrameAllocator &codeAllocator,
+             FrameAllocator &dataAllocator)
+{
+   struct InflateJob
+   {
+      elf::SectionHeader header;
+      uint8_t *dst;
+      uint32_t size;
+   };
+
+   auto jobs = std::vector<InflateJob> { };
+   auto result = true;
+
+   auto readSection =
+      [&](elf::Section &section, uint8_t *dst, uint32_t size) {
+         if (!size) {
+            return;
+         }
+
+         if (size >= ParallelInflateThreshold && (section.header.flags & elf::SHF_DEFLATED)) {
+            jobs.push_back({ section.header, dst, size });
+         } else {
+            result = readSectionDataInto(file, section.header, dst, size) && result;
+         }
+      };
+
+   for (auto &section : sections) {
+      if (section.header.type == elf::SHT_RELA) {
+         // Relocations targetting these sections are processed manually in
+         // process{Imports,Exports,Symbols} so there is no need to read them
+         auto &targetSec = sections[section.header.info];
+
+         if (targetSec.header.type == elf::SHT_RPL_EXPORTS ||
+             targetSec.header.type == elf::SHT_RPL_IMPORTS ||
+             targetSec.header.type == elf::SHT_SYMTAB) {
+            continue;
+         }
+
+         auto size = getSectionDataSize(file, section.header);
+         section.loaderBuffer.resize(size);
+         readSection(section, section.loaderBuffer.data(), size);
+         continue;
+      }
+
+      if (!(section.header.flags & elf::SHF_ALLOC)) {
+         continue;
+      }
+
+      // Allocate from correct memory segment, the allocations must happen in
+      // section order so that each module always gets the same layout.
+      auto size = getSectionDataSize(file, section.header);
+
+      if (section.header.type == elf::SHT_PROGBITS || section.header.type == elf::SHT_NOBITS) {
+         void *allocData = nullptr;
+
+         if (section.header.flags & elf::SHF_EXECINSTR) {
+            allocData = codeAllocator.allocate(size, section.header.addralign);
+         } else {
+            allocData = dataAllocator.allocate(size, section.header.addralign);
+         }
+
+         section.memory = reinterpret_cast<uint8_t*>(allocData);
+         section.virtAddress = mem::untranslate(allocData);
+         section.virtSize = size;
+      } else {
+         section.loaderBuffer.resize(size);
+         section.memory = section.loaderBuffer.data();
+         section.virtAddress = 0;
+         section.virtSize = size;
+      }
+
+      readSection(section, section.memory, size);
+   }
+
+   // Inflate the large sections on a bounded number of threads, the loader
+   //  thread takes jobs too rather than waiting idle.
+   auto nextJob = std::atomic<size_t> { 0 };
+   auto jobsResult = std::atomic<bool> { true };
+   auto numWorkers = std::min<size_t>(jobs.size(),
+                                      std::min(MaxInflateWorkers, std::max(1u, std::thread::hardware_concurrency())));
+   auto workers = std::vector<std::future<void>> { };
+
+   auto inflateJobs =
+      [&]() {
+         for (auto i = nextJob++; i < jobs.size(); i = nextJob++) {
+            auto &job = jobs[i];
+
+            if (!readSectionDataInto(file, job.header, job.dst, job.size)) {
+               jobsResult = false;
+            }
+         }
+      };
+
+   for (auto i = 1u; i < numWorkers; ++i) {
+      workers.emplace_back(std::async(std::launch::async, inflateJobs));
+   }
+
+   inflateJobs();
+
+   for (auto &worker : workers) {
+      worker.wait();
+   }
+
+   return result && jobsResult;
+}
+
 // Find and read the SHT_RPL_FILEINFO section
 static bool
 readFileInfo(const gsl::span<uint8_t> &file,
@@ -395,6 +640,81 @@ processKernelTraceFilters(const std::string &module,
 }
 
 
+static bool
+compareSectionStart(const LoadedSection *lhs,
+                    const LoadedSection *rhs)
+{
+   return lhs->start < rhs->start;
+}
+
+static LoadedSection *
+findSectionInSortedList(const std::vector<LoadedSection *> &sections,
+                        ppcaddr_t address)
+{
+   // Find the last section which starts at or before address
+   auto itr = std::upper_bound(sections.begin(), sections.end(), address,
+                               [](ppcaddr_t address, const LoadedSection *section) {
+                                  return address < section->start;
+                               });
+
+   if (itr == sections.begin()) {
+      return nullptr;
+   }
+
+   --itr;
+
+   if (address >= (*itr)->end) {
+      return nullptr;
+   }
+
+   return *itr;
+}
+
+// Merge a module's function symbols into sGlobalSymbolLookup
+static void
+addGlobalSymbols(LoadedModule *loadedMod)
+{
+   // TODO: Modify symbol lookup functions to support picking the type of
+   //  symbol you want so that we can have our global symbol lookup table
+   //  include information about which symbol, and relatedly, display data
+   //  symbol names in the debugger.
+   auto symbols = std::vector<GlobalSymbol> { };
+
+   for (auto &entry : loadedMod->symbolsByAddress) {
+      if (entry.symbol->type == SymbolType::Function) {
+         sGlobalSymbolNames.emplace_back(fmt::format("{}:{}", loadedMod->name, *entry.name));
+         symbols.emplace_back(GlobalSymbol { entry.address, &sGlobalSymbolNames.back() });
+      }
+   }
+
+   // Merge keeping the first symbol registered at any address
+   auto merged = std::vector<GlobalSymbol> { };
+   merged.reserve(sGlobalSymbolLookup.size() + symbols.size());
+   std::merge(sGlobalSymbolLookup.begin(), sGlobalSymbolLookup.end(),
+              symbols.begin(), symbols.end(),
+              std::back_inserter(merged),
+              [](const GlobalSymbol &lhs, const GlobalSymbol &rhs) {
+                 return lhs.address < rhs.address;
+              });
+
+   merged.erase(std::unique(merged.begin(), merged.end(),
+                            [](const GlobalSymbol &lhs, const GlobalSymbol &rhs) {
+                               return lhs.address == rhs.address;
+                            }),
+                merged.end());
+   sGlobalSymbolLookup = std::move(merged);
+}
+
+// Add a module's sections to sGlobalSectionLookup
+static void
+addGlobalSections(LoadedModule *loadedMod)
+{
+   sGlobalSectionLookup.insert(sGlobalSectionLookup.end(),
+                               loadedMod->sectionsByAddress.begin(),
+                               loadedMod->sectionsByAddress.end());
+   std::stable_sort(sGlobalSectionLookup.begin(), sGlobalSectionLookup.end(), compareSectionStart);
+}
+
 /**
  * Load a kernel module into virtual memory space by creating thunks
  */
@@ -509,6 +829,9 @@ loadHleModule(const std::string &moduleName,
       }
    }
 
+   loadedMod->buildLookupTables();
+   addGlobalSections(loadedMod);
+
    module->initialise();
    return loadedMod;
 }
@@ -522,7 +845,6 @@ processRelocations(LoadedModule *loadedMod,
                    AddressRange &trampSeg)
 {
    auto trampolines = TrampolineMap{};
-   auto buffer = std::vector<uint8_t> {};
    trampSeg.first = mem::untranslate(codeSeg.top());
 
    for (auto &section : sections) {
@@ -530,8 +852,6 @@ processRelocations(LoadedModule *loadedMod,
          continue;
       }
 
-      readSectionData(file, section.header, buffer);
-
       auto &symSec = sections[section.header.link];
       auto &targetSec = sections[section.header.info];
       auto &symStrTab = sections[symSec.header.link];
@@ -547,7 +867,8 @@ processRelocations(LoadedModule *loadedMod,
       auto targetVirtAddr = targetSec.virtAddress;
 
       auto symbols = gsl::make_span(reinterpret_cast<elf::Symbol *>(symSec.memory), symSec.virtSize / sizeof(elf::Symbol));
-      auto relocations = gsl::make_span(reinterpret_cast<elf::Rela *>(buffer.data()), buffer.size() / sizeof(elf::Rela));
+      auto &buffer = section.loaderBuffer;
+      auto relocations = gsl::make_span(reinterpret_cast<const elf::Rela *>(buffer.data()), buffer.size() / sizeof(elf::Rela));
 
       for (auto &rela : relocations) {
          auto index = rela.info >> 8;
@@ -690,6 +1011,39 @@ processImports(LoadedModule *loadedMod,
                SectionList &sections)
 {
    std::map<std::string, ppcaddr_t> symbolTable;
+   auto prefetchJobs = std::vector<std::shared_ptr<PrefetchJob>> { };
+
+   // Start reading every imported module so the files are ready by the time
+   // we have finished loading the ones before them
+   for (auto &section : sections) {
+      if (section.header.type == elf::SHT_RPL_IMPORTS) {
+         if (auto job = prefetchRPL(reinterpret_cast<const char *>(section.memory + 8))) {
+            prefetchJobs.emplace_back(std::move(job));
+         }
+      }
+   }
+
+   // Read the files on a bounded number of threads, like section inflating,
+   //  the loader thread reads any file which it needs before a worker does.
+   auto nextJob = std::atomic<size_t> { 0 };
+   auto numWorkers = std::min<size_t>(prefetchJobs.size(),
+                                      std::min(MaxInflateWorkers, std::max(1u, std::thread::hardware_concurrency())));
+   auto workers = std::vector<std::future<void>> { };
+
+   auto prefetchFiles =
+      [&]() {
+         for (auto i = nextJob++; i < prefetchJobs.size(); i = nextJob++) {
+            auto &job = *prefetchJobs[i];
+
+            if (!job.claimed.exchange(true)) {
+               job.data.set_value(readModuleFile(job.fh));
+            }
+         }
+      };
+
+   for (auto i = 0u; i < numWorkers; ++i) {
+      workers.emplace_back(std::async(std::launch::async, prefetchFiles));
+   }
 
    // Process import sections
    for (auto &section : sections) {
@@ -717,6 +1071,16 @@ processImports(LoadedModule *loadedMod,
       }
    }
 
+   for (auto &worker : workers) {
+      worker.wait();
+   }
+
+   // Do not keep the data of any module we prefetched but did not load, for
+   //  example because loading an earlier import failed
+   for (auto &job : prefetchJobs) {
+      sPrefetchedModules.erase(job->moduleName);
+   }
+
    // Process import symbols
    for (auto &section : sections) {
       if (section.header.type != elf::SHT_SYMTAB) {
@@ -1013,7 +1377,8 @@ loadRPL(const std::string &moduleName,
         const std::string &name,
         const gsl::span<uint8_t> &data)
 {
-   std::vector<uint8_t> buffer;
+   auto timer = LoaderTimer { };
+   auto timings = LoaderTimings { };
    auto loadedMod = new LoadedModule();
    loadedMod->name = name;
    sLoadedModules.emplace(moduleName, loadedMod);
@@ -1089,42 +1454,10 @@ loadRPL(const std::string &moduleName,
    auto codeAllocator = FrameAllocator { codeSegment, info.textSize };
    auto dataAllocator = FrameAllocator { dataSegment, info.dataSize };
 
-   // Allocate sections from our memory segments
-   for (auto &section : sections) {
-      if (section.header.flags & elf::SHF_ALLOC) {
-         void *allocData = nullptr;
-
-         // Read the section data
-         if (section.header.type == elf::SHT_NOBITS) {
-            buffer.clear();
-            buffer.resize(section.header.size, 0);
-         } else {
-            if (!readSectionData(data, section.header, buffer)) {
-               gLog->error("Failed to read section data");
-               return nullptr;
-            }
-         }
-
-         // Allocate from correct memory segment
-         if (section.header.type == elf::SHT_PROGBITS || section.header.type == elf::SHT_NOBITS) {
-            if (section.header.flags & elf::SHF_EXECINSTR) {
-               allocData = codeAllocator.allocate(buffer.size(), section.header.addralign);
-            } else {
-               allocData = dataAllocator.allocate(buffer.size(), section.header.addralign);
-            }
-
-            memcpy(allocData, buffer.data(), buffer.size());
-            section.memory = reinterpret_cast<uint8_t*>(allocData);
-            section.virtAddress = mem::untranslate(allocData);
-            section.virtSize = static_cast<uint32_t>(buffer.size());
-         } else {
-            section.loaderBuffer = buffer;
-            section.memory = section.loaderBuffer.data();
-            section.virtAddress = 0;
-            section.virtSize = static_cast<uint32_t>(buffer.size());
-         }
-
-      }
+   // Allocate sections from our memory segments and read their data
+   if (!readSections(data, sections, codeAllocator, dataAllocator)) {
+      gLog->error("Failed to read section data");
+      return nullptr;
    }
 
    // Read strtab
@@ -1191,24 +1524,32 @@ loadRPL(const std::string &moduleName,
    loadedMod->tlsModuleIndex = sModuleIndex++;
    loadedMod->tlsAlignShift = info.tlsAlignShift;
 
+   timings.sections = timer.lap();
+
    // Process exports
    if (!processExports(loadedMod, sections)) {
       gLog->error("Error loading exports");
       return nullptr;
    }
 
-   // Process imports
+   timings.exports = timer.lap();
+
+   // Process imports, this includes the time to load any imported modules
    if (!processImports(loadedMod, sections)) {
       gLog->error("Error loading imports");
       return nullptr;
    }
 
+   timings.imports = timer.lap();
+
    // Process symbols
    if (!processSymbols(loadedMod, sections)) {
       gLog->error("Error loading symbols");
       return nullptr;
    }
 
+   timings.symbols = timer.lap();
+
    // Process relocations
    auto trampSeg = AddressRange { };
 
@@ -1217,6 +1558,8 @@ loadRPL(const std::string &moduleName,
       return nullptr;
    }
 
+   timings.relocations = timer.lap();
+
    // Process dot syscall
    for (auto &section : sections) {
       auto sectionName = shStrTab + section.header.name;
@@ -1277,22 +1620,27 @@ loadRPL(const std::string &moduleName,
    // Add the modules entry point as an symbol called 'start'
    loadedMod->symbols.emplace("__start", Symbol { entryPoint, SymbolType::Function });
 
-   // Add all the modules symbols to the Global Symbol Map
-   for (auto &i : loadedMod->symbols) {
-      // TODO: Modify symbol lookup functions to support picking the type of
-      //  symbol you want so that we can have our global symbol lookup table
-      //  include information about which symbol, and relatedly, display data
-      //  symbol names in the debugger.
-      if (i.second.type == SymbolType::Function) {
-         sGlobalSymbolLookup.emplace(i.second.address, fmt::format("{}:{}", loadedMod->name, i.first));
-      }
-   }
+   // Build the modules lookup tables and add them to the global ones
+   loadedMod->buildLookupTables();
+   addGlobalSymbols(loadedMod);
+   addGlobalSections(loadedMod);
 
    loadedMod->defaultStackSize = info.stackSize;
    loadedMod->entryPoint = entryPoint;
    loadedMod->handle = coreinit::internal::sysAlloc<LoadedModuleHandleData>();
    loadedMod->handle->ptr = loadedMod;
 
+   timings.finalise = timer.lap();
+   gLog->debug("Loader timings for {}: sections {:.2f}ms, exports {:.2f}ms, imports {:.2f}ms, "
+               "symbols {:.2f}ms, relocations {:.2f}ms, finalise {:.2f}ms, total {:.2f}ms",
+               moduleName,
+               timings.sections.count(),
+               timings.exports.count(),
+               timings.imports.count(),
+               timings.symbols.count(),
+               timings.relocations.count(),
+               timings.finalise.count(),
+               timer.total().count());
    return loadedMod;
 }
 
@@ -1310,13 +1658,81 @@ normalizeModuleName(const std::string &name,
    }
 }
 
+// Find the file for a module in the game or system code directories
+static fs::FileHandle
+openModuleFile(const std::string &fileName)
+{
+   auto fs = kernel::getFileSystem();
+
+   // Try to find module in the game code directory.
+   auto result = fs->openFile("/vol/code/" + fileName, fs::File::Read);
+
+   if (result) {
+      return result.value();
+   }
+
+   // Try to find module in the system library directory.
+   // Only if it is on the allowed lle_modules list.
+   if (std::find(decaf::config::system::lle_modules.begin(),
+                 decaf::config::system::lle_modules.end(),
+                 fileName) != decaf::config::system::lle_modules.end()) {
+      result = fs->openFile("/vol/storage_mlc01/sys/title/00050010/1000400A/code/" + fileName, fs::File::Read);
+
+      if (result) {
+         return result.value();
+      }
+   }
+
+   return nullptr;
+}
+
+static std::vector<uint8_t>
+readModuleFile(fs::FileHandle fh)
+{
+   auto buffer = std::vector<uint8_t>(fh->size());
+   fh->read(buffer.data(), buffer.size(), 1);
+   fh->close();
+   return buffer;
+}
+
+static std::shared_ptr<PrefetchJob>
+prefetchRPL(const std::string &name)
+{
+   std::string moduleName;
+   std::string fileName;
+   normalizeModuleName(name, moduleName, fileName);
+
+   if (sLoadedModules.find(moduleName) != sLoadedModules.end() ||
+       sPrefetchedModules.find(moduleName) != sPrefetchedModules.end()) {
+      return nullptr;
+   }
+
+   if (kernel::findHleModule(fileName)) {
+      return nullptr;
+   }
+
+   // The file is opened here as the filesystem is not thread safe, only
+   // reading its contents happens on a worker thread.
+   auto fh = openModuleFile(fileName);
+
+   if (!fh) {
+      return nullptr;
+   }
+
+   auto job = std::make_shared<PrefetchJob>();
+   job->moduleName = moduleName;
+   job->fh = fh;
+   job->result = job->data.get_future();
+   sPrefetchedModules.emplace(moduleName, job);
+   return job;
+}
+
 LoadedModule *
 loadRPLNoLock(const std::string &name)
 {
    LoadedModule *module = nullptr;
    std::string moduleName;
    std::string fileName;
-   fs::FileHandle fh;
 
    normalizeModuleName(name, moduleName, fileName);
 
@@ -1336,38 +1752,29 @@ loadRPLNoLock(const std::string &name)
       }
    }
 
-   // Try to find module in the game code directory.
+   // Load from file, using the prefetched data if it is available
    if (!module) {
-      auto fs = kernel::getFileSystem();
-      auto result = fs->openFile("/vol/code/" + fileName, fs::File::Read);
-
-      if (result) {
-         fh = result.value();
-      }
-   }
-
-   // Try to find module in the system library directory.
-   // Only if it is on the allowed lle_modules list.
-   if (!module && !fh &&
-       std::find(decaf::config::system::lle_modules.begin(),
-                 decaf::config::system::lle_modules.end(),
-                 fileName) != decaf::config::system::lle_modules.end()) {
+      auto timer = LoaderTimer { };
+      auto buffer = std::vector<uint8_t> { };
+      auto prefetched = sPrefetchedModules.find(moduleName);
 
-      auto fs = kernel::getFileSystem();
-      auto result = fs->openFile("/vol/storage_mlc01/sys/title/00050010/1000400A/code/" + fileName, fs::File::Read);
+      if (prefetched != sPrefetchedModules.end()) {
+         auto job = prefetched->second;
+         sPrefetchedModules.erase(prefetched);
 
-      if (result) {
-         fh = result.value();
+         if (!job->claimed.exchange(true)) {
+            buffer = readModuleFile(job->fh);
+         } else {
+            buffer = job->result.get();
+         }
+      } else if (auto fh = openModuleFile(fileName)) {
+         buffer = readModuleFile(fh);
       }
-   }
-
-   // Load from file
-   if (fh) {
-      auto buffer = std::vector<uint8_t>(fh->size());
-      fh->read(buffer.data(), buffer.size(), 1);
-      fh->close();
 
-      module = loadRPL(moduleName, fileName, buffer);
+      if (!buffer.empty()) {
+         gLog->debug("Read module {} in {:.2f}ms", fileName, timer.lap().count());
+         module = loadRPL(moduleName, fileName, buffer);
+      }
    }
 
    if (!module) {
@@ -1402,6 +1809,98 @@ unlockLoader()
    coreinit::internal::releaseIdLock(sLoaderLock, cpu::this_core::id());
 }
 
+Symbol *
+LoadedModule::findSymbol(ppcaddr_t address)
+{
+   if (symbolsByAddress.empty()) {
+      for (auto &sym : symbols) {
+         if (sym.second.address == address) {
+            return &sym.second;
+         }
+      }
+
+      return nullptr;
+   }
+
+   auto itr = std::lower_bound(symbolsByAddress.begin(), symbolsByAddress.end(), address,
+                               [](const SymbolAddressEntry &entry, ppcaddr_t address) {
+                                  return entry.address < address;
+                               });
+
+   if (itr == symbolsByAddress.end() || itr->address != address) {
+      return nullptr;
+   }
+
+   return itr->symbol;
+}
+
+const SymbolAddressEntry *
+LoadedModule::findNearestSymbol(ppcaddr_t address) const
+{
+   auto itr = std::upper_bound(symbolsByAddress.begin(), symbolsByAddress.end(), address,
+                               [](ppcaddr_t address, const SymbolAddressEntry &entry) {
+                                  return address < entry.address;
+                               });
+
+   if (itr == symbolsByAddress.begin()) {
+      return nullptr;
+   }
+
+   return &*(itr - 1);
+}
+
+LoadedSection *
+LoadedModule::findAddressSection(ppcaddr_t address)
+{
+   if (sectionsByAddress.empty()) {
+      for (auto &sec : sections) {
+         if (address >= sec.start && address < sec.end) {
+            return &sec;
+         }
+      }
+
+      return nullptr;
+   }
+
+   return findSectionInSortedList(sectionsByAddress, address);
+}
+
+void
+LoadedModule::buildLookupTables()
+{
+   exportLookup.clear();
+   exportLookup.reserve(exports.size());
+
+   for (auto &exp : exports) {
+      exportLookup.emplace(exp.first, exp.second);
+   }
+
+   // Symbols are stable sorted from name order so that for symbols which
+   // share an address we keep the same order as a search of symbols would.
+   symbolsByAddress.clear();
+   symbolsByAddress.reserve(symbols.size());
+
+   for (auto &sym : symbols) {
+      symbolsByAddress.emplace_back(SymbolAddressEntry { sym.second.address, &sym.first, &sym.second });
+   }
+
+   std::stable_sort(symbolsByAddress.begin(), symbolsByAddress.end(),
+                    [](const SymbolAddressEntry &lhs, const SymbolAddressEntry &rhs) {
+                       return lhs.address < rhs.address;
+                    });
+
+   // Empty sections can never contain an address so leave them out
+   sectionsByAddress.clear();
+
+   for (auto &sec : sections) {
+      if (sec.end > sec.start) {
+         sectionsByAddress.push_back(&sec);
+      }
+   }
+
+   std::stable_sort(sectionsByAddress.begin(), sectionsByAddress.end(), compareSectionStart);
+}
+
 LoadedModule *
 findModule(const std::string& name)
 {
@@ -1422,44 +1921,116 @@ findModule(const std::string& name)
 LoadedSection *
 findSectionForAddress(ppcaddr_t address)
 {
-   for (auto &mod : sLoadedModules) {
-      for (auto &sec : mod.second->sections) {
-         if (address >= sec.start && address < sec.end) {
-            return &sec;
-         }
-      }
-   }
-   return nullptr;
+   return findSectionInSortedList(sGlobalSectionLookup, address);
 }
 
-std::string *
+const std::string *
 findSymbolNameForAddress(ppcaddr_t address)
 {
-   auto symIter = sGlobalSymbolLookup.find(address);
+   auto symIter = std::lower_bound(sGlobalSymbolLookup.begin(), sGlobalSymbolLookup.end(), address,
+                                   [](const GlobalSymbol &symbol, ppcaddr_t address) {
+                                      return symbol.address < address;
+                                   });
 
-   if (symIter == sGlobalSymbolLookup.end()) {
+   if (symIter == sGlobalSymbolLookup.end() || symIter->address != address) {
       return nullptr;
    }
 
-   return &symIter->second;
+   return symIter->name;
+}
+
+static std::string
+formatNearestSymbolName(std::vector<GlobalSymbol>::const_iterator symIter,
+                        ppcaddr_t address)
+{
+   auto delta = address - symIter->address;
+
+   if (delta == 0) {
+      return *symIter->name;
+   } else {
+      return fmt::format("{} + 0x{:x}", *symIter->name, delta);
+   }
 }
 
 std::string
 findNearestSymbolNameForAddress(ppcaddr_t address)
 {
-   auto symIter = sGlobalSymbolLookup.lower_bound(address);
+   // Find the last symbol at or before address
+   auto symIter = std::upper_bound(sGlobalSymbolLookup.cbegin(), sGlobalSymbolLookup.cend(), address,
+                                   [](ppcaddr_t address, const GlobalSymbol &symbol) {
+                                      return address < symbol.address;
+                                   });
 
-   if (symIter == sGlobalSymbolLookup.end()) {
+   if (symIter == sGlobalSymbolLookup.cbegin()) {
       return "?";
    }
 
-   auto delta = address - symIter->first;
+   return formatNearestSymbolName(symIter - 1, address);
+}
+
+// For each address returns the first symbol after it, the addresses are
+// sorted so each search only has to look past the previous result.
+static std::vector<std::vector<GlobalSymbol>::const_iterator>
+findSymbolsAfterAddresses(const std::vector<ppcaddr_t> &addresses)
+{
+   auto result = std::vector<std::vector<GlobalSymbol>::const_iterator>(addresses.size());
+   auto order = std::vector<size_t>(addresses.size());
 
-   if (delta == 0) {
-      return symIter->second;
-   } else {
-      return fmt::format("{} + 0x{:x}", symIter->second, delta);
+   for (auto i = 0u; i < order.size(); ++i) {
+      order[i] = i;
    }
+
+   std::sort(order.begin(), order.end(),
+             [&](size_t lhs, size_t rhs) {
+                return addresses[lhs] < addresses[rhs];
+             });
+
+   auto symIter = sGlobalSymbolLookup.cbegin();
+
+   for (auto index : order) {
+      symIter = std::upper_bound(symIter, sGlobalSymbolLookup.cend(), addresses[index],
+                                 [](ppcaddr_t address, const GlobalSymbol &symbol) {
+                                    return address < symbol.address;
+                                 });
+      result[index] = symIter;
+   }
+
+   return result;
+}
+
+std::vector<const std::string *>
+findSymbolNamesForAddresses(const std::vector<ppcaddr_t> &addresses)
+{
+   auto symbols = findSymbolsAfterAddresses(addresses);
+   auto names = std::vector<const std::string *>(addresses.size(), nullptr);
+
+   for (auto i = 0u; i < symbols.size(); ++i) {
+      if (symbols[i] != sGlobalSymbolLookup.cbegin() && (symbols[i] - 1)->address == addresses[i]) {
+         names[i] = (symbols[i] - 1)->name;
+      }
+   }
+
+   return names;
+}
+
+std::vector<std::string>
+findNearestSymbolNamesForAddresses(const std::vector<ppcaddr_t> &addresses,
+                                   bool includeOffset)
+{
+   auto symbols = findSymbolsAfterAddresses(addresses);
+   auto names = std::vector<std::string>(addresses.size());
+
+   for (auto i = 0u; i < symbols.size(); ++i) {
+      if (symbols[i] == sGlobalSymbolLookup.cbegin()) {
+         names[i] = "?";
+      } else if (!includeOffset) {
+         names[i] = *(symbols[i] - 1)->name;
+      } else {
+         names[i] = formatNearestSymbolName(symbols[i] - 1, addresses[i]);
+      }
+   }
+
+   return names;
 }
 
 const std::map<std::string, LoadedModule *> &
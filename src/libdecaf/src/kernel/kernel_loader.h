@@ -6,6 +6,8 @@
 #include <limits>
 #include <vector>
 #include <map>
+#include <string>
+#include <unordered_map>
 
 namespace kernel
 {
@@ -62,14 +64,26 @@ struct Symbol
    SymbolType type;
 };
 
+struct SymbolAddressEntry
+{
+   ppcaddr_t address;
+   const std::string *name;
+   Symbol *symbol;
+};
+
 struct LoadedModule
 {
    ppcaddr_t
    findExport(const std::string& symName) const
    {
-      auto itr = exports.find(symName);
+      if (exportLookup.empty()) {
+         auto itr = exports.find(symName);
+         return itr == exports.end() ? 0u : itr->second;
+      }
+
+      auto itr = exportLookup.find(symName);
 
-      if (itr == exports.end()) {
+      if (itr == exportLookup.end()) {
          return 0u;
       }
 
@@ -77,16 +91,10 @@ struct LoadedModule
    }
 
    Symbol *
-   findSymbol(ppcaddr_t address)
-   {
-      for (auto &sym : symbols) {
-         if (sym.second.address == address) {
-            return &sym.second;
-         }
-      }
+   findSymbol(ppcaddr_t address);
 
-      return nullptr;
-   }
+   const SymbolAddressEntry *
+   findNearestSymbol(ppcaddr_t address) const;
 
    template<typename ReturnType, typename... Args>
    wfunc_ptr<ReturnType, Args...>
@@ -103,16 +111,10 @@ struct LoadedModule
    }
 
    LoadedSection *
-   findAddressSection(ppcaddr_t address)
-   {
-      for (auto &sec : sections) {
-         if (address >= sec.start && address < sec.end) {
-            return &sec;
-         }
-      }
+   findAddressSection(ppcaddr_t address);
 
-      return nullptr;
-   }
+   void
+   buildLookupTables();
 
    std::string name;
    LoadedModuleHandleData *handle = nullptr;
@@ -128,6 +130,11 @@ struct LoadedModule
    std::vector<LoadedSection> sections;
    std::map<std::string, ppcaddr_t> exports;
    std::map<std::string, Symbol> symbols;
+
+   //! Lookup tables built by buildLookupTables once the module is loaded.
+   std::unordered_map<std::string, ppcaddr_t> exportLookup;
+   std::vector<SymbolAddressEntry> symbolsByAddress;
+   std::vector<LoadedSection *> sectionsByAddress;
 };
 
 void
@@ -148,12 +155,20 @@ findModule(const std::string& name);
 LoadedSection *
 findSectionForAddress(ppcaddr_t address);
 
-std::string *
+//! The returned name stays valid for the rest of the run
+const std::string *
 findSymbolNameForAddress(ppcaddr_t address);
 
 std::string
 findNearestSymbolNameForAddress(ppcaddr_t address);
 
+std::vector<const std::string *>
+findSymbolNamesForAddresses(const std::vector<ppcaddr_t> &addresses);
+
+std::vector<std::string>
+findNearestSymbolNamesForAddresses(const std::vector<ppcaddr_t> &addresses,
+                                   bool includeOffset = true);
+
 const std::map<std::string, LoadedModule*> &
 getLoadedModules();
 
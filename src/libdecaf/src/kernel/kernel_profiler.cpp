@@ -0,0 +1,194 @@
+#include "kernel_loader.h"
+#include "kernel_profiler.h"
+#include "modules/coreinit/coreinit_scheduler.h"
+#include "modules/coreinit/coreinit_thread.h"
+
+#include <algorithm>
+#include <chrono>
+#include <common/log.h>
+#include <fmt/format.h>
+#include <fstream>
+#include <libcpu/cpu.h>
+#include <libcpu/cpu_config.h>
+#include <libcpu/mem.h>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace kernel
+{
+
+//! Number of return addresses to read from the stack of each sample
+static constexpr size_t MaxStackDepth = 16;
+
+//! A sampled stack is the thread name followed by nia, lr and the return
+//!  addresses found by walking the back chain.
+using SampleKey = std::pair<std::string, std::vector<ppcaddr_t>>;
+
+static std::mutex
+sSamplesMutex;
+
+static std::map<SampleKey, uint64_t>
+sSamples;
+
+static uint64_t
+sNumSamples = 0;
+
+void
+profilerStart(unsigned rate)
+{
+   if (!rate) {
+      return;
+   }
+
+   if (cpu::config::timing::deterministic) {
+      gLog->warn("Guest profiler is not available in deterministic mode");
+      return;
+   }
+
+   gLog->info("Sampling guest stacks {} times per second", rate);
+   cpu::setProfilerInterval(std::chrono::nanoseconds { 1000000000ull / rate });
+}
+
+void
+profilerStop()
+{
+   cpu::setProfilerInterval(std::chrono::nanoseconds { 0 });
+}
+
+/**
+ * Called from the interrupt handler when PROFILER_INTERRUPT is raised.
+ *
+ * This may run while the guest has interrupts disabled or holds the scheduler
+ * lock, so it only reads guest state.
+ */
+void
+profilerSample()
+{
+   auto core = cpu::this_core::state();
+   auto thread = coreinit::internal::getCurrentThread();
+   auto key = SampleKey { };
+   key.second.reserve(MaxStackDepth + 2);
+   key.second.push_back(core->nia);
+   key.second.push_back(core->lr);
+
+   if (thread) {
+      key.first = thread->name
+         ? std::string { thread->name.get() }
+         : fmt::format("Thread {}", thread->id);
+
+      // Every frame stores the caller's stack pointer at 0 and the caller
+      //  saves its return address at 4 of that, stop as soon as the chain
+      //  leaves the thread's stack.
+      auto stackStart = thread->stackStart.getAddress();
+      auto stackEnd = thread->stackEnd.getAddress();
+      auto sp = core->gpr[1];
+
+      while (key.second.size() < MaxStackDepth + 2) {
+         if (sp < stackEnd || sp + 8 > stackStart) {
+            break;
+         }
+
+         auto backChain = mem::read<uint32_t>(sp);
+
+         if (backChain <= sp || backChain + 8 > stackStart) {
+            break;
+         }
+
+         auto returnAddress = mem::read<uint32_t>(backChain + 4);
+
+         if (!returnAddress) {
+            break;
+         }
+
+         key.second.push_back(returnAddress);
+         sp = backChain;
+      }
+   } else {
+      key.first = "?";
+   }
+
+   std::unique_lock<std::mutex> lock { sSamplesMutex };
+   sSamples[std::move(key)]++;
+   sNumSamples++;
+}
+
+/**
+ * Writes the samples in the folded stack format used by flamegraph.pl and
+ * speedscope, one line per unique stack from the thread down to the leaf.
+ */
+bool
+profilerWriteFolded(const std::string &path)
+{
+   std::unique_lock<std::mutex> lock { sSamplesMutex };
+   auto addresses = std::vector<ppcaddr_t> { };
+
+   for (auto &sample : sSamples) {
+      addresses.insert(addresses.end(), sample.first.second.begin(), sample.first.second.end());
+   }
+
+   std::sort(addresses.begin(), addresses.end());
+   addresses.erase(std::unique(addresses.begin(), addresses.end()), addresses.end());
+
+   loader::lockLoader();
+   auto names = loader::findNearestSymbolNamesForAddresses(addresses, false);
+   loader::unlockLoader();
+
+   auto symbols = std::unordered_map<ppcaddr_t, const std::string *> { };
+
+   for (auto i = 0u; i < addresses.size(); ++i) {
+      symbols[addresses[i]] = &names[i];
+   }
+
+   // Several samples can fold into the same line once addresses are symbols
+   auto folded = std::map<std::string, uint64_t> { };
+
+   for (auto &sample : sSamples) {
+      auto &frames = sample.first.second;
+      auto &leaf = *symbols[frames[0]];
+      auto stack = std::vector<const std::string *> { };
+
+      for (auto i = frames.size() - 1; i >= 2; --i) {
+         stack.push_back(symbols[frames[i]]);
+      }
+
+      // lr only tells us the caller when the leaf has not saved it yet, in
+      //  which case it is not on the stack and points outside the leaf.
+      auto &caller = *symbols[frames[1]];
+      auto lrSaved = frames.size() > 2 && frames[2] == frames[1];
+
+      if (!lrSaved && caller != leaf) {
+         stack.push_back(&caller);
+      }
+
+      auto line = sample.first.first;
+
+      for (auto name : stack) {
+         line += ';';
+         line += *name;
+      }
+
+      line += ';';
+      line += leaf;
+      folded[line] += sample.second;
+   }
+
+   std::ofstream out { path, std::ofstream::out | std::ofstream::trunc };
+
+   if (!out.is_open()) {
+      gLog->error("Could not open {} to write profile", path);
+      return false;
+   }
+
+   for (auto &line : folded) {
+      out << line.first << ' ' << line.second << '\n';
+   }
+
+   gLog->info("Wrote {} guest stack samples in {} unique stacks to {}",
+              sNumSamples, folded.size(), path);
+   return true;
+}
+
+} // namespace kernel
@@ -0,0 +1,30 @@
+#pragma once
+#include <string>
+
+namespace kernel
+{
+
+/**
+ * \defgroup kernel_profiler Profiler
+ * \ingroup kernel
+ *
+ * Statistical profiler which periodically samples the guest call stack of
+ * every running core.
+ * @{
+ */
+
+void
+profilerStart(unsigned rate);
+
+void
+profilerStop();
+
+void
+profilerSample();
+
+bool
+profilerWriteFolded(const std::string &path);
+
+/** @} */
+
+} // namespace kernel
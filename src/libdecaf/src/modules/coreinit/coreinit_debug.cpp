@@ -168,18 +168,12 @@ OSGetSymbolName(uint32_t address,
       auto sec = mod->findAddressSection(address);
 
       if (sec) {
-         const char *closestSym = nullptr;
-         auto closestAddr = sec->start;
-         for (auto &sym : mod->symbols) {
-            if (sym.second.address >= closestAddr && sym.second.address <= address) {
-               closestSym = sym.first.c_str();
-               closestAddr = sym.second.address;
-            }
-         }
-         if (closestSym) {
+         auto closest = mod->findNearestSymbol(address);
+
+         if (closest && closest->address >= sec->start) {
             foundModule = mod->name.c_str();
-            foundSymbol = closestSym;
-            foundAddress = closestAddr;
+            foundSymbol = closest->name->c_str();
+            foundAddress = closest->address;
          }
          break;
       }
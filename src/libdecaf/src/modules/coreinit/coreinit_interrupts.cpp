@@ -28,8 +28,11 @@ OSDisableInterrupts()
 {
    // We allow DBGBREAK_INTERRUPT here so that the debugger can still trace through
    // OSDisableInterrupts calls.  This is not an issue only because internally we
-   // only care about the scheduler lock which is only used internally.
-   return cpu::this_core::setInterruptMask(cpu::DBGBREAK_INTERRUPT) == cpu::INTERRUPT_MASK;
+   // only care about the scheduler lock which is only used internally.  The same
+   // goes for PROFILER_INTERRUPT, so samples are not skewed to where interrupts
+   // are re-enabled.
+   auto mask = cpu::DBGBREAK_INTERRUPT | cpu::PROFILER_INTERRUPT;
+   return cpu::this_core::setInterruptMask(mask) == cpu::INTERRUPT_MASK;
 }
 
 
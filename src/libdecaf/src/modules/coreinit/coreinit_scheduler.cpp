@@ -36,6 +36,17 @@ sSchedulerEnabled[3];
 static std::atomic<uint32_t>
 sSchedulerLock { 0 };
 
+//! Lock statistics, only written while holding sSchedulerLock so they do not
+//!  need an atomic read-modify-write
+static std::atomic<uint64_t>
+sSchedulerLockAcquires { 0 };
+
+static std::atomic<uint64_t>
+sSchedulerLockContended { 0 };
+
+static std::atomic<uint64_t>
+sSchedulerLockSpins { 0 };
+
 static OSThreadQueue *
 sActiveThreads;
 
@@ -115,11 +126,34 @@ lockScheduler()
       core = SchedulerLockNonCpuCoreId;
    }
 
+   auto spins = uint64_t { 0 };
+
    while (!sSchedulerLock.compare_exchange_weak(expected, core, std::memory_order_acquire)) {
       expected = 0;
+      ++spins;
+   }
+
+   sSchedulerLockAcquires.store(sSchedulerLockAcquires.load(std::memory_order_relaxed) + 1,
+                                std::memory_order_relaxed);
+
+   if (spins) {
+      sSchedulerLockContended.store(sSchedulerLockContended.load(std::memory_order_relaxed) + 1,
+                                    std::memory_order_relaxed);
+      sSchedulerLockSpins.store(sSchedulerLockSpins.load(std::memory_order_relaxed) + spins,
+                                std::memory_order_relaxed);
    }
 }
 
+SchedulerLockStats
+getSchedulerLockStats()
+{
+   auto stats = SchedulerLockStats { };
+   stats.acquires = sSchedulerLockAcquires.load(std::memory_order_relaxed);
+   stats.contended = sSchedulerLockContended.load(std::memory_order_relaxed);
+   stats.spins = sSchedulerLockSpins.load(std::memory_order_relaxed);
+   return stats;
+}
+
 bool
 isSchedulerLocked()
 {
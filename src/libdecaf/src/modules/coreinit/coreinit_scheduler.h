@@ -11,6 +11,18 @@ struct OSThreadQueue;
 namespace internal
 {
 
+struct SchedulerLockStats
+{
+   //! Times the scheduler lock has been taken
+   uint64_t acquires;
+
+   //! Times the lock was already held by someone else
+   uint64_t contended;
+
+   //! Failed attempts to take the lock while it was held
+   uint64_t spins;
+};
+
 void
 startDefaultCoreThreads();
 
@@ -38,6 +50,9 @@ isSchedulerLocked();
 void
 unlockScheduler();
 
+SchedulerLockStats
+getSchedulerLockStats();
+
 bool
 isSchedulerEnabled();
 
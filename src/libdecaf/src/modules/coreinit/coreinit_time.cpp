@@ -1,6 +1,7 @@
 #include "coreinit.h"
 #include "coreinit_time.h"
 #include "coreinit_systeminfo.h"
+#include <common/bitutils.h>
 #include <common/platform_time.h>
 #include "decaf_config.h"
 #include "libcpu/cpu.h"
@@ -17,17 +18,18 @@ sBaseClock;
 static cpu::TimerDuration
 sBaseTicks;
 
+//! decaf::config::system::time_scale as 32.32 fixed point
+static uint64_t
+sTimeScale = 1ull << 32;
+
 
 static uint64_t
 scaledTimebase()
 {
-   if (decaf::config::system::time_scale == 1.0) {
+   if (sTimeScale == 1ull << 32) {
       return cpu::this_core::state()->tb();
    } else {
-      // This might introduce timeBase inaccuracies, which is why we only
-      //  do it when it is not set to 1.0.
-      auto tbDbl = static_cast<double>(cpu::this_core::state()->tb());
-      return static_cast<uint64_t>(tbDbl * decaf::config::system::time_scale);
+      return mul_fixed32(cpu::this_core::state()->tb(), sTimeScale);
    }
 }
 
@@ -134,6 +136,7 @@ Module::initialiseClock()
    tm.tm_year = 2000 - 1900;
    tm.tm_isdst = -1;
    sEpochTime = std::chrono::system_clock::from_time_t(platform::make_gm_time(tm));
+   sTimeScale = static_cast<uint64_t>(decaf::config::system::time_scale * 4294967296.0);
 
    sBaseClock = std::chrono::system_clock::now();
    auto ticksSinceEpoch = std::chrono::duration_cast<cpu::TimerDuration>(sBaseClock - sEpochTime);
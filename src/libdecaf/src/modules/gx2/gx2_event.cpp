@@ -1,3 +1,4 @@
+#include "decaf_metrics.h"
 #include "gx2.h"
 #include "gx2_event.h"
 #include "gx2_state.h"
@@ -38,6 +39,10 @@ sLastSubmittedTimestamp { 0 };
 static std::atomic<int64_t>
 sRetiredTimestamp { 0 };
 
+//! Retired timestamp which has had its interrupt raised
+static std::atomic<int64_t>
+sRetireInterruptTimestamp { 0 };
+
 static OSThreadQueue *
 sVsyncThreadQueue = nullptr;
 
@@ -309,6 +314,19 @@ setRetiredTimestamp(OSTime timestamp)
 {
    sRetiredTimestamp.store(timestamp, std::memory_order_release);
    cpu::interrupt(gx2::internal::getMainCoreId(), cpu::GPU_RETIRE_INTERRUPT);
+   sRetireInterruptTimestamp.store(timestamp, std::memory_order_release);
+}
+
+
+/**
+ * Check whether every submitted command buffer has retired and raised its
+ * interrupt, which also covers any flips the buffers contained.
+ */
+bool
+isGpuIdle()
+{
+   return sRetireInterruptTimestamp.load(std::memory_order_acquire) >=
+          sLastSubmittedTimestamp.load(std::memory_order_acquire);
 }
 
 
@@ -329,6 +347,7 @@ void
 onSwap()
 {
    sSwapCount++;
+   decaf::metrics::recordFrame();
 }
 
 
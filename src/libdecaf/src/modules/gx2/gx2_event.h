@@ -80,6 +80,9 @@ handleGpuRetireInterrupt();
 void
 setRetiredTimestamp(coreinit::OSTime timestamp);
 
+bool
+isGpuIdle();
+
 void
 onSwap();
 
@@ -265,9 +265,12 @@ freeCommandBuffer(CommandBuffer *cb)
 void
 onRetireCommandBuffer(void *context)
 {
+   // Free the buffer before publishing the timestamp, so anyone who sees
+   //  the buffer retired also sees its space back in the pool.
    auto buf = reinterpret_cast<CommandBuffer *>(context);
-   setRetiredTimestamp(buf->submitTime);
+   auto submitTime = buf->submitTime;
    freeCommandBuffer(buf);
+   setRetiredTimestamp(submitTime);
 }
 
 static void
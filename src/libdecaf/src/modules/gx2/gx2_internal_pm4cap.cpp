@@ -8,7 +8,10 @@
 #include <common/byte_swap.h>
 #include <common/log.h>
 #include <common/platform_dir.h>
+#include <common/platform_thread.h>
 #include <common/murmur3.h>
+#include <condition_variable>
+#include <deque>
 #include <fmt/format.h>
 #include <fstream>
 #include <gsl.h>
@@ -18,9 +21,16 @@
 #include <libgpu/latte/latte_pm4.h>
 #include <libgpu/latte/latte_pm4_commands.h>
 #include <libgpu/latte/latte_pm4_reader.h>
+#include <set>
+#include <thread>
 #include <vector>
+#include <zlib.h>
 
-using decaf::pm4::CaptureMagic;
+using decaf::pm4::CaptureChunk;
+using decaf::pm4::CaptureMagicCompressed;
+using decaf::pm4::CaptureMaxBlobBytes;
+using decaf::pm4::CaptureMemoryBlob;
+using decaf::pm4::CaptureMemoryLoadBlob;
 using decaf::pm4::CapturePacket;
 using decaf::pm4::CaptureMemoryLoad;
 using decaf::pm4::CaptureSetBuffer;
@@ -32,6 +42,19 @@ HashAllMemory = true;
 static const auto
 HashShadowState = true;
 
+//! Size of the uncompressed chunks handed to the writer thread
+static const auto
+ChunkSize = size_t { 4 * 1024 * 1024 };
+
+//! Number of chunks which can be waiting for the writer thread before the
+//!  recorder has to wait for it
+static const auto
+MaxQueuedChunks = size_t { 8 };
+
+//! zlib compression level, favour speed so the writer thread keeps up
+static const auto
+CompressionLevel = 1;
+
 namespace gx2
 {
 
@@ -53,6 +76,13 @@ public:
       mRegisters.fill(0);
    }
 
+   ~Recorder()
+   {
+      if (mWriterThread.joinable()) {
+         stopWriter();
+      }
+   }
+
    bool
    requestStart(const std::string &path)
    {
@@ -65,10 +95,15 @@ public:
       }
 
       // Write magic header
-      mOut.write(CaptureMagic.data(), CaptureMagic.size());
+      mOut.write(CaptureMagicCompressed.data(), CaptureMagicCompressed.size());
 
       // Set intial state
       mRecordedMemory.clear();
+      mWrittenBlobs.clear();
+      mWrittenBlobBytes = 0;
+      mChunk.clear();
+      mChunk.reserve(ChunkSize);
+      startWriter();
       mState = CaptureState::WaitStartNextFrame;
 
       return true;
@@ -170,6 +205,7 @@ private:
    stop()
    {
       decaf_check(mState == CaptureState::Enabled || mState == CaptureState::WaitEndNextFrame);
+      stopWriter();
       mOut.close();
       mState = CaptureState::Disabled;
    }
@@ -228,33 +264,149 @@ private:
       }
    }
 
+   void
+   startWriter()
+   {
+      mWriterStop = false;
+      mWriterThread = std::thread { [this]() { writerThread(); } };
+      platform::setThreadName(&mWriterThread, "PM4 Capture Writer");
+   }
+
+   void
+   stopWriter()
+   {
+      flushChunk();
+
+      {
+         std::unique_lock<std::mutex> lock { mQueueMutex };
+         mWriterStop = true;
+      }
+
+      mQueueNotEmpty.notify_all();
+      mWriterThread.join();
+   }
+
+   // Compresses and writes chunks until stopWriter is called and the queue
+   //  is empty.
+   void
+   writerThread()
+   {
+      auto compressed = std::vector<uint8_t> { };
+
+      while (true) {
+         auto chunk = std::vector<uint8_t> { };
+
+         {
+            std::unique_lock<std::mutex> lock { mQueueMutex };
+            mQueueNotEmpty.wait(lock, [this]() { return mWriterStop || !mQueue.empty(); });
+
+            if (mQueue.empty()) {
+               break;
+            }
+
+            chunk = std::move(mQueue.front());
+            mQueue.pop_front();
+         }
+
+         mQueueNotFull.notify_one();
+
+         auto compressedSize = compressBound(static_cast<uLong>(chunk.size()));
+         compressed.resize(compressedSize);
+
+         if (compress2(compressed.data(), &compressedSize,
+                       chunk.data(), static_cast<uLong>(chunk.size()),
+                       CompressionLevel) != Z_OK) {
+            gLog->error("Failed to compress pm4 capture chunk of {} bytes", chunk.size());
+            continue;
+         }
+
+         auto header = CaptureChunk { };
+         header.compressedSize = static_cast<uint32_t>(compressedSize);
+         header.uncompressedSize = static_cast<uint32_t>(chunk.size());
+         mOut.write(reinterpret_cast<const char *>(&header), sizeof(CaptureChunk));
+         mOut.write(reinterpret_cast<const char *>(compressed.data()), compressedSize);
+      }
+   }
+
+   // Hands the current chunk to the writer thread, waiting if the queue is full
+   void
+   flushChunk()
+   {
+      if (mChunk.empty()) {
+         return;
+      }
+
+      {
+         std::unique_lock<std::mutex> lock { mQueueMutex };
+         mQueueNotFull.wait(lock, [this]() { return mQueue.size() < MaxQueuedChunks; });
+         mQueue.emplace_back(std::move(mChunk));
+      }
+
+      mQueueNotEmpty.notify_one();
+      mChunk = std::vector<uint8_t> { };
+      mChunk.reserve(ChunkSize);
+   }
+
    void
    writePacket(CapturePacket &packet)
    {
-      mOut.write(reinterpret_cast<const char *>(&packet), sizeof(CapturePacket));
+      writeData(&packet, sizeof(CapturePacket));
    }
 
    void
-   writeData(void *data, uint32_t size)
+   writeData(const void *data, uint32_t size)
    {
-      mOut.write(reinterpret_cast<const char *>(data), size);
+      auto bytes = reinterpret_cast<const uint8_t *>(data);
+      mChunk.insert(mChunk.end(), bytes, bytes + size);
+
+      if (mChunk.size() >= ChunkSize) {
+         flushChunk();
+      }
    }
 
+   // Writes the memory as a blob unless a blob with the same hash is still
+   //  remembered, and then a load which refers to the blob by hash.
    void
    writeMemoryLoad(CaptureMemoryLoad::MemoryType type,
                    void *buffer,
-                   uint32_t size)
+                   uint32_t size,
+                   const uint64_t hash[2])
    {
-      CaptureMemoryLoad load;
+      auto key = std::array<uint64_t, 2> { hash[0], hash[1] };
+
+      if (mWrittenBlobs.find(key) == mWrittenBlobs.end()) {
+         // The reader forgets its blobs at the same point, see CaptureMaxBlobBytes
+         if (mWrittenBlobBytes + size > CaptureMaxBlobBytes) {
+            mWrittenBlobs.clear();
+            mWrittenBlobBytes = 0;
+         }
+
+         mWrittenBlobs.insert(key);
+         mWrittenBlobBytes += size;
+
+         CaptureMemoryBlob blob;
+         blob.hash[0] = hash[0];
+         blob.hash[1] = hash[1];
+
+         CapturePacket packet;
+         packet.type = CapturePacket::MemoryBlob;
+         packet.size = size + sizeof(CaptureMemoryBlob);
+         writePacket(packet);
+         writeData(&blob, sizeof(CaptureMemoryBlob));
+         writeData(buffer, size);
+      }
+
+      CaptureMemoryLoadBlob load;
       load.type = type;
       load.address = mem::untranslate(buffer);
+      load.hash[0] = hash[0];
+      load.hash[1] = hash[1];
 
       CapturePacket packet;
-      packet.type = CapturePacket::MemoryLoad;
-      packet.size = size + sizeof(CaptureMemoryLoad);
+      packet.type = CapturePacket::MemoryLoadBlob;
+      packet.size = sizeof(CaptureMemoryLoadBlob);
       writePacket(packet);
-      writeData(&load, sizeof(CaptureMemoryLoad));
-      writeData(buffer, size);
+      writeData(&load, sizeof(CaptureMemoryLoadBlob));
    }
 
    void
@@ -905,7 +1057,12 @@ private:
          mRecordedMemory.emplace_back(RecordedMemory { trackStart, trackEnd, hash[0], hash[1] });
       }
 
-      writeMemoryLoad(type, mem::translate(addr), size);
+      if (!useHash) {
+         // Blobs are stored by hash, so we need it regardless
+         MurmurHash3_x64_128(mem::translate(addr), size, 0, hash);
+      }
+
+      writeMemoryLoad(type, mem::translate(addr), size, hash);
       return true;
    }
 
@@ -914,6 +1071,23 @@ private:
    std::mutex mMutex;
    std::ofstream mOut;
    std::vector<RecordedMemory> mRecordedMemory;
+
+   //! Hashes of the memory blobs the reader will still remember
+   std::set<std::array<uint64_t, 2>> mWrittenBlobs;
+
+   //! Total size of the blobs in mWrittenBlobs
+   uint64_t mWrittenBlobBytes = 0;
+
+   //! Packets waiting to be handed to the writer thread
+   std::vector<uint8_t> mChunk;
+
+   std::thread mWriterThread;
+   std::mutex mQueueMutex;
+   std::condition_variable mQueueNotEmpty;
+   std::condition_variable mQueueNotFull;
+   std::deque<std::vector<uint8_t>> mQueue;
+   bool mWriterStop = false;
+
    std::array<uint32_t, 0x10000> mRegisters;
    size_t mCapturedFrames = 0;
    size_t mCaptureNumFrames = 0;
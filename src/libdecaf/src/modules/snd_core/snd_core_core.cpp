@@ -12,6 +12,7 @@
 #include "ppcutils/wfunc_ptr.h"
 #include "ppcutils/wfunc_call.h"
 
+#include <common/perftrace.h>
 #include <fmt/format.h>
 
 namespace snd_core
@@ -319,6 +320,8 @@ frameCallbackThreadEntry(uint32_t core_id,
       coreinit::internal::rescheduleSelfNoLock();
       coreinit::internal::unlockScheduler();
 
+      PERFTRACE_ZONE("snd", "AXFrame");
+
       if (sFrameCallback) {
          sFrameCallback();
       }
@@ -17,6 +17,13 @@ extern std::vector<int64_t> debug_filters;
 //! Dump shaders
 extern bool dump_shaders;
 
+//! Write protect memory used by GPU resources so we only need to check for
+//!  changes in resources which have actually been written to.
+extern bool write_tracking;
+
+//! Untile surfaces in a compute shader instead of on the CPU
+extern bool compute_untile;
+
 } // namespace config
 
 } // namespace gpu
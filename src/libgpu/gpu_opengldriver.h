@@ -17,6 +17,15 @@ public:
       uint64_t numShaderPipelines = 0;
       uint64_t numSurfaces = 0;
       uint64_t numDataBuffers = 0;
+
+      // Per frame
+      uint64_t numRegisterWrites = 0;
+      uint64_t numRedundantRegisterWrites = 0;
+      uint64_t numStateGroupApplies = 0;
+      uint64_t numRedundantStateGroupApplies = 0;
+      uint64_t numDraws = 0;
+      uint64_t numMergedDraws = 0;
+      uint64_t numDrawBatches = 0;
    };
 
    virtual ~OpenGLDriver() = default;
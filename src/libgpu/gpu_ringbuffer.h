@@ -28,6 +28,14 @@ waitForItem();
 void
 awaken();
 
+//! Number of buffers submitted which the driver has not dequeued yet
+uint32_t
+getPendingItems();
+
+//! Number of words in the buffers counted by getPendingItems
+uint64_t
+getPendingWords();
+
 } // namespace ringbuffer
 
 } // namespace gpu
@@ -5,6 +5,27 @@
 namespace gpu
 {
 
+/**
+ * Everything the addrlibopt address calculation needs to know about a tiled
+ * surface besides its size, so the same calculation can be done elsewhere,
+ * such as in a compute shader. Only single sample surfaces are supported.
+ */
+struct TiledSurfaceParams
+{
+   //! 0 for linear, 1 for micro tiled and 2 for macro tiled tile modes
+   uint32_t tiling = 0;
+   uint32_t thickness = 1;
+   uint32_t rotation = 0;
+   uint32_t macroTilePitch = 0;
+   uint32_t macroTileHeight = 0;
+
+   //! Zero unless the tile mode is bank swapped
+   uint32_t bankSwapWidth = 0;
+
+   uint32_t bankSwizzle = 0;
+   uint32_t pipeSwizzle = 0;
+};
+
 ADDR_HANDLE
 getAddrLibHandle();
 
@@ -32,4 +53,11 @@ convertFromTiled(uint8_t *output,
                  bool isDepth,
                  uint32_t bpp);
 
+bool
+getTiledSurfaceParams(TiledSurfaceParams &params,
+                      latte::SQ_TILE_MODE tileMode,
+                      uint32_t swizzle,
+                      uint32_t pitch,
+                      uint32_t bpp);
+
 } // namespace gpu
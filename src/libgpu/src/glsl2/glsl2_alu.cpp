@@ -1,6 +1,10 @@
 #include "glsl2_alu.h"
 #include "latte/latte_instructions.h"
 
+#include <cmath>
+#include <common/bit_cast.h>
+#include <common/decaf_assert.h>
+#include <cstdlib>
 #include <fmt/format.h>
 
 using namespace latte;
@@ -8,13 +12,6 @@ using namespace latte;
 namespace glsl2
 {
 
-union LiteralValue
-{
-   float asFloat;
-   uint32_t asUint;
-   int asInt;
-};
-
 void
 insertIndexMode(fmt::MemoryWriter &out,
                 SQ_INDEX_MODE index)
@@ -63,6 +60,35 @@ insertChannel(fmt::MemoryWriter &out,
    }
 }
 
+void
+insertFloatConstant(fmt::MemoryWriter &out,
+                    uint32_t bits)
+{
+   auto value = bit_cast<float>(bits);
+   auto text = fmt::format("{:.6f}", value);
+
+   // Only use the short form when it will be read back as the same value
+   if (std::isfinite(value) && std::strtof(text.c_str(), nullptr) == value) {
+      out << text << 'f';
+   } else {
+      out.write("uintBitsToFloat({:#x}u)", bits);
+   }
+}
+
+static void
+insertConstant(fmt::MemoryWriter &out,
+               SQ_ALU_FLAGS flags,
+               uint32_t bits)
+{
+   if (flags & SQ_ALU_FLAG_INT_IN) {
+      out << bit_cast<int32_t>(bits);
+   } else if (flags & SQ_ALU_FLAG_UINT_IN) {
+      out << bits;
+   } else {
+      insertFloatConstant(out, bits);
+   }
+}
+
 void
 insertSource0(State &state,
               fmt::MemoryWriter &out,
@@ -194,7 +220,7 @@ insertSource(State &state,
    auto didTypeConversion = false;
    auto needsChannelSelect = false;
    auto flags = SQ_ALU_FLAG_NONE;
-   LiteralValue value;
+   auto previous = AluValue { };
 
    if (inst.word1.ENCODING() == SQ_ALU_ENCODING::OP2) {
       flags = getInstructionFlags(inst.op2.ALU_INST());
@@ -202,6 +228,17 @@ insertSource(State &state,
       flags = getInstructionFlags(inst.op3.ALU_INST());
    }
 
+   if (state.aluGroup && (sel == SQ_ALU_SRC::PV || sel == SQ_ALU_SRC::PS)) {
+      previous = state.aluGroup->previous[sel == SQ_ALU_SRC::PS ? SQ_CHAN::T : chan];
+   }
+
+   if (previous.type == AluValue::Register) {
+      // The previous group also wrote this value to a register
+      auto gpr = static_cast<SQ_ALU_SRC>(SQ_ALU_SRC::REGISTER_FIRST + previous.gpr);
+      insertSource(state, out, cf, inst, gpr, SQ_REL::ABS, previous.chan, abs, neg);
+      return;
+   }
+
    if (abs) {
       out << "abs(";
    }
@@ -227,6 +264,11 @@ insertSource(State &state,
       case SQ_ALU_SRC::PV:
       case SQ_ALU_SRC::PS:
          // PreviousVector, PreviousScalar
+         if (previous.type == AluValue::Constant) {
+            // Constants are inserted directly in the type we need
+            break;
+         }
+
          if (flags & SQ_ALU_FLAG_INT_IN) {
             out << "floatBitsToInt(";
             didTypeConversion = true;
@@ -340,11 +382,19 @@ insertSource(State &state,
    } else {
       switch (sel) {
       case SQ_ALU_SRC::PV:
-         out << "PV";
-         needsChannelSelect = true;
+         if (previous.type == AluValue::Constant) {
+            insertConstant(out, flags, previous.value);
+         } else {
+            out << "PV";
+            needsChannelSelect = true;
+         }
          break;
       case SQ_ALU_SRC::PS:
-         out << "PS";
+         if (previous.type == AluValue::Constant) {
+            insertConstant(out, flags, previous.value);
+         } else {
+            out << "PS";
+         }
          break;
       case SQ_ALU_SRC::IMM_0:
          out << "0.0f";
@@ -362,15 +412,7 @@ insertSource(State &state,
          out << "-1";
          break;
       case SQ_ALU_SRC::LITERAL:
-         value.asUint = state.literals[chan];
-
-         if (flags & SQ_ALU_FLAG_INT_IN) {
-            out << value.asInt;
-         } else if (flags & SQ_ALU_FLAG_UINT_IN) {
-            out << value.asUint;
-         } else {
-            out.write("{:.6f}f", value.asFloat);
-         }
+         insertConstant(out, flags, state.literals[chan]);
          break;
       case SQ_ALU_SRC::IMM_1_DBL_L:
       case SQ_ALU_SRC::IMM_1_DBL_M:
@@ -463,8 +505,7 @@ insertDestBegin(State &state,
    auto flags = SQ_ALU_FLAG_NONE;
    auto omod = SQ_ALU_OMOD::OFF;
    auto writeMask = true;
-
-   insertPreviousValueUpdate(state.out, unit);
+   auto directWrite = state.aluGroup && state.aluGroup->units[unit].directWrite;
 
    if (inst.word1.ENCODING() == SQ_ALU_ENCODING::OP2) {
       writeMask = inst.op2.WRITE_MASK();
@@ -474,7 +515,17 @@ insertDestBegin(State &state,
       flags = getInstructionFlags(inst.op3.ALU_INST());
    }
 
-   if (writeMask) {
+   if (directWrite) {
+      // Nothing reads this through PV / PS, so skip the temporary
+      decaf_check(writeMask);
+      state.out << "R[" << inst.word1.DST_GPR() << "].";
+      insertChannel(state.out, inst.word1.DST_CHAN());
+      state.out << " = ";
+   } else {
+      insertPreviousValueUpdate(state.out, unit);
+   }
+
+   if (writeMask && !directWrite) {
       fmt::MemoryWriter postWrite;
 
       auto gpr = inst.word1.DST_GPR();
@@ -521,6 +572,22 @@ insertDestBegin(State &state,
    }
 }
 
+void
+insertFoldedWrite(State &state,
+                  const AluUnitIR &unit)
+{
+   if (unit.writesRegister) {
+      fmt::MemoryWriter postWrite;
+      postWrite << "R[" << unit.gpr << "].";
+      insertChannel(postWrite, unit.chan);
+      postWrite << " = ";
+      insertFloatConstant(postWrite, unit.foldedValue);
+      postWrite << ";";
+
+      state.postGroupWrites.push_back(postWrite.str());
+   }
+}
+
 void
 insertDestEnd(State &state,
               const ControlFlowInst &cf,
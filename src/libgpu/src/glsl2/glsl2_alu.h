@@ -12,6 +12,10 @@ void
 insertChannel(fmt::MemoryWriter &out,
               latte::SQ_CHAN channel);
 
+void
+insertFloatConstant(fmt::MemoryWriter &out,
+                    uint32_t bits);
+
 void
 insertSource0(State &state,
               fmt::MemoryWriter &out,
@@ -77,6 +81,10 @@ insertDestBegin(State &state,
                 const latte::AluInst &inst,
                 latte::SQ_CHAN unit);
 
+void
+insertFoldedWrite(State &state,
+                  const AluUnitIR &unit);
+
 void
 insertDestEnd(State &state,
               const latte::ControlFlowInst &cf,
@@ -0,0 +1,439 @@
+#include "glsl2_ir.h"
+#include "latte/latte_decoders.h"
+
+#include <algorithm>
+#include <cmath>
+#include <common/bit_cast.h>
+#include <gsl.h>
+
+using namespace latte;
+
+namespace glsl2
+{
+
+struct AluSource
+{
+   SQ_ALU_SRC sel;
+   SQ_REL rel;
+   SQ_CHAN chan;
+   bool abs;
+   bool neg;
+};
+
+struct AluRead
+{
+   //! Unit of the instruction doing the read
+   unsigned unit;
+
+   //! Index into AluGroupIR::previous for reads through PV / PS, else -1
+   int previous;
+
+   //! Register being read when previous is -1
+   uint32_t gpr;
+   SQ_CHAN chan;
+};
+
+struct AluGroupReads
+{
+   gsl::span<const uint32_t> literals;
+   std::vector<AluRead> reads;
+   bool readsRelative = false;
+};
+
+static SQ_ALU_FLAGS
+getAluFlags(const AluInst &inst)
+{
+   if (inst.word1.ENCODING() == SQ_ALU_ENCODING::OP2) {
+      return getInstructionFlags(inst.op2.ALU_INST());
+   } else {
+      return getInstructionFlags(inst.op3.ALU_INST());
+   }
+}
+
+static unsigned
+getAluSources(const AluInst &inst,
+              std::array<AluSource, 3> &sources)
+{
+   auto isOp2 = inst.word1.ENCODING() == SQ_ALU_ENCODING::OP2;
+   sources[0] = AluSource {
+      inst.word0.SRC0_SEL(), inst.word0.SRC0_REL(), inst.word0.SRC0_CHAN(),
+      isOp2 && inst.op2.SRC0_ABS(), inst.word0.SRC0_NEG()
+   };
+
+   sources[1] = AluSource {
+      inst.word0.SRC1_SEL(), inst.word0.SRC1_REL(), inst.word0.SRC1_CHAN(),
+      isOp2 && inst.op2.SRC1_ABS(), inst.word0.SRC1_NEG()
+   };
+
+   sources[2] = AluSource {
+      inst.op3.SRC2_SEL(), inst.op3.SRC2_REL(), inst.op3.SRC2_CHAN(),
+      false, inst.op3.SRC2_NEG()
+   };
+
+   if (isOp2) {
+      return getInstructionNumSrcs(inst.op2.ALU_INST());
+   } else {
+      return getInstructionNumSrcs(inst.op3.ALU_INST());
+   }
+}
+
+static bool
+isPureInstruction(const AluInst &inst)
+{
+   auto flags = getAluFlags(inst);
+
+   if (flags & (SQ_ALU_FLAG_REDUCTION | SQ_ALU_FLAG_PRED_SET)) {
+      return false;
+   }
+
+   if (inst.word0.PRED_SEL() != SQ_PRED_SEL::OFF) {
+      return false;
+   }
+
+   if (inst.word1.ENCODING() == SQ_ALU_ENCODING::OP2) {
+      switch (inst.op2.ALU_INST()) {
+      case SQ_OP2_INST_KILLE:
+      case SQ_OP2_INST_KILLE_INT:
+      case SQ_OP2_INST_KILLGE:
+      case SQ_OP2_INST_KILLGE_INT:
+      case SQ_OP2_INST_KILLGE_UINT:
+      case SQ_OP2_INST_KILLGT:
+      case SQ_OP2_INST_KILLGT_INT:
+      case SQ_OP2_INST_KILLGT_UINT:
+      case SQ_OP2_INST_KILLNE:
+      case SQ_OP2_INST_KILLNE_INT:
+      case SQ_OP2_INST_MOVA:
+      case SQ_OP2_INST_MOVA_FLOOR:
+      case SQ_OP2_INST_MOVA_INT:
+      case SQ_OP2_INST_MOVA_GPR_INT:
+      case SQ_OP2_INST_NOP:
+         return false;
+      default:
+         break;
+      }
+   }
+
+   return true;
+}
+
+static bool
+getConstantSource(const AluGroupIR &group,
+                  const AluGroupReads &reads,
+                  const AluSource &source,
+                  float &value)
+{
+   switch (source.sel) {
+   case SQ_ALU_SRC::IMM_0:
+      value = 0.0f;
+      break;
+   case SQ_ALU_SRC::IMM_1:
+      value = 1.0f;
+      break;
+   case SQ_ALU_SRC::IMM_0_5:
+      value = 0.5f;
+      break;
+   case SQ_ALU_SRC::LITERAL:
+      if (source.chan >= reads.literals.size()) {
+         return false;
+      }
+
+      value = bit_cast<float>(reads.literals[source.chan]);
+      break;
+   case SQ_ALU_SRC::PV:
+   case SQ_ALU_SRC::PS:
+   {
+      auto &previous = group.previous[source.sel == SQ_ALU_SRC::PS ? SQ_CHAN::T : source.chan];
+
+      if (previous.type != AluValue::Constant) {
+         return false;
+      }
+
+      value = bit_cast<float>(previous.value);
+      break;
+   }
+   default:
+      return false;
+   }
+
+   // Matches the abs(-(x)) order insertSource emits
+   if (source.neg) {
+      value = -value;
+   }
+
+   if (source.abs) {
+      value = std::fabs(value);
+   }
+
+   return true;
+}
+
+static bool
+foldInstruction(const AluGroupIR &group,
+                const AluGroupReads &reads,
+                const AluInst &inst,
+                uint32_t &result)
+{
+   auto sources = std::array<AluSource, 3> { };
+   auto values = std::array<float, 3> { };
+   auto numSrcs = getAluSources(inst, sources);
+   auto omod = SQ_ALU_OMOD::OFF;
+   auto value = 0.0f;
+
+   for (auto i = 0u; i < numSrcs; ++i) {
+      if (!getConstantSource(group, reads, sources[i], values[i])) {
+         return false;
+      }
+   }
+
+   if (inst.word1.ENCODING() == SQ_ALU_ENCODING::OP2) {
+      omod = inst.op2.OMOD();
+
+      switch (inst.op2.ALU_INST()) {
+      case SQ_OP2_INST_MOV:
+         value = values[0];
+         break;
+      case SQ_OP2_INST_ADD:
+         value = values[0] + values[1];
+         break;
+      case SQ_OP2_INST_MUL:
+      case SQ_OP2_INST_MUL_IEEE:
+         value = values[0] * values[1];
+         break;
+      case SQ_OP2_INST_MAX:
+         value = std::max(values[0], values[1]);
+         break;
+      case SQ_OP2_INST_MIN:
+         value = std::min(values[0], values[1]);
+         break;
+      default:
+         return false;
+      }
+   } else {
+      switch (inst.op3.ALU_INST()) {
+      case SQ_OP3_INST_MULADD:
+      case SQ_OP3_INST_MULADD_IEEE:
+         value = values[0] * values[1] + values[2];
+         break;
+      default:
+         return false;
+      }
+   }
+
+   switch (omod) {
+   case SQ_ALU_OMOD::OFF:
+      break;
+   case SQ_ALU_OMOD::M2:
+      value *= 2.0f;
+      break;
+   case SQ_ALU_OMOD::M4:
+      value *= 4.0f;
+      break;
+   case SQ_ALU_OMOD::D2:
+      value /= 2.0f;
+      break;
+   default:
+      return false;
+   }
+
+   if (inst.word1.CLAMP()) {
+      value = std::min(std::max(value, 0.0f), 1.0f);
+   }
+
+   result = bit_cast<uint32_t>(value);
+   return true;
+}
+
+static unsigned
+countRegisterWriters(const AluGroupIR &group,
+                     uint32_t gpr,
+                     SQ_CHAN chan)
+{
+   auto count = 0u;
+
+   for (auto &unit : group.units) {
+      if (unit.inst && unit.writesRegister && unit.gpr == gpr && unit.chan == chan) {
+         ++count;
+      }
+   }
+
+   return count;
+}
+
+static bool
+canWriteDirect(const AluGroupIR &group,
+               const AluGroupReads &reads,
+               unsigned unitIndex)
+{
+   auto &unit = group.units[unitIndex];
+
+   // A relative read could be of any register
+   if (reads.readsRelative) {
+      return false;
+   }
+
+   if (countRegisterWriters(group, unit.gpr, unit.chan) != 1) {
+      return false;
+   }
+
+   // Every other instruction in the group must still see the old value, an
+   // instruction reading its own destination is fine as GLSL evaluates the
+   // right hand side first.
+   for (auto &read : reads.reads) {
+      auto gpr = read.gpr;
+      auto chan = read.chan;
+
+      if (read.unit == unitIndex) {
+         continue;
+      }
+
+      if (read.previous >= 0) {
+         auto &previous = group.previous[read.previous];
+
+         if (previous.type != AluValue::Register) {
+            continue;
+         }
+
+         gpr = previous.gpr;
+         chan = previous.chan;
+      }
+
+      if (gpr == unit.gpr && chan == unit.chan) {
+         return false;
+      }
+   }
+
+   return true;
+}
+
+void
+buildAluClauseIR(AluClauseIR &ir,
+                 const AluInst *clause,
+                 size_t count)
+{
+   auto groupReads = std::vector<AluGroupReads> { };
+   ir.groups.clear();
+
+   // Decode the clause
+   for (size_t slot = 0u; slot < count; ) {
+      auto units = AluGroupUnits { };
+      auto group = AluGroup { clause + slot };
+      auto groupIR = AluGroupIR { };
+      auto reads = AluGroupReads { };
+      reads.literals = group.literals;
+
+      for (auto &inst : group.instructions) {
+         auto unit = units.addInstructionUnit(inst);
+         auto &unitIR = groupIR.units[unit];
+         auto sources = std::array<AluSource, 3> { };
+         auto numSrcs = getAluSources(inst, sources);
+
+         unitIR.inst = &inst;
+         unitIR.pure = isPureInstruction(inst);
+         unitIR.gpr = inst.word1.DST_GPR();
+         unitIR.chan = inst.word1.DST_CHAN();
+
+         if (inst.word1.ENCODING() == SQ_ALU_ENCODING::OP2) {
+            unitIR.writesRegister = inst.op2.WRITE_MASK();
+         } else {
+            unitIR.writesRegister = true;
+         }
+
+         if (getAluFlags(inst) & SQ_ALU_FLAG_REDUCTION) {
+            groupIR.isReduction = true;
+         }
+
+         for (auto i = 0u; i < numSrcs; ++i) {
+            auto &source = sources[i];
+
+            if (source.sel == SQ_ALU_SRC::PV) {
+               reads.reads.push_back({ unit, static_cast<int>(source.chan), 0, source.chan });
+            } else if (source.sel == SQ_ALU_SRC::PS) {
+               reads.reads.push_back({ unit, static_cast<int>(SQ_CHAN::T), 0, source.chan });
+            } else if (source.sel >= SQ_ALU_SRC::REGISTER_FIRST && source.sel <= SQ_ALU_SRC::REGISTER_LAST) {
+               if (source.rel) {
+                  reads.readsRelative = true;
+               } else {
+                  reads.reads.push_back({ unit, -1, source.sel - SQ_ALU_SRC::REGISTER_FIRST, source.chan });
+               }
+            }
+         }
+      }
+
+      ir.groups.push_back(groupIR);
+      groupReads.push_back(reads);
+      slot = group.getNextSlot(slot);
+   }
+
+   // Propagate values forwards through PV / PS and fold constants
+   for (auto i = 0u; i < ir.groups.size(); ++i) {
+      auto &group = ir.groups[i];
+
+      if (i > 0) {
+         auto &prevGroup = ir.groups[i - 1];
+
+         for (auto j = 0u; j < prevGroup.units.size(); ++j) {
+            auto &unit = prevGroup.units[j];
+            auto &value = group.previous[j];
+
+            // Reduction instructions are never pure, so in a reduction group
+            //  only the T unit can propagate. A folded unit never writes PVo /
+            //  PSo, so it must always propagate as a constant.
+            if (!unit.inst || !unit.pure) {
+               continue;
+            }
+
+            if (unit.folded) {
+               value.type = AluValue::Constant;
+               value.value = unit.foldedValue;
+            } else if (unit.writesRegister && countRegisterWriters(prevGroup, unit.gpr, unit.chan) == 1) {
+               value.type = AluValue::Register;
+               value.gpr = unit.gpr;
+               value.chan = unit.chan;
+            }
+         }
+      }
+
+      for (auto &unit : group.units) {
+         if (unit.inst && unit.pure) {
+            unit.folded = foldInstruction(group, groupReads[i], *unit.inst, unit.foldedValue);
+         }
+      }
+   }
+
+   // Decide which results are still needed in PVo / PSo
+   for (auto i = 0u; i < ir.groups.size(); ++i) {
+      auto &group = ir.groups[i];
+      auto needed = std::array<bool, 5> { false, false, false, false, false };
+
+      if (i + 1 < ir.groups.size()) {
+         auto &nextGroup = ir.groups[i + 1];
+
+         for (auto &read : groupReads[i + 1].reads) {
+            if (read.previous >= 0 && nextGroup.previous[read.previous].type == AluValue::Unknown) {
+               needed[read.previous] = true;
+            }
+         }
+      }
+
+      for (auto j = 0u; j < group.units.size(); ++j) {
+         auto &unit = group.units[j];
+
+         if (!unit.inst || !unit.pure || unit.folded || needed[j]) {
+            continue;
+         }
+
+         if (!unit.writesRegister) {
+            unit.dead = true;
+         } else {
+            unit.directWrite = canWriteDirect(group, groupReads[i], j);
+         }
+      }
+
+      group.updatePreviousVector =
+         (group.units[0].inst || group.units[1].inst || group.units[2].inst || group.units[3].inst)
+         && (needed[0] || needed[1] || needed[2] || needed[3]);
+      group.updatePreviousScalar = group.units[4].inst && needed[4];
+   }
+}
+
+} // namespace glsl2
@@ -0,0 +1,102 @@
+#pragma once
+#include "latte/latte_instructions.h"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace glsl2
+{
+
+/**
+ * A small intermediate representation of a Latte ALU clause.
+ *
+ * Translating an ALU instruction naively writes its result to PVo / PSo and
+ * then copies it to R at the end of the group, leaving it to the host GLSL
+ * compiler to work out which of those temporaries actually matter. Before
+ * emitting a clause we decode it into this form and decide that ourselves:
+ *
+ *  - results which are neither written to R nor read through PV / PS by the
+ *    next group are not emitted at all,
+ *  - results which are only written to R are assigned to it directly,
+ *  - reads of PV / PS are replaced by the register the previous group wrote
+ *    the same value to (copy propagation across groups),
+ *  - instructions whose inputs are all constant are folded to a constant,
+ *    which is in turn propagated through PV / PS.
+ *
+ * PV and PS do not survive past the end of an ALU clause, so the analysis
+ * never has to look further than the clause it is given.
+ */
+
+//! Where the value read through PV.xyzw / PS can be found.
+struct AluValue
+{
+   enum Type
+   {
+      //! Must be read from PV / PS
+      Unknown,
+
+      //! Same value as R[gpr].chan
+      Register,
+
+      //! Known constant, value holds the bits
+      Constant,
+   };
+
+   Type type = Unknown;
+   uint32_t gpr = 0;
+   latte::SQ_CHAN chan = latte::SQ_CHAN::X;
+   uint32_t value = 0;
+};
+
+struct AluUnitIR
+{
+   //! Instruction executed in this unit, nullptr if the unit is unused
+   const latte::AluInst *inst = nullptr;
+
+   //! Instruction has no side effects besides writing PV / PS and R
+   bool pure = false;
+
+   //! Instruction writes its result to R[gpr].chan
+   bool writesRegister = false;
+   uint32_t gpr = 0;
+   latte::SQ_CHAN chan = latte::SQ_CHAN::X;
+
+   //! Every input was constant, foldedValue holds the result bits
+   bool folded = false;
+   uint32_t foldedValue = 0;
+
+   //! Nothing reads the result so the instruction is not emitted
+   bool dead = false;
+
+   //! Result is assigned to R[gpr].chan directly instead of through PVo / PSo
+   bool directWrite = false;
+};
+
+struct AluGroupIR
+{
+   //! Indexed by unit, X / Y / Z / W / T
+   std::array<AluUnitIR, 5> units;
+
+   //! How to read PV.x / PV.y / PV.z / PV.w / PS in this group
+   std::array<AluValue, 5> previous;
+
+   //! Group contains a reduction instruction (DOT4, CUBE, ...)
+   bool isReduction = false;
+
+   //! Whether PV = PVo / PS = PSo must be emitted at the end of the group
+   bool updatePreviousVector = false;
+   bool updatePreviousScalar = false;
+};
+
+struct AluClauseIR
+{
+   std::vector<AluGroupIR> groups;
+};
+
+void
+buildAluClauseIR(AluClauseIR &ir,
+                 const latte::AluInst *clause,
+                 size_t count);
+
+} // namespace glsl2
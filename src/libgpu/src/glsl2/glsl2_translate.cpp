@@ -1,4 +1,5 @@
 #include "glsl2_translate.h"
+#include "glsl2_alu.h"
 #include "glsl2_cf.h"
 #include "latte/latte_constants.h"
 #include "latte/latte_decoders.h"
@@ -10,6 +11,7 @@
 #include <common/log.h>
 #include <fmt/format.h>
 #include <map>
+#include <mutex>
 
 using namespace latte;
 
@@ -251,6 +253,12 @@ translateControlFlowALU(State &state, const ControlFlowInst &cf)
    auto count = cf.alu.word1.COUNT() + 1;
    auto clause = reinterpret_cast<const AluInst *>(state.binary.data() + 8 * addr);
    auto didPushBefore = false;
+   auto clauseIR = AluClauseIR { };
+   auto groupIndex = 0u;
+
+   if (state.shader && state.shader->optimiseAlu) {
+      buildAluClauseIR(clauseIR, clause, count);
+   }
 
    insertLineStart(state);
    state.out.write("// {:02} ", state.cfPC);
@@ -273,6 +281,7 @@ translateControlFlowALU(State &state, const ControlFlowInst &cf)
       auto updatePreviousVector = false;
       auto updatePreviousScalar = false;
       state.literals = group.literals;
+      state.aluGroup = clauseIR.groups.empty() ? nullptr : &clauseIR.groups[groupIndex];
 
       for (auto j = 0u; j < group.instructions.size(); ++j) {
          auto &inst = group.instructions[j];
@@ -325,11 +334,18 @@ translateControlFlowALU(State &state, const ControlFlowInst &cf)
          latte::disassembler::disassembleAluInstruction(state.out, cf, inst, state.groupPC, state.unit, state.literals);
          insertLineEnd(state);
 
-         if (func) {
+         if (state.aluGroup && state.aluGroup->units[unit].folded) {
+            insertFoldedWrite(state, state.aluGroup->units[unit]);
+         } else if (func && !(state.aluGroup && state.aluGroup->units[unit].dead)) {
             func(state, cf, inst);
          }
       }
 
+      if (state.aluGroup) {
+         updatePreviousVector = state.aluGroup->updatePreviousVector;
+         updatePreviousScalar = state.aluGroup->updatePreviousScalar;
+      }
+
       insertLineStart(state);
       state.out.write("// {:02} --", state.groupPC);
       insertLineEnd(state);
@@ -355,10 +371,12 @@ translateControlFlowALU(State &state, const ControlFlowInst &cf)
 
       slot = group.getNextSlot(slot);
       state.groupPC++;
+      groupIndex++;
 
       state.out << '\n';
    }
 
+   state.aluGroup = nullptr;
    condEnd(state);
 
    switch (id) {
@@ -407,21 +425,19 @@ translateControlFlowALU(State &state, const ControlFlowInst &cf)
 static void
 initialise()
 {
-   static bool didRegister = false;
-
-   if (didRegister) {
-      return;
-   }
-
-   didRegister = true;
-   registerCfFunctions();
-   registerExpFunctions();
-   registerTexFunctions();
-   registerVtxFunctions();
-   registerOP2Functions();
-   registerOP3Functions();
-   registerOP2ReductionFunctions();
-   registerOP3ReductionFunctions();
+   // Shaders may be translated from several threads at once
+   static std::once_flag didRegister;
+
+   std::call_once(didRegister, [] {
+      registerCfFunctions();
+      registerExpFunctions();
+      registerTexFunctions();
+      registerVtxFunctions();
+      registerOP2Functions();
+      registerOP3Functions();
+      registerOP2ReductionFunctions();
+      registerOP3ReductionFunctions();
+   });
 }
 
 void
@@ -547,10 +563,16 @@ insertFileHeader(State &state)
 
    if (state.shader->uniformRegistersEnabled) {
       if (state.shader->type == Shader::PixelShader) {
-         out << "uniform vec4 PR[256];\n";
+         out << "layout (std140, binding = " << opengl::PixelRegisterBinding << ") uniform PixelRegisters {\n"
+             << "   vec4 PR[256];\n"
+             << "};\n";
       } else if (state.shader->type == Shader::VertexShader) {
-         out << "uniform vec4 VR[256];\n";
+         out << "layout (std140, binding = " << opengl::VertexRegisterBinding << ") uniform VertexRegisters {\n"
+             << "   vec4 VR[256];\n"
+             << "};\n";
       } else if (state.shader->type == Shader::GeometryShader) {
+         // The GL driver has no geometry stage to upload these for, so they
+         //  are not given a uniform block binding.
          out << "uniform vec4 GR[256];\n";
       }
    }
@@ -715,6 +737,20 @@ insertCodeHeader(State &state)
 
 bool
 translate(Shader &shader, const gsl::span<const uint8_t> &binary)
+{
+   auto error = std::string { };
+
+   if (!translate(shader, binary, error)) {
+      auto assembly = disassemble(binary);
+      gLog->critical("GLSL translate exception: {}\nDisassembly:\n{}", error, assembly);
+      decaf_abort(fmt::format("GLSL translate exception: {}", error));
+   }
+
+   return true;
+}
+
+bool
+translate(Shader &shader, const gsl::span<const uint8_t> &binary, std::string &error)
 {
    State state;
    state.binary = binary;
@@ -753,12 +789,15 @@ translate(Shader &shader, const gsl::span<const uint8_t> &binary)
          state.cfPC++;
       }
    } catch (const translate_exception &e) {
-      auto assembly = disassemble(binary);
-      gLog->critical("GLSL translate exception: {}\nDisassembly:\n{}", e.what(), assembly);
-      decaf_abort(fmt::format("GLSL translate exception: {}", e.what()));
+      error = e.what();
+      return false;
+   }
+
+   if (state.loopStack.size() != 0) {
+      error = "Unterminated loop at end of shader";
+      return false;
    }
 
-   decaf_check(state.loopStack.size() == 0);
    insertFileHeader(state);
    insertCodeHeader(state);
 
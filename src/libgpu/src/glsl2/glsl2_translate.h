@@ -1,4 +1,5 @@
 #pragma once
+#include "glsl2_ir.h"
 #include "latte/latte_constants.h"
 #include "latte/latte_instructions.h"
 
@@ -62,6 +63,7 @@ struct Shader
    std::array<latte::SQ_TEX_DIM, 16> samplerDim;
    bool uniformRegistersEnabled = false;
    bool uniformBlocksEnabled = false;
+   bool optimiseAlu = true;
 
    // Output (maybe)
    std::string fileHeader;
@@ -92,6 +94,7 @@ struct State
    std::string indent;
    latte::SQ_CHAN unit;
    gsl::span<const uint32_t> literals;
+   const AluGroupIR *aluGroup = nullptr;
    std::vector<std::string> postGroupWrites;
    std::stack<LoopState> loopStack;
    bool printMyCode = false;
@@ -100,6 +103,10 @@ struct State
 bool
 translate(Shader &shader, const gsl::span<const uint8_t> &binary);
 
+//! Same as above, but returns the error rather than aborting on failure
+bool
+translate(Shader &shader, const gsl::span<const uint8_t> &binary, std::string &error);
+
 using TranslateFuncCF = void(*)(State &state, const latte::ControlFlowInst &cf);
 using TranslateFuncEXP = void(*)(State &state, const latte::ControlFlowInst &cf);
 using TranslateFuncALU = void(*)(State &state, const latte::ControlFlowInst &cf, const latte::AluInst &inst);
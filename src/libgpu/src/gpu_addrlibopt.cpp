@@ -1072,6 +1072,58 @@ copySurfacePixels(uint8_t *dstBasePtr,
    }
 }
 
+// Runtime version of the constants used by AddrComputeSurfaceAddrFromCoord
+//  for a single sample surface
+bool
+getTiledSurfaceParams(TiledSurfaceParams &params,
+                      AddrTileMode tileMode,
+                      uint32_t pitch,
+                      uint32_t bpp)
+{
+   if (tileMode > ADDR_TM_3B_TILED_THICK) {
+      return false;
+   }
+
+   params.tiling = static_cast<uint32_t>(TileModeTiling[tileMode]);
+   params.thickness = TileModeThickness[tileMode];
+   params.rotation = TileModeRotation[tileMode];
+   params.macroTilePitch = 0;
+   params.macroTileHeight = 0;
+   params.bankSwapWidth = 0;
+
+   if (TileModeTiling[tileMode] != TilingMode::Macro) {
+      return true;
+   }
+
+   auto factor = TileModeAspectRatio[tileMode];
+   params.macroTilePitch = (8 * NumBanks) / factor;
+   params.macroTileHeight = (8 * NumPipes) * factor;
+
+   if (TileModeBankSwapped[tileMode]) {
+      // Same as ComputeSurfaceBankSwappedWidth with NumSamples = 1
+      auto bytesPerSample = 8 * bpp;
+      auto samplesPerTile = SplitSize / bytesPerSample;
+      auto numSamples = params.thickness > 1 ? 4u : 1u;
+      auto slicesPerTile = samplesPerTile ? std::max<uint32_t>(1u, 1u / samplesPerTile) : 1u;
+      auto bytesPerTileSlice = numSamples * bytesPerSample / slicesPerTile;
+
+      auto swapTiles = std::max<uint32_t>(1u, (SwapSize >> 1) / bpp);
+      auto swapWidth = swapTiles * 8 * NumBanks;
+      auto heightBytes = factor * NumPipes * bpp / slicesPerTile;
+      auto swapMax = NumPipes * NumBanks * RowSize / heightBytes;
+      auto swapMin = PipeInterleaveBytes * 8 * NumBanks / bytesPerTileSlice;
+      auto bankSwapWidth = std::min(swapMax, std::max(swapMin, swapWidth));
+
+      while (bankSwapWidth >= 2 * pitch) {
+         bankSwapWidth >>= 1;
+      }
+
+      params.bankSwapWidth = bankSwapWidth;
+   }
+
+   return true;
+}
+
 } // namespace addrlibopt
 
 } // namespace gpu
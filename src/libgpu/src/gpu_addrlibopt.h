@@ -1,4 +1,5 @@
 #pragma once
+#include "gpu_tiling.h"
 
 #include <addrlib/addrinterface.h>
 
@@ -21,6 +22,12 @@ copySurfacePixels(uint8_t *dstBasePtr,
                   bool isDepth,
                   uint32_t numSamples);
 
+bool
+getTiledSurfaceParams(TiledSurfaceParams &params,
+                      AddrTileMode tileMode,
+                      uint32_t pitch,
+                      uint32_t bpp);
+
 } // namespace addrlibopt
 
 } // namespace gpu
@@ -9,6 +9,8 @@ namespace config
 bool debug = false;
 std::vector<int64_t> debug_filters = { };
 bool dump_shaders = false;
+bool write_tracking = false;
+bool compute_untile = false;
 
 } // namespace config
 
@@ -19,11 +19,16 @@ sQueueCV;
 static std::queue<Item>
 sQueue;
 
+//! Words in every buffer in sQueue, protected by sQueueMutex
+static uint64_t
+sQueueWords = 0;
+
 static void
 appendItem(Item item)
 {
    std::unique_lock<std::mutex> lock { sQueueMutex };
    sQueue.push(item);
+   sQueueWords += item.numWords;
    sQueueCV.notify_all();
 }
 
@@ -50,6 +55,7 @@ dequeueItem()
 
    auto next = sQueue.front();
    sQueue.pop();
+   sQueueWords -= next.numWords;
    return next;
 }
 
@@ -64,6 +70,7 @@ waitForItem()
 
    auto next = sQueue.front();
    sQueue.pop();
+   sQueueWords -= next.numWords;
    return next;
 }
 
@@ -73,6 +80,20 @@ awaken()
    appendItem(Item { 0 });
 }
 
+uint32_t
+getPendingItems()
+{
+   std::unique_lock<std::mutex> lock { sQueueMutex };
+   return static_cast<uint32_t>(sQueue.size());
+}
+
+uint64_t
+getPendingWords()
+{
+   std::unique_lock<std::mutex> lock { sQueueMutex };
+   return sQueueWords;
+}
+
 } // namespace ringbuffer
 
 } // namespace gpu
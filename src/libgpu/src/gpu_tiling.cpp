@@ -210,4 +210,25 @@ convertFromTiled(
    return true;
 }
 
+bool
+getTiledSurfaceParams(TiledSurfaceParams &params,
+                      latte::SQ_TILE_MODE tileMode,
+                      uint32_t swizzle,
+                      uint32_t pitch,
+                      uint32_t bpp)
+{
+   if (!addrlibopt::getTiledSurfaceParams(params,
+                                          static_cast<AddrTileMode>(tileMode),
+                                          pitch,
+                                          bpp)) {
+      return false;
+   }
+
+   calcSurfaceBankPipeSwizzle(swizzle,
+      &params.bankSwizzle,
+      &params.pipeSwizzle);
+
+   return true;
+}
+
 } // namespace gpu
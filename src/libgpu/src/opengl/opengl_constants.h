@@ -6,4 +6,12 @@ namespace opengl
 extern unsigned
 MaxUniformBlockSize;
 
+// Uniform buffer bindings for the DX9 style uniform registers, these come
+//  after the 16 vertex and 16 pixel shader uniform blocks.
+static constexpr unsigned
+VertexRegisterBinding = 32;
+
+static constexpr unsigned
+PixelRegisterBinding = 33;
+
 } // namespace opengl
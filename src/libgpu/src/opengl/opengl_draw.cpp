@@ -2,6 +2,7 @@
 #include "opengl_driver.h"
 
 #include <common/decaf_assert.h>
+#include <cstring>
 #include <fmt/format.h>
 #include <glbinding/gl/gl.h>
 #include <glbinding/Meta.h>
@@ -11,6 +12,15 @@ namespace opengl
 
 bool GLDriver::checkReadyDraw()
 {
+   // Nothing checked below can change until a register is written or some
+   //  other packet is processed, both of which clear mDrawStateValid. The
+   //  stream buffer does move on with every draw though, so submitDrawBatch
+   //  clears it too, which makes checkActiveUniforms re-upload the uniform
+   //  registers before the ring can wrap over their last upload.
+   if (mDrawStateValid) {
+      return true;
+   }
+
    if (!checkActiveShader()) {
       gLog->warn("Skipping draw with invalid shader.");
       return false;
@@ -71,11 +81,16 @@ bool GLDriver::checkReadyDraw()
       mFramebufferChanged = false;
    }
 
+   checkState();
+
    if (!checkViewport()) {
       gLog->warn("Skipping draw with invalid viewport.");
       return false;
    }
 
+   // Feedback buffer offsets move with every draw so always recheck those
+   auto vgt_strmout_en = getRegister<latte::VGT_STRMOUT_EN>(latte::Register::VGT_STRMOUT_EN);
+   mDrawStateValid = !vgt_strmout_en.STREAMOUT();
    return true;
 }
 
@@ -104,55 +119,68 @@ getPrimitiveMode(latte::VGT_DI_PRIMITIVE_TYPE type)
    }
 }
 
-template<typename IndexType>
 static void
 drawPrimitives2(gl::GLenum mode,
                 uint32_t count,
-                const IndexType *indices,
+                gl::GLenum indexType,
+                const void *indices,
                 uint32_t baseVertex,
                 uint32_t numInstances,
                 uint32_t baseInstance)
 {
-   static_assert(std::is_same<IndexType, uint16_t>::value || std::is_same<IndexType, uint32_t>::value);
-
    if (numInstances == 1) {
-      if (!indices) {
+      if (indexType == gl::GL_NONE) {
          gl::glDrawArrays(mode, baseVertex, count);
-      } else if constexpr (std::is_same<IndexType, uint16_t>()) {
-         gl::glDrawElementsBaseVertex(mode, count, gl::GL_UNSIGNED_SHORT, indices, baseVertex);
-      } else if constexpr (std::is_same<IndexType, uint32_t>()) {
-         gl::glDrawElementsBaseVertex(mode, count, gl::GL_UNSIGNED_INT, indices, baseVertex);
+      } else {
+         gl::glDrawElementsBaseVertex(mode, count, indexType, indices, baseVertex);
       }
    } else {
-      if (!indices) {
+      if (indexType == gl::GL_NONE) {
          gl::glDrawArraysInstancedBaseInstance(mode, 0, count, numInstances, baseInstance);
-      } else if constexpr (std::is_same<IndexType, uint16_t>()) {
-         gl::glDrawElementsInstancedBaseInstance(mode, count, gl::GL_UNSIGNED_SHORT, indices, numInstances, baseInstance);
-      } else if constexpr (std::is_same<IndexType, uint32_t>()) {
-         gl::glDrawElementsInstancedBaseInstance(mode, count, gl::GL_UNSIGNED_INT, indices, numInstances, baseInstance);
+      } else {
+         gl::glDrawElementsInstancedBaseInstance(mode, count, indexType, indices, numInstances, baseInstance);
       }
    }
 }
 
-template<bool IsRects, typename IndexType>
 static void
-unpackQuadRectList(uint32_t count,
-               const IndexType *src,
-               uint32_t baseVertex,
-               uint32_t numInstances,
-               uint32_t baseInstance)
+drawCommand(gl::GLenum mode,
+            gl::GLenum indexType,
+            const DrawIndirectCommand &command)
+{
+   auto indexSize = (indexType == gl::GL_UNSIGNED_SHORT) ? 2u : 4u;
+   auto indices = reinterpret_cast<const void *>(static_cast<uintptr_t>(command.first * indexSize));
+   auto baseVertex = (indexType == gl::GL_NONE) ? command.first : static_cast<uint32_t>(command.baseVertex);
+
+   drawPrimitives2(mode,
+                   command.count,
+                   indexType,
+                   indices,
+                   baseVertex,
+                   command.instanceCount,
+                   command.baseInstance);
+}
+
+template<bool Swap, typename IndexType>
+static inline IndexType
+readIndex(const IndexType *src)
 {
-   auto tris = (count / 4) * 6;
-   auto unpacked = std::vector<IndexType>(tris);
-   auto dst = &unpacked[0];
+   return Swap ? byte_swap(*src) : *src;
+}
 
+template<bool IsRects, bool Swap, typename IndexType>
+static void
+unpackQuadRectList(uint32_t count,
+                   const IndexType *src,
+                   IndexType *dst)
+{
    // Unpack quad indices into triangle indices
    if (src) {
       for (auto i = 0u; i < count / 4; ++i) {
-         auto index_0 = *src++;
-         auto index_1 = *src++;
-         auto index_2 = *src++;
-         auto index_3 = *src++;
+         auto index_0 = readIndex<Swap>(src++);
+         auto index_1 = readIndex<Swap>(src++);
+         auto index_2 = readIndex<Swap>(src++);
+         auto index_3 = readIndex<Swap>(src++);
 
          *(dst++) = index_0;
          *(dst++) = index_1;
@@ -193,14 +221,48 @@ unpackQuadRectList(uint32_t count,
          }
       }
    }
+}
+
+template<bool Swap, typename IndexType>
+static void
+copyIndices(uint32_t count,
+            const IndexType *src,
+            IndexType *dst)
+{
+   if (!Swap) {
+      std::memcpy(dst, src, count * sizeof(IndexType));
+      return;
+   }
+
+   for (auto i = 0u; i < count; ++i) {
+      dst[i] = byte_swap(src[i]);
+   }
+}
+
+template<bool Swap, typename IndexType>
+static void
+writeIndices(latte::VGT_DI_PRIMITIVE_TYPE primType,
+             uint32_t count,
+             const void *indices,
+             void *dst)
+{
+   auto src = reinterpret_cast<const IndexType *>(indices);
+   auto out = reinterpret_cast<IndexType *>(dst);
 
-   drawPrimitives2(gl::GL_TRIANGLES, tris, unpacked.data(), baseVertex, numInstances, baseInstance);
+   if (primType == latte::VGT_DI_PRIMITIVE_TYPE::QUADLIST) {
+      unpackQuadRectList<false, Swap>(count, src, out);
+   } else if (primType == latte::VGT_DI_PRIMITIVE_TYPE::RECTLIST) {
+      unpackQuadRectList<true, Swap>(count, src, out);
+   } else {
+      copyIndices<Swap>(count, src, out);
+   }
 }
 
 void
 GLDriver::drawPrimitives(uint32_t count,
                          const void *indices,
-                         latte::VGT_INDEX_TYPE indexFmt)
+                         latte::VGT_INDEX_TYPE indexFmt,
+                         bool swapIndices)
 {
    auto vgt_primitive_type = getRegister<latte::VGT_PRIMITIVE_TYPE>(latte::Register::VGT_PRIMITIVE_TYPE);
    auto vgt_dma_num_instances = getRegister<latte::VGT_DMA_NUM_INSTANCES>(latte::Register::VGT_DMA_NUM_INSTANCES);
@@ -214,8 +276,13 @@ GLDriver::drawPrimitives(uint32_t count,
    auto baseInstance = sq_vtx_start_inst_loc.OFFSET();
 
    auto mode = getPrimitiveMode(primType);
+   auto streamPosition = mStreamBufferPosition;
 
    if (vgt_strmout_en.STREAMOUT()) {
+      // Transform feedback is paused and resumed around every draw, so these
+      //  are never batched.
+      submitDrawBatch();
+
       auto baseMode = mode;
 
       if (mode == gl::GL_TRIANGLE_STRIP || mode == gl::GL_TRIANGLE_FAN) {
@@ -235,31 +302,144 @@ GLDriver::drawPrimitives(uint32_t count,
       }
    }
 
-   if (primType == latte::VGT_DI_PRIMITIVE_TYPE::QUADLIST) {
-      if (indexFmt == latte::VGT_INDEX_TYPE::INDEX_16) {
-         unpackQuadRectList<false>(count, reinterpret_cast<const uint16_t*>(indices), baseVertex, numInstances, baseInstance);
-      } else if (indexFmt == latte::VGT_INDEX_TYPE::INDEX_32) {
-         unpackQuadRectList<false>(count, reinterpret_cast<const uint32_t*>(indices), baseVertex, numInstances, baseInstance);
-      }
-   } else if (primType == latte::VGT_DI_PRIMITIVE_TYPE::RECTLIST) {
-      if (indexFmt == latte::VGT_INDEX_TYPE::INDEX_16) {
-         unpackQuadRectList<true>(count, reinterpret_cast<const uint16_t*>(indices), baseVertex, numInstances, baseInstance);
-      } else if (indexFmt == latte::VGT_INDEX_TYPE::INDEX_32) {
-         unpackQuadRectList<true>(count, reinterpret_cast<const uint32_t*>(indices), baseVertex, numInstances, baseInstance);
-      }
+   auto isQuads = primType == latte::VGT_DI_PRIMITIVE_TYPE::QUADLIST
+               || primType == latte::VGT_DI_PRIMITIVE_TYPE::RECTLIST;
+   auto indexType = gl::GL_NONE;
+   auto command = DrawIndirectCommand { };
+   command.instanceCount = numInstances;
+
+   // Instanced draws use the base instance but not the base vertex
+   if (numInstances == 1) {
+      command.baseVertex = static_cast<int32_t>(baseVertex);
    } else {
-      if (indexFmt == latte::VGT_INDEX_TYPE::INDEX_16) {
-         drawPrimitives2(mode, count, reinterpret_cast<const uint16_t*>(indices), baseVertex, numInstances, baseInstance);
-      } else if (indexFmt == latte::VGT_INDEX_TYPE::INDEX_32) {
-         drawPrimitives2(mode, count, reinterpret_cast<const uint32_t*>(indices), baseVertex, numInstances, baseInstance);
+      command.baseInstance = baseInstance;
+   }
+
+   if (!indices && !isQuads) {
+      command.count = count;
+      command.first = command.baseVertex;
+      command.baseVertex = 0;
+   } else {
+      // Quads and rects are drawn as triangles, so even auto indexed draws
+      //  need an index buffer.  The indices are written straight into the
+      //  streaming buffer which is bound as every vertex array's element buffer.
+      auto is16Bit = (indexFmt == latte::VGT_INDEX_TYPE::INDEX_16);
+      auto indexSize = is16Bit ? 2u : 4u;
+      auto numIndices = isQuads ? (count / 4) * 6 : count;
+      auto stream = allocateStreamBuffer(numIndices * indexSize, indexSize);
+
+      if (is16Bit && swapIndices) {
+         writeIndices<true, uint16_t>(primType, count, indices, stream.data);
+      } else if (is16Bit) {
+         writeIndices<false, uint16_t>(primType, count, indices, stream.data);
+      } else if (swapIndices) {
+         writeIndices<true, uint32_t>(primType, count, indices, stream.data);
+      } else {
+         writeIndices<false, uint32_t>(primType, count, indices, stream.data);
       }
+
+      indexType = is16Bit ? gl::GL_UNSIGNED_SHORT : gl::GL_UNSIGNED_INT;
+      command.count = numIndices;
+      command.first = stream.offset / indexSize;
    }
 
+   mDraws++;
+
    if (vgt_strmout_en.STREAMOUT()) {
+      drawCommand(mode, indexType, command);
+
+      // Protect anything this draw streamed from being overwritten until the GPU is done
+      fenceStreamBuffer();
       gl::glPauseTransformFeedback();
+   } else {
+      queueDraw(mode, indexType, streamPosition, command);
    }
 }
 
+void
+GLDriver::queueDraw(gl::GLenum mode,
+                    gl::GLenum indexType,
+                    uint64_t streamPosition,
+                    const DrawIndirectCommand &command)
+{
+   auto &batch = mDrawBatch;
+
+   if (!batch.commands.empty()) {
+      if (batch.mode != mode
+       || batch.indexType != indexType
+       || batch.commands.size() >= MaxDrawBatchSize
+       || mStreamBufferPosition - batch.startPosition > MaxDrawBatchStreamSize) {
+         submitDrawBatch();
+      }
+   }
+
+   if (batch.commands.empty()) {
+      batch.mode = mode;
+      batch.indexType = indexType;
+      batch.startPosition = streamPosition;
+   }
+
+   batch.commands.push_back(command);
+}
+
+void
+GLDriver::submitDrawBatch()
+{
+   auto &batch = mDrawBatch;
+   auto numCommands = static_cast<uint32_t>(batch.commands.size());
+
+   if (numCommands == 0) {
+      return;
+   }
+
+   if (numCommands == 1) {
+      drawCommand(batch.mode, batch.indexType, batch.commands[0]);
+   } else if (batch.indexType == gl::GL_NONE) {
+      // DrawArraysIndirectCommand is the same minus the base vertex
+      auto stream = allocateStreamBuffer(numCommands * 4 * sizeof(uint32_t), 4);
+      auto dst = reinterpret_cast<uint32_t *>(stream.data);
+
+      for (auto &command : batch.commands) {
+         *(dst++) = command.count;
+         *(dst++) = command.instanceCount;
+         *(dst++) = command.first;
+         *(dst++) = command.baseInstance;
+      }
+
+      gl::glMultiDrawArraysIndirect(batch.mode,
+                                    reinterpret_cast<const void *>(static_cast<uintptr_t>(stream.offset)),
+                                    numCommands, 0);
+   } else {
+      auto size = static_cast<uint32_t>(numCommands * sizeof(DrawIndirectCommand));
+      auto stream = allocateStreamBuffer(size, 4);
+      std::memcpy(stream.data, batch.commands.data(), size);
+
+      gl::glMultiDrawElementsIndirect(batch.mode,
+                                      batch.indexType,
+                                      reinterpret_cast<const void *>(static_cast<uintptr_t>(stream.offset)),
+                                      numCommands, 0);
+   }
+
+   if (numCommands > 1) {
+      mMergedDraws += numCommands;
+      mDrawBatches++;
+   }
+
+   // Protect anything the batch streamed from being overwritten until the GPU is done
+   fenceStreamBuffer();
+   batch.commands.clear();
+
+   // The batch advanced the stream buffer, see checkReadyDraw
+   mDrawStateValid = false;
+}
+
+void
+GLDriver::flushDrawBatch()
+{
+   submitDrawBatch();
+   mDrawStateValid = false;
+}
+
 void
 GLDriver::drawPrimitivesIndexed(const void *buffer,
                                 uint32_t count)
@@ -271,42 +451,31 @@ GLDriver::drawPrimitivesIndexed(const void *buffer,
    auto vgt_dma_index_type = getRegister<latte::VGT_DMA_INDEX_TYPE>(latte::Register::VGT_DMA_INDEX_TYPE);
 
    // Swap and indexBytes are separate because you can have 32-bit swap,
-   //   but 16-bit indices in some cases...  This is also why we pre-swap
-   //   the data before intercepting QUAD and POLYGON draws.
+   //   but 16-bit indices in some cases...  The swap is performed whilst
+   //   copying the indices into the streaming buffer.
    if (vgt_dma_index_type.SWAP_MODE() == latte::VGT_DMA_SWAP::SWAP_16_BIT) {
-      auto *src = reinterpret_cast<const uint16_t *>(buffer);
-      auto indices = std::vector<uint16_t>(count);
-
       if (vgt_dma_index_type.INDEX_TYPE() != latte::VGT_INDEX_TYPE::INDEX_16) {
          decaf_abort(fmt::format("Unexpected INDEX_TYPE {} for VGT_DMA_SWAP_16_BIT", vgt_dma_index_type.INDEX_TYPE()));
       }
 
-      for (auto i = 0u; i < count; ++i) {
-         indices[i] = byte_swap(src[i]);
-      }
-
       drawPrimitives(count,
-                     indices.data(),
-                     vgt_dma_index_type.INDEX_TYPE());
+                     buffer,
+                     vgt_dma_index_type.INDEX_TYPE(),
+                     true);
    } else if (vgt_dma_index_type.SWAP_MODE() == latte::VGT_DMA_SWAP::SWAP_32_BIT) {
-      auto *src = reinterpret_cast<const uint32_t *>(buffer);
-      auto indices = std::vector<uint32_t>(count);
-
       if (vgt_dma_index_type.INDEX_TYPE() != latte::VGT_INDEX_TYPE::INDEX_32) {
          decaf_abort(fmt::format("Unexpected INDEX_TYPE {} for VGT_DMA_SWAP_32_BIT", vgt_dma_index_type.INDEX_TYPE()));
       }
 
-      for (auto i = 0u; i < count; ++i) {
-         indices[i] = byte_swap(src[i]);
-      }
-
       drawPrimitives(count,
-                     indices.data(),
-                     vgt_dma_index_type.INDEX_TYPE());
+                     buffer,
+                     vgt_dma_index_type.INDEX_TYPE(),
+                     true);
    } else if (vgt_dma_index_type.SWAP_MODE() == latte::VGT_DMA_SWAP::NONE) {
       drawPrimitives(count,
                      buffer,
-                     vgt_dma_index_type.INDEX_TYPE());
+                     vgt_dma_index_type.INDEX_TYPE(),
+                     false);
    } else {
       decaf_abort(fmt::format("Unimplemented vgt_dma_index_type.SWAP_MODE {}", vgt_dma_index_type.SWAP_MODE()));
    }
@@ -321,7 +490,8 @@ GLDriver::drawIndexAuto(const latte::pm4::DrawIndexAuto &data)
 
    drawPrimitives(data.count,
                   nullptr,
-                  latte::VGT_INDEX_TYPE::INDEX_32);
+                  latte::VGT_INDEX_TYPE::INDEX_32,
+                  false);
 }
 
 void
@@ -339,6 +509,8 @@ GLDriver::drawIndexImmd(const latte::pm4::DrawIndexImmd &data)
 void
 GLDriver::decafClearColor(const latte::pm4::DecafClearColor &data)
 {
+   flushDrawBatch();
+
    float colors[] = {
       data.red,
       data.green,
@@ -346,6 +518,9 @@ GLDriver::decafClearColor(const latte::pm4::DecafClearColor &data)
       data.alpha
    };
 
+   // Clears are affected by state such as rasterizer discard
+   checkState();
+
    // Find our colorbuffer to clear
    auto buffer = getColorBuffer(data.cb_color_base, data.cb_color_size, data.cb_color_info, true);
 
@@ -373,6 +548,8 @@ GLDriver::decafClearColor(const latte::pm4::DecafClearColor &data)
 void
 GLDriver::decafClearDepthStencil(const latte::pm4::DecafClearDepthStencil &data)
 {
+   flushDrawBatch();
+
    auto db_depth_clear = getRegister<latte::DB_DEPTH_CLEAR>(latte::Register::DB_DEPTH_CLEAR);
    auto db_stencil_clear = getRegister<latte::DB_STENCIL_CLEAR>(latte::Register::DB_STENCIL_CLEAR);
    auto dbFormat = data.db_depth_info.FORMAT();
@@ -380,6 +557,10 @@ GLDriver::decafClearDepthStencil(const latte::pm4::DecafClearDepthStencil &data)
                    || dbFormat == latte::DB_FORMAT::DEPTH_8_24_FLOAT
                    || dbFormat == latte::DB_FORMAT::DEPTH_X24_8_32_FLOAT);
 
+   // Clears are affected by state such as rasterizer discard, this also
+   //  makes sure the depth mask we restore below matches mGLStateCache
+   checkState();
+
    // Find our depthbuffer to clear
    auto buffer = getDepthBuffer(data.db_depth_base, data.db_depth_size, data.db_depth_info, true);
 
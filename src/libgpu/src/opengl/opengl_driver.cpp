@@ -8,6 +8,7 @@
 
 #include <common/decaf_assert.h>
 #include <common/log.h>
+#include <common/perftrace.h>
 #include <common/tga_encoder.h>
 #include <fmt/format.h>
 #include <fstream>
@@ -40,7 +41,10 @@ GLDriver::initGL()
    mActiveShader = nullptr;
    mDrawBuffers.fill(gl::GL_NONE);
    mGLStateCache.blendEnable.fill(false);
+   mGLStateCache.blendControl.fill(0xFFFFFFFF); // Force the first draw to set it
    mLastUniformUpdate.fill(0);
+   mLastVertexUniformUpdate = 0;
+   mLastPixelUniformUpdate = 0;
 
    // We always use the scissor test
    gl::glEnable(gl::GL_SCISSOR_TEST);
@@ -77,38 +81,46 @@ GLDriver::initGL()
    gl::GLint value;
    gl::glGetIntegerv(gl::GL_MAX_UNIFORM_BLOCK_SIZE, &value);
    MaxUniformBlockSize = value;
+
+   // Create the buffer which per-draw data is streamed through
+   initStreamBuffer();
+
+   if (gpu::config::compute_untile) {
+      mUntilerReady = mUntiler.initialise();
+
+      if (mUntilerReady) {
+         gl::glCreateBuffers(1, &mUntileTiledBuffer);
+         gl::glCreateBuffers(1, &mUntileLinearBuffer);
+
+         if (gpu::config::debug) {
+            gl::glObjectLabel(gl::GL_BUFFER, mUntileTiledBuffer, -1, "untile tiled");
+            gl::glObjectLabel(gl::GL_BUFFER, mUntileLinearBuffer, -1, "untile linear");
+         }
+      } else {
+         gLog->warn("Falling back to untiling surfaces on the CPU");
+      }
+   }
 }
 
 void
 GLDriver::decafSetBuffer(const latte::pm4::DecafSetBuffer &data)
 {
+   flushDrawBatch();
+
    auto chain = data.isTv ? &mTvScanBuffers : &mDrcScanBuffers;
 
    // Destroy any old chain
-   if (chain->object) {
-      gl::glDeleteTextures(1, &chain->object);
-      chain->object = 0;
+   if (chain->objects[0]) {
+      gl::glDeleteTextures(static_cast<gl::GLsizei>(chain->objects.size()), chain->objects.data());
+      chain->objects.fill(0);
    }
 
-   // NOTE: A SwapBufferChain is not really a chain as we rely on OpenGL
-   //  to provide the buffering for us.  This means we do not always match
-   //  the games buffering mode, but in practice this is probably meaningless.
+   // NOTE: We only keep as many buffers as we need to let the GPU work on
+   //  one frame while the previous is being displayed, we do not try to
+   //  match the games buffering mode, in practice this is probably meaningless.
 
    // Create the chain
-   gl::glCreateTextures(gl::GL_TEXTURE_2D, 1, &chain->object);
-   gl::glTextureParameteri(chain->object, gl::GL_TEXTURE_MAG_FILTER, static_cast<int>(gl::GL_NEAREST));
-   gl::glTextureParameteri(chain->object, gl::GL_TEXTURE_MIN_FILTER, static_cast<int>(gl::GL_NEAREST));
-   gl::glTextureParameteri(chain->object, gl::GL_TEXTURE_WRAP_S, static_cast<int>(gl::GL_CLAMP_TO_EDGE));
-   gl::glTextureParameteri(chain->object, gl::GL_TEXTURE_WRAP_T, static_cast<int>(gl::GL_CLAMP_TO_EDGE));
-   gl::glTextureStorage2D(chain->object, 1, gl::GL_RGBA8, data.width, data.height);
-
-   chain->width = data.width;
-   chain->height = data.height;
-
-   if (gpu::config::debug) {
-      const char *label = data.isTv ? "TV framebuffer" : "DRC framebuffer";
-      gl::glObjectLabel(gl::GL_TEXTURE, chain->object, -1, label);
-   }
+   gl::glCreateTextures(gl::GL_TEXTURE_2D, static_cast<gl::GLsizei>(chain->objects.size()), chain->objects.data());
 
    // Initialize the pixels to a more useful color
 #define rf_to_ru(x) (static_cast<uint32_t>(x * 256) & 0xFF)
@@ -121,8 +133,32 @@ GLDriver::decafSetBuffer(const latte::pm4::DecafSetBuffer &data)
       tmpClearBuf[i] = clearColor;
    }
 
-   gl::glTextureSubImage2D(chain->object, 0, 0, 0, data.width, data.height, gl::GL_RGBA, gl::GL_UNSIGNED_BYTE, tmpClearBuf);
+   for (auto object : chain->objects) {
+      gl::glTextureParameteri(object, gl::GL_TEXTURE_MAG_FILTER, static_cast<int>(gl::GL_NEAREST));
+      gl::glTextureParameteri(object, gl::GL_TEXTURE_MIN_FILTER, static_cast<int>(gl::GL_NEAREST));
+      gl::glTextureParameteri(object, gl::GL_TEXTURE_WRAP_S, static_cast<int>(gl::GL_CLAMP_TO_EDGE));
+      gl::glTextureParameteri(object, gl::GL_TEXTURE_WRAP_T, static_cast<int>(gl::GL_CLAMP_TO_EDGE));
+      gl::glTextureStorage2D(object, 1, gl::GL_RGBA8, data.width, data.height);
+
+      if (gpu::config::debug) {
+         const char *label = data.isTv ? "TV framebuffer" : "DRC framebuffer";
+         gl::glObjectLabel(gl::GL_TEXTURE, object, -1, label);
+      }
+
+      gl::glTextureSubImage2D(object, 0, 0, 0, data.width, data.height, gl::GL_RGBA, gl::GL_UNSIGNED_BYTE, tmpClearBuf);
+   }
+
    delete[] tmpClearBuf;
+
+   chain->width = data.width;
+   chain->height = data.height;
+   chain->index = 0;
+   chain->written = false;
+   chain->object = chain->objects[chain->index];
+
+   // Make sure the initial contents are visible before anyone displays them
+   gl::glFinish();
+   chain->presented = chain->object;
 }
 
 enum
@@ -134,6 +170,8 @@ enum
 void
 GLDriver::decafCopyColorToScan(const latte::pm4::DecafCopyColorToScan &data)
 {
+   flushDrawBatch();
+
    auto buffer = getColorBuffer(data.cb_color_base, data.cb_color_size, data.cb_color_info, false);
    ScanBufferChain *target = nullptr;
 
@@ -146,6 +184,7 @@ GLDriver::decafCopyColorToScan(const latte::pm4::DecafCopyColorToScan &data)
       return;
    }
 
+   beginScanBufferWrite(*target);
    gl::glNamedFramebufferTexture(mBlitFrameBuffers[0], gl::GL_COLOR_ATTACHMENT0, target->object, 0);
    gl::glNamedFramebufferTexture(mBlitFrameBuffers[1], gl::GL_COLOR_ATTACHMENT0, buffer->active->object, 0);
 
@@ -193,20 +232,34 @@ GLDriver::decafSwapBuffers(const latte::pm4::DecafSwapBuffers &data)
 {
    static const auto weight = 0.9;
 
+   flushDrawBatch();
+
    // We do not need to actually call swap as our driver does this
-   //  automatically with the vsync.  We do however need to make sure
-   //  that we've finished all our OpenGL commands before we continue,
-   //  otherwise, we may overwrite a buffer used on this frame.
-   gl::glFinish();
+   //  automatically with the vsync.  Rather than waiting for the GPU to
+   //  finish this frame we insert a fence and only display the frame, and
+   //  signal the flip, once that fence has completed.
+   auto tvBuffer = mTvScanBuffers.object;
+   auto drcBuffer = mDrcScanBuffers.object;
+
+   addFenceSync([=](){
+      mTvScanBuffers.presented = tvBuffer;
+      mDrcScanBuffers.presented = drcBuffer;
 
-   // TODO: We should have a render chain of 2 buffers so that we don't render stuff
-   //  until the game actually asked us to.
-   gpu::onFlip();
+      // TODO: We should have a render chain of 2 buffers so that we don't render stuff
+      //  until the game actually asked us to.
+      gpu::onFlip();
+
+      if (mSwapFunc) {
+         mSwapFunc(tvBuffer, drcBuffer);
+      }
+   });
 
    auto now = std::chrono::system_clock::now();
 
    if (mLastSwap.time_since_epoch().count()) {
       mAverageFrameTime = weight * mAverageFrameTime + (1.0 - weight) * (now - mLastSwap);
+      perftrace::counter("gpu", "frameTimeMs",
+                         std::chrono::duration<double, std::milli> { now - mLastSwap }.count());
    }
 
    mLastSwap = now;
@@ -223,11 +276,57 @@ GLDriver::decafSwapBuffers(const latte::pm4::DecafSwapBuffers &data)
       mFramesCaptured++;
    }
 
-   if (mSwapFunc) {
-      mSwapFunc(mTvScanBuffers.object, mDrcScanBuffers.object);
+   endScanBufferFrame(mTvScanBuffers);
+   endScanBufferFrame(mDrcScanBuffers);
+   updateGraphicsDebugInfo();
+}
+
+/**
+ * Moves a chain on to its next buffer before the first write of a frame.
+ *
+ * Each chain only rotates when the game writes to it, so a screen which is
+ * not flipped this frame keeps showing its last frame instead of an older
+ * buffer. Writes to a scan buffer always cover all of it, so the previous
+ * contents never need to be carried over.
+ */
+void
+GLDriver::beginScanBufferWrite(ScanBufferChain &chain)
+{
+   if (chain.written) {
+      return;
    }
 
-   updateGraphicsDebugInfo();
+   chain.written = true;
+   chain.index = (chain.index + 1) % NumScanBuffers;
+   chain.object = chain.objects[chain.index];
+
+   // The buffer we are about to write to is displayed until the frame which
+   //  wrote the buffer after it completes, so wait for that before we render
+   //  into it again.  This lets us queue at most one frame ahead of the GPU
+   //  rather than draining it every swap.
+   auto waitIndex = (chain.index + 1) % NumScanBuffers;
+
+   if (auto sync = chain.syncs[waitIndex]) {
+      gl::glClientWaitSync(sync, gl::GL_SYNC_FLUSH_COMMANDS_BIT, gl::GL_TIMEOUT_IGNORED);
+      gl::glDeleteSync(sync);
+      chain.syncs[waitIndex] = nullptr;
+      checkSyncObjects(0);
+   }
+}
+
+void
+GLDriver::endScanBufferFrame(ScanBufferChain &chain)
+{
+   if (!chain.written) {
+      return;
+   }
+
+   if (chain.syncs[chain.index]) {
+      gl::glDeleteSync(chain.syncs[chain.index]);
+   }
+
+   chain.syncs[chain.index] = gl::glFenceSync(gl::GL_SYNC_GPU_COMMANDS_COMPLETE, static_cast<gl::UnusedMask>(0));
+   chain.written = false;
 }
 
 void
@@ -252,15 +351,19 @@ GLDriver::decafDebugMarker(const latte::pm4::DecafDebugMarker &data)
 void
 GLDriver::decafOSScreenFlip(const latte::pm4::DecafOSScreenFlip &data)
 {
+   flushDrawBatch();
+
    auto texture = 0u;
    auto width = 0u;
    auto height = 0u;
 
    if (data.screen == 0) {
+      beginScanBufferWrite(mTvScanBuffers);
       texture = mTvScanBuffers.object;
       width = mTvScanBuffers.width;
       height = mTvScanBuffers.height;
    } else {
+      beginScanBufferWrite(mDrcScanBuffers);
       texture = mDrcScanBuffers.object;
       width = mDrcScanBuffers.width;
       height = mDrcScanBuffers.height;
@@ -300,6 +403,8 @@ getTextureTarget(latte::SQ_TEX_DIM dim)
 void
 GLDriver::decafCopySurface(const latte::pm4::DecafCopySurface &data)
 {
+   flushDrawBatch();
+
    decaf_check(data.dstPitch <= data.srcPitch);
    decaf_check(data.dstWidth == data.srcWidth);
    decaf_check(data.dstHeight == data.srcHeight);
@@ -366,6 +471,8 @@ GLDriver::decafCopySurface(const latte::pm4::DecafCopySurface &data)
 void
 GLDriver::surfaceSync(const latte::pm4::SurfaceSync &data)
 {
+   flushDrawBatch();
+
    auto memStart = data.addr << 8;
    auto memEnd = memStart + (data.size << 8);
 
@@ -394,50 +501,42 @@ GLDriver::surfaceSync(const latte::pm4::SurfaceSync &data)
       shaderExport = true;
    }
 
-   std::unique_lock<std::mutex> lock(mResourceMap.getMutex());
-
-   auto iter = mResourceMap.getIterator(memStart, memEnd - memStart);
-
-   Resource *resource;
-   while ((resource = iter.next()) != nullptr) {
+   mResourceMap.visitResources(memStart, memEnd - memStart, [&](Resource *resource) {
       switch (resource->type) {
 
       case Resource::SURFACE:
          if (surfaces) {
             auto surface = reinterpret_cast<SurfaceBuffer *>(resource);
-            surface->needUpload |= surface->dirtyMemory;
-            surface->dirtyMemory = false;
+            surface->needUpload |= surface->dirtyMemory.exchange(false);
          }
          break;
 
       case Resource::SHADER:
          if (shaders) {
             auto shader = reinterpret_cast<Shader *>(resource);
-            shader->needRebuild |= shader->dirtyMemory;
-            shader->dirtyMemory = false;
+            shader->needRebuild |= shader->dirtyMemory.exchange(false);
          }
          break;
 
       case Resource::DATA_BUFFER:
          if (shaders || surfaces) {
             auto buffer = reinterpret_cast<DataBuffer *>(resource);
-            if (buffer->isInput && buffer->dirtyMemory) {
+            if (buffer->isInput && buffer->dirtyMemory.exchange(false)) {
                auto offset = std::max(memStart, buffer->cpuMemStart) - buffer->cpuMemStart;
                auto size = (std::min(memEnd, buffer->cpuMemEnd) - buffer->cpuMemStart) - offset;
                uploadDataBuffer(buffer, offset, size);
-               buffer->dirtyMemory = false;
             }
          }
       }
-   }
+   });
 }
 
 void
 GLDriver::getSwapBuffers(gl::GLuint *tv,
                          gl::GLuint *drc)
 {
-   *tv = mTvScanBuffers.object;
-   *drc = mDrcScanBuffers.object;
+   *tv = mTvScanBuffers.presented;
+   *drc = mDrcScanBuffers.presented;
 }
 
 float
@@ -474,6 +573,21 @@ GLDriver::updateGraphicsDebugInfo()
    mDebuggerInfo.numShaderPipelines = mShaderPipelines.size();
    mDebuggerInfo.numSurfaces = mSurfaces.size();
    mDebuggerInfo.numDataBuffers = mDataBuffers.size();
+   mDebuggerInfo.numRegisterWrites = mRegisterWrites;
+   mDebuggerInfo.numRedundantRegisterWrites = mRedundantRegisterWrites;
+   mDebuggerInfo.numStateGroupApplies = mStateGroupApplies;
+   mDebuggerInfo.numRedundantStateGroupApplies = mRedundantStateGroupApplies;
+   mDebuggerInfo.numDraws = mDraws;
+   mDebuggerInfo.numMergedDraws = mMergedDraws;
+   mDebuggerInfo.numDrawBatches = mDrawBatches;
+
+   mRegisterWrites = 0;
+   mRedundantRegisterWrites = 0;
+   mStateGroupApplies = 0;
+   mRedundantStateGroupApplies = 0;
+   mDraws = 0;
+   mMergedDraws = 0;
+   mDrawBatches = 0;
 }
 
 uint64_t
@@ -505,6 +619,8 @@ swapValueForWrite(uint64_t value, latte::CB_ENDIAN swap)
 void
 GLDriver::memWrite(const latte::pm4::MemWrite &data)
 {
+   flushDrawBatch();
+
    auto value = uint64_t { 0 };
    auto addr = mem::translate(data.addrLo.ADDR_LO() << 2);
 
@@ -526,6 +642,8 @@ GLDriver::memWrite(const latte::pm4::MemWrite &data)
 void
 GLDriver::eventWrite(const latte::pm4::EventWrite &data)
 {
+   flushDrawBatch();
+
    auto type = data.eventInitiator.EVENT_TYPE();
    auto addr = data.addrLo.ADDR_LO() << 2;
    auto ptr = mem::translate(addr);
@@ -588,37 +706,38 @@ GLDriver::eventWrite(const latte::pm4::EventWrite &data)
 void
 GLDriver::eventWriteEOP(const latte::pm4::EventWriteEOP &data)
 {
+   flushDrawBatch();
+
    if (!data.eventInitiator.EVENT_TYPE()) {
       return;
    }
 
-   auto value = uint64_t { 0 };
    auto addr = data.addrLo.ADDR_LO() << 2;
    auto ptr = mem::translate(addr);
 
    decaf_assert(data.addrHi.ADDR_HI() == 0, "Invalid event write address (high word not zero)");
 
-   switch (data.eventInitiator.EVENT_TYPE()) {
-   case latte::VGT_EVENT_TYPE::BOTTOM_OF_PIPE_TS:
-      value = getGpuClock();
-      break;
-   default:
+   if (data.eventInitiator.EVENT_TYPE() != latte::VGT_EVENT_TYPE::BOTTOM_OF_PIPE_TS) {
       decaf_abort(fmt::format("Unexpected EOP event type {}", data.eventInitiator.EVENT_TYPE()));
    }
 
-   value = swapValueForWrite(value, data.addrLo.ENDIAN_SWAP());
+   // The event happens once everything before it has been executed, so
+   //  perform the write when a fence placed here completes.
+   addFenceSync([=](){
+      auto value = swapValueForWrite(getGpuClock(), data.addrLo.ENDIAN_SWAP());
 
-   switch (data.addrHi.DATA_SEL()) {
-   case latte::pm4::EWP_DATA_DISCARD:
-      break;
-   case latte::pm4::EWP_DATA_32:
-      *reinterpret_cast<uint32_t *>(ptr) = static_cast<uint32_t>(value);
-      break;
-   case latte::pm4::EWP_DATA_64:
-   case latte::pm4::EWP_DATA_CLOCK:
-      *reinterpret_cast<uint64_t *>(ptr) = value;
-      break;
-   }
+      switch (data.addrHi.DATA_SEL()) {
+      case latte::pm4::EWP_DATA_DISCARD:
+         break;
+      case latte::pm4::EWP_DATA_32:
+         *reinterpret_cast<uint32_t *>(ptr) = static_cast<uint32_t>(value);
+         break;
+      case latte::pm4::EWP_DATA_64:
+      case latte::pm4::EWP_DATA_CLOCK:
+         *reinterpret_cast<uint64_t *>(ptr) = value;
+         break;
+      }
+   });
 }
 
 void
@@ -636,6 +755,10 @@ GLDriver::executeBuffer(const gpu::ringbuffer::Item &item)
    // Execute command buffer
    runCommandBuffer(item.buffer, item.numWords);
 
+   // Guest memory may change before the next buffer so no draws can be
+   //  merged across buffers.
+   flushDrawBatch();
+
    // Release command buffer when it finishes executing
    addFenceSync([=](){
       gpu::onRetire(item.context);
@@ -713,6 +836,11 @@ GLDriver::checkSyncObjects(gl::GLuint64 timeout)
    for (auto i = mSyncList.begin(); i != mSyncList.end(); ) {
       if (i->isComplete) {
          i->func();
+
+         if (i->type == SyncObject::FENCE) {
+            gl::glDeleteSync(i->sync);
+         }
+
          i = mSyncList.erase(i);
       } else {
          ++i;
@@ -750,49 +878,31 @@ void
 GLDriver::notifyCpuFlush(void *ptr,
                          uint32_t size)
 {
-   std::unique_lock<std::mutex> lock(mResourceMap.getMutex());
-
-   auto iter = mResourceMap.getIterator(mem::untranslate(ptr), size);
-
-   Resource *resource;
-   while ((resource = iter.next()) != nullptr) {
+   mResourceMap.visitResources(mem::untranslate(ptr), size, [](Resource *resource) {
       resource->dirtyMemory = true;
-   }
+   });
 }
 
 void
 GLDriver::notifyGpuFlush(void *ptr,
                          uint32_t size)
 {
-   std::unique_lock<std::mutex> lock(mOutputBufferMap.getMutex());
-
    auto memStart = mem::untranslate(ptr);
    auto memEnd = memStart + size;
-   auto iter = mOutputBufferMap.getIterator(memStart, size);
-
-   // This allows us to avoid downloading a buffer twice if we hit both its
-   //  endpoints in the scan (as will happen if memStart/memEnd coincide
-   //  with a buffer's range).
-   auto flushStamp = ++mGpuFlushCounter;
 
-   Resource *resource;
-   while ((resource = iter.next()) != nullptr) {
+   mOutputBufferMap.visitResources(memStart, size, [&](Resource *resource) {
       decaf_check(resource->type == Resource::DATA_BUFFER);
       DataBuffer *buffer = reinterpret_cast<DataBuffer *>(resource);
 
-      if (buffer->lastGpuFlush != flushStamp) {
-         buffer->lastGpuFlush = flushStamp;
+      auto copyOffset = std::max(memStart, buffer->cpuMemStart) - buffer->cpuMemStart;
+      auto copySize = (std::min(memEnd, buffer->cpuMemEnd) - buffer->cpuMemStart) - copyOffset;
 
-         auto copyOffset = std::max(memStart, buffer->cpuMemStart) - buffer->cpuMemStart;
-         auto copySize = (std::min(memEnd, buffer->cpuMemEnd) - buffer->cpuMemStart) - copyOffset;
+      runOnGLThread([=](){
+         downloadDataBuffer(buffer, copyOffset, copySize);
+      });
 
-         runOnGLThread([=](){
-            downloadDataBuffer(buffer, copyOffset, copySize);
-         });
-
-         buffer->dirtyMemory = false;
-      }
-   }
+      buffer->dirtyMemory = false;
+   });
 }
 
 void
@@ -826,6 +936,7 @@ GLDriver::run()
 
    mRunState = RunState::Running;
    initGL();
+   perftrace::setThreadName("GPU");
 
    while (mRunState == RunState::Running) {
       auto item = gpu::ringbuffer::Item { };
@@ -8,8 +8,11 @@
 #include "latte/latte_contextstate.h"
 #include "latte/latte_pm4_commands.h"
 #include "opengl_resource.h"
+#include "opengl_untile.h"
 #include "pm4_processor.h"
 
+#include <array>
+#include <atomic>
 #include <chrono>
 #include <common/log.h>
 #include <common/platform.h>
@@ -78,14 +81,12 @@ struct FetchShader : public Shader
 struct VertexShader : public Shader
 {
    gl::GLuint object = 0;
-   gl::GLuint uniformRegisters = 0;
    gl::GLuint uniformViewport = 0;
    bool isScreenSpace = false;
    std::array<gl::GLuint, latte::MaxAttributes> attribLocations;
    std::array<uint8_t, 256> outputMap;
    std::array<bool, 16> usedUniformBlocks;
    std::array<bool, 4> usedFeedbackBuffers;
-   uint32_t lastUniformUpdate = 0;
    std::string code;
    std::string disassembly;
 };
@@ -93,12 +94,10 @@ struct VertexShader : public Shader
 struct PixelShader : public Shader
 {
    gl::GLuint object = 0;
-   gl::GLuint uniformRegisters = 0;
    gl::GLuint uniformAlphaRef = 0;
    latte::SX_ALPHA_TEST_CONTROL sx_alpha_test_control;
    std::array<glsl2::SamplerUsage, latte::MaxSamplers> samplerUsage;
    std::array<bool, 16> usedUniformBlocks;
-   uint32_t lastUniformUpdate = 0;
    std::string code;
    std::string disassembly;
 };
@@ -148,9 +147,29 @@ struct SurfaceBuffer : public Resource
    SurfaceBuffer() : Resource(Resource::SURFACE) { }
 };
 
+// Number of frames which can be in flight, one is being rendered, one is
+//  waiting for the GPU to finish it and one is being displayed.
+static constexpr size_t NumScanBuffers = 3;
+
 struct ScanBufferChain
 {
+   //! The buffer which the frame currently being rendered is copied to.
    gl::GLuint object = 0;
+
+   //! The most recent buffer which the GPU has finished rendering.
+   std::atomic<gl::GLuint> presented { 0 };
+
+   std::array<gl::GLuint, NumScanBuffers> objects = { };
+
+   //! Index into objects of object.
+   size_t index = 0;
+
+   //! Fences for the frames which wrote each buffer.
+   std::array<gl::GLsync, NumScanBuffers> syncs = { };
+
+   //! Whether object has been written since the last swap.
+   bool written = false;
+
    uint32_t width;
    uint32_t height;
 };
@@ -163,7 +182,6 @@ struct DataBuffer : public Resource
    bool isInput = false;  // Uniform or attribute buffers
    bool isOutput = false;  // Transform feedback buffers
    bool dirtyMap = false;  // True if we need to glFlushMappedBufferRange
-   uint32_t lastGpuFlush = 0;  // Last time we touched this buffer in notifyGpuFlush()
 
    DataBuffer() : Resource(Resource::DATA_BUFFER) { }
 };
@@ -228,9 +246,25 @@ struct SamplerCache
    sfixed_1_5_6_t lodBias;
 };
 
+namespace GLStateGroup
+{
+enum Value : uint32_t
+{
+   BlendControl = 1 << 0,
+   BlendEnable = 1 << 1,
+   BlendColor = 1 << 2,
+   DepthStencil = 1 << 3,
+   Cull = 1 << 4,
+   Clip = 1 << 5,
+   PrimRestart = 1 << 6,
+};
+} // namespace GLStateGroup
+
 struct GLStateCache
 {
    std::array<bool, latte::MaxRenderTargets> blendEnable;
+   std::array<uint32_t, latte::MaxRenderTargets> blendControl;
+   std::array<uint32_t, 4> blendColor = { };
 
    bool cullFaceEnable = false;
    gl::GLenum cullFace = gl::GL_BACK;
@@ -288,6 +322,56 @@ struct SyncObject
    }
 };
 
+// The streaming buffer is split into segments which are each protected by
+//  a fence, so we only ever have to wait for the GPU when we wrap around
+//  into a segment which it may still be reading from.
+static constexpr uint32_t StreamBufferSize = 32 * 1024 * 1024;
+static constexpr uint32_t StreamBufferSegments = 8;
+static constexpr uint32_t StreamBufferSegmentSize = StreamBufferSize / StreamBufferSegments;
+
+struct StreamAllocation
+{
+   //! Where to write the data, this is write-combined memory so never read from it.
+   uint8_t *data = nullptr;
+
+   //! Offset of the allocation in the streaming buffer.
+   uint32_t offset = 0;
+
+   //! Position of the allocation in the stream, which unlike offset does not wrap.
+   uint64_t position = 0;
+};
+
+// Consecutive draws with no packets in between share all of their state, so
+//  they are queued up and submitted together with a single multi draw call.
+static constexpr uint32_t MaxDrawBatchSize = 1024;
+
+// Stream buffer data used by a batch is only fenced once it is submitted, so
+//  a batch must not grow anywhere near a full lap of the stream buffer.
+static constexpr uint32_t MaxDrawBatchStreamSize = StreamBufferSize / 16;
+
+//! Parameters of a queued draw, laid out as DrawElementsIndirectCommand.
+struct DrawIndirectCommand
+{
+   uint32_t count;
+   uint32_t instanceCount;
+   uint32_t first;
+   int32_t baseVertex;
+   uint32_t baseInstance;
+};
+
+struct DrawBatch
+{
+   gl::GLenum mode = gl::GL_NONE;
+
+   //! Index type of every draw in the batch, GL_NONE for non-indexed draws
+   gl::GLenum indexType = gl::GL_NONE;
+
+   //! mStreamBufferPosition before the first draw streamed its indices
+   uint64_t startPosition = 0;
+
+   std::vector<DrawIndirectCommand> commands;
+};
+
 using GLContext = uint64_t;
 
 class GLDriver : public gpu::OpenGLDriver, public Pm4Processor
@@ -382,6 +466,19 @@ private:
                  bool isDepthBuffer,
                  latte::SQ_TILE_MODE tileMode);
 
+   bool
+   untileSurfaceOnGpu(const void *tiled,
+                      uint32_t linearPitch,
+                      latte::SQ_TILE_MODE tileMode,
+                      uint32_t swizzle,
+                      uint32_t pitch,
+                      uint32_t width,
+                      uint32_t height,
+                      uint32_t depth,
+                      bool isDepth,
+                      uint32_t bpp,
+                      uint32_t linearSize);
+
    SurfaceBuffer *
    getSurfaceBuffer(ppcaddr_t baseAddress,
                     uint32_t pitch,
@@ -428,8 +525,17 @@ private:
    bool checkActiveTextures();
    bool checkActiveUniforms();
    bool checkAttribBuffersBound();
+   void checkState();
    bool checkViewport();
 
+   bool applyBlendControl();
+   bool applyBlendEnable();
+   bool applyBlendColor();
+   bool applyDepthStencil();
+   bool applyCull();
+   bool applyClip();
+   bool applyPrimRestart();
+
    DataBuffer *
    getDataBuffer(uint32_t address,
                  uint32_t size,
@@ -484,6 +590,25 @@ private:
    void
    checkSyncObjects(gl::GLuint64 timeout);
 
+   void
+   initStreamBuffer();
+
+   StreamAllocation
+   allocateStreamBuffer(uint32_t size,
+                        uint32_t alignment);
+
+   void
+   fenceStreamBuffer();
+
+   bool
+   isStreamAllocationValid(uint64_t position);
+
+   void
+   uploadUniformRegisters(latte::Register firstReg,
+                          gl::GLuint binding,
+                          uint32_t &lastUniformUpdate,
+                          uint64_t &lastUploadPosition);
+
    void
    runOnGLThread(std::function<void()> func);
 
@@ -493,16 +618,35 @@ private:
    void
    drawPrimitives(uint32_t count,
                   const void *indices,
-                  latte::VGT_INDEX_TYPE indexFmt);
+                  latte::VGT_INDEX_TYPE indexFmt,
+                  bool swapIndices);
 
    void
    drawPrimitivesIndexed(const void *indices,
                          uint32_t count);
 
+   void
+   queueDraw(gl::GLenum mode,
+             gl::GLenum indexType,
+             uint64_t streamPosition,
+             const DrawIndirectCommand &command);
+
+   void
+   submitDrawBatch();
+
+   void
+   flushDrawBatch();
+
    bool
    dumpScanBuffer(const std::string &filename,
                   const ScanBufferChain &buf);
 
+   void
+   beginScanBufferWrite(ScanBufferChain &chain);
+
+   void
+   endScanBufferFrame(ScanBufferChain &chain);
+
    void
    updateGraphicsDebugInfo();
 
@@ -523,6 +667,27 @@ private:
    bool mDepthRangeDirty = false;
    bool mScissorDirty = false;
 
+   // GLStateGroup bits for state which must be applied before the next draw
+   uint32_t mDirtyState = 0;
+   uint32_t mDirtyBlendTargets = 0;
+
+   // Number of state groups applied, and how many of them turned out to
+   //  match mGLStateCache, since the last swap
+   uint64_t mStateGroupApplies = 0;
+   uint64_t mRedundantStateGroupApplies = 0;
+
+   //! Set once checkReadyDraw has passed, cleared by flushDrawBatch whenever
+   //!  a register changes or any other packet is processed, and by
+   //!  submitDrawBatch as every batch moves the stream buffer on.
+   bool mDrawStateValid = false;
+   DrawBatch mDrawBatch;
+
+   // Number of draws, and how many of them were merged into a multi draw
+   //  call along with how many of those calls we made, since the last swap
+   uint64_t mDraws = 0;
+   uint64_t mMergedDraws = 0;
+   uint64_t mDrawBatches = 0;
+
    std::unordered_map<uint64_t, FetchShader *> mFetchShaders;
    std::unordered_map<uint64_t, VertexShader *> mVertexShaders;
    std::unordered_map<uint64_t, PixelShader *> mPixelShaders;
@@ -532,7 +697,6 @@ private:
 
    ResourceMemoryMap mResourceMap;
    ResourceMemoryMap mOutputBufferMap;
-   uint32_t mGpuFlushCounter = 0;
 
    std::array<Sampler, latte::MaxSamplers> mVertexSamplers;
    std::array<Sampler, latte::MaxSamplers> mPixelSamplers;
@@ -568,6 +732,31 @@ private:
    // Used to detect changes to uniform registers; see countModifiedUniforms()
    uint32_t mUniformUpdateGen = 0;
    std::array<uint32_t, (2 * latte::MaxUniformRegisters) / 16> mLastUniformUpdate;
+   uint32_t mLastVertexUniformUpdate = 0;
+   uint32_t mLastPixelUniformUpdate = 0;
+   uint64_t mVertexUniformPosition = 0;
+   uint64_t mPixelUniformPosition = 0;
+
+   //! Persistently mapped buffer which all per-draw data is streamed through.
+   gl::GLuint mStreamBuffer = 0;
+   uint8_t *mStreamBufferMap = nullptr;
+   uint64_t mStreamBufferPosition = 0;
+   uint32_t mStreamBufferSegment = 0;
+   uint32_t mUniformBufferAlignment = 256;
+
+   //! Fences for each segment of mStreamBuffer, set once we have moved on from it.
+   std::array<gl::GLsync, StreamBufferSegments> mStreamBufferSyncs = { };
+
+   //! Segments which we have moved on from but have not yet fenced.
+   std::vector<uint32_t> mStreamBufferUnfenced;
+
+   //! Untiles surfaces on the GPU when gpu::config::compute_untile is set.
+   ComputeUntiler mUntiler;
+   bool mUntilerReady = false;
+   gl::GLuint mUntileTiledBuffer = 0;
+   gl::GLuint mUntileLinearBuffer = 0;
+   uint32_t mUntileTiledBufferSize = 0;
+   uint32_t mUntileLinearBufferSize = 0;
 
    using duration_system_clock = std::chrono::duration<double, std::chrono::system_clock::period>;
    using duration_ms = std::chrono::duration<double, std::chrono::milliseconds::period>;
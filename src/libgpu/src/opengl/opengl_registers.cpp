@@ -23,7 +23,8 @@ getStencilFunc(latte::DB_STENCIL_FUNC func);
 void
 GLDriver::applyRegister(latte::Register reg)
 {
-   auto value = getRegister<uint32_t>(reg);
+   // Draws queued so far must see the state from before this write
+   flushDrawBatch();
 
    // Handle optimization with uniform update generation tracking
    if (reg >= latte::Register::AluConstRegisterBase &&
@@ -34,7 +35,8 @@ GLDriver::applyRegister(latte::Register reg)
       return;
    }
 
-   // Handle setting OpenGL state for anything else
+   // Anything else which affects OpenGL state is only marked dirty here,
+   //  the state is applied once by checkState when we next draw.
    switch (reg) {
    case latte::Register::CB_BLEND0_CONTROL:
    case latte::Register::CB_BLEND1_CONTROL:
@@ -46,7 +48,125 @@ GLDriver::applyRegister(latte::Register reg)
    case latte::Register::CB_BLEND7_CONTROL:
    {
       auto target = (reg - latte::Register::CB_BLEND0_CONTROL) / 4;
-      auto cb_blend_control = latte::CB_BLENDN_CONTROL::get(value);
+      mDirtyBlendTargets |= 1 << target;
+      mDirtyState |= GLStateGroup::BlendControl;
+   } break;
+
+   case latte::Register::CB_COLOR_CONTROL:
+      mDirtyState |= GLStateGroup::BlendEnable;
+      break;
+
+   case latte::Register::CB_BLEND_RED:
+   case latte::Register::CB_BLEND_GREEN:
+   case latte::Register::CB_BLEND_BLUE:
+   case latte::Register::CB_BLEND_ALPHA:
+      mDirtyState |= GLStateGroup::BlendColor;
+      break;
+
+   case latte::Register::DB_DEPTH_CONTROL:
+   case latte::Register::DB_STENCILREFMASK:
+   case latte::Register::DB_STENCILREFMASK_BF:
+      mDirtyState |= GLStateGroup::DepthStencil;
+      break;
+
+   case latte::Register::PA_CL_VPORT_XSCALE_0:
+   case latte::Register::PA_CL_VPORT_XOFFSET_0:
+   case latte::Register::PA_CL_VPORT_YSCALE_0:
+   case latte::Register::PA_CL_VPORT_YOFFSET_0:
+      mViewportDirty = true;
+      break;
+
+   case latte::Register::PA_CL_VPORT_ZSCALE_0:
+   case latte::Register::PA_CL_VPORT_ZOFFSET_0:
+   case latte::Register::PA_SC_VPORT_ZMIN_0:
+   case latte::Register::PA_SC_VPORT_ZMAX_0:
+      mDepthRangeDirty = true;
+      break;
+
+   case latte::Register::PA_SC_GENERIC_SCISSOR_TL:
+   case latte::Register::PA_SC_GENERIC_SCISSOR_BR:
+      mScissorDirty = true;
+      break;
+
+   case latte::Register::PA_SU_SC_MODE_CNTL:
+      mDirtyState |= GLStateGroup::Cull;
+      break;
+
+   case latte::Register::PA_CL_CLIP_CNTL:
+      mDirtyState |= GLStateGroup::Clip;
+      break;
+
+   case latte::Register::VGT_MULTI_PRIM_IB_RESET_EN:
+   case latte::Register::VGT_MULTI_PRIM_IB_RESET_INDX:
+      mDirtyState |= GLStateGroup::PrimRestart;
+      break;
+   }
+}
+
+void
+GLDriver::checkState()
+{
+   auto dirty = mDirtyState;
+   mDirtyState = 0;
+
+   auto countApply =
+      [this](bool changed) {
+         mStateGroupApplies++;
+
+         if (!changed) {
+            mRedundantStateGroupApplies++;
+         }
+      };
+
+   if (dirty & GLStateGroup::BlendControl) {
+      countApply(applyBlendControl());
+   }
+
+   if (dirty & GLStateGroup::BlendEnable) {
+      countApply(applyBlendEnable());
+   }
+
+   if (dirty & GLStateGroup::BlendColor) {
+      countApply(applyBlendColor());
+   }
+
+   if (dirty & GLStateGroup::DepthStencil) {
+      countApply(applyDepthStencil());
+   }
+
+   if (dirty & GLStateGroup::Cull) {
+      countApply(applyCull());
+   }
+
+   if (dirty & GLStateGroup::Clip) {
+      countApply(applyClip());
+   }
+
+   if (dirty & GLStateGroup::PrimRestart) {
+      countApply(applyPrimRestart());
+   }
+}
+
+bool
+GLDriver::applyBlendControl()
+{
+   auto changed = false;
+
+   for (auto target = 0u; target < latte::MaxRenderTargets; ++target) {
+      if (!(mDirtyBlendTargets & (1 << target))) {
+         continue;
+      }
+
+      auto reg = static_cast<latte::Register>(latte::Register::CB_BLEND0_CONTROL + target * 4);
+      auto cb_blend_control = getRegister<latte::CB_BLENDN_CONTROL>(reg);
+
+      if (mGLStateCache.blendControl[target] == cb_blend_control.value) {
+         continue;
+      }
+
+      mGLStateCache.blendControl[target] = cb_blend_control.value;
+      changed = true;
+
       auto dstRGB = getBlendFunc(cb_blend_control.COLOR_DESTBLEND());
       auto srcRGB = getBlendFunc(cb_blend_control.COLOR_SRCBLEND());
       auto modeRGB = getBlendEquation(cb_blend_control.COLOR_COMB_FCN());
@@ -61,273 +181,295 @@ GLDriver::applyRegister(latte::Register reg)
          gl::glBlendFuncSeparatei(target, srcRGB, dstRGB, srcAlpha, dstAlpha);
          gl::glBlendEquationSeparatei(target, modeRGB, modeAlpha);
       }
-   } break;
-
-   case latte::Register::CB_COLOR_CONTROL:
-   {
-      auto cb_color_control = latte::CB_COLOR_CONTROL::get(value);
-
-      for (auto i = 0u; i < 8; ++i) {
-         auto enable = !!(cb_color_control.TARGET_BLEND_ENABLE() & (1 << i));
-         if (enable != mGLStateCache.blendEnable[i]) {
-            mGLStateCache.blendEnable[i] = enable;
-            if (enable) {
-               gl::glEnablei(gl::GL_BLEND, i);
-            } else {
-               gl::glDisablei(gl::GL_BLEND, i);
-            }
-         }
-      }
-   } break;
-
-   case latte::Register::DB_STENCILREFMASK_BF:
-   {
-      auto db_depth_control = getRegister<latte::DB_DEPTH_CONTROL>(latte::Register::DB_DEPTH_CONTROL);
+   }
 
-      if (db_depth_control.BACKFACE_ENABLE()) {
-         auto db_stencilrefmask_bf = latte::DB_STENCILREFMASK_BF::get(value);
-         auto backStencilRef = db_stencilrefmask_bf.STENCILREF_BF();
-         auto backStencilMask = db_stencilrefmask_bf.STENCILMASK_BF();
+   mDirtyBlendTargets = 0;
+   return changed;
+}
 
-         if (mGLStateCache.backStencilRef != backStencilRef
-          || mGLStateCache.backStencilMask != backStencilMask) {
-            mGLStateCache.backStencilRef = backStencilRef;
-            mGLStateCache.backStencilMask = backStencilMask;
+bool
+GLDriver::applyBlendEnable()
+{
+   auto cb_color_control = getRegister<latte::CB_COLOR_CONTROL>(latte::Register::CB_COLOR_CONTROL);
+   auto changed = false;
 
-            auto backStencilFunc = getRefFunc(db_depth_control.STENCILFUNC_BF());
+   for (auto i = 0u; i < 8; ++i) {
+      auto enable = !!(cb_color_control.TARGET_BLEND_ENABLE() & (1 << i));
+      if (enable != mGLStateCache.blendEnable[i]) {
+         mGLStateCache.blendEnable[i] = enable;
+         changed = true;
 
-            gl::glStencilFuncSeparate(gl::GL_BACK, backStencilFunc, backStencilRef, backStencilMask);
+         if (enable) {
+            gl::glEnablei(gl::GL_BLEND, i);
+         } else {
+            gl::glDisablei(gl::GL_BLEND, i);
          }
       }
-   } break;
+   }
 
-   case latte::Register::DB_STENCILREFMASK:
-   {
-      auto db_stencilrefmask = latte::DB_STENCILREFMASK::get(value);
-      auto frontStencilRef = db_stencilrefmask.STENCILREF();
-      auto frontStencilMask = db_stencilrefmask.STENCILMASK();
+   return changed;
+}
 
-      if (mGLStateCache.frontStencilRef != frontStencilRef
-       || mGLStateCache.frontStencilMask != frontStencilMask) {
-         mGLStateCache.frontStencilRef = frontStencilRef;
-         mGLStateCache.frontStencilMask = frontStencilMask;
+bool
+GLDriver::applyBlendColor()
+{
+   auto blendColor = std::array<uint32_t, 4> {
+      getRegister<uint32_t>(latte::Register::CB_BLEND_RED),
+      getRegister<uint32_t>(latte::Register::CB_BLEND_GREEN),
+      getRegister<uint32_t>(latte::Register::CB_BLEND_BLUE),
+      getRegister<uint32_t>(latte::Register::CB_BLEND_ALPHA),
+   };
+
+   if (mGLStateCache.blendColor == blendColor) {
+      return false;
+   }
 
-         auto db_depth_control = getRegister<latte::DB_DEPTH_CONTROL>(latte::Register::DB_DEPTH_CONTROL);
-         auto frontStencilFunc = getRefFunc(db_depth_control.STENCILFUNC());
+   mGLStateCache.blendColor = blendColor;
 
-         if (!db_depth_control.BACKFACE_ENABLE()) {
-            gl::glStencilFuncSeparate(gl::GL_FRONT_AND_BACK, frontStencilFunc, frontStencilRef, frontStencilMask);
-         } else {
-            gl::glStencilFuncSeparate(gl::GL_FRONT, frontStencilFunc, frontStencilRef, frontStencilMask);
-         }
-      }
-   } break;
+   auto cb_blend_red = getRegister<latte::CB_BLEND_RED>(latte::Register::CB_BLEND_RED);
+   auto cb_blend_green = getRegister<latte::CB_BLEND_GREEN>(latte::Register::CB_BLEND_GREEN);
+   auto cb_blend_blue = getRegister<latte::CB_BLEND_BLUE>(latte::Register::CB_BLEND_BLUE);
+   auto cb_blend_alpha = getRegister<latte::CB_BLEND_ALPHA>(latte::Register::CB_BLEND_ALPHA);
 
-   case latte::Register::DB_DEPTH_CONTROL:
-   {
-      auto db_depth_control = latte::DB_DEPTH_CONTROL::get(value);
+   gl::glBlendColor(cb_blend_red.BLEND_RED(),
+                    cb_blend_green.BLEND_GREEN(),
+                    cb_blend_blue.BLEND_BLUE(),
+                    cb_blend_alpha.BLEND_ALPHA());
+   return true;
+}
 
-      if (mGLStateCache.depthEnable != db_depth_control.Z_ENABLE()) {
-         mGLStateCache.depthEnable = db_depth_control.Z_ENABLE();
-         if (db_depth_control.Z_ENABLE()) {
-            gl::glEnable(gl::GL_DEPTH_TEST);
-         } else {
-            gl::glDisable(gl::GL_DEPTH_TEST);
-         }
-      }
+bool
+GLDriver::applyDepthStencil()
+{
+   auto db_depth_control = getRegister<latte::DB_DEPTH_CONTROL>(latte::Register::DB_DEPTH_CONTROL);
+   auto changed = false;
 
-      if (mGLStateCache.depthWrite != db_depth_control.Z_WRITE_ENABLE()) {
-         mGLStateCache.depthWrite = db_depth_control.Z_WRITE_ENABLE();
-         if (db_depth_control.Z_WRITE_ENABLE()) {
-            gl::glDepthMask(gl::GL_TRUE);
-         } else {
-            gl::glDepthMask(gl::GL_FALSE);
-         }
-      }
+   if (mGLStateCache.depthEnable != db_depth_control.Z_ENABLE()) {
+      mGLStateCache.depthEnable = db_depth_control.Z_ENABLE();
+      changed = true;
 
-      auto zfunc = getRefFunc(db_depth_control.ZFUNC());
-      if (mGLStateCache.depthFunc != zfunc) {
-         mGLStateCache.depthFunc = zfunc;
-         gl::glDepthFunc(zfunc);
+      if (db_depth_control.Z_ENABLE()) {
+         gl::glEnable(gl::GL_DEPTH_TEST);
+      } else {
+         gl::glDisable(gl::GL_DEPTH_TEST);
       }
+   }
 
-      if (mGLStateCache.stencilEnable != db_depth_control.STENCIL_ENABLE()) {
-         mGLStateCache.stencilEnable = db_depth_control.STENCIL_ENABLE();
-         if (db_depth_control.STENCIL_ENABLE()) {
-            gl::glEnable(gl::GL_STENCIL_TEST);
-         } else {
-            gl::glDisable(gl::GL_STENCIL_TEST);
-         }
+   if (mGLStateCache.depthWrite != db_depth_control.Z_WRITE_ENABLE()) {
+      mGLStateCache.depthWrite = db_depth_control.Z_WRITE_ENABLE();
+      changed = true;
+
+      if (db_depth_control.Z_WRITE_ENABLE()) {
+         gl::glDepthMask(gl::GL_TRUE);
+      } else {
+         gl::glDepthMask(gl::GL_FALSE);
       }
+   }
 
-      // Rather than doing 9 separate loads, conversions, and comparisons,
-      //  we just mask off the stencil backface and operation bits and
-      //  compare them as a unit to save time when the state is unchanged.
-      auto stencilState = db_depth_control.value & 0xFFFFFF80u;
-      if (mGLStateCache.stencilState != stencilState) {
-         mGLStateCache.stencilState = stencilState;
-
-         auto frontStencilFunc = getRefFunc(db_depth_control.STENCILFUNC());
-         auto frontStencilZPass = getStencilFunc(db_depth_control.STENCILZPASS());
-         auto frontStencilZFail = getStencilFunc(db_depth_control.STENCILZFAIL());
-         auto frontStencilFail = getStencilFunc(db_depth_control.STENCILFAIL());
-         auto db_stencilrefmask = getRegister<latte::DB_STENCILREFMASK>(latte::Register::DB_STENCILREFMASK);
-
-         if (db_depth_control.BACKFACE_ENABLE()) {
-            auto backStencilFunc = getRefFunc(db_depth_control.STENCILFUNC_BF());
-            auto backStencilZPass = getStencilFunc(db_depth_control.STENCILZPASS_BF());
-            auto backStencilZFail = getStencilFunc(db_depth_control.STENCILZFAIL_BF());
-            auto backStencilFail = getStencilFunc(db_depth_control.STENCILFAIL_BF());
-            auto db_stencilrefmask_bf = getRegister<latte::DB_STENCILREFMASK_BF>(latte::Register::DB_STENCILREFMASK_BF);
-
-            gl::glStencilFuncSeparate(gl::GL_FRONT, frontStencilFunc, db_stencilrefmask_bf.STENCILREF_BF(), db_stencilrefmask_bf.STENCILMASK_BF());
-            gl::glStencilOpSeparate(gl::GL_FRONT, frontStencilFail, frontStencilZFail, frontStencilZPass);
-
-            gl::glStencilFuncSeparate(gl::GL_BACK, backStencilFunc, db_stencilrefmask_bf.STENCILREF_BF(), db_stencilrefmask_bf.STENCILMASK_BF());
-            gl::glStencilOpSeparate(gl::GL_BACK, backStencilFail, backStencilZFail, backStencilZPass);
-         } else {
-            gl::glStencilFuncSeparate(gl::GL_FRONT_AND_BACK, frontStencilFunc, db_stencilrefmask.STENCILREF(), db_stencilrefmask.STENCILMASK());
-            gl::glStencilOpSeparate(gl::GL_FRONT_AND_BACK, frontStencilFail, frontStencilZFail, frontStencilZPass);
-         }
+   auto zfunc = getRefFunc(db_depth_control.ZFUNC());
+   if (mGLStateCache.depthFunc != zfunc) {
+      mGLStateCache.depthFunc = zfunc;
+      changed = true;
+      gl::glDepthFunc(zfunc);
+   }
+
+   if (mGLStateCache.stencilEnable != db_depth_control.STENCIL_ENABLE()) {
+      mGLStateCache.stencilEnable = db_depth_control.STENCIL_ENABLE();
+      changed = true;
+
+      if (db_depth_control.STENCIL_ENABLE()) {
+         gl::glEnable(gl::GL_STENCIL_TEST);
+      } else {
+         gl::glDisable(gl::GL_STENCIL_TEST);
       }
-   } break;
+   }
 
-   case latte::Register::CB_BLEND_RED:
-   case latte::Register::CB_BLEND_GREEN:
-   case latte::Register::CB_BLEND_BLUE:
-   case latte::Register::CB_BLEND_ALPHA:
-   {
-      auto cb_blend_red = getRegister<latte::CB_BLEND_RED>(latte::Register::CB_BLEND_RED);
-      auto cb_blend_green = getRegister<latte::CB_BLEND_GREEN>(latte::Register::CB_BLEND_GREEN);
-      auto cb_blend_blue = getRegister<latte::CB_BLEND_BLUE>(latte::Register::CB_BLEND_BLUE);
-      auto cb_blend_alpha = getRegister<latte::CB_BLEND_ALPHA>(latte::Register::CB_BLEND_ALPHA);
-
-      gl::glBlendColor(cb_blend_red.BLEND_RED(),
-                       cb_blend_green.BLEND_GREEN(),
-                       cb_blend_blue.BLEND_BLUE(),
-                       cb_blend_alpha.BLEND_ALPHA());
-   } break;
+   // Rather than doing 9 separate loads, conversions, and comparisons,
+   //  we just mask off the stencil backface and operation bits and
+   //  compare them as a unit to save time when the state is unchanged.
+   auto stencilState = db_depth_control.value & 0xFFFFFF80u;
+   if (mGLStateCache.stencilState != stencilState) {
+      mGLStateCache.stencilState = stencilState;
+      changed = true;
 
-   case latte::Register::PA_CL_VPORT_XSCALE_0:
-   case latte::Register::PA_CL_VPORT_XOFFSET_0:
-   case latte::Register::PA_CL_VPORT_YSCALE_0:
-   case latte::Register::PA_CL_VPORT_YOFFSET_0:
-      mViewportDirty = true;
-      break;
+      auto frontStencilFunc = getRefFunc(db_depth_control.STENCILFUNC());
+      auto frontStencilZPass = getStencilFunc(db_depth_control.STENCILZPASS());
+      auto frontStencilZFail = getStencilFunc(db_depth_control.STENCILZFAIL());
+      auto frontStencilFail = getStencilFunc(db_depth_control.STENCILFAIL());
+      auto db_stencilrefmask = getRegister<latte::DB_STENCILREFMASK>(latte::Register::DB_STENCILREFMASK);
 
-   case latte::Register::PA_CL_VPORT_ZSCALE_0:
-   case latte::Register::PA_CL_VPORT_ZOFFSET_0:
-   case latte::Register::PA_SC_VPORT_ZMIN_0:
-   case latte::Register::PA_SC_VPORT_ZMAX_0:
-      mDepthRangeDirty = true;
-      break;
+      if (db_depth_control.BACKFACE_ENABLE()) {
+         auto backStencilFunc = getRefFunc(db_depth_control.STENCILFUNC_BF());
+         auto backStencilZPass = getStencilFunc(db_depth_control.STENCILZPASS_BF());
+         auto backStencilZFail = getStencilFunc(db_depth_control.STENCILZFAIL_BF());
+         auto backStencilFail = getStencilFunc(db_depth_control.STENCILFAIL_BF());
+         auto db_stencilrefmask_bf = getRegister<latte::DB_STENCILREFMASK_BF>(latte::Register::DB_STENCILREFMASK_BF);
 
-   case latte::Register::PA_SC_GENERIC_SCISSOR_TL:
-   case latte::Register::PA_SC_GENERIC_SCISSOR_BR:
-      mScissorDirty = true;
-      break;
+         gl::glStencilFuncSeparate(gl::GL_FRONT, frontStencilFunc, db_stencilrefmask_bf.STENCILREF_BF(), db_stencilrefmask_bf.STENCILMASK_BF());
+         gl::glStencilOpSeparate(gl::GL_FRONT, frontStencilFail, frontStencilZFail, frontStencilZPass);
 
-   case latte::Register::PA_SU_SC_MODE_CNTL:
-   {
-      auto pa_su_sc_mode_cntl = latte::PA_SU_SC_MODE_CNTL::get(value);
-      auto cullFace = gl::GL_NONE;
-
-      if (pa_su_sc_mode_cntl.CULL_FRONT() && pa_su_sc_mode_cntl.CULL_BACK()) {
-         cullFace = gl::GL_FRONT_AND_BACK;
-      } else if (pa_su_sc_mode_cntl.CULL_FRONT()) {
-         cullFace = gl::GL_FRONT;
-      } else if (pa_su_sc_mode_cntl.CULL_BACK()) {
-         cullFace = gl::GL_BACK;
+         gl::glStencilFuncSeparate(gl::GL_BACK, backStencilFunc, db_stencilrefmask_bf.STENCILREF_BF(), db_stencilrefmask_bf.STENCILMASK_BF());
+         gl::glStencilOpSeparate(gl::GL_BACK, backStencilFail, backStencilZFail, backStencilZPass);
+      } else {
+         gl::glStencilFuncSeparate(gl::GL_FRONT_AND_BACK, frontStencilFunc, db_stencilrefmask.STENCILREF(), db_stencilrefmask.STENCILMASK());
+         gl::glStencilOpSeparate(gl::GL_FRONT_AND_BACK, frontStencilFail, frontStencilZFail, frontStencilZPass);
       }
+   }
 
-      auto cullFaceEnable = (cullFace != gl::GL_NONE);
+   auto db_stencilrefmask = getRegister<latte::DB_STENCILREFMASK>(latte::Register::DB_STENCILREFMASK);
+   auto frontStencilRef = db_stencilrefmask.STENCILREF();
+   auto frontStencilMask = db_stencilrefmask.STENCILMASK();
 
-      if (mGLStateCache.cullFaceEnable != cullFaceEnable) {
-         mGLStateCache.cullFaceEnable = cullFaceEnable;
+   if (mGLStateCache.frontStencilRef != frontStencilRef
+    || mGLStateCache.frontStencilMask != frontStencilMask) {
+      mGLStateCache.frontStencilRef = frontStencilRef;
+      mGLStateCache.frontStencilMask = frontStencilMask;
+      changed = true;
 
-         if (cullFaceEnable) {
-            gl::glEnable(gl::GL_CULL_FACE);
-         } else {
-            gl::glDisable(gl::GL_CULL_FACE);
-         }
-      }
+      auto frontStencilFunc = getRefFunc(db_depth_control.STENCILFUNC());
 
-      if (cullFaceEnable && mGLStateCache.cullFace != cullFace) {
-         mGLStateCache.cullFace = cullFace;
-         gl::glCullFace(cullFace);
+      if (!db_depth_control.BACKFACE_ENABLE()) {
+         gl::glStencilFuncSeparate(gl::GL_FRONT_AND_BACK, frontStencilFunc, frontStencilRef, frontStencilMask);
+      } else {
+         gl::glStencilFuncSeparate(gl::GL_FRONT, frontStencilFunc, frontStencilRef, frontStencilMask);
       }
+   }
 
-      auto frontFace = (pa_su_sc_mode_cntl.FACE() == latte::PA_FACE::CW ? gl::GL_CW : gl::GL_CCW);
+   if (db_depth_control.BACKFACE_ENABLE()) {
+      auto db_stencilrefmask_bf = getRegister<latte::DB_STENCILREFMASK_BF>(latte::Register::DB_STENCILREFMASK_BF);
+      auto backStencilRef = db_stencilrefmask_bf.STENCILREF_BF();
+      auto backStencilMask = db_stencilrefmask_bf.STENCILMASK_BF();
 
-      if (mGLStateCache.frontFace != frontFace) {
-         mGLStateCache.frontFace = frontFace;
-         gl::glFrontFace(frontFace);
-      }
-   } break;
+      if (mGLStateCache.backStencilRef != backStencilRef
+       || mGLStateCache.backStencilMask != backStencilMask) {
+         mGLStateCache.backStencilRef = backStencilRef;
+         mGLStateCache.backStencilMask = backStencilMask;
+         changed = true;
 
-   case latte::Register::PA_CL_CLIP_CNTL:
-   {
-      auto pa_cl_clip_cntl = latte::PA_CL_CLIP_CNTL::get(value);
+         auto backStencilFunc = getRefFunc(db_depth_control.STENCILFUNC_BF());
 
-      if (mGLStateCache.rasterizerDiscard != pa_cl_clip_cntl.RASTERISER_DISABLE()) {
-         mGLStateCache.rasterizerDiscard = pa_cl_clip_cntl.RASTERISER_DISABLE();
-         if (pa_cl_clip_cntl.RASTERISER_DISABLE()) {
-            gl::glEnable(gl::GL_RASTERIZER_DISCARD);
-         } else {
-            gl::glDisable(gl::GL_RASTERIZER_DISCARD);
-         }
+         gl::glStencilFuncSeparate(gl::GL_BACK, backStencilFunc, backStencilRef, backStencilMask);
       }
+   }
 
-      decaf_assert(pa_cl_clip_cntl.ZCLIP_NEAR_DISABLE() == pa_cl_clip_cntl.ZCLIP_FAR_DISABLE(),
-                   fmt::format("Inconsistent near/far depth clamp setting"));
+   return changed;
+}
+
+bool
+GLDriver::applyCull()
+{
+   auto pa_su_sc_mode_cntl = getRegister<latte::PA_SU_SC_MODE_CNTL>(latte::Register::PA_SU_SC_MODE_CNTL);
+   auto cullFace = gl::GL_NONE;
+   auto changed = false;
+
+   if (pa_su_sc_mode_cntl.CULL_FRONT() && pa_su_sc_mode_cntl.CULL_BACK()) {
+      cullFace = gl::GL_FRONT_AND_BACK;
+   } else if (pa_su_sc_mode_cntl.CULL_FRONT()) {
+      cullFace = gl::GL_FRONT;
+   } else if (pa_su_sc_mode_cntl.CULL_BACK()) {
+      cullFace = gl::GL_BACK;
+   }
 
-      if (mGLStateCache.depthClamp != !pa_cl_clip_cntl.ZCLIP_NEAR_DISABLE()) {
-         mGLStateCache.depthClamp = !pa_cl_clip_cntl.ZCLIP_NEAR_DISABLE();
+   auto cullFaceEnable = (cullFace != gl::GL_NONE);
 
-         if (pa_cl_clip_cntl.ZCLIP_NEAR_DISABLE()) {
-            gl::glEnable(gl::GL_DEPTH_CLAMP);
-         } else {
-            gl::glDisable(gl::GL_DEPTH_CLAMP);
-         }
+   if (mGLStateCache.cullFaceEnable != cullFaceEnable) {
+      mGLStateCache.cullFaceEnable = cullFaceEnable;
+      changed = true;
+
+      if (cullFaceEnable) {
+         gl::glEnable(gl::GL_CULL_FACE);
+      } else {
+         gl::glDisable(gl::GL_CULL_FACE);
       }
+   }
 
-      if (mGLStateCache.halfZClipSpace != pa_cl_clip_cntl.DX_CLIP_SPACE_DEF()) {
-         mGLStateCache.halfZClipSpace = pa_cl_clip_cntl.DX_CLIP_SPACE_DEF();
+   if (cullFaceEnable && mGLStateCache.cullFace != cullFace) {
+      mGLStateCache.cullFace = cullFace;
+      changed = true;
+      gl::glCullFace(cullFace);
+   }
 
-         if (pa_cl_clip_cntl.DX_CLIP_SPACE_DEF()) {
-            gl::glClipControl(gl::GL_UPPER_LEFT, gl::GL_ZERO_TO_ONE);
-         } else {
-            gl::glClipControl(gl::GL_UPPER_LEFT, gl::GL_NEGATIVE_ONE_TO_ONE);
-         }
+   auto frontFace = (pa_su_sc_mode_cntl.FACE() == latte::PA_FACE::CW ? gl::GL_CW : gl::GL_CCW);
+
+   if (mGLStateCache.frontFace != frontFace) {
+      mGLStateCache.frontFace = frontFace;
+      changed = true;
+      gl::glFrontFace(frontFace);
+   }
+
+   return changed;
+}
+
+bool
+GLDriver::applyClip()
+{
+   auto pa_cl_clip_cntl = getRegister<latte::PA_CL_CLIP_CNTL>(latte::Register::PA_CL_CLIP_CNTL);
+   auto changed = false;
+
+   if (mGLStateCache.rasterizerDiscard != pa_cl_clip_cntl.RASTERISER_DISABLE()) {
+      mGLStateCache.rasterizerDiscard = pa_cl_clip_cntl.RASTERISER_DISABLE();
+      changed = true;
+
+      if (pa_cl_clip_cntl.RASTERISER_DISABLE()) {
+         gl::glEnable(gl::GL_RASTERIZER_DISCARD);
+      } else {
+         gl::glDisable(gl::GL_RASTERIZER_DISCARD);
       }
-   } break;
+   }
 
-   case latte::Register::VGT_MULTI_PRIM_IB_RESET_EN:
-   {
-      auto vgt_multi_prim_ib_reset_en = *reinterpret_cast<latte::VGT_MULTI_PRIM_IB_RESET_EN*>(&value);
+   decaf_assert(pa_cl_clip_cntl.ZCLIP_NEAR_DISABLE() == pa_cl_clip_cntl.ZCLIP_FAR_DISABLE(),
+                fmt::format("Inconsistent near/far depth clamp setting"));
 
-      if (mGLStateCache.primRestartEnable != vgt_multi_prim_ib_reset_en.RESET_EN()) {
-         mGLStateCache.primRestartEnable = vgt_multi_prim_ib_reset_en.RESET_EN();
+   if (mGLStateCache.depthClamp != !pa_cl_clip_cntl.ZCLIP_NEAR_DISABLE()) {
+      mGLStateCache.depthClamp = !pa_cl_clip_cntl.ZCLIP_NEAR_DISABLE();
+      changed = true;
 
-         if (vgt_multi_prim_ib_reset_en.RESET_EN()) {
-            gl::glEnable(gl::GL_PRIMITIVE_RESTART);
-         } else {
-            gl::glDisable(gl::GL_PRIMITIVE_RESTART);
-         }
+      if (pa_cl_clip_cntl.ZCLIP_NEAR_DISABLE()) {
+         gl::glEnable(gl::GL_DEPTH_CLAMP);
+      } else {
+         gl::glDisable(gl::GL_DEPTH_CLAMP);
       }
-   } break;
+   }
 
-   case latte::Register::VGT_MULTI_PRIM_IB_RESET_INDX:
-   {
-      auto vgt_multi_prim_ib_reset_indx = *reinterpret_cast<latte::VGT_MULTI_PRIM_IB_RESET_INDX*>(&value);
+   if (mGLStateCache.halfZClipSpace != pa_cl_clip_cntl.DX_CLIP_SPACE_DEF()) {
+      mGLStateCache.halfZClipSpace = pa_cl_clip_cntl.DX_CLIP_SPACE_DEF();
+      changed = true;
 
-      if (mGLStateCache.primRestartIndex != vgt_multi_prim_ib_reset_indx.RESET_INDX()) {
-         mGLStateCache.primRestartIndex = vgt_multi_prim_ib_reset_indx.RESET_INDX();
-         gl::glPrimitiveRestartIndex(vgt_multi_prim_ib_reset_indx.RESET_INDX());
+      if (pa_cl_clip_cntl.DX_CLIP_SPACE_DEF()) {
+         gl::glClipControl(gl::GL_UPPER_LEFT, gl::GL_ZERO_TO_ONE);
+      } else {
+         gl::glClipControl(gl::GL_UPPER_LEFT, gl::GL_NEGATIVE_ONE_TO_ONE);
       }
-   } break;
+   }
+
+   return changed;
+}
+
+bool
+GLDriver::applyPrimRestart()
+{
+   auto vgt_multi_prim_ib_reset_en = getRegister<latte::VGT_MULTI_PRIM_IB_RESET_EN>(latte::Register::VGT_MULTI_PRIM_IB_RESET_EN);
+   auto vgt_multi_prim_ib_reset_indx = getRegister<latte::VGT_MULTI_PRIM_IB_RESET_INDX>(latte::Register::VGT_MULTI_PRIM_IB_RESET_INDX);
+   auto changed = false;
 
+   if (mGLStateCache.primRestartEnable != vgt_multi_prim_ib_reset_en.RESET_EN()) {
+      mGLStateCache.primRestartEnable = vgt_multi_prim_ib_reset_en.RESET_EN();
+      changed = true;
+
+      if (vgt_multi_prim_ib_reset_en.RESET_EN()) {
+         gl::glEnable(gl::GL_PRIMITIVE_RESTART);
+      } else {
+         gl::glDisable(gl::GL_PRIMITIVE_RESTART);
+      }
    }
+
+   if (mGLStateCache.primRestartIndex != vgt_multi_prim_ib_reset_indx.RESET_INDX()) {
+      mGLStateCache.primRestartIndex = vgt_multi_prim_ib_reset_indx.RESET_INDX();
+      changed = true;
+      gl::glPrimitiveRestartIndex(vgt_multi_prim_ib_reset_indx.RESET_INDX());
+   }
+
+   return changed;
 }
 
 gl::GLenum
@@ -1,57 +1,245 @@
 #ifdef DECAF_GL
+#include "gpu_config.h"
 #include "opengl_resource.h"
+
+#include <algorithm>
 #include <common/decaf_assert.h>
+#include <libcpu/mmu.h>
 
 namespace opengl
 {
 
-ResourceMemoryMap::ResourceMemoryMap()
-   : mCounter(0)
+bool
+checkMemoryWritten(Resource *resource,
+                   uint32_t address,
+                   uint32_t size)
 {
+   if (!gpu::config::write_tracking) {
+      return true;
+   }
+
+   if (resource->writeTrackStart == address &&
+       resource->writeTrackSize == size &&
+       !cpu::isMemoryWritten(cpu::VirtualAddress { address }, size, resource->writeTrackSequence)) {
+      return false;
+   }
+
+   // Start tracking before the caller reads the memory, so that any write
+   //  which happens whilst they are reading it will still be noticed.
+   resource->writeTrackStart = address;
+   resource->writeTrackSize = size;
+   resource->writeTrackSequence = cpu::trackMemoryWrites(cpu::VirtualAddress { address }, size);
+   return true;
 }
 
 void
 ResourceMemoryMap::addResource(Resource *resource)
 {
-   std::unique_lock<std::mutex> lock(mMutex);
+   std::unique_lock<std::shared_mutex> lock { mMutex };
 
    if (mKnownResources.find(resource) != mKnownResources.end()) {
       return;
    }
 
-   // mCounter serves to differentiate multiple resources with the same
-   //  start or end address.
-   auto counter = mCounter++;
-   auto keyStart = static_cast<uint64_t>(resource->cpuMemStart) << 32 | counter;
-   auto keyEnd = static_cast<uint64_t>(resource->cpuMemEnd - 1) << 32 | counter;
-   mKnownResources[resource] = counter;
-
-   // We insert entries for both the start (first byte) and end (last byte)
-   //  of the resource.  Then in markDirty(), we can simply set the dirty
-   //  flag on every resource with at least one key (region endpoint) in
-   //  the dirty region.
-   decaf_check(mMemoryMap.find(keyStart) == mMemoryMap.end());
-   mMemoryMap[keyStart] = resource;
-   decaf_check(mMemoryMap.find(keyEnd) == mMemoryMap.end());
-   mMemoryMap[keyEnd] = resource;
+   mKnownResources[resource] = resource->cpuMemStart;
+   mRoot = insert(mRoot, allocateNode(resource));
 }
 
 void
 ResourceMemoryMap::removeResource(Resource *resource)
 {
-   std::unique_lock<std::mutex> lock(mMutex);
+   std::unique_lock<std::shared_mutex> lock { mMutex };
 
    auto knownIter = mKnownResources.find(resource);
    decaf_check(knownIter != mKnownResources.end());
-   auto counter = knownIter->second;
+   auto start = knownIter->second;
    mKnownResources.erase(knownIter);
-   auto keyStart = static_cast<uint64_t>(resource->cpuMemStart) << 32 | counter;
-   auto keyEnd = static_cast<uint64_t>(resource->cpuMemEnd - 1) << 32 | counter;
 
-   decaf_check(mMemoryMap.find(keyStart) != mMemoryMap.end());
-   mMemoryMap.erase(keyStart);
-   decaf_check(mMemoryMap.find(keyEnd) != mMemoryMap.end());
-   mMemoryMap.erase(keyEnd);
+   mRoot = remove(mRoot, start, resource);
+}
+
+int32_t
+ResourceMemoryMap::allocateNode(Resource *resource)
+{
+   auto index = int32_t { -1 };
+
+   if (!mFreeNodes.empty()) {
+      index = mFreeNodes.back();
+      mFreeNodes.pop_back();
+   } else {
+      index = static_cast<int32_t>(mNodes.size());
+      mNodes.emplace_back();
+   }
+
+   auto &node = mNodes[index];
+   node.resource = resource;
+   node.start = resource->cpuMemStart;
+   node.end = resource->cpuMemEnd;
+   node.maxEnd = node.end;
+   node.left = -1;
+   node.right = -1;
+   node.height = 1;
+   return index;
+}
+
+void
+ResourceMemoryMap::update(int32_t index)
+{
+   auto &node = mNodes[index];
+   auto height = int32_t { 0 };
+   node.maxEnd = node.end;
+
+   if (node.left >= 0) {
+      height = std::max(height, mNodes[node.left].height);
+      node.maxEnd = std::max(node.maxEnd, mNodes[node.left].maxEnd);
+   }
+
+   if (node.right >= 0) {
+      height = std::max(height, mNodes[node.right].height);
+      node.maxEnd = std::max(node.maxEnd, mNodes[node.right].maxEnd);
+   }
+
+   node.height = height + 1;
+}
+
+int32_t
+ResourceMemoryMap::rotateLeft(int32_t index)
+{
+   auto right = mNodes[index].right;
+   mNodes[index].right = mNodes[right].left;
+   mNodes[right].left = index;
+   update(index);
+   update(right);
+   return right;
+}
+
+int32_t
+ResourceMemoryMap::rotateRight(int32_t index)
+{
+   auto left = mNodes[index].left;
+   mNodes[index].left = mNodes[left].right;
+   mNodes[left].right = index;
+   update(index);
+   update(left);
+   return left;
+}
+
+int32_t
+ResourceMemoryMap::balance(int32_t index)
+{
+   auto heightOf =
+      [this](int32_t index) {
+         return index >= 0 ? mNodes[index].height : 0;
+      };
+
+   update(index);
+
+   auto &node = mNodes[index];
+   auto factor = heightOf(node.left) - heightOf(node.right);
+
+   if (factor > 1) {
+      auto &left = mNodes[node.left];
+
+      if (heightOf(left.left) < heightOf(left.right)) {
+         node.left = rotateLeft(node.left);
+      }
+
+      return rotateRight(index);
+   } else if (factor < -1) {
+      auto &right = mNodes[node.right];
+
+      if (heightOf(right.right) < heightOf(right.left)) {
+         node.right = rotateRight(node.right);
+      }
+
+      return rotateLeft(index);
+   }
+
+   return index;
+}
+
+// Nodes are ordered by start address, with the resource pointer used to
+//  order multiple resources with the same start address.
+static bool
+lessThan(uint32_t lhsStart,
+         Resource *lhsResource,
+         uint32_t rhsStart,
+         Resource *rhsResource)
+{
+   if (lhsStart != rhsStart) {
+      return lhsStart < rhsStart;
+   }
+
+   return lhsResource < rhsResource;
+}
+
+int32_t
+ResourceMemoryMap::insert(int32_t index,
+                          int32_t node)
+{
+   if (index < 0) {
+      return node;
+   }
+
+   if (lessThan(mNodes[node].start, mNodes[node].resource, mNodes[index].start, mNodes[index].resource)) {
+      auto left = insert(mNodes[index].left, node);
+      mNodes[index].left = left;
+   } else {
+      auto right = insert(mNodes[index].right, node);
+      mNodes[index].right = right;
+   }
+
+   return balance(index);
+}
+
+int32_t
+ResourceMemoryMap::removeMin(int32_t index,
+                             int32_t &min)
+{
+   if (mNodes[index].left < 0) {
+      min = index;
+      return mNodes[index].right;
+   }
+
+   auto left = removeMin(mNodes[index].left, min);
+   mNodes[index].left = left;
+   return balance(index);
+}
+
+int32_t
+ResourceMemoryMap::remove(int32_t index,
+                          uint32_t start,
+                          Resource *resource)
+{
+   decaf_check(index >= 0);
+   auto &node = mNodes[index];
+
+   if (node.resource == resource) {
+      auto left = node.left;
+      auto right = node.right;
+      mFreeNodes.push_back(index);
+
+      if (right < 0) {
+         return left;
+      }
+
+      // Replace this node with the smallest node in the right subtree
+      auto min = int32_t { -1 };
+      right = removeMin(right, min);
+      mNodes[min].left = left;
+      mNodes[min].right = right;
+      return balance(min);
+   }
+
+   if (lessThan(start, resource, node.start, node.resource)) {
+      auto left = remove(node.left, start, resource);
+      mNodes[index].left = left;
+   } else {
+      auto right = remove(node.right, start, resource);
+      mNodes[index].right = right;
+   }
+
+   return balance(index);
 }
 
 } // namespace opengl
@@ -1,8 +1,11 @@
 #pragma once
 #ifdef DECAF_GL
-#include <map>
+#include <atomic>
+#include <cstdint>
 #include <mutex>
+#include <shared_mutex>
 #include <unordered_map>
+#include <vector>
 
 namespace opengl
 {
@@ -18,8 +21,16 @@ struct Resource
    //! Hash of the memory contents, for detecting changes
    uint64_t cpuMemHash[2] = { 0, 0 };
 
-   //! True if a DCFlush has been received for the memory region
-   bool dirtyMemory = true;
+   //! True if a DCFlush has been received for the memory region, this is
+   //!  set from the CPU cores whilst the GPU thread may be reading it
+   std::atomic<bool> dirtyMemory { true };
+
+   //! The memory range which is being write tracked, see checkMemoryWritten
+   uint32_t writeTrackStart = 0;
+   uint32_t writeTrackSize = 0;
+
+   //! Write tracking sequence from when the memory was last checked
+   uint32_t writeTrackSequence = 0;
 
    //! The type of resource (poor man's RTTI for surfaceSync())
    enum Type {
@@ -31,64 +42,124 @@ struct Resource
    Resource(Type type_) : type(type_) { }
 };
 
+// Returns false if the memory has definitely not been written since the last
+//  time it was checked for this resource, in which case the caller can skip
+//  hashing it.  Always returns true if write tracking is disabled.
+bool
+checkMemoryWritten(Resource *resource,
+                   uint32_t address,
+                   uint32_t size);
+
 // Manages data ranges associated with resources for efficient querying by
-//  address.  addResource() and removeResource() lock the object for the
-//  duration of the call.
+//  address.  Resources are kept in an AVL tree ordered by start address where
+//  each node also knows the highest end address in its subtree, which lets a
+//  query find every overlapping resource in O(log n + k).
+//
+//  addResource() and removeResource() take an exclusive lock, whereas
+//  visitResources() only takes a shared lock so flushes from multiple cores
+//  can query the map at the same time.
 class ResourceMemoryMap
 {
-public:
-   class Iterator
+   struct Node
    {
-   public:
-      Iterator(const ResourceMemoryMap &map, uint32_t start, uint32_t size)
-         : mMap(map),
-           mKeyStart(static_cast<uint64_t>(start) << 32),
-           mKeyEnd(static_cast<uint64_t>(start + size) << 32),
-           mMapIter(mMap.mMemoryMap.lower_bound(mKeyStart))
-      {
-      }
-
-      Resource *next()
-      {
-         if (mMapIter != mMap.mMemoryMap.end() && mMapIter->first < mKeyEnd) {
-            return (mMapIter++)->second;
-         } else {
-            return nullptr;
-         }
-      }
-
-   private:
-      const ResourceMemoryMap &mMap;
-      uint64_t mKeyStart;
-      uint64_t mKeyEnd;
-      std::map<uint64_t, Resource *>::const_iterator mMapIter;
+      Resource *resource;
+      uint32_t start;
+      uint32_t end;
+      uint32_t maxEnd;
+      int32_t left;
+      int32_t right;
+      int32_t height;
    };
 
-   ResourceMemoryMap();
-
+public:
    void
    addResource(Resource *resource);
 
    void
    removeResource(Resource *resource);
 
-   std::mutex &
-   getMutex()
+   // Calls func for every resource which overlaps [start, start + size)
+   template<typename Func>
+   void
+   visitResources(uint32_t start,
+                  uint32_t size,
+                  Func func)
    {
-      return mMutex;
+      std::shared_lock<std::shared_mutex> lock { mMutex };
+      auto end = static_cast<uint64_t>(start) + size;
+
+      if (mRoot >= 0 && size) {
+         visitNode(mRoot, start, end, func);
+      }
    }
 
-   Iterator
-   getIterator(uint32_t start, uint32_t size)
+private:
+   template<typename Func>
+   void
+   visitNode(int32_t index,
+             uint32_t start,
+             uint64_t end,
+             Func &func)
    {
-      return Iterator(*this, start, size);
+      auto &node = mNodes[index];
+
+      // Nothing in this subtree ends after our range starts
+      if (node.maxEnd <= start) {
+         return;
+      }
+
+      if (node.left >= 0) {
+         visitNode(node.left, start, end, func);
+      }
+
+      // Everything to the right starts after our range ends
+      if (node.start >= end) {
+         return;
+      }
+
+      if (node.end > start) {
+         func(node.resource);
+      }
+
+      if (node.right >= 0) {
+         visitNode(node.right, start, end, func);
+      }
    }
 
+   int32_t
+   allocateNode(Resource *resource);
+
+   void
+   update(int32_t index);
+
+   int32_t
+   rotateLeft(int32_t index);
+
+   int32_t
+   rotateRight(int32_t index);
+
+   int32_t
+   balance(int32_t index);
+
+   int32_t
+   insert(int32_t index,
+          int32_t node);
+
+   int32_t
+   remove(int32_t index,
+          uint32_t start,
+          Resource *resource);
+
+   int32_t
+   removeMin(int32_t index,
+             int32_t &min);
+
 private:
-   std::mutex mMutex;
+   std::shared_mutex mMutex;
    std::unordered_map<Resource *, uint32_t> mKnownResources;
-   std::map<uint64_t, Resource *> mMemoryMap;
-   uint32_t mCounter;
+   std::vector<Node> mNodes;
+   std::vector<int32_t> mFreeNodes;
+   int32_t mRoot = -1;
 };
 
 } // namespace opengl
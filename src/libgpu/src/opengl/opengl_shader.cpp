@@ -10,6 +10,7 @@
 #include <common/decaf_assert.h>
 #include <common/log.h>
 #include <common/murmur3.h>
+#include <common/perftrace.h>
 #include <common/platform_dir.h>
 #include <common/strutils.h>
 #include <fmt/format.h>
@@ -56,6 +57,11 @@ dumpRawShader(const std::string &type, ppcaddr_t data, uint32_t size, bool isSub
    auto output = latte::disassemble(gsl::make_span(mem::translate<uint8_t>(data), size), isSubroutine);
 
    file << output << std::endl;
+
+   // Also keep the raw binary so tools/shader-bench can translate it offline
+   auto binPath = fmt::format("dump/gpu_{}_{:08x}.bin", type, data);
+   auto binFile = std::ofstream { binPath, std::ofstream::out | std::ofstream::binary };
+   binFile.write(reinterpret_cast<const char *>(mem::translate<uint8_t>(data)), size);
 }
 
 static void
@@ -130,6 +136,11 @@ invalidateShaderIfChanged(ShaderPtrType &shader,
       return false;
    }
 
+   if (!checkMemoryWritten(shader, shader->cpuMemStart, shader->cpuMemEnd - shader->cpuMemStart)) {
+      shader->needRebuild = false;
+      return false;
+   }
+
    // Check whether the shader has actually changed; we want to avoid
    //  recompiling shaders if possible, since that's very slow.
    //  Note that we don't save this, which means we have to compute it
@@ -309,6 +320,9 @@ bool GLDriver::checkActiveShader()
             gl::glObjectLabel(gl::GL_VERTEX_ARRAY, fetchShader->object, -1, label.c_str());
          }
 
+         // Indices are always streamed, so every vertex array uses the stream buffer
+         gl::glVertexArrayElementBuffer(fetchShader->object, mStreamBuffer);
+
          auto bufferUsed = std::array<bool, latte::MaxAttributes> { false };
          auto bufferDivisor = std::array<uint32_t, latte::MaxAttributes> { 0 };
 
@@ -363,6 +377,7 @@ bool GLDriver::checkActiveShader()
       invalidateShaderIfChanged(vertexShader, vsShaderKey, mVertexShaders, mResourceMap);
 
       if (!vertexShader) {
+         PERFTRACE_ZONE("shader", "vertex");
          vertexShader = new VertexShader;
 
          vertexShader->cpuMemStart = vsPgmAddress;
@@ -404,7 +419,6 @@ bool GLDriver::checkActiveShader()
          }
 
          // Get uniform locations
-         vertexShader->uniformRegisters = gl::glGetUniformLocation(vertexShader->object, "VR");
          vertexShader->uniformViewport = gl::glGetUniformLocation(vertexShader->object, "uViewport");
 
          // Get attribute locations
@@ -432,6 +446,7 @@ bool GLDriver::checkActiveShader()
          invalidateShaderIfChanged(pixelShader, psShaderKey, mPixelShaders, mResourceMap);
 
          if (!pixelShader) {
+            PERFTRACE_ZONE("shader", "pixel");
             pixelShader = new PixelShader;
 
             pixelShader->cpuMemStart = psPgmAddress;
@@ -473,7 +488,6 @@ bool GLDriver::checkActiveShader()
             }
 
             // Get uniform locations
-            pixelShader->uniformRegisters = gl::glGetUniformLocation(pixelShader->object, "PR");
             pixelShader->uniformAlphaRef = gl::glGetUniformLocation(pixelShader->object, "uAlphaRef");
             pixelShader->sx_alpha_test_control = sx_alpha_test_control;
          }
@@ -556,25 +570,17 @@ bool GLDriver::checkActiveUniforms()
    if (sq_config.DX9_CONSTS()) {
       // Upload uniform registers
       if (mActiveShader->vertex && mActiveShader->vertex->object) {
-         auto uploadCount = countModifiedUniforms(latte::Register::SQ_ALU_CONSTANT0_256, mActiveShader->vertex->lastUniformUpdate);
-
-         if (uploadCount > 0) {
-            auto values = reinterpret_cast<float *>(&mRegisters[latte::Register::SQ_ALU_CONSTANT0_256 / 4]);
-            gl::glProgramUniform4fv(mActiveShader->vertex->object, mActiveShader->vertex->uniformRegisters, uploadCount, values);
-
-            mActiveShader->vertex->lastUniformUpdate = ++mUniformUpdateGen;
-         }
+         uploadUniformRegisters(latte::Register::SQ_ALU_CONSTANT0_256,
+                                VertexRegisterBinding,
+                                mLastVertexUniformUpdate,
+                                mVertexUniformPosition);
       }
 
       if (mActiveShader->pixel && mActiveShader->pixel->object) {
-         auto uploadCount = countModifiedUniforms(latte::Register::SQ_ALU_CONSTANT0_0, mActiveShader->pixel->lastUniformUpdate);
-
-         if (uploadCount > 0) {
-            auto values = reinterpret_cast<float *>(&mRegisters[latte::Register::SQ_ALU_CONSTANT0_0 / 4]);
-            gl::glProgramUniform4fv(mActiveShader->pixel->object, mActiveShader->pixel->uniformRegisters, uploadCount, values);
-
-            mActiveShader->pixel->lastUniformUpdate = ++mUniformUpdateGen;
-         }
+         uploadUniformRegisters(latte::Register::SQ_ALU_CONSTANT0_0,
+                                PixelRegisterBinding,
+                                mLastPixelUniformUpdate,
+                                mPixelUniformPosition);
       }
    } else {
       if (mActiveShader->vertex && mActiveShader->vertex->object) {
@@ -781,6 +787,10 @@ GLDriver::uploadDataBuffer(DataBuffer *buffer,
                            uint32_t size)
 {
    // Avoid uploading the data if it hasn't changed.
+   if (!checkMemoryWritten(buffer, buffer->cpuMemStart, buffer->allocatedSize)) {
+      return;
+   }
+
    uint64_t newHash[2] = { 0, 0 };
    MurmurHash3_x64_128(mem::translate(buffer->cpuMemStart), buffer->allocatedSize, 0, newHash);
 
@@ -0,0 +1,136 @@
+#ifdef DECAF_GL
+#include "gpu_config.h"
+#include "latte/latte_registers.h"
+#include "opengl_driver.h"
+
+#include <algorithm>
+#include <common/align.h>
+#include <common/decaf_assert.h>
+#include <cstring>
+#include <fmt/format.h>
+#include <glbinding/gl/gl.h>
+
+namespace opengl
+{
+
+void
+GLDriver::initStreamBuffer()
+{
+   auto usage = gl::BufferStorageMask::GL_NONE_BIT;
+   usage |= gl::GL_MAP_WRITE_BIT | gl::GL_MAP_PERSISTENT_BIT | gl::GL_MAP_COHERENT_BIT;
+
+   auto access = gl::MapBufferAccessMask::GL_NONE_BIT;
+   access |= gl::GL_MAP_WRITE_BIT | gl::GL_MAP_PERSISTENT_BIT | gl::GL_MAP_COHERENT_BIT;
+
+   gl::glCreateBuffers(1, &mStreamBuffer);
+
+   if (gpu::config::debug) {
+      gl::glObjectLabel(gl::GL_BUFFER, mStreamBuffer, -1, "stream buffer");
+   }
+
+   gl::glNamedBufferStorage(mStreamBuffer, StreamBufferSize, nullptr, usage);
+   mStreamBufferMap = static_cast<uint8_t *>(gl::glMapNamedBufferRange(mStreamBuffer, 0, StreamBufferSize, access));
+   decaf_check(mStreamBufferMap);
+
+   // Batched draws read their indirect commands from the stream buffer too
+   gl::glBindBuffer(gl::GL_DRAW_INDIRECT_BUFFER, mStreamBuffer);
+
+   mStreamBufferPosition = 0;
+   mStreamBufferSegment = 0;
+   mStreamBufferSyncs.fill(nullptr);
+   mStreamBufferUnfenced.clear();
+
+   gl::GLint value;
+   gl::glGetIntegerv(gl::GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &value);
+   mUniformBufferAlignment = static_cast<uint32_t>(value);
+}
+
+StreamAllocation
+GLDriver::allocateStreamBuffer(uint32_t size,
+                               uint32_t alignment)
+{
+   // Limiting the size means a single draw can never wrap all the way around
+   //  into a segment which it has not yet fenced.
+   decaf_assert(size <= StreamBufferSize / 4,
+                fmt::format("Stream allocation of {} bytes is too large", size));
+
+   auto offset = align_up(mStreamBufferPosition % StreamBufferSize, alignment);
+   auto position = mStreamBufferPosition - (mStreamBufferPosition % StreamBufferSize) + offset;
+
+   if (offset + size > StreamBufferSize) {
+      position += StreamBufferSize - offset;
+      offset = 0;
+   }
+
+   // Wait for the GPU to finish with every segment we are about to enter,
+   //  segments are numbered by position so they never wrap.
+   auto lastSegment = (position + std::max(size, 1u) - 1) / StreamBufferSegmentSize;
+
+   while (mStreamBufferSegment < lastSegment) {
+      mStreamBufferUnfenced.push_back(mStreamBufferSegment % StreamBufferSegments);
+      mStreamBufferSegment++;
+
+      auto &sync = mStreamBufferSyncs[mStreamBufferSegment % StreamBufferSegments];
+
+      if (sync) {
+         gl::glClientWaitSync(sync, gl::GL_SYNC_FLUSH_COMMANDS_BIT, gl::GL_TIMEOUT_IGNORED);
+         gl::glDeleteSync(sync);
+         sync = nullptr;
+      }
+   }
+
+   mStreamBufferPosition = position + size;
+
+   auto allocation = StreamAllocation { };
+   allocation.data = mStreamBufferMap + offset;
+   allocation.offset = static_cast<uint32_t>(offset);
+   allocation.position = position;
+   return allocation;
+}
+
+void
+GLDriver::fenceStreamBuffer()
+{
+   // The fence for a segment can only be placed once the draws which use
+   //  it have been submitted, so this is called after every draw.
+   for (auto segment : mStreamBufferUnfenced) {
+      decaf_check(!mStreamBufferSyncs[segment]);
+      mStreamBufferSyncs[segment] = gl::glFenceSync(gl::GL_SYNC_GPU_COMMANDS_COMPLETE, static_cast<gl::UnusedMask>(0));
+   }
+
+   mStreamBufferUnfenced.clear();
+}
+
+bool
+GLDriver::isStreamAllocationValid(uint64_t position)
+{
+   // A segment is only reused once we have moved a whole buffer past it, so
+   //  anything within half a buffer is safe to use for one more draw.
+   return mStreamBufferPosition - position < StreamBufferSize / 2;
+}
+
+void
+GLDriver::uploadUniformRegisters(latte::Register firstReg,
+                                 gl::GLuint binding,
+                                 uint32_t &lastUniformUpdate,
+                                 uint64_t &lastUploadPosition)
+{
+   if (!countModifiedUniforms(firstReg, lastUniformUpdate) &&
+       isStreamAllocationValid(lastUploadPosition)) {
+      return;
+   }
+
+   // The whole register block is uploaded as the uniform block binding
+   //  range must cover the size of the block declared in the shader.
+   auto size = static_cast<uint32_t>(latte::MaxUniformRegisters * 4 * sizeof(float));
+   auto stream = allocateStreamBuffer(size, mUniformBufferAlignment);
+   std::memcpy(stream.data, &mRegisters[firstReg / 4], size);
+   gl::glBindBufferRange(gl::GL_UNIFORM_BUFFER, binding, mStreamBuffer, stream.offset, size);
+
+   lastUniformUpdate = ++mUniformUpdateGen;
+   lastUploadPosition = stream.position;
+}
+
+} // namespace opengl
+
+#endif // ifdef DECAF_GL
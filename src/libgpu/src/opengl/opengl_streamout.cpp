@@ -165,6 +165,8 @@ GLDriver::streamOutBaseUpdate(const latte::pm4::StreamOutBaseUpdate &data)
 void
 GLDriver::streamOutBufferUpdate(const latte::pm4::StreamOutBufferUpdate &data)
 {
+   flushDrawBatch();
+
    auto bufferIndex = data.control.SELECT_BUFFER();
 
    if (data.control.STORE_BUFFER_FILLED_SIZE()) {
@@ -6,6 +6,7 @@
 
 #include <common/decaf_assert.h>
 #include <common/murmur3.h>
+#include <common/perftrace.h>
 #include <fmt/format.h>
 #include <glbinding/gl/gl.h>
 #include <glbinding/Meta.h>
@@ -527,6 +528,7 @@ GLDriver::uploadSurface(SurfaceBuffer *buffer,
                         bool isDepthBuffer,
                         latte::SQ_TILE_MODE tileMode)
 {
+   PERFTRACE_ZONE("gpu", "uploadSurface");
    auto imagePtr = mem::translate(baseAddress);
    auto bpp = latte::getDataFormatBitsPerElement(format);
    auto srcWidth = width;
@@ -553,6 +555,11 @@ GLDriver::uploadSurface(SurfaceBuffer *buffer,
    auto srcImageSize = srcPitch * srcHeight * uploadDepth * bpp / 8;
    auto dstImageSize = srcWidth * srcHeight * uploadDepth * bpp / 8;
 
+   // Don't bother hashing the memory if we know it has not been written
+   if (!checkMemoryWritten(buffer, baseAddress, srcImageSize)) {
+      return;
+   }
+
    // Calculate a new memory CRC
    uint64_t newHash[2] = { 0 };
    MurmurHash3_x64_128(imagePtr, srcImageSize, 0, newHash);
@@ -565,31 +572,55 @@ GLDriver::uploadSurface(SurfaceBuffer *buffer,
       buffer->cpuMemHash[0] = newHash[0];
       buffer->cpuMemHash[1] = newHash[1];
 
-      std::vector<uint8_t> untiledImage, untiledMipmap;
-      untiledImage.resize(dstImageSize);
-
-      // Untile
-      gpu::convertFromTiled(
-         untiledImage.data(),
-         uploadPitch,
-         imagePtr,
-         tileMode,
-         swizzle,
-         srcPitch,
-         srcWidth,
-         srcHeight,
-         uploadDepth,
-         0,
-         isDepthBuffer,
-         bpp
-      );
+      std::vector<uint8_t> untiledImage;
+      const void *pixels = nullptr;
+      auto usePixelBuffer = false;
+
+      if (mUntilerReady) {
+         usePixelBuffer = untileSurfaceOnGpu(imagePtr,
+                                             uploadPitch,
+                                             tileMode,
+                                             swizzle,
+                                             srcPitch,
+                                             srcWidth,
+                                             srcHeight,
+                                             uploadDepth,
+                                             isDepthBuffer,
+                                             bpp,
+                                             dstImageSize);
+      }
+
+      if (usePixelBuffer) {
+         // pixels is an offset into the bound pixel unpack buffer
+         gl::glBindBuffer(gl::GL_PIXEL_UNPACK_BUFFER, mUntileLinearBuffer);
+      } else {
+         untiledImage.resize(dstImageSize);
+
+         // Untile
+         gpu::convertFromTiled(
+            untiledImage.data(),
+            uploadPitch,
+            imagePtr,
+            tileMode,
+            swizzle,
+            srcPitch,
+            srcWidth,
+            srcHeight,
+            uploadDepth,
+            0,
+            isDepthBuffer,
+            bpp
+         );
+
+         pixels = untiledImage.data();
+      }
 
       // Create texture
       auto compressed = latte::getDataFormatIsCompressed(format);
       auto target = getGlTarget(dim);
       auto textureDataType = gl::GL_INVALID_ENUM;
       auto textureFormat = getGlFormat(format);
-      auto size = untiledImage.size();
+      auto size = dstImageSize;
 
       if (compressed) {
          textureDataType = getGlCompressedDataType(format, formatComp, degamma);
@@ -610,7 +641,7 @@ GLDriver::uploadSurface(SurfaceBuffer *buffer,
                width,
                textureDataType,
                gsl::narrow_cast<gl::GLsizei>(size),
-               untiledImage.data());
+               pixels);
          } else {
             gl::glTextureSubImage1D(buffer->active->object,
                0, /* level */
@@ -618,7 +649,7 @@ GLDriver::uploadSurface(SurfaceBuffer *buffer,
                width,
                textureFormat,
                textureDataType,
-               untiledImage.data());
+               pixels);
          }
          break;
       case latte::SQ_TEX_DIM::DIM_2D:
@@ -630,7 +661,7 @@ GLDriver::uploadSurface(SurfaceBuffer *buffer,
                height,
                textureDataType,
                gsl::narrow_cast<gl::GLsizei>(size),
-               untiledImage.data());
+               pixels);
          } else {
             gl::glTextureSubImage2D(buffer->active->object,
                0, /* level */
@@ -638,7 +669,7 @@ GLDriver::uploadSurface(SurfaceBuffer *buffer,
                width, height,
                textureFormat,
                textureDataType,
-               untiledImage.data());
+               pixels);
          }
          break;
       case latte::SQ_TEX_DIM::DIM_3D:
@@ -649,7 +680,7 @@ GLDriver::uploadSurface(SurfaceBuffer *buffer,
                width, height, depth,
                textureDataType,
                gsl::narrow_cast<gl::GLsizei>(size),
-               untiledImage.data());
+               pixels);
          } else {
             gl::glTextureSubImage3D(buffer->active->object,
                0, /* level */
@@ -657,7 +688,7 @@ GLDriver::uploadSurface(SurfaceBuffer *buffer,
                width, height, depth,
                textureFormat,
                textureDataType,
-               untiledImage.data());
+               pixels);
          }
          break;
       case latte::SQ_TEX_DIM::DIM_CUBEMAP:
@@ -670,7 +701,7 @@ GLDriver::uploadSurface(SurfaceBuffer *buffer,
                width, height, uploadDepth,
                textureDataType,
                gsl::narrow_cast<gl::GLsizei>(size),
-               untiledImage.data());
+               pixels);
          } else {
             gl::glTextureSubImage3D(buffer->active->object,
                0, /* level */
@@ -678,13 +709,62 @@ GLDriver::uploadSurface(SurfaceBuffer *buffer,
                width, height, uploadDepth,
                textureFormat,
                textureDataType,
-               untiledImage.data());
+               pixels);
          }
          break;
       default:
          decaf_abort(fmt::format("Unsupported texture dim: {}", dim));
       }
+
+      if (usePixelBuffer) {
+         gl::glBindBuffer(gl::GL_PIXEL_UNPACK_BUFFER, 0);
+      }
+   }
+}
+
+bool
+GLDriver::untileSurfaceOnGpu(const void *tiled,
+                             uint32_t linearPitch,
+                             latte::SQ_TILE_MODE tileMode,
+                             uint32_t swizzle,
+                             uint32_t pitch,
+                             uint32_t width,
+                             uint32_t height,
+                             uint32_t depth,
+                             bool isDepth,
+                             uint32_t bpp,
+                             uint32_t linearSize)
+{
+   auto tiledSize = ComputeUntiler::getTiledSize(tileMode, pitch, height, depth, bpp);
+   linearSize = ComputeUntiler::getBufferSize(linearSize);
+
+   if (!tiledSize || !linearSize) {
+      return false;
    }
+
+   if (tiledSize > mUntileTiledBufferSize) {
+      gl::glNamedBufferData(mUntileTiledBuffer, tiledSize, nullptr, gl::GL_STREAM_DRAW);
+      mUntileTiledBufferSize = tiledSize;
+   }
+
+   if (linearSize > mUntileLinearBufferSize) {
+      gl::glNamedBufferData(mUntileLinearBuffer, linearSize, nullptr, gl::GL_STREAM_COPY);
+      mUntileLinearBufferSize = linearSize;
+   }
+
+   gl::glNamedBufferSubData(mUntileTiledBuffer, 0, tiledSize, tiled);
+
+   return mUntiler.untile(mUntileLinearBuffer,
+                          linearPitch,
+                          mUntileTiledBuffer,
+                          tileMode,
+                          swizzle,
+                          pitch,
+                          width,
+                          height,
+                          depth,
+                          isDepth,
+                          bpp);
 }
 
 SurfaceBuffer *
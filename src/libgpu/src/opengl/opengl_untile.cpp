@@ -0,0 +1,348 @@
+#ifdef DECAF_GL
+#include "opengl_untile.h"
+
+#include <algorithm>
+#include <common/align.h>
+#include <common/log.h>
+#include <string>
+
+namespace opengl
+{
+
+static constexpr uint32_t UntileGroupSize = 64;
+static constexpr uint64_t MaxUntileSize = 0xFFFFFFFCull;
+
+// Explicit uniform locations used by UntileShaderSource
+enum UntileUniform : gl::GLint
+{
+   Bpp,
+   IsDepth,
+   Tiling,
+   Thickness,
+   Rotation,
+   MacroTilePitch,
+   MacroTileHeight,
+   BankSwapWidth,
+   BankSwizzle,
+   PipeSwizzle,
+   Pitch,
+   Height,
+   Width,
+   LinearPitch,
+   NumElements,
+   NumWords,
+};
+
+// One invocation writes each 32 bit word of the linear surface, so 8 and 16
+//  bit surfaces are handled without having to synchronise byte writes.
+//  The address calculation mirrors ComputeSurfaceAddrFromCoord{Linear,
+//  MicroTiled,MacroTiled} in gpu_addrlibopt.cpp for NumPipes = 2,
+//  NumBanks = 4, a single sample and no compressed depth.
+//  Sizes are calculated in bytes rather than bits, uBpp is always a multiple
+//  of 8, so they do not overflow for slices of 512 MiB and larger.
+static const char *
+UntileShaderSource = R"(#version 450
+layout(local_size_x = 64) in;
+
+layout(std430, binding = 0) readonly buffer TiledBuffer { uint tiled[]; };
+layout(std430, binding = 1) writeonly buffer LinearBuffer { uint linear[]; };
+
+layout(location = 0) uniform uint uBpp;
+layout(location = 1) uniform uint uIsDepth;
+layout(location = 2) uniform uint uTiling;
+layout(location = 3) uniform uint uThickness;
+layout(location = 4) uniform uint uRotation;
+layout(location = 5) uniform uint uMacroTilePitch;
+layout(location = 6) uniform uint uMacroTileHeight;
+layout(location = 7) uniform uint uBankSwapWidth;
+layout(location = 8) uniform uint uBankSwizzle;
+layout(location = 9) uniform uint uPipeSwizzle;
+layout(location = 10) uniform uint uPitch;
+layout(location = 11) uniform uint uHeight;
+layout(location = 12) uniform uint uWidth;
+layout(location = 13) uniform uint uLinearPitch;
+layout(location = 14) uniform uint uNumElements;
+layout(location = 15) uniform uint uNumWords;
+
+uint bit(uint value, uint index)
+{
+   return (value >> index) & 1u;
+}
+
+uint pixelIndexWithinMicroTile(uint x, uint y, uint z)
+{
+   uint x0 = bit(x, 0u), x1 = bit(x, 1u), x2 = bit(x, 2u);
+   uint y0 = bit(y, 0u), y1 = bit(y, 1u), y2 = bit(y, 2u);
+   uint b0, b1, b2, b3, b4, b5;
+   uint b6 = 0u, b7 = 0u;
+
+   if (uIsDepth != 0u) {
+      b0 = x0; b1 = y0; b2 = x1; b3 = y1; b4 = x2; b5 = y2;
+   } else if (uBpp == 8u) {
+      b0 = x0; b1 = x1; b2 = x2; b3 = y1; b4 = y0; b5 = y2;
+   } else if (uBpp == 16u) {
+      b0 = x0; b1 = x1; b2 = x2; b3 = y0; b4 = y1; b5 = y2;
+   } else if (uBpp == 64u) {
+      b0 = x0; b1 = y0; b2 = x1; b3 = x2; b4 = y1; b5 = y2;
+   } else if (uBpp == 128u) {
+      b0 = y0; b1 = x0; b2 = x1; b3 = x2; b4 = y1; b5 = y2;
+   } else {
+      b0 = x0; b1 = x1; b2 = y0; b3 = x2; b4 = y1; b5 = y2;
+   }
+
+   if (uThickness > 1u) {
+      b6 = bit(z, 0u);
+      b7 = bit(z, 1u);
+   }
+
+   return b0 | (b1 << 1) | (b2 << 2) | (b3 << 3) | (b4 << 4) | (b5 << 5) | (b6 << 6) | (b7 << 7);
+}
+
+uint addrFromCoordLinear(uint x, uint y, uint slice)
+{
+   return ((slice * uHeight + y) * uPitch + x) * (uBpp / 8u);
+}
+
+uint addrFromCoordMicroTiled(uint x, uint y, uint slice)
+{
+   uint microTileBytes = (64u * uThickness * uBpp + 7u) / 8u;
+   uint microTilesPerRow = uPitch / 8u;
+   uint microTileOffset = microTileBytes * (x / 8u + (y / 8u) * microTilesPerRow);
+
+   uint sliceBytes = uPitch * uHeight * uThickness * (uBpp / 8u);
+   uint sliceOffset = (slice / uThickness) * sliceBytes;
+
+   uint pixelOffset = uBpp * pixelIndexWithinMicroTile(x, y, slice) / 8u;
+   return pixelOffset + microTileOffset + sliceOffset;
+}
+
+uint addrFromCoordMacroTiled(uint x, uint y, uint slice)
+{
+   uint elemOffset = uBpp * pixelIndexWithinMicroTile(x, y, slice) / 8u;
+
+   uint pipe = bit(y, 3u) ^ bit(x, 3u);
+   uint bank = (bit(y, 5u) ^ bit(x, 3u)) | ((bit(y, 4u) ^ bit(x, 4u)) << 1);
+   uint bankPipe = pipe + 2u * bank;
+   uint swizzle = uPipeSwizzle + 2u * uBankSwizzle;
+   uint sliceIn = (uThickness > 1u) ? slice / 4u : slice;
+
+   bankPipe ^= swizzle + sliceIn * uRotation;
+   bankPipe %= 8u;
+   pipe = bankPipe % 2u;
+   bank = bankPipe / 2u;
+
+   uint sliceBytes = uPitch * uHeight * uThickness * (uBpp / 8u);
+   uint sliceOffset = sliceBytes * (slice / uThickness);
+
+   uint macroTilesPerRow = uPitch / uMacroTilePitch;
+   uint macroTileBytes = uThickness * (uBpp / 8u) * uMacroTileHeight * uMacroTilePitch;
+   uint macroTileIndexX = x / uMacroTilePitch;
+   uint macroTileIndexY = y / uMacroTileHeight;
+   uint macroTileOffset = macroTileBytes * (macroTileIndexX + macroTilesPerRow * macroTileIndexY);
+
+   if (uBankSwapWidth != 0u) {
+      const uint bankSwapOrder[4] = uint[4](0u, 1u, 3u, 2u);
+      uint swapIndex = uMacroTilePitch * macroTileIndexX / uBankSwapWidth;
+      bank ^= bankSwapOrder[swapIndex & 3u];
+   }
+
+   uint totalOffset = elemOffset + ((macroTileOffset + sliceOffset) >> 3);
+   uint offsetHigh = (totalOffset & ~255u) << 3;
+   uint offsetLow = totalOffset & 255u;
+   return (bank << 9) | (pipe << 8) | offsetLow | offsetHigh;
+}
+
+uint addrFromCoord(uint x, uint y, uint slice)
+{
+   if (uTiling == 0u) {
+      return addrFromCoordLinear(x, y, slice);
+   } else if (uTiling == 1u) {
+      return addrFromCoordMicroTiled(x, y, slice);
+   } else {
+      return addrFromCoordMacroTiled(x, y, slice);
+   }
+}
+
+// Returns the tiled address of a byte in the linear surface, or ~0 for
+//  padding which the CPU path would not have written
+uint tiledByteAddress(uint linearByte)
+{
+   uint bytesPerElement = uBpp / 8u;
+   uint element = linearByte / bytesPerElement;
+   uint x = element % uLinearPitch;
+   uint y = (element / uLinearPitch) % uHeight;
+   uint slice = element / (uLinearPitch * uHeight);
+
+   if (element >= uNumElements || x >= uWidth) {
+      return 0xFFFFFFFFu;
+   }
+
+   return addrFromCoord(x, y, slice) + linearByte % bytesPerElement;
+}
+
+void main()
+{
+   uint word = gl_GlobalInvocationID.x + gl_GlobalInvocationID.y * gl_NumWorkGroups.x * 64u;
+
+   if (word >= uNumWords) {
+      return;
+   }
+
+   if (uBpp >= 32u) {
+      uint addr = tiledByteAddress(word * 4u);
+      linear[word] = (addr == 0xFFFFFFFFu) ? 0u : tiled[addr >> 2];
+   } else {
+      uint value = 0u;
+
+      for (uint i = 0u; i < 4u; ++i) {
+         uint addr = tiledByteAddress(word * 4u + i);
+
+         if (addr != 0xFFFFFFFFu) {
+            value |= ((tiled[addr >> 2] >> ((addr & 3u) * 8u)) & 0xFFu) << (i * 8u);
+         }
+      }
+
+      linear[word] = value;
+   }
+}
+)";
+
+ComputeUntiler::~ComputeUntiler()
+{
+   if (mProgram) {
+      gl::glDeleteProgram(mProgram);
+   }
+}
+
+bool
+ComputeUntiler::initialise()
+{
+   if (mProgram) {
+      return true;
+   }
+
+   mProgram = gl::glCreateShaderProgramv(gl::GL_COMPUTE_SHADER, 1, &UntileShaderSource);
+
+   auto isLinked = gl::GLint { 0 };
+   gl::glGetProgramiv(mProgram, gl::GL_LINK_STATUS, &isLinked);
+
+   if (!isLinked) {
+      auto logLength = gl::GLint { 0 };
+      auto log = std::string { };
+      gl::glGetProgramiv(mProgram, gl::GL_INFO_LOG_LENGTH, &logLength);
+      log.resize(logLength);
+      gl::glGetProgramInfoLog(mProgram, logLength, &logLength, &log[0]);
+      gLog->error("OpenGL failed to compile untile compute shader:\n{}", log);
+
+      gl::glDeleteProgram(mProgram);
+      mProgram = 0;
+      return false;
+   }
+
+   gl::glGetIntegeri_v(gl::GL_MAX_COMPUTE_WORK_GROUP_COUNT, 0, &mMaxWorkGroups);
+   return true;
+}
+
+uint32_t
+ComputeUntiler::getTiledSize(latte::SQ_TILE_MODE tileMode,
+                             uint32_t pitch,
+                             uint32_t height,
+                             uint32_t depth,
+                             uint32_t bpp)
+{
+   auto params = gpu::TiledSurfaceParams { };
+
+   if (!gpu::getTiledSurfaceParams(params, tileMode, 0, pitch, bpp)) {
+      return 0;
+   }
+
+   // Tiles extend past the end of the surface when it is not a multiple of
+   //  the tile size, the CPU path simply reads that from guest memory.
+   if (params.tiling == 2) {
+      height = align_up(height, params.macroTileHeight);
+   } else if (params.tiling == 1) {
+      height = align_up(height, 8u);
+   }
+
+   depth = align_up(depth, params.thickness);
+
+   // The shader addresses the surface with 32 bit byte offsets, anything
+   //  larger is left to the CPU path.
+   auto size = uint64_t { pitch } * height * depth * (bpp / 8);
+
+   if (size > MaxUntileSize) {
+      return 0;
+   }
+
+   return getBufferSize(static_cast<uint32_t>(size));
+}
+
+bool
+ComputeUntiler::untile(gl::GLuint linearBuffer,
+                       uint32_t linearPitch,
+                       gl::GLuint tiledBuffer,
+                       latte::SQ_TILE_MODE tileMode,
+                       uint32_t swizzle,
+                       uint32_t pitch,
+                       uint32_t width,
+                       uint32_t height,
+                       uint32_t depth,
+                       bool isDepth,
+                       uint32_t bpp)
+{
+   auto params = gpu::TiledSurfaceParams { };
+
+   if (!mProgram || bpp < 8 || !gpu::getTiledSurfaceParams(params, tileMode, swizzle, pitch, bpp)) {
+      return false;
+   }
+
+   auto linearSize = uint64_t { linearPitch } * height * depth * (bpp / 8);
+
+   if (linearSize > MaxUntileSize) {
+      return false;
+   }
+
+   auto numElements = linearPitch * height * depth;
+   auto numWords = getBufferSize(static_cast<uint32_t>(linearSize)) / 4;
+
+   if (!numWords) {
+      return true;
+   }
+
+   gl::glProgramUniform1ui(mProgram, UntileUniform::Bpp, bpp);
+   gl::glProgramUniform1ui(mProgram, UntileUniform::IsDepth, isDepth ? 1 : 0);
+   gl::glProgramUniform1ui(mProgram, UntileUniform::Tiling, params.tiling);
+   gl::glProgramUniform1ui(mProgram, UntileUniform::Thickness, params.thickness);
+   gl::glProgramUniform1ui(mProgram, UntileUniform::Rotation, params.rotation);
+   gl::glProgramUniform1ui(mProgram, UntileUniform::MacroTilePitch, params.macroTilePitch);
+   gl::glProgramUniform1ui(mProgram, UntileUniform::MacroTileHeight, params.macroTileHeight);
+   gl::glProgramUniform1ui(mProgram, UntileUniform::BankSwapWidth, params.bankSwapWidth);
+   gl::glProgramUniform1ui(mProgram, UntileUniform::BankSwizzle, params.bankSwizzle);
+   gl::glProgramUniform1ui(mProgram, UntileUniform::PipeSwizzle, params.pipeSwizzle);
+   gl::glProgramUniform1ui(mProgram, UntileUniform::Pitch, pitch);
+   gl::glProgramUniform1ui(mProgram, UntileUniform::Height, height);
+   gl::glProgramUniform1ui(mProgram, UntileUniform::Width, width);
+   gl::glProgramUniform1ui(mProgram, UntileUniform::LinearPitch, linearPitch);
+   gl::glProgramUniform1ui(mProgram, UntileUniform::NumElements, numElements);
+   gl::glProgramUniform1ui(mProgram, UntileUniform::NumWords, numWords);
+
+   gl::glBindBufferBase(gl::GL_SHADER_STORAGE_BUFFER, 0, tiledBuffer);
+   gl::glBindBufferBase(gl::GL_SHADER_STORAGE_BUFFER, 1, linearBuffer);
+
+   // Spread the work groups over y once we go past the maximum count for x
+   auto numGroups = (numWords + UntileGroupSize - 1) / UntileGroupSize;
+   auto groupsX = std::min<uint32_t>(numGroups, static_cast<uint32_t>(mMaxWorkGroups));
+   auto groupsY = (numGroups + groupsX - 1) / groupsX;
+
+   gl::glUseProgram(mProgram);
+   gl::glDispatchCompute(groupsX, groupsY, 1);
+   gl::glUseProgram(0);
+
+   // The result is read back as a pixel unpack buffer
+   gl::glMemoryBarrier(gl::GL_PIXEL_BUFFER_BARRIER_BIT | gl::GL_BUFFER_UPDATE_BARRIER_BIT);
+   return true;
+}
+
+} // namespace opengl
+
+#endif // ifdef DECAF_GL
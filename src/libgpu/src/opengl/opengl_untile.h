@@ -0,0 +1,63 @@
+#pragma once
+#ifdef DECAF_GL
+
+#include "gpu_tiling.h"
+
+#include <cstdint>
+#include <glbinding/gl/gl.h>
+
+namespace opengl
+{
+
+/**
+ * Untiles surfaces on the GPU with a compute shader which implements the same
+ * address calculation as gpu_addrlibopt, gpu::convertFromTiled remains the
+ * reference implementation.
+ *
+ * The tiled surface is read from one shader storage buffer and written
+ * linearly to another, which can then be used as a pixel unpack buffer.
+ */
+class ComputeUntiler
+{
+public:
+   ~ComputeUntiler();
+
+   bool
+   initialise();
+
+   //! Size in bytes which the tiled and linear buffers must be rounded up to
+   static uint32_t
+   getBufferSize(uint32_t size)
+   {
+      return (size + 3) & ~3u;
+   }
+
+   //! Number of bytes of the tiled surface which untile reads
+   static uint32_t
+   getTiledSize(latte::SQ_TILE_MODE tileMode,
+                uint32_t pitch,
+                uint32_t height,
+                uint32_t depth,
+                uint32_t bpp);
+
+   bool
+   untile(gl::GLuint linearBuffer,
+          uint32_t linearPitch,
+          gl::GLuint tiledBuffer,
+          latte::SQ_TILE_MODE tileMode,
+          uint32_t swizzle,
+          uint32_t pitch,
+          uint32_t width,
+          uint32_t height,
+          uint32_t depth,
+          bool isDepth,
+          uint32_t bpp);
+
+private:
+   gl::GLuint mProgram = 0;
+   gl::GLint mMaxWorkGroups = 65535;
+};
+
+} // namespace opengl
+
+#endif // ifdef DECAF_GL
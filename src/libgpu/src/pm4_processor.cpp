@@ -1,9 +1,20 @@
+#include "latte/latte_enum_as_string.h"
 #include "latte/latte_pm4_reader.h"
 #include "pm4_processor.h"
 
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <common/bitutils.h>
 #include <common/log.h>
+#include <common/perftrace.h>
 #include <libcpu/mmu.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PM4_SWAP_SSE2
+#endif
+
 void
 Pm4Processor::indirectBufferCall(const IndirectBufferCall &data)
 {
@@ -11,21 +22,96 @@ Pm4Processor::indirectBufferCall(const IndirectBufferCall &data)
    runCommandBuffer(buffer, data.size);
 }
 
+/**
+ * Byte swap count words from src into dst.
+ *
+ * Register and constant payloads can be thousands of words long so this is
+ * done 4 words at a time where we can, using only SSE2.
+ */
+static void
+swapWords(uint32_t *dst,
+          const uint32_t *src,
+          size_t count)
+{
+   auto i = size_t { 0 };
+
+#ifdef PM4_SWAP_SSE2
+   for (; i + 4 <= count; i += 4) {
+      auto value = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+
+      // Swap the bytes in each 16 bit lane, then swap the 16 bit lanes
+      value = _mm_or_si128(_mm_slli_epi16(value, 8), _mm_srli_epi16(value, 8));
+      value = _mm_shufflelo_epi16(value, _MM_SHUFFLE(2, 3, 0, 1));
+      value = _mm_shufflehi_epi16(value, _MM_SHUFFLE(2, 3, 0, 1));
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), value);
+   }
+#endif
+
+   for (; i < count; ++i) {
+      dst[i] = byte_swap(src[i]);
+   }
+}
+
+void
+Pm4Processor::resetPacketStats()
+{
+   mType0Stats = PacketStats { };
+   mType3Stats.fill(PacketStats { });
+   mRegisterWrites = 0;
+   mRedundantRegisterWrites = 0;
+}
+
+static void
+recordPacketTime(Pm4Processor::PacketStats &stats,
+                 std::chrono::steady_clock::time_point start)
+{
+   auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+   auto bucket = 0ul;
+
+   if (ns > 0) {
+      bit_scan_reverse(&bucket, static_cast<uint32_t>(std::min<int64_t>(ns, 0xFFFFFFFF)));
+   }
+
+   stats.totalNs += ns;
+   stats.histogram[bucket]++;
+}
+
+// Names the trace zone of each type 3 packet, interned once up front
+static const char *
+getType3TraceName(IT_OPCODE opcode)
+{
+   static const auto names = []() {
+      auto names = std::array<const char *, 256> { };
+
+      for (auto i = 0u; i < names.size(); ++i) {
+         names[i] = perftrace::intern(latte::pm4::to_string(static_cast<IT_OPCODE>(i)));
+      }
+
+      return names;
+   }();
+
+   return names[static_cast<uint8_t>(opcode)];
+}
+
 void
 Pm4Processor::runCommandBuffer(uint32_t *buffer, uint32_t buffer_size)
 {
-   std::vector<uint32_t> swapped;
-   swapped.resize(buffer_size);
+   PERFTRACE_ZONE("gpu", "runCommandBuffer");
 
-   for (auto i = 0u; i < buffer_size; ++i) {
-      swapped[i] = byte_swap(buffer[i]);
+   // Packets are swapped one at a time into a scratch buffer which is kept
+   // around between calls. An indirect buffer is run from inside a packet of
+   // its parent buffer, so each level of nesting gets its own scratch buffer.
+   if (mPacketScratch.size() <= mCommandBufferDepth) {
+      mPacketScratch.resize(mCommandBufferDepth + 1);
    }
 
+   auto &scratch = mPacketScratch[mCommandBufferDepth++];
+
    for (auto pos = 0u; pos < buffer_size; ) {
-      auto header = *reinterpret_cast<Header *>(&swapped[pos]);
+      auto header = Header::get(byte_swap(buffer[pos]));
       auto size = 0u;
 
-      if (swapped[pos] == 0) {
+      if (header.value == 0) {
          break;
       }
 
@@ -35,8 +121,25 @@ Pm4Processor::runCommandBuffer(uint32_t *buffer, uint32_t buffer_size)
          auto header3 = HeaderType3::get(header.value);
          size = header3.size() + 1;
 
-         decaf_check(pos + size <= buffer_size);
-         handlePacketType3(header3, gsl::make_span(&swapped[pos + 1], size));
+         decaf_check(pos + 1 + size <= buffer_size);
+
+         if (scratch.size() < size) {
+            scratch.resize(size);
+         }
+
+         swapWords(scratch.data(), &buffer[pos + 1], size);
+
+         PERFTRACE_ZONE("pm4", getType3TraceName(header3.opcode()));
+         auto &stats = mType3Stats[static_cast<uint8_t>(header3.opcode())];
+         stats.count++;
+
+         if (mPacketTiming) {
+            auto start = std::chrono::steady_clock::now();
+            handlePacketType3(header3, gsl::make_span(scratch.data(), size));
+            recordPacketTime(stats, start);
+         } else {
+            handlePacketType3(header3, gsl::make_span(scratch.data(), size));
+         }
          break;
       }
       case PacketType::Type0:
@@ -44,8 +147,22 @@ Pm4Processor::runCommandBuffer(uint32_t *buffer, uint32_t buffer_size)
          auto header0 = HeaderType0::get(header.value);
          size = header0.count() + 1;
 
-         decaf_check(pos + size <= buffer_size);
-         handlePacketType0(header0, gsl::make_span(&swapped[pos + 1], size));
+         decaf_check(pos + 1 + size <= buffer_size);
+
+         if (scratch.size() < size) {
+            scratch.resize(size);
+         }
+
+         swapWords(scratch.data(), &buffer[pos + 1], size);
+         mType0Stats.count++;
+
+         if (mPacketTiming) {
+            auto start = std::chrono::steady_clock::now();
+            handlePacketType0(header0, gsl::make_span(scratch.data(), size));
+            recordPacketTime(mType0Stats, start);
+         } else {
+            handlePacketType0(header0, gsl::make_span(scratch.data(), size));
+         }
          break;
       }
       case PacketType::Type2:
@@ -62,6 +179,8 @@ Pm4Processor::runCommandBuffer(uint32_t *buffer, uint32_t buffer_size)
 
       pos += size + 1;
    }
+
+   --mCommandBufferDepth;
 }
 
 void
@@ -384,8 +503,14 @@ void Pm4Processor::loadRegisters(latte::Register base,
       auto start = range.first;
       auto count = range.second;
 
-      for (auto j = start; j < start + count; ++j) {
-         setRegister(static_cast<latte::Register>(base + j * 4), src[j]);
+      if (mLoadScratch.size() < count) {
+         mLoadScratch.resize(count);
+      }
+
+      swapWords(mLoadScratch.data(), reinterpret_cast<uint32_t *>(&src[start]), count);
+
+      for (auto j = 0u; j < count; ++j) {
+         setRegister(static_cast<latte::Register>(base + (start + j) * 4), mLoadScratch[j]);
       }
    }
 }
@@ -461,6 +586,12 @@ Pm4Processor::setRegister(latte::Register reg,
    decaf_check((reg % 4) == 0);
    auto isChanged = (value != mRegisters[reg / 4]);
 
+   mRegisterWrites++;
+
+   if (!isChanged) {
+      mRedundantRegisterWrites++;
+   }
+
    // Save to local registers
    mRegisters[reg / 4] = value;
 
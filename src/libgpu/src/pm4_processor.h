@@ -1,11 +1,56 @@
 #pragma once
 #include "latte/latte_pm4_commands.h"
 #include <libcpu/pointer.h>
+#include <array>
+#include <deque>
+#include <vector>
 
 using namespace latte::pm4;
 
 class Pm4Processor
 {
+public:
+   //! How many packets of one type were handled and how long they took
+   struct PacketStats
+   {
+      uint64_t count = 0;
+      uint64_t totalNs = 0;
+
+      //! Bucket n counts packets which took from 2^n up to 2^(n+1) ns
+      std::array<uint64_t, 32> histogram = { };
+   };
+
+   virtual ~Pm4Processor() = default;
+
+   //! Packets are always counted, timing them has to be enabled. The time
+   //!  of an indirect buffer call includes the packets it runs.
+   void
+   setPacketTiming(bool enabled)
+   {
+      mPacketTiming = enabled;
+   }
+
+   const PacketStats &
+   getType0Stats() const
+   {
+      return mType0Stats;
+   }
+
+   const PacketStats &
+   getType3Stats(IT_OPCODE opcode) const
+   {
+      return mType3Stats[static_cast<uint8_t>(opcode)];
+   }
+
+   uint64_t
+   getRegisterWrites() const
+   {
+      return mRegisterWrites;
+   }
+
+   void
+   resetPacketStats();
+
 protected:
    virtual void decafSetBuffer(const DecafSetBuffer &data) = 0;
    virtual void decafCopyColorToScan(const DecafCopyColorToScan &data) = 0;
@@ -71,4 +116,23 @@ protected:
 
    latte::ShadowState mShadowState;
    std::array<uint32_t, 0x10000> mRegisters;
+
+   //! Number of register writes, and how many did not change the value.
+   uint64_t mRegisterWrites = 0;
+   uint64_t mRedundantRegisterWrites = 0;
+
+private:
+   //! Byte swapped packet data, one per level of indirect buffer nesting.
+   //! A deque so growing it does not move the scratch of an outer level.
+   std::deque<std::vector<uint32_t>> mPacketScratch;
+
+   //! Current level of indirect buffer nesting in runCommandBuffer.
+   size_t mCommandBufferDepth = 0;
+
+   //! Byte swapped register data for loadRegisters.
+   std::vector<uint32_t> mLoadScratch;
+
+   bool mPacketTiming = false;
+   PacketStats mType0Stats;
+   std::array<PacketStats, 256> mType3Stats;
 };
@@ -0,0 +1,179 @@
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include <common/bit_cast.h>
+#include <glsl2/glsl2_ir.h>
+#include <latte/latte_instructions.h>
+#include <vector>
+
+using namespace latte;
+
+struct Source
+{
+   SQ_ALU_SRC sel;
+   SQ_CHAN chan;
+};
+
+static Source
+reg(uint32_t gpr, SQ_CHAN chan)
+{
+   return { static_cast<SQ_ALU_SRC>(SQ_ALU_SRC::REGISTER_FIRST + gpr), chan };
+}
+
+static Source
+src(SQ_ALU_SRC sel, SQ_CHAN chan = SQ_CHAN::X)
+{
+   return { sel, chan };
+}
+
+static AluInst
+op2(SQ_OP2_INST id,
+    uint32_t gpr,
+    SQ_CHAN chan,
+    Source src0,
+    Source src1 = { SQ_ALU_SRC::IMM_0, SQ_CHAN::X },
+    bool writeMask = true)
+{
+   auto inst = AluInst { };
+   inst.word0.value = 0;
+   inst.word1.value = 0;
+
+   inst.word0 = inst.word0
+      .SRC0_SEL(src0.sel)
+      .SRC0_CHAN(src0.chan)
+      .SRC1_SEL(src1.sel)
+      .SRC1_CHAN(src1.chan);
+
+   inst.word1 = inst.word1
+      .ENCODING(SQ_ALU_ENCODING::OP2)
+      .DST_GPR(gpr)
+      .DST_CHAN(chan);
+
+   inst.op2 = inst.op2
+      .ALU_INST(id)
+      .WRITE_MASK(writeMask);
+
+   return inst;
+}
+
+/**
+ * Appends an instruction group to a clause, marking the last instruction and
+ * packing the literals after it two per slot.
+ */
+static void
+addGroup(std::vector<AluInst> &clause,
+         std::vector<AluInst> group,
+         std::vector<float> literals = { })
+{
+   group.back().word0 = group.back().word0.LAST(true);
+   clause.insert(clause.end(), group.begin(), group.end());
+
+   for (auto i = 0u; i < literals.size(); i += 2) {
+      auto slot = AluInst { };
+      slot.word0.value = bit_cast<uint32_t>(literals[i]);
+      slot.word1.value = (i + 1 < literals.size()) ? bit_cast<uint32_t>(literals[i + 1]) : 0;
+      clause.push_back(slot);
+   }
+}
+
+static glsl2::AluClauseIR
+build(const std::vector<AluInst> &clause)
+{
+   auto ir = glsl2::AluClauseIR { };
+   glsl2::buildAluClauseIR(ir, clause.data(), clause.size());
+   return ir;
+}
+
+TEST_CASE("PV reads are replaced by the register the previous group wrote")
+{
+   auto clause = std::vector<AluInst> { };
+   addGroup(clause, { op2(SQ_OP2_INST_MOV, 1, SQ_CHAN::X, reg(0, SQ_CHAN::X)) });
+   addGroup(clause, { op2(SQ_OP2_INST_ADD, 2, SQ_CHAN::X, src(SQ_ALU_SRC::PV, SQ_CHAN::X), reg(0, SQ_CHAN::Y)) });
+
+   auto ir = build(clause);
+   REQUIRE(ir.groups.size() == 2);
+
+   auto &previous = ir.groups[1].previous[SQ_CHAN::X];
+   REQUIRE(previous.type == glsl2::AluValue::Register);
+   REQUIRE(previous.gpr == 1);
+   REQUIRE(previous.chan == SQ_CHAN::X);
+
+   // Nothing reads PV any more, so the MOV goes straight to R1.x
+   REQUIRE(ir.groups[0].units[SQ_CHAN::X].directWrite);
+   REQUIRE(!ir.groups[0].updatePreviousVector);
+}
+
+TEST_CASE("Results which nothing reads are dead")
+{
+   auto clause = std::vector<AluInst> { };
+   addGroup(clause, { op2(SQ_OP2_INST_MOV, 1, SQ_CHAN::X, reg(0, SQ_CHAN::X), src(SQ_ALU_SRC::IMM_0), false) });
+   addGroup(clause, { op2(SQ_OP2_INST_MOV, 2, SQ_CHAN::X, reg(0, SQ_CHAN::Y)) });
+
+   auto ir = build(clause);
+   REQUIRE(ir.groups[0].units[SQ_CHAN::X].dead);
+   REQUIRE(!ir.groups[1].units[SQ_CHAN::X].dead);
+}
+
+TEST_CASE("Direct writes are not used when the group reads the old value")
+{
+   auto clause = std::vector<AluInst> { };
+   addGroup(clause, {
+      op2(SQ_OP2_INST_MOV, 1, SQ_CHAN::X, reg(0, SQ_CHAN::X)),
+      op2(SQ_OP2_INST_MOV, 2, SQ_CHAN::Y, reg(1, SQ_CHAN::X)),
+   });
+
+   auto ir = build(clause);
+   REQUIRE(!ir.groups[0].units[SQ_CHAN::X].directWrite);
+   REQUIRE(ir.groups[0].units[SQ_CHAN::Y].directWrite);
+}
+
+TEST_CASE("Constants are folded and propagated through PV")
+{
+   auto clause = std::vector<AluInst> { };
+   addGroup(clause, { op2(SQ_OP2_INST_MOV, 1, SQ_CHAN::X, src(SQ_ALU_SRC::IMM_1)) });
+   addGroup(clause, { op2(SQ_OP2_INST_ADD, 2, SQ_CHAN::X, src(SQ_ALU_SRC::PV, SQ_CHAN::X), src(SQ_ALU_SRC::LITERAL, SQ_CHAN::X)) }, { 0.25f });
+
+   auto ir = build(clause);
+   auto &mov = ir.groups[0].units[SQ_CHAN::X];
+   REQUIRE(mov.folded);
+   REQUIRE(bit_cast<float>(mov.foldedValue) == 1.0f);
+
+   auto &add = ir.groups[1].units[SQ_CHAN::X];
+   REQUIRE(ir.groups[1].previous[SQ_CHAN::X].type == glsl2::AluValue::Constant);
+   REQUIRE(add.folded);
+   REQUIRE(bit_cast<float>(add.foldedValue) == 1.25f);
+   REQUIRE(!ir.groups[0].updatePreviousVector);
+}
+
+TEST_CASE("Values propagate past a reduction group")
+{
+   // DOT4 in the vector units next to a MOV of a literal in T
+   auto clause = std::vector<AluInst> { };
+   addGroup(clause, {
+      op2(SQ_OP2_INST_DOT4, 1, SQ_CHAN::X, reg(0, SQ_CHAN::X), reg(0, SQ_CHAN::X)),
+      op2(SQ_OP2_INST_DOT4, 1, SQ_CHAN::Y, reg(0, SQ_CHAN::Y), reg(0, SQ_CHAN::Y), false),
+      op2(SQ_OP2_INST_DOT4, 1, SQ_CHAN::Z, reg(0, SQ_CHAN::Z), reg(0, SQ_CHAN::Z), false),
+      op2(SQ_OP2_INST_DOT4, 1, SQ_CHAN::W, reg(0, SQ_CHAN::W), reg(0, SQ_CHAN::W), false),
+      op2(SQ_OP2_INST_MOV, 2, SQ_CHAN::X, src(SQ_ALU_SRC::LITERAL, SQ_CHAN::X)),
+   }, { 2.0f });
+   addGroup(clause, {
+      op2(SQ_OP2_INST_MUL, 3, SQ_CHAN::X, src(SQ_ALU_SRC::PV, SQ_CHAN::X), src(SQ_ALU_SRC::PS)),
+   });
+
+   auto ir = build(clause);
+   REQUIRE(ir.groups.size() == 2);
+   REQUIRE(ir.groups[0].isReduction);
+
+   // The folded MOV never writes PSo, so PS must be read as the constant
+   auto &mov = ir.groups[0].units[SQ_CHAN::T];
+   REQUIRE(mov.folded);
+
+   auto &scalar = ir.groups[1].previous[SQ_CHAN::T];
+   REQUIRE(scalar.type == glsl2::AluValue::Constant);
+   REQUIRE(bit_cast<float>(scalar.value) == 2.0f);
+   REQUIRE(!ir.groups[0].updatePreviousScalar);
+
+   // The DOT4 result is only available through PV
+   REQUIRE(ir.groups[1].previous[SQ_CHAN::X].type == glsl2::AluValue::Unknown);
+   REQUIRE(ir.groups[0].updatePreviousVector);
+}
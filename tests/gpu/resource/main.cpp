@@ -0,0 +1,152 @@
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include <opengl/opengl_resource.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <vector>
+
+using opengl::Resource;
+using opengl::ResourceMemoryMap;
+
+static std::vector<Resource *>
+queryMap(ResourceMemoryMap &map,
+         uint32_t start,
+         uint32_t size)
+{
+   auto result = std::vector<Resource *> { };
+   map.visitResources(start, size, [&](Resource *resource) {
+      result.push_back(resource);
+   });
+
+   std::sort(result.begin(), result.end());
+   return result;
+}
+
+// What visitResources should find, by checking every resource in the map
+static std::vector<Resource *>
+queryList(const std::vector<Resource *> &resources,
+          uint32_t start,
+          uint32_t size)
+{
+   auto result = std::vector<Resource *> { };
+   auto end = static_cast<uint64_t>(start) + size;
+
+   if (size) {
+      for (auto resource : resources) {
+         if (resource->cpuMemStart < end && resource->cpuMemEnd > start) {
+            result.push_back(resource);
+         }
+      }
+   }
+
+   std::sort(result.begin(), result.end());
+   return result;
+}
+
+static std::unique_ptr<Resource>
+makeResource(uint32_t start,
+             uint32_t end)
+{
+   auto resource = std::make_unique<Resource>(Resource::DATA_BUFFER);
+   resource->cpuMemStart = start;
+   resource->cpuMemEnd = end;
+   return resource;
+}
+
+TEST_CASE("Resource map queries find every overlapping resource")
+{
+   auto map = ResourceMemoryMap { };
+   auto a = makeResource(0x1000, 0x2000);
+   auto b = makeResource(0x1800, 0x1900);
+   auto c = makeResource(0x2000, 0x3000);
+   auto empty = makeResource(0x1500, 0x1500);
+   auto top = makeResource(0xFFFFF000, 0xFFFFFFFF);
+   auto all = std::vector<Resource *> { a.get(), b.get(), c.get(), empty.get(), top.get() };
+
+   for (auto resource : all) {
+      map.addResource(resource);
+   }
+
+   // Adding a resource twice does nothing
+   map.addResource(a.get());
+
+   REQUIRE(queryMap(map, 0x1000, 0x1000) == queryList(all, 0x1000, 0x1000));
+   REQUIRE(queryMap(map, 0x1FFF, 1) == queryList(all, 0x1FFF, 1));
+   REQUIRE(queryMap(map, 0x2000, 1).size() == 1);
+   REQUIRE(queryMap(map, 0x0, 0x1000).empty());
+   REQUIRE(queryMap(map, 0x1500, 0).empty());
+   REQUIRE(queryMap(map, 0x1500, 1) == std::vector<Resource *> { a.get() });
+
+   // Ranges which run past the end of the address space
+   REQUIRE(queryMap(map, 0xFFFFFFF0, 0x100) == std::vector<Resource *> { top.get() });
+   REQUIRE(queryMap(map, 0, 0xFFFFFFFF) == queryList(all, 0, 0xFFFFFFFF));
+
+   map.removeResource(a.get());
+   all.erase(all.begin());
+   REQUIRE(queryMap(map, 0x1800, 0x800) == std::vector<Resource *> { b.get() });
+   REQUIRE(queryMap(map, 0x1000, 0x1000) == queryList(all, 0x1000, 0x1000));
+   REQUIRE(queryMap(map, 0, 0xFFFFFFFF) == queryList(all, 0, 0xFFFFFFFF));
+}
+
+TEST_CASE("Resource map matches a brute force list under random use")
+{
+   auto rng = std::mt19937 { 0x5eed };
+   auto map = ResourceMemoryMap { };
+   auto owned = std::vector<std::unique_ptr<Resource>> { };
+   auto live = std::vector<Resource *> { };
+
+   // A small address space so resources overlap a lot and share starts
+   auto randomAddress = [&]() {
+      return static_cast<uint32_t>(rng() % 0x10000) * 0x10;
+   };
+
+   auto randomSize = [&]() {
+      switch (rng() % 4) {
+      case 0:
+         return 0u;
+      case 1:
+         return static_cast<uint32_t>(rng() % 0x10) * 0x10;
+      case 2:
+         return static_cast<uint32_t>(rng() % 0x1000) * 0x10;
+      default:
+         return static_cast<uint32_t>(rng() % 0x10000) * 0x10;
+      }
+   };
+
+   for (auto i = 0; i < 20000; ++i) {
+      auto op = rng() % 8;
+
+      if (op < 3 || live.empty()) {
+         auto start = randomAddress();
+         owned.emplace_back(makeResource(start, start + randomSize()));
+         map.addResource(owned.back().get());
+         live.push_back(owned.back().get());
+      } else if (op < 5) {
+         auto index = rng() % live.size();
+         map.removeResource(live[index]);
+         live.erase(live.begin() + index);
+      } else {
+         auto start = randomAddress();
+         auto size = randomSize();
+         REQUIRE(queryMap(map, start, size) == queryList(live, start, size));
+      }
+   }
+
+   // Empty it out again, checking as we go
+   std::shuffle(live.begin(), live.end(), rng);
+
+   while (!live.empty()) {
+      map.removeResource(live.back());
+      live.pop_back();
+      REQUIRE(queryMap(map, 0, 0xFFFFFFFF) == queryList(live, 0, 0xFFFFFFFF));
+   }
+
+   // Freed nodes are reused
+   auto resource = makeResource(0x100, 0x200);
+   map.addResource(resource.get());
+   REQUIRE(queryMap(map, 0, 0x1000) == std::vector<Resource *> { resource.get() });
+}
@@ -0,0 +1,182 @@
+#define CATCH_CONFIG_RUNNER
+#include <catch.hpp>
+
+#include "gpu_tiling.h"
+#include "opengl/opengl_untile.h"
+
+#include <algorithm>
+#include <glbinding/Binding.h>
+#include <glbinding/gl/gl.h>
+#include <iostream>
+#include <random>
+#include <SDL.h>
+#include <spdlog/spdlog.h>
+#include <vector>
+
+std::shared_ptr<spdlog::logger>
+gLog;
+
+static const latte::SQ_TILE_MODE
+TileModes[] = {
+   latte::SQ_TILE_MODE::LINEAR_ALIGNED,
+   latte::SQ_TILE_MODE::TILED_1D_THIN1,
+   latte::SQ_TILE_MODE::TILED_1D_THICK,
+   latte::SQ_TILE_MODE::TILED_2D_THIN1,
+   latte::SQ_TILE_MODE::TILED_2D_THIN2,
+   latte::SQ_TILE_MODE::TILED_2D_THIN4,
+   latte::SQ_TILE_MODE::TILED_2D_THICK,
+   latte::SQ_TILE_MODE::TILED_2B_THIN1,
+   latte::SQ_TILE_MODE::TILED_2B_THIN2,
+   latte::SQ_TILE_MODE::TILED_2B_THIN4,
+   latte::SQ_TILE_MODE::TILED_2B_THICK,
+   latte::SQ_TILE_MODE::TILED_3D_THIN1,
+   latte::SQ_TILE_MODE::TILED_3D_THICK,
+   latte::SQ_TILE_MODE::TILED_3B_THIN1,
+   latte::SQ_TILE_MODE::TILED_3B_THICK,
+};
+
+static const uint32_t
+BitsPerElement[] = { 8, 16, 32, 64, 128 };
+
+//! Must match SKIP_RETURN_CODE in CMakeLists.txt
+static const int
+SkipReturnCode = 77;
+
+// Creates a hidden window with an OpenGL 4.5 context, shared by every test
+static bool
+initialiseContext()
+{
+   if (SDL_Init(SDL_INIT_VIDEO) != 0) {
+      std::cout << "Failed to initialize SDL: " << SDL_GetError() << std::endl;
+      return false;
+   }
+
+   SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 4);
+   SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 5);
+   SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+
+   auto window = SDL_CreateWindow("test-gpu-untile",
+                                  SDL_WINDOWPOS_UNDEFINED,
+                                  SDL_WINDOWPOS_UNDEFINED,
+                                  16, 16,
+                                  SDL_WINDOW_OPENGL | SDL_WINDOW_HIDDEN);
+
+   if (!window) {
+      std::cout << "Failed to create window: " << SDL_GetError() << std::endl;
+      return false;
+   }
+
+   if (!SDL_GL_CreateContext(window)) {
+      std::cout << "Failed to create OpenGL 4.5 context: " << SDL_GetError() << std::endl;
+      return false;
+   }
+
+   glbinding::Binding::initialize();
+   return true;
+}
+
+static std::vector<uint8_t>
+untileOnGpu(opengl::ComputeUntiler &untiler,
+            std::vector<uint8_t> &tiled,
+            uint32_t linearSize,
+            latte::SQ_TILE_MODE tileMode,
+            uint32_t swizzle,
+            uint32_t pitch,
+            uint32_t width,
+            uint32_t height,
+            uint32_t depth,
+            bool isDepth,
+            uint32_t bpp)
+{
+   gl::GLuint buffers[2];
+   gl::glCreateBuffers(2, buffers);
+   gl::glNamedBufferData(buffers[0], tiled.size(), tiled.data(), gl::GL_STATIC_DRAW);
+   gl::glNamedBufferData(buffers[1], opengl::ComputeUntiler::getBufferSize(linearSize), nullptr, gl::GL_STATIC_READ);
+
+   auto result = std::vector<uint8_t> { };
+
+   if (untiler.untile(buffers[1], width, buffers[0], tileMode, swizzle, pitch, width, height, depth, isDepth, bpp)) {
+      result.resize(linearSize);
+      gl::glGetNamedBufferSubData(buffers[1], 0, linearSize, result.data());
+   }
+
+   gl::glDeleteBuffers(2, buffers);
+   return result;
+}
+
+static void
+compareUntile(opengl::ComputeUntiler &untiler,
+              latte::SQ_TILE_MODE tileMode,
+              uint32_t swizzle,
+              uint32_t bpp,
+              bool isDepth)
+{
+   const auto pitch = 256u;
+   const auto width = 250u;
+   const auto height = 60u;
+   const auto depth = 4u;
+
+   auto tiledSize = opengl::ComputeUntiler::getTiledSize(tileMode, pitch, height, depth, bpp);
+   auto linearSize = width * height * depth * bpp / 8;
+   REQUIRE(tiledSize >= pitch * height * depth * bpp / 8);
+
+   auto tiled = std::vector<uint8_t>(tiledSize);
+   auto random = std::mt19937 { static_cast<uint32_t>(tileMode) * 1000 + bpp };
+
+   for (auto &byte : tiled) {
+      byte = static_cast<uint8_t>(random());
+   }
+
+   auto expected = std::vector<uint8_t>(linearSize);
+   REQUIRE(gpu::convertFromTiled(expected.data(), width, tiled.data(), tileMode, swizzle,
+                                 pitch, width, height, depth, 0, isDepth, bpp));
+
+   auto result = untileOnGpu(untiler, tiled, linearSize, tileMode, swizzle,
+                             pitch, width, height, depth, isDepth, bpp);
+   REQUIRE(result.size() == expected.size());
+
+   // Report the first differing byte rather than the whole surface
+   auto mismatch = std::mismatch(expected.begin(), expected.end(), result.begin());
+   REQUIRE(std::distance(expected.begin(), mismatch.first) == static_cast<ptrdiff_t>(linearSize));
+}
+
+TEST_CASE("compute untile matches convertFromTiled")
+{
+   opengl::ComputeUntiler untiler;
+   REQUIRE(untiler.initialise());
+
+   for (auto tileMode : TileModes) {
+      for (auto bpp : BitsPerElement) {
+         for (auto swizzle : { 0u, 0x700u }) {
+            INFO("tileMode " << static_cast<uint32_t>(tileMode) << " bpp " << bpp << " swizzle " << swizzle);
+            compareUntile(untiler, tileMode, swizzle, bpp, false);
+         }
+      }
+   }
+}
+
+TEST_CASE("compute untile matches convertFromTiled for depth")
+{
+   opengl::ComputeUntiler untiler;
+   REQUIRE(untiler.initialise());
+
+   for (auto tileMode : TileModes) {
+      for (auto bpp : { 16u, 32u }) {
+         INFO("tileMode " << static_cast<uint32_t>(tileMode) << " bpp " << bpp);
+         compareUntile(untiler, tileMode, 0x300u, bpp, true);
+      }
+   }
+}
+
+int main(int argc, char **argv)
+{
+   gLog = std::make_shared<spdlog::logger>("test-gpu-untile", spdlog::sinks::stdout_sink_mt::instance());
+
+   // Without a context nothing was tested, so report a skip rather than a pass
+   if (!initialiseContext()) {
+      std::cout << "Skipping compute untile tests" << std::endl;
+      return SkipReturnCode;
+   }
+
+   return Catch::Session().run(argc, argv);
+}
@@ -0,0 +1,147 @@
+#include <catch.hpp>
+
+#include <filesystem/filesystem_image_archive.h>
+#include <filesystem/filesystem_image_packer.h>
+
+#include <algorithm>
+#include <common/platform_dir.h>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+static const auto
+TestChunkSize = 4096u;
+
+static void
+writeFile(const std::string &path,
+          const std::vector<uint8_t> &data)
+{
+   std::ofstream out { path, std::ofstream::binary | std::ofstream::trunc };
+   out.write(reinterpret_cast<const char *>(data.data()), data.size());
+   REQUIRE(out.good());
+}
+
+/**
+ * Part of the data repeats so its chunks compress, and part is noise so its
+ * chunks are stored as is.
+ */
+static std::vector<uint8_t>
+makeData(size_t size)
+{
+   auto data = std::vector<uint8_t>(size);
+   auto seed = uint32_t { 0x12345678 };
+
+   for (auto i = 0u; i < size; ++i) {
+      if (i < size / 2) {
+         data[i] = static_cast<uint8_t>(i % 7);
+      } else {
+         seed = seed * 1664525 + 1013904223;
+         data[i] = static_cast<uint8_t>(seed >> 24);
+      }
+   }
+
+   return data;
+}
+
+static std::vector<uint8_t>
+readEntry(fs::ImageArchive &archive,
+          const fs::ImageEntry *entry)
+{
+   auto data = std::vector<uint8_t>(static_cast<size_t>(entry->size));
+   REQUIRE(archive.read(entry, 0, data.data(), data.size()) == data.size());
+   return data;
+}
+
+static void
+checkImage(const std::string &path,
+           const std::vector<uint8_t> &large,
+           const std::vector<uint8_t> &small)
+{
+   // A cache smaller than the large file makes reads evict chunks
+   auto archive = fs::ImageArchive::open(path, TestChunkSize * 2);
+   REQUIRE(archive);
+
+   auto root = archive->findChildren({});
+   REQUIRE(root.size() == 2);
+   REQUIRE(archive->getEntryName(root[0]) == "code");
+   REQUIRE(archive->getEntryName(root[1]) == "content");
+
+   auto content = archive->findChildren("content");
+   REQUIRE(content.size() == 3);
+   REQUIRE(archive->getEntryPath(content[0]) == "content/empty.bin");
+   REQUIRE(archive->getEntryPath(content[1]) == "content/large.bin");
+   REQUIRE(archive->getEntryPath(content[2]) == "content/sub");
+   REQUIRE(content[2]->type == fs::ImageEntryType::Folder);
+
+   auto empty = archive->findEntry("content/empty.bin");
+   REQUIRE(empty);
+   REQUIRE(empty->size == 0);
+
+   auto buffer = uint8_t { 0 };
+   REQUIRE(archive->read(empty, 0, &buffer, 1) == 0);
+
+   auto smallEntry = archive->findEntry("content/sub/small.txt");
+   REQUIRE(smallEntry);
+   REQUIRE(readEntry(*archive, smallEntry) == small);
+
+   auto largeEntry = archive->findEntry("content/large.bin");
+   REQUIRE(largeEntry);
+   REQUIRE(largeEntry->type == fs::ImageEntryType::File);
+   REQUIRE(largeEntry->size == large.size());
+   REQUIRE(readEntry(*archive, largeEntry) == large);
+
+   // A read which starts in one chunk and ends in the next
+   auto offset = size_t { TestChunkSize * 2 - 100 };
+   auto span = std::vector<uint8_t>(300);
+   REQUIRE(archive->read(largeEntry, offset, span.data(), span.size()) == span.size());
+   REQUIRE(std::equal(span.begin(), span.end(), large.begin() + offset));
+
+   // Reads are clamped to the end of the file
+   offset = large.size() - 10;
+   REQUIRE(archive->read(largeEntry, offset, span.data(), span.size()) == 10);
+   REQUIRE(std::equal(span.begin(), span.begin() + 10, large.begin() + offset));
+   REQUIRE(archive->read(largeEntry, large.size(), span.data(), span.size()) == 0);
+
+   REQUIRE(!archive->findEntry("content/missing.bin"));
+   REQUIRE(!archive->findEntry("content/sub/"));
+}
+
+TEST_CASE("Packed images read back the files they were packed from")
+{
+   // Not a multiple of the chunk size so the last chunk is short
+   auto large = makeData(TestChunkSize * 5 + 123);
+   auto text = std::string { "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n<app />\n" };
+   auto small = std::vector<uint8_t> { text.begin(), text.end() };
+
+   REQUIRE(platform::createDirectory("image_src/code"));
+   REQUIRE(platform::createDirectory("image_src/content/sub"));
+   writeFile("image_src/code/app.xml", small);
+   writeFile("image_src/content/empty.bin", { });
+   writeFile("image_src/content/large.bin", large);
+   writeFile("image_src/content/sub/small.txt", small);
+
+   SECTION("zlib")
+   {
+      auto options = fs::ImagePackOptions { };
+      options.chunkSize = TestChunkSize;
+      REQUIRE(fs::packImage("image_src", "image_zlib.dci", options));
+      checkImage("image_zlib.dci", large, small);
+   }
+
+   SECTION("uncompressed")
+   {
+      auto options = fs::ImagePackOptions { };
+      options.chunkSize = TestChunkSize;
+      options.compression = fs::ImageCompression::None;
+      REQUIRE(fs::packImage("image_src", "image_none.dci", options));
+      checkImage("image_none.dci", large, small);
+   }
+}
+
+TEST_CASE("Files which are not images are rejected")
+{
+   writeFile("image_invalid.dci", makeData(256));
+   REQUIRE(!fs::ImageArchive::open("image_invalid.dci"));
+   REQUIRE(!fs::ImageArchive::open("image_missing.dci"));
+}
@@ -0,0 +1,11 @@
+#define CATCH_CONFIG_RUNNER
+#include <catch.hpp>
+
+#include <common/log.h>
+#include <spdlog/spdlog.h>
+
+int main(int argc, char **argv)
+{
+   gLog = std::make_shared<spdlog::logger>("test-libdecaf", spdlog::sinks::stdout_sink_st::instance());
+   return Catch::Session().run(argc, argv);
+}
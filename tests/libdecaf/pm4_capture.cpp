@@ -0,0 +1,464 @@
+#include <catch.hpp>
+
+#include <decaf_pm4replay.h>
+
+#include <algorithm>
+#include <common/byte_swap.h>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <libgpu/latte/latte_pm4.h>
+#include <string>
+#include <vector>
+#include <zlib.h>
+
+using namespace decaf::pm4;
+
+static void
+appendPacket(std::vector<uint8_t> &stream,
+             CapturePacket::Type type,
+             const void *header,
+             size_t headerSize,
+             const std::vector<uint8_t> &payload)
+{
+   auto packet = CapturePacket { };
+   packet.type = type;
+   packet.size = static_cast<uint32_t>(headerSize + payload.size());
+
+   auto bytes = reinterpret_cast<const uint8_t *>(&packet);
+   stream.insert(stream.end(), bytes, bytes + sizeof(CapturePacket));
+
+   bytes = reinterpret_cast<const uint8_t *>(header);
+   stream.insert(stream.end(), bytes, bytes + headerSize);
+   stream.insert(stream.end(), payload.begin(), payload.end());
+}
+
+static void
+appendBlob(std::vector<uint8_t> &stream,
+           uint64_t hash,
+           const std::vector<uint8_t> &data)
+{
+   auto blob = CaptureMemoryBlob { };
+   blob.hash[0] = hash;
+   blob.hash[1] = ~hash;
+   appendPacket(stream, CapturePacket::MemoryBlob, &blob, sizeof(blob), data);
+}
+
+static void
+appendLoadBlob(std::vector<uint8_t> &stream,
+               uint64_t hash,
+               uint32_t address)
+{
+   auto load = CaptureMemoryLoadBlob { };
+   load.type = CaptureMemoryLoad::Surface;
+   load.address = address;
+   load.hash[0] = hash;
+   load.hash[1] = ~hash;
+   appendPacket(stream, CapturePacket::MemoryLoadBlob, &load, sizeof(load), { });
+}
+
+//! Writes the packet stream as a DPMZ capture with chunks of chunkSize bytes
+static void
+writeCompressed(const std::string &path,
+                const std::vector<uint8_t> &stream,
+                size_t chunkSize)
+{
+   std::ofstream out { path, std::ofstream::binary | std::ofstream::trunc };
+   out.write(CaptureMagicCompressed.data(), CaptureMagicCompressed.size());
+
+   for (auto pos = size_t { 0 }; pos < stream.size(); pos += chunkSize) {
+      auto size = std::min(chunkSize, stream.size() - pos);
+      auto compressed = std::vector<uint8_t>(compressBound(static_cast<uLong>(size)));
+      auto compressedSize = static_cast<uLongf>(compressed.size());
+      REQUIRE(compress(compressed.data(), &compressedSize, stream.data() + pos, static_cast<uLong>(size)) == Z_OK);
+
+      auto chunk = CaptureChunk { };
+      chunk.compressedSize = static_cast<uint32_t>(compressedSize);
+      chunk.uncompressedSize = static_cast<uint32_t>(size);
+      out.write(reinterpret_cast<const char *>(&chunk), sizeof(chunk));
+      out.write(reinterpret_cast<const char *>(compressed.data()), compressedSize);
+   }
+
+   REQUIRE(out.good());
+}
+
+static void
+writeUncompressed(const std::string &path,
+                  const std::vector<uint8_t> &stream)
+{
+   std::ofstream out { path, std::ofstream::binary | std::ofstream::trunc };
+   out.write(CaptureMagic.data(), CaptureMagic.size());
+   out.write(reinterpret_cast<const char *>(stream.data()), stream.size());
+   REQUIRE(out.good());
+}
+
+static void
+requireMemoryLoad(CaptureReader &reader,
+                  uint32_t address,
+                  const std::vector<uint8_t> &expected)
+{
+   auto packet = CapturePacket { };
+   auto data = std::vector<uint8_t> { };
+   REQUIRE(reader.readPacket(packet, data));
+   REQUIRE(packet.type == CapturePacket::MemoryLoad);
+   REQUIRE(packet.size == sizeof(CaptureMemoryLoad) + expected.size());
+   REQUIRE(data.size() == packet.size);
+
+   auto load = CaptureMemoryLoad { };
+   std::memcpy(&load, data.data(), sizeof(load));
+   REQUIRE(load.type == CaptureMemoryLoad::Surface);
+   REQUIRE(load.address == address);
+   REQUIRE(std::equal(expected.begin(), expected.end(), data.begin() + sizeof(CaptureMemoryLoad)));
+}
+
+static void
+requireCommandBuffer(CaptureReader &reader,
+                     const std::vector<uint8_t> &expected)
+{
+   auto packet = CapturePacket { };
+   auto data = std::vector<uint8_t> { };
+   REQUIRE(reader.readPacket(packet, data));
+   REQUIRE(packet.type == CapturePacket::CommandBuffer);
+   REQUIRE(data == expected);
+}
+
+static void
+requireEof(CaptureReader &reader)
+{
+   auto packet = CapturePacket { };
+   auto data = std::vector<uint8_t> { };
+   REQUIRE(!reader.readPacket(packet, data));
+   REQUIRE(reader.eof());
+}
+
+TEST_CASE("Compressed captures read back the packets they were written with")
+{
+   auto commands = std::vector<uint8_t>(4000);
+   auto surface = std::vector<uint8_t>(10000);
+   auto other = std::vector<uint8_t>(64);
+
+   for (auto i = 0u; i < commands.size(); ++i) {
+      commands[i] = static_cast<uint8_t>(i * 13);
+   }
+
+   for (auto i = 0u; i < surface.size(); ++i) {
+      surface[i] = static_cast<uint8_t>(i >> 4);
+   }
+
+   std::fill(other.begin(), other.end(), uint8_t { 0xCD });
+
+   // The surface is loaded twice but only stored once
+   auto stream = std::vector<uint8_t> { };
+   appendPacket(stream, CapturePacket::CommandBuffer, nullptr, 0, commands);
+   appendBlob(stream, 1, surface);
+   appendLoadBlob(stream, 1, 0x10000000);
+   appendBlob(stream, 2, other);
+   appendLoadBlob(stream, 2, 0x20000000);
+   appendLoadBlob(stream, 1, 0x30000000);
+   appendPacket(stream, CapturePacket::CommandBuffer, nullptr, 0, commands);
+
+   auto check =
+      [&](const std::string &path) {
+         auto reader = CaptureReader { };
+         REQUIRE(reader.open(path));
+         requireCommandBuffer(reader, commands);
+         requireMemoryLoad(reader, 0x10000000, surface);
+         requireMemoryLoad(reader, 0x20000000, other);
+         requireMemoryLoad(reader, 0x30000000, surface);
+         requireCommandBuffer(reader, commands);
+         requireEof(reader);
+      };
+
+   SECTION("uncompressed")
+   {
+      writeUncompressed("capture.pm4", stream);
+      check("capture.pm4");
+   }
+
+   SECTION("one chunk")
+   {
+      writeCompressed("capture_one_chunk.pm4", stream, stream.size());
+      check("capture_one_chunk.pm4");
+   }
+
+   SECTION("packets split across chunks")
+   {
+      // Small enough that headers and payloads straddle chunk boundaries
+      writeCompressed("capture_split.pm4", stream, 999);
+      check("capture_split.pm4");
+   }
+}
+
+TEST_CASE("Truncated compressed captures end at the last whole packet")
+{
+   auto commands = std::vector<uint8_t>(256, uint8_t { 0x42 });
+   auto stream = std::vector<uint8_t> { };
+   appendPacket(stream, CapturePacket::CommandBuffer, nullptr, 0, commands);
+   appendPacket(stream, CapturePacket::CommandBuffer, nullptr, 0, commands);
+
+   // Drop the end of the second packet
+   stream.resize(stream.size() - 16);
+   writeCompressed("capture_truncated.pm4", stream, 100);
+
+   auto reader = CaptureReader { };
+   REQUIRE(reader.open("capture_truncated.pm4"));
+   requireCommandBuffer(reader, commands);
+   requireEof(reader);
+}
+
+//! Builds a big endian command buffer of a NOP followed by an optional swap
+static std::vector<uint8_t>
+makeCommandBuffer(uint32_t marker,
+                  bool swap)
+{
+   using namespace latte::pm4;
+   auto words = std::vector<uint32_t> { };
+
+   // The NOP payload looks like a swap, only packet headers must be matched
+   auto swapHeader = HeaderType3::get(0)
+      .type(PacketType::Type3)
+      .opcode(IT_OPCODE::DECAF_SWAP_BUFFERS)
+      .size(0);
+
+   words.push_back(HeaderType3::get(0)
+      .type(PacketType::Type3)
+      .opcode(IT_OPCODE::NOP)
+      .size(1).value);
+   words.push_back(swapHeader.value);
+   words.push_back(marker);
+   words.push_back(HeaderType2::get(0)
+      .type(PacketType::Type2).value);
+
+   if (swap) {
+      words.push_back(swapHeader.value);
+      words.push_back(0);
+   }
+
+   auto data = std::vector<uint8_t>(words.size() * 4);
+
+   for (auto i = 0u; i < words.size(); ++i) {
+      auto word = byte_swap(words[i]);
+      std::memcpy(data.data() + i * 4, &word, 4);
+   }
+
+   return data;
+}
+
+static void
+appendMemoryLoad(std::vector<uint8_t> &stream,
+                 uint32_t address,
+                 const std::vector<uint8_t> &data)
+{
+   auto load = CaptureMemoryLoad { };
+   load.type = CaptureMemoryLoad::Surface;
+   load.address = address;
+   appendPacket(stream, CapturePacket::MemoryLoad, &load, sizeof(load), data);
+}
+
+static void
+requirePacket(CaptureReader &reader,
+              CapturePacket::Type type,
+              const std::vector<uint8_t> &expected)
+{
+   auto packet = CapturePacket { };
+   auto data = std::vector<uint8_t> { };
+   REQUIRE(reader.readPacket(packet, data));
+   REQUIRE(packet.type == type);
+   REQUIRE(data == expected);
+}
+
+static void
+requireIndexedPacket(const IndexedCapture &capture,
+                     uint32_t index,
+                     CapturePacket::Type type,
+                     uint32_t address,
+                     const std::vector<uint8_t> &expected)
+{
+   auto &packet = capture.packet(index);
+   REQUIRE(packet.type == type);
+   REQUIRE(packet.size == expected.size());
+   REQUIRE(packet.offset % CapturePageSize == 0);
+   REQUIRE(std::equal(expected.begin(), expected.end(), capture.payload(packet)));
+
+   if (type == CapturePacket::MemoryLoad) {
+      REQUIRE(packet.memoryType == CaptureMemoryLoad::Surface);
+      REQUIRE(packet.address == address);
+   }
+}
+
+static std::vector<uint8_t>
+readFile(const std::string &path)
+{
+   std::ifstream in { path, std::ifstream::binary };
+   return { std::istreambuf_iterator<char> { in }, std::istreambuf_iterator<char> { } };
+}
+
+static void
+writeFile(const std::string &path,
+          const std::vector<uint8_t> &data)
+{
+   std::ofstream out { path, std::ofstream::binary | std::ofstream::trunc };
+   out.write(reinterpret_cast<const char *>(data.data()), data.size());
+   REQUIRE(out.good());
+}
+
+TEST_CASE("Indexed captures split frames at swaps and share identical memory")
+{
+   auto draw = makeCommandBuffer(1, false);
+   auto swap = makeCommandBuffer(2, true);
+   auto surface = std::vector<uint8_t>(5000);
+   auto other = std::vector<uint8_t>(100, uint8_t { 0xAB });
+   auto registers = std::vector<uint8_t>(300, uint8_t { 0x12 });
+   auto buffer = std::vector<uint8_t>(sizeof(CaptureSetBuffer), uint8_t { 0x34 });
+
+   for (auto i = 0u; i < surface.size(); ++i) {
+      surface[i] = static_cast<uint8_t>(i * 7);
+   }
+
+   auto stream = std::vector<uint8_t> { };
+
+   // Frame 0
+   appendMemoryLoad(stream, 0x10000000, surface);
+   appendPacket(stream, CapturePacket::CommandBuffer, nullptr, 0, draw);
+   appendPacket(stream, CapturePacket::CommandBuffer, nullptr, 0, swap);
+
+   // Frame 1, the blob is not a packet of its own in the indexed capture
+   appendPacket(stream, CapturePacket::RegisterSnapshot, nullptr, 0, registers);
+   appendPacket(stream, CapturePacket::SetBuffer, nullptr, 0, buffer);
+   appendMemoryLoad(stream, 0x30000000, surface);
+   appendBlob(stream, 1, other);
+   appendLoadBlob(stream, 1, 0x20000000);
+   appendPacket(stream, CapturePacket::CommandBuffer, nullptr, 0, swap);
+
+   // Frame 2 never swaps
+   appendPacket(stream, CapturePacket::CommandBuffer, nullptr, 0, draw);
+
+   auto check =
+      [&](const std::string &path) {
+         auto capture = IndexedCapture { };
+         REQUIRE(capture.open(path));
+         REQUIRE(capture.numPackets() == 9);
+         REQUIRE(capture.numFrames() == 3);
+
+         REQUIRE(capture.frame(0).firstPacket == 0);
+         REQUIRE(capture.frame(0).numPackets == 3);
+         REQUIRE(capture.frame(1).firstPacket == 3);
+         REQUIRE(capture.frame(1).numPackets == 5);
+         REQUIRE(capture.frame(2).firstPacket == 8);
+         REQUIRE(capture.frame(2).numPackets == 1);
+
+         requireIndexedPacket(capture, 0, CapturePacket::MemoryLoad, 0x10000000, surface);
+         requireIndexedPacket(capture, 1, CapturePacket::CommandBuffer, 0, draw);
+         requireIndexedPacket(capture, 2, CapturePacket::CommandBuffer, 0, swap);
+         requireIndexedPacket(capture, 3, CapturePacket::RegisterSnapshot, 0, registers);
+         requireIndexedPacket(capture, 4, CapturePacket::SetBuffer, 0, buffer);
+         requireIndexedPacket(capture, 5, CapturePacket::MemoryLoad, 0x30000000, surface);
+         requireIndexedPacket(capture, 6, CapturePacket::MemoryLoad, 0x20000000, other);
+         requireIndexedPacket(capture, 7, CapturePacket::CommandBuffer, 0, swap);
+         requireIndexedPacket(capture, 8, CapturePacket::CommandBuffer, 0, draw);
+
+         // The second load of the surface shares the payload of the first
+         REQUIRE(capture.packet(5).offset == capture.packet(0).offset);
+         REQUIRE(capture.packet(6).offset != capture.packet(0).offset);
+         REQUIRE(capture.packet(7).offset != capture.packet(2).offset);
+         capture.close();
+
+         auto reader = CaptureReader { };
+         REQUIRE(reader.open(path));
+         requireMemoryLoad(reader, 0x10000000, surface);
+         requireCommandBuffer(reader, draw);
+         requireCommandBuffer(reader, swap);
+         requirePacket(reader, CapturePacket::RegisterSnapshot, registers);
+         requirePacket(reader, CapturePacket::SetBuffer, buffer);
+         requireMemoryLoad(reader, 0x30000000, surface);
+         requireMemoryLoad(reader, 0x20000000, other);
+         requireCommandBuffer(reader, swap);
+         requireCommandBuffer(reader, draw);
+         requireEof(reader);
+      };
+
+   SECTION("from uncompressed")
+   {
+      writeUncompressed("capture_index_src.pm4", stream);
+      REQUIRE(convertToIndexedCapture("capture_index_src.pm4", "capture_index.pm4"));
+      check("capture_index.pm4");
+   }
+
+   SECTION("from compressed")
+   {
+      writeCompressed("capture_index_srcz.pm4", stream, 999);
+      REQUIRE(convertToIndexedCapture("capture_index_srcz.pm4", "capture_indexz.pm4"));
+      check("capture_indexz.pm4");
+   }
+}
+
+TEST_CASE("Indexed captures with a damaged index are rejected")
+{
+   auto stream = std::vector<uint8_t> { };
+   appendMemoryLoad(stream, 0x10000000, std::vector<uint8_t>(64, uint8_t { 0x56 }));
+   appendPacket(stream, CapturePacket::CommandBuffer, nullptr, 0, makeCommandBuffer(1, true));
+   writeUncompressed("capture_damaged_src.pm4", stream);
+   REQUIRE(convertToIndexedCapture("capture_damaged_src.pm4", "capture_damaged_ok.pm4"));
+
+   auto capture = IndexedCapture { };
+   REQUIRE(capture.open("capture_damaged_ok.pm4"));
+   capture.close();
+
+   auto file = readFile("capture_damaged_ok.pm4");
+   auto footer = CaptureIndexFooter { };
+   REQUIRE(file.size() > sizeof(footer));
+   std::memcpy(&footer, file.data() + file.size() - sizeof(footer), sizeof(footer));
+
+   auto writeFooter =
+      [&]() {
+         std::memcpy(file.data() + file.size() - sizeof(footer), &footer, sizeof(footer));
+      };
+
+   SECTION("footer cut off")
+   {
+      file.resize(file.size() - 8);
+   }
+
+   SECTION("payloads cut off")
+   {
+      // Keeps a valid looking footer whose index is now past the end
+      file.erase(file.begin() + CapturePageSize, file.end() - sizeof(footer));
+   }
+
+   SECTION("too many packets")
+   {
+      footer.numPackets = 0x10000000;
+      writeFooter();
+   }
+
+   SECTION("frame index past the end")
+   {
+      footer.framesOffset = file.size();
+      writeFooter();
+   }
+
+   SECTION("payload past the end")
+   {
+      auto packet = CaptureIndexPacket { };
+      auto pos = static_cast<size_t>(footer.packetsOffset) + sizeof(packet);
+      std::memcpy(&packet, file.data() + pos, sizeof(packet));
+      packet.offset = file.size() - 4;
+      std::memcpy(file.data() + pos, &packet, sizeof(packet));
+   }
+
+   SECTION("frame past the packet index")
+   {
+      auto frame = CaptureIndexFrame { };
+      auto pos = static_cast<size_t>(footer.framesOffset);
+      std::memcpy(&frame, file.data() + pos, sizeof(frame));
+      frame.numPackets = footer.numPackets + 1;
+      std::memcpy(file.data() + pos, &frame, sizeof(frame));
+   }
+
+   writeFile("capture_damaged.pm4", file);
+   REQUIRE(!capture.open("capture_damaged.pm4"));
+
+   // Nor does the reader mistake it for one of the streamed formats
+   auto reader = CaptureReader { };
+   REQUIRE(!reader.open("capture_damaged.pm4"));
+}
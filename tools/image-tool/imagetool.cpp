@@ -0,0 +1,112 @@
+#include <filesystem/filesystem_image_archive.h>
+#include <filesystem/filesystem_image_format.h>
+#include <filesystem/filesystem_image_packer.h>
+
+#include <excmd.h>
+#include <iostream>
+#include <spdlog/spdlog.h>
+#include <string>
+#include <zlib.h>
+
+std::shared_ptr<spdlog::logger>
+gLog;
+
+static bool
+printInfo(const std::string &path)
+{
+   auto image = fs::ImageArchive::open(path);
+
+   if (!image) {
+      std::cout << "Could not open image " << path << std::endl;
+      return false;
+   }
+
+   auto printFolder =
+      [&](const std::string &folder, const std::string &indent, auto &self) -> void {
+         for (auto entry : image->findChildren(folder)) {
+            auto entryPath = image->getEntryPath(entry);
+
+            if (entry->type == fs::ImageEntryType::Folder) {
+               std::cout << indent << image->getEntryName(entry) << "/" << std::endl;
+               self(entryPath, indent + "  ", self);
+            } else {
+               std::cout << indent << image->getEntryName(entry) << " (" << entry->size << " bytes)" << std::endl;
+            }
+         }
+      };
+
+   printFolder({}, {}, printFolder);
+   return true;
+}
+
+int main(int argc, char **argv)
+{
+   int result = -1;
+   excmd::parser parser;
+   excmd::option_state options;
+
+   // Setup command line options
+   parser.global_options()
+      .add_option("h,help", excmd::description { "Show the help." });
+
+   parser.add_command("help")
+      .add_argument("command", excmd::value<std::string> { });
+
+   parser.add_command("info")
+      .add_argument("image", excmd::value<std::string> { });
+
+   parser.add_command("pack")
+      .add_option("chunk-size",
+                  excmd::description { "Uncompressed size of each chunk in bytes." },
+                  excmd::default_value<uint32_t> { fs::ImageDefaultChunkSize })
+      .add_option("level",
+                  excmd::description { "zlib compression level, 0 stores chunks uncompressed." },
+                  excmd::default_value<int> { Z_BEST_COMPRESSION })
+      .add_argument("src", excmd::value<std::string> { })
+      .add_argument("dst", excmd::value<std::string> { });
+
+   // Parse command line
+   try {
+      options = parser.parse(argc, argv);
+   } catch (excmd::exception ex) {
+      std::cout << "Error parsing command line: " << ex.what() << std::endl;
+      std::exit(-1);
+   }
+
+   // Print help
+   if (argc == 1 || options.has("help")) {
+      if (options.has("command")) {
+         std::cout << parser.format_help("image-tool", options.get<std::string>("command")) << std::endl;
+      } else {
+         std::cout << parser.format_help("image-tool") << std::endl;
+      }
+
+      std::exit(0);
+   }
+
+   gLog = std::make_shared<spdlog::logger>("image-tool", spdlog::sinks::stdout_sink_st::instance());
+
+   if (options.has("info")) {
+      auto image = options.get<std::string>("image");
+      result = printInfo(image) ? 0 : -1;
+   } else if (options.has("pack")) {
+      auto src = options.get<std::string>("src");
+      auto dst = options.get<std::string>("dst");
+      auto packOptions = fs::ImagePackOptions { };
+      packOptions.chunkSize = options.get<uint32_t>("chunk-size");
+      packOptions.level = options.get<int>("level");
+
+      if (packOptions.level == 0) {
+         packOptions.compression = fs::ImageCompression::None;
+      }
+
+      if (packOptions.chunkSize == 0) {
+         std::cout << "Invalid chunk size" << std::endl;
+         std::exit(-1);
+      }
+
+      result = fs::packImage(src, dst, packOptions) ? 0 : -1;
+   }
+
+   return result;
+}
@@ -0,0 +1,731 @@
+#include <algorithm>
+#include <chrono>
+#include <common/byte_swap.h>
+#include <common/decaf_assert.h>
+#include <common/log.h>
+#include <common/platform_memory.h>
+#include <cstring>
+#include <excmd.h>
+#include <fmt/format.h>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <libcpu/cpu.h>
+#include <libcpu/mem.h>
+#include <libdecaf/decaf.h>
+#include <libdecaf/decaf_pm4replay.h>
+#include <libdecaf/src/kernel/kernel_memory.h>
+#include <libgpu/latte/latte_enum_as_string.h>
+#include <libgpu/latte/latte_pm4_sizer.h>
+#include <libgpu/latte/latte_pm4_writer.h>
+#include <memory>
+#include <pm4_processor.h>
+#include <string>
+#include <vector>
+
+#if defined(DECAF_GL) && defined(DECAF_SDL)
+#define PM4_BENCH_GL
+#include <glbinding/Binding.h>
+#include <glbinding/gl/gl.h>
+#include <libgpu/gpu_opengldriver.h>
+#include <libgpu/gpu_ringbuffer.h>
+#include <SDL.h>
+#endif
+
+/**
+ * A Pm4Processor which does nothing with the packets it parses, so we only
+ * measure the cost of reading and dispatching them.
+ */
+class BenchProcessor : public Pm4Processor
+{
+public:
+   void run(uint32_t *buffer, uint32_t numWords)
+   {
+      runCommandBuffer(buffer, numWords);
+   }
+
+protected:
+   virtual void decafSetBuffer(const DecafSetBuffer &data) override { }
+   virtual void decafCopyColorToScan(const DecafCopyColorToScan &data) override { }
+   virtual void decafSwapBuffers(const DecafSwapBuffers &data) override { }
+   virtual void decafCapSyncRegisters(const DecafCapSyncRegisters &data) override { }
+   virtual void decafClearColor(const DecafClearColor &data) override { }
+   virtual void decafClearDepthStencil(const DecafClearDepthStencil &data) override { }
+   virtual void decafDebugMarker(const DecafDebugMarker &data) override { }
+   virtual void decafOSScreenFlip(const DecafOSScreenFlip &data) override { }
+   virtual void decafCopySurface(const DecafCopySurface &data) override { }
+   virtual void decafSetSwapInterval(const DecafSetSwapInterval &data) override { }
+   virtual void drawIndexAuto(const DrawIndexAuto &data) override { }
+   virtual void drawIndex2(const DrawIndex2 &data) override { }
+   virtual void drawIndexImmd(const DrawIndexImmd &data) override { }
+   virtual void memWrite(const MemWrite &data) override { }
+   virtual void eventWrite(const EventWrite &data) override { }
+   virtual void eventWriteEOP(const EventWriteEOP &data) override { }
+   virtual void pfpSyncMe(const PfpSyncMe &data) override { }
+   virtual void streamOutBaseUpdate(const StreamOutBaseUpdate &data) override { }
+   virtual void streamOutBufferUpdate(const StreamOutBufferUpdate &data) override { }
+   virtual void surfaceSync(const SurfaceSync &data) override { }
+   virtual void applyRegister(latte::Register reg) override { }
+};
+
+/**
+ * Something which command buffers can be run through.
+ */
+class BenchDriver
+{
+public:
+   virtual ~BenchDriver() = default;
+
+   virtual const char *name() = 0;
+   virtual Pm4Processor *processor() = 0;
+   virtual void run(uint32_t *buffer, uint32_t numWords) = 0;
+
+   // Called after guest memory has been loaded from the capture
+   virtual void memoryLoad(void *ptr, uint32_t size) { }
+
+   // Waits for everything which has been run to complete
+   virtual void finish() { }
+};
+
+class NullBenchDriver : public BenchDriver
+{
+public:
+   virtual const char *name() override
+   {
+      return "null";
+   }
+
+   virtual Pm4Processor *processor() override
+   {
+      return &mProcessor;
+   }
+
+   virtual void run(uint32_t *buffer, uint32_t numWords) override
+   {
+      mProcessor.run(buffer, numWords);
+   }
+
+private:
+   BenchProcessor mProcessor;
+};
+
+#ifdef PM4_BENCH_GL
+
+/**
+ * Runs command buffers through the OpenGL driver on a hidden window, on the
+ * calling thread using syncPoll. On a machine without a GPU this can use a
+ * software renderer, for example with LIBGL_ALWAYS_SOFTWARE=1 on Mesa.
+ */
+class GLBenchDriver : public BenchDriver
+{
+public:
+   ~GLBenchDriver()
+   {
+      delete mDriver;
+
+      if (mContext) {
+         SDL_GL_DeleteContext(mContext);
+      }
+
+      if (mWindow) {
+         SDL_DestroyWindow(mWindow);
+      }
+   }
+
+   bool initialise()
+   {
+      if (SDL_Init(SDL_INIT_VIDEO) != 0) {
+         std::cout << "Failed to initialize SDL: " << SDL_GetError() << std::endl;
+         return false;
+      }
+
+      SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 4);
+      SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 5);
+      SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+
+      mWindow = SDL_CreateWindow("pm4-bench",
+                                 SDL_WINDOWPOS_UNDEFINED,
+                                 SDL_WINDOWPOS_UNDEFINED,
+                                 16, 16,
+                                 SDL_WINDOW_OPENGL | SDL_WINDOW_HIDDEN);
+
+      if (!mWindow) {
+         std::cout << "Failed to create window: " << SDL_GetError() << std::endl;
+         return false;
+      }
+
+      mContext = SDL_GL_CreateContext(mWindow);
+
+      if (!mContext) {
+         std::cout << "Failed to create OpenGL 4.5 context: " << SDL_GetError() << std::endl;
+         return false;
+      }
+
+      glbinding::Binding::initialize();
+      mDriver = reinterpret_cast<gpu::OpenGLDriver *>(gpu::createGLDriver());
+      mProcessor = dynamic_cast<Pm4Processor *>(mDriver);
+      decaf_check(mProcessor);
+      return true;
+   }
+
+   virtual const char *name() override
+   {
+      return "gl";
+   }
+
+   virtual Pm4Processor *processor() override
+   {
+      return mProcessor;
+   }
+
+   virtual void run(uint32_t *buffer, uint32_t numWords) override
+   {
+      gpu::ringbuffer::submit(nullptr, buffer, numWords);
+      mDriver->syncPoll([](gl::GLuint, gl::GLuint) { });
+   }
+
+   virtual void memoryLoad(void *ptr, uint32_t size) override
+   {
+      mDriver->notifyCpuFlush(ptr, size);
+   }
+
+   virtual void finish() override
+   {
+      gl::glFinish();
+      mDriver->syncPoll([](gl::GLuint, gl::GLuint) { });
+   }
+
+private:
+   SDL_Window *mWindow = nullptr;
+   SDL_GLContext mContext = nullptr;
+   gpu::OpenGLDriver *mDriver = nullptr;
+   Pm4Processor *mProcessor = nullptr;
+};
+
+#endif // ifdef PM4_BENCH_GL
+
+struct CaptureEvent
+{
+   decaf::pm4::CapturePacket::Type type;
+   uint32_t address = 0;
+   std::vector<uint8_t> data;
+};
+
+// Serialises a packet on its own, like gx2::internal::writePM4 does
+template<typename Type>
+static std::vector<uint8_t>
+encodePacket(const Type &value)
+{
+   auto &ncValue = const_cast<Type &>(value);
+   latte::pm4::PacketSizer sizer;
+   ncValue.serialise(sizer);
+
+   auto totalSize = sizer.getSize() + 1;
+   auto words = std::vector<uint32_t>(totalSize);
+   auto curSize = 0u;
+
+   {
+      auto writer = latte::pm4::PacketWriter { words.data(), curSize, Type::Opcode, totalSize };
+      ncValue.serialise(writer);
+   }
+
+   auto bytes = reinterpret_cast<uint8_t *>(words.data());
+   return { bytes, bytes + words.size() * sizeof(uint32_t) };
+}
+
+template<typename Type>
+static void
+appendPacket(std::vector<uint8_t> &buffer,
+             const Type &value)
+{
+   auto packet = encodePacket(value);
+   buffer.insert(buffer.end(), packet.begin(), packet.end());
+}
+
+template<typename Type>
+static void
+appendRegisterLoad(std::vector<uint8_t> &buffer,
+                   be_val<uint32_t> *registers,
+                   uint32_t base,
+                   uint32_t end)
+{
+   auto range = std::pair<uint32_t, uint32_t> { 0, (end - base) / 4 };
+   appendPacket(buffer, Type { registers + base / 4, gsl::make_span(&range, 1) });
+}
+
+/**
+ * Turns a register snapshot into the same LOAD_ packets pm4-replay writes
+ * for it: the registers are copied into guest memory as big endian, then a
+ * command buffer loads them from there.
+ */
+static void
+addRegisterSnapshot(const uint8_t *data,
+                    uint32_t size,
+                    std::vector<CaptureEvent> &events)
+{
+   decaf_check((size % 4) == 0);
+   auto storage = kernel::getVirtualRange(kernel::VirtualRegion::SystemHeap).start.getAddress();
+   auto registers = mem::translate<be_val<uint32_t>>(storage);
+
+   auto load = CaptureEvent { };
+   load.type = decaf::pm4::CapturePacket::MemoryLoad;
+   load.address = storage;
+   load.data.resize(size);
+
+   for (auto i = 0u; i < size / 4; ++i) {
+      auto value = uint32_t { 0 };
+      std::memcpy(&value, data + i * 4, 4);
+      value = byte_swap(value);
+      std::memcpy(load.data.data() + i * 4, &value, 4);
+   }
+
+   auto LOAD_CONTROL = latte::CONTEXT_CONTROL_ENABLE::get(0)
+      .ENABLE_CONFIG_REG(true)
+      .ENABLE_CONTEXT_REG(true)
+      .ENABLE_ALU_CONST(true)
+      .ENABLE_BOOL_CONST(true)
+      .ENABLE_LOOP_CONST(true)
+      .ENABLE_RESOURCE(true)
+      .ENABLE_SAMPLER(true)
+      .ENABLE_CTL_CONST(true)
+      .ENABLE_ORDINAL(true);
+
+   auto commands = CaptureEvent { };
+   commands.type = decaf::pm4::CapturePacket::CommandBuffer;
+   appendPacket(commands.data, ContextControl { LOAD_CONTROL, latte::CONTEXT_CONTROL_ENABLE::get(0) });
+   appendRegisterLoad<LoadConfigReg>(commands.data, registers, latte::Register::ConfigRegisterBase, latte::Register::ConfigRegisterEnd);
+   appendRegisterLoad<LoadContextReg>(commands.data, registers, latte::Register::ContextRegisterBase, latte::Register::ContextRegisterEnd);
+   appendRegisterLoad<LoadAluConst>(commands.data, registers, latte::Register::AluConstRegisterBase, latte::Register::AluConstRegisterEnd);
+   appendRegisterLoad<LoadResource>(commands.data, registers, latte::Register::ResourceRegisterBase, latte::Register::ResourceRegisterEnd);
+   appendRegisterLoad<LoadSampler>(commands.data, registers, latte::Register::SamplerRegisterBase, latte::Register::SamplerRegisterEnd);
+   appendRegisterLoad<LoadControlConst>(commands.data, registers, latte::Register::ControlRegisterBase, latte::Register::ControlRegisterEnd);
+   appendRegisterLoad<LoadLoopConst>(commands.data, registers, latte::Register::LoopConstRegisterBase, latte::Register::LoopConstRegisterEnd);
+
+   events.emplace_back(std::move(load));
+   events.emplace_back(std::move(commands));
+}
+
+static bool
+readCapture(const std::string &path,
+            std::vector<CaptureEvent> &events)
+{
+   decaf::pm4::CaptureReader reader;
+
+   if (!reader.open(path)) {
+      std::cout << "Could not open " << path << " as a pm4 capture" << std::endl;
+      return false;
+   }
+
+   auto packet = decaf::pm4::CapturePacket { };
+   auto data = std::vector<uint8_t> { };
+   auto hasInitialRegisters = false;
+   auto hasCommands = false;
+
+   while (reader.readPacket(packet, data)) {
+      auto event = CaptureEvent { };
+      event.type = packet.type;
+
+      if (packet.type == decaf::pm4::CapturePacket::RegisterSnapshot) {
+         if (!hasCommands) {
+            hasInitialRegisters = true;
+         }
+
+         addRegisterSnapshot(data.data(), packet.size, events);
+         continue;
+      } else if (packet.type == decaf::pm4::CapturePacket::CommandBuffer) {
+         hasCommands = true;
+         event.data = data;
+      } else if (packet.type == decaf::pm4::CapturePacket::MemoryLoad) {
+         auto load = decaf::pm4::CaptureMemoryLoad { };
+         std::memcpy(&load, data.data(), sizeof(load));
+         event.address = load.address;
+         event.data.assign(data.begin() + sizeof(load), data.end());
+      } else if (packet.type == decaf::pm4::CapturePacket::SetBuffer) {
+         // The driver needs to know about the scan buffers before it can
+         //  copy to them, so run the same packet pm4-replay would.
+         auto setBuffer = decaf::pm4::CaptureSetBuffer { };
+         std::memcpy(&setBuffer, data.data(), sizeof(setBuffer));
+
+         auto isTv = (setBuffer.type == decaf::pm4::CaptureSetBuffer::TvBuffer) ? 1u : 0u;
+         event.type = decaf::pm4::CapturePacket::CommandBuffer;
+         event.data = encodePacket(DecafSetBuffer {
+            isTv,
+            setBuffer.bufferingMode,
+            setBuffer.width,
+            setBuffer.height
+         });
+      } else {
+         continue;
+      }
+
+      events.emplace_back(std::move(event));
+   }
+
+   if (!hasInitialRegisters) {
+      // Start every iteration from the same register state rather than
+      //  from whatever the previous iteration left behind.
+      auto reset = std::vector<CaptureEvent> { };
+      auto registers = std::vector<uint8_t>(latte::Register::LoopConstRegisterEnd);
+      addRegisterSnapshot(registers.data(), static_cast<uint32_t>(registers.size()), reset);
+      events.insert(events.begin(),
+                    std::make_move_iterator(reset.begin()),
+                    std::make_move_iterator(reset.end()));
+   }
+
+   return true;
+}
+
+struct BenchResult
+{
+   std::string capture;
+   std::string driver;
+   unsigned iterations = 0;
+   bool timedPackets = false;
+   double seconds = 0.0;
+   uint64_t numBuffers = 0;
+   uint64_t numWords = 0;
+   uint64_t numPackets = 0;
+   uint64_t numDraws = 0;
+   uint64_t numRegisterWrites = 0;
+   size_t peakMemory = 0;
+
+   struct Opcode
+   {
+      std::string name;
+      Pm4Processor::PacketStats stats;
+   };
+
+   std::vector<Opcode> opcodes;
+};
+
+static void
+collectStats(Pm4Processor *processor,
+             BenchResult &result)
+{
+   auto addStats = [&](const std::string &name, const Pm4Processor::PacketStats &stats) {
+      if (stats.count) {
+         result.numPackets += stats.count;
+         result.opcodes.push_back({ name, stats });
+      }
+   };
+
+   addStats("TYPE0", processor->getType0Stats());
+
+   for (auto i = 0u; i < 256; ++i) {
+      auto opcode = static_cast<IT_OPCODE>(i);
+      addStats(latte::pm4::to_string(opcode), processor->getType3Stats(opcode));
+   }
+
+   result.numDraws = processor->getType3Stats(IT_OPCODE::DRAW_INDEX_AUTO).count
+                   + processor->getType3Stats(IT_OPCODE::DRAW_INDEX_2).count
+                   + processor->getType3Stats(IT_OPCODE::DRAW_INDEX_IMMD).count;
+   result.numRegisterWrites = processor->getRegisterWrites();
+
+   // Most expensive first, or most frequent when we did not time them
+   std::sort(result.opcodes.begin(), result.opcodes.end(),
+             [](const BenchResult::Opcode &lhs, const BenchResult::Opcode &rhs) {
+                if (lhs.stats.totalNs != rhs.stats.totalNs) {
+                   return lhs.stats.totalNs > rhs.stats.totalNs;
+                }
+
+                return lhs.stats.count > rhs.stats.count;
+             });
+}
+
+//! Rate of count per second, 0 when the run was too short to be timed
+static double
+perSecond(double count,
+          double seconds)
+{
+   return seconds > 0.0 ? count / seconds : 0.0;
+}
+
+static void
+printResult(const BenchResult &result)
+{
+   auto seconds = result.seconds;
+
+   std::cout << "Replayed " << result.numBuffers << " command buffers through the "
+             << result.driver << " driver in " << (seconds * 1000.0) << " ms" << std::endl;
+   std::cout << "  " << perSecond(result.numWords * 4 / (1024.0 * 1024.0), seconds) << " MiB/s" << std::endl;
+   std::cout << "  " << perSecond(result.numPackets, seconds) << " packets/s" << std::endl;
+   std::cout << "  " << perSecond(result.numDraws, seconds) << " draws/s" << std::endl;
+   std::cout << "  " << perSecond(result.numRegisterWrites, seconds) << " register writes/s" << std::endl;
+   std::cout << "  " << (result.peakMemory / (1024.0 * 1024.0)) << " MiB peak memory" << std::endl;
+
+   if (!result.timedPackets) {
+      return;
+   }
+
+   std::cout << std::endl;
+   std::cout << std::left << std::setw(32) << "Opcode"
+             << std::right << std::setw(12) << "Count"
+             << std::setw(14) << "Total ms"
+             << std::setw(12) << "Mean ns" << std::endl;
+
+   for (auto &opcode : result.opcodes) {
+      std::cout << std::left << std::setw(32) << opcode.name
+                << std::right << std::setw(12) << opcode.stats.count
+                << std::setw(14) << std::fixed << std::setprecision(3) << (opcode.stats.totalNs / 1000000.0)
+                << std::setw(12) << std::setprecision(0) << (static_cast<double>(opcode.stats.totalNs) / opcode.stats.count)
+                << std::endl;
+   }
+
+   std::cout.unsetf(std::ios::floatfield);
+}
+
+//! Quotes a string for JSON, escaping quotes, backslashes and control characters
+static std::string
+jsonString(const std::string &value)
+{
+   auto result = std::string { "\"" };
+
+   for (auto c : value) {
+      switch (c) {
+      case '"':
+         result += "\\\"";
+         break;
+      case '\\':
+         result += "\\\\";
+         break;
+      case '\n':
+         result += "\\n";
+         break;
+      case '\r':
+         result += "\\r";
+         break;
+      case '\t':
+         result += "\\t";
+         break;
+      default:
+         if (static_cast<unsigned char>(c) < 0x20) {
+            result += fmt::format("\\u{:04x}", static_cast<unsigned>(c));
+         } else {
+            result += c;
+         }
+      }
+   }
+
+   result += '"';
+   return result;
+}
+
+static bool
+writeJson(const BenchResult &result,
+          const std::string &path)
+{
+   std::ofstream out { path };
+
+   if (!out.is_open()) {
+      std::cout << "Could not open " << path << " for writing" << std::endl;
+      return false;
+   }
+
+   out << std::setprecision(10);
+   out << "{\n";
+   out << "  \"capture\": " << jsonString(result.capture) << ",\n";
+   out << "  \"driver\": " << jsonString(result.driver) << ",\n";
+   out << "  \"iterations\": " << result.iterations << ",\n";
+   out << "  \"seconds\": " << result.seconds << ",\n";
+   out << "  \"commandBuffers\": " << result.numBuffers << ",\n";
+   out << "  \"bytes\": " << result.numWords * 4 << ",\n";
+   out << "  \"packets\": " << result.numPackets << ",\n";
+   out << "  \"draws\": " << result.numDraws << ",\n";
+   out << "  \"registerWrites\": " << result.numRegisterWrites << ",\n";
+   out << "  \"packetsPerSecond\": " << perSecond(result.numPackets, result.seconds) << ",\n";
+   out << "  \"drawsPerSecond\": " << perSecond(result.numDraws, result.seconds) << ",\n";
+   out << "  \"peakMemoryBytes\": " << result.peakMemory << ",\n";
+   out << "  \"opcodes\": [";
+
+   for (auto i = 0u; i < result.opcodes.size(); ++i) {
+      auto &opcode = result.opcodes[i];
+      out << (i ? ",\n" : "\n");
+      out << "    { \"name\": " << jsonString(opcode.name) << ", \"count\": " << opcode.stats.count;
+
+      if (result.timedPackets) {
+         // Bucket n holds packets which took from 2^n up to 2^(n+1) ns
+         auto lastBucket = opcode.stats.histogram.size();
+
+         while (lastBucket > 0 && !opcode.stats.histogram[lastBucket - 1]) {
+            --lastBucket;
+         }
+
+         out << ", \"totalNs\": " << opcode.stats.totalNs << ", \"log2NsHistogram\": [";
+
+         for (auto j = 0u; j < lastBucket; ++j) {
+            out << (j ? ", " : "") << opcode.stats.histogram[j];
+         }
+
+         out << "]";
+      }
+
+      out << " }";
+   }
+
+   out << "\n  ]\n";
+   out << "}\n";
+   return !!out;
+}
+
+static std::unique_ptr<BenchDriver>
+createBenchDriver(const std::string &name)
+{
+   if (name == "null") {
+      return std::make_unique<NullBenchDriver>();
+   }
+
+#ifdef PM4_BENCH_GL
+   if (name == "gl") {
+      auto driver = std::make_unique<GLBenchDriver>();
+
+      if (!driver->initialise()) {
+         return nullptr;
+      }
+
+      return std::move(driver);
+   }
+#endif
+
+   std::cout << "Unsupported driver " << name << std::endl;
+   return nullptr;
+}
+
+static int
+runBenchmark(const std::string &path,
+             const std::string &driverName,
+             unsigned iterations,
+             bool timePackets,
+             const std::string &jsonPath)
+{
+   // Indirect buffers and LOAD_ packets point into guest memory
+   cpu::initialise();
+   kernel::initialiseVirtualMemory();
+   kernel::initialiseAppMemory(0x10000);
+
+   auto events = std::vector<CaptureEvent> { };
+
+   if (!readCapture(path, events)) {
+      return -1;
+   }
+
+   auto driver = createBenchDriver(driverName);
+
+   if (!driver) {
+      return -1;
+   }
+
+   auto processor = driver->processor();
+   processor->setPacketTiming(timePackets);
+
+   auto result = BenchResult { };
+   auto elapsed = std::chrono::steady_clock::duration { };
+   result.capture = path;
+   result.driver = driver->name();
+   result.iterations = iterations;
+   result.timedPackets = timePackets;
+
+   for (auto i = 0u; i < iterations; ++i) {
+      for (auto &event : events) {
+         if (event.type == decaf::pm4::CapturePacket::MemoryLoad) {
+            auto ptr = mem::translate(event.address);
+            std::memcpy(ptr, event.data.data(), event.data.size());
+            driver->memoryLoad(ptr, static_cast<uint32_t>(event.data.size()));
+            continue;
+         }
+
+         auto buffer = reinterpret_cast<uint32_t *>(event.data.data());
+         auto size = static_cast<uint32_t>(event.data.size() / 4);
+         auto start = std::chrono::steady_clock::now();
+         driver->run(buffer, size);
+         elapsed += std::chrono::steady_clock::now() - start;
+
+         result.numBuffers++;
+         result.numWords += size;
+      }
+
+      auto start = std::chrono::steady_clock::now();
+      driver->finish();
+      elapsed += std::chrono::steady_clock::now() - start;
+   }
+
+   result.seconds = std::chrono::duration_cast<std::chrono::duration<double>>(elapsed).count();
+   result.peakMemory = platform::getPeakResidentSize();
+   collectStats(processor, result);
+   printResult(result);
+
+   if (!jsonPath.empty() && !writeJson(result, jsonPath)) {
+      return -1;
+   }
+
+   return 0;
+}
+
+int main(int argc, char **argv)
+{
+   excmd::parser parser;
+   excmd::option_state options;
+
+   parser.global_options()
+      .add_option("h,help", excmd::description { "Show the help." });
+
+   parser.add_command("help")
+      .add_argument("command", excmd::value<std::string> { });
+
+   parser.add_command("replay")
+      .add_option("iterations",
+                  excmd::description { "Number of times to replay the capture." },
+                  excmd::default_value<unsigned> { 10 })
+      .add_option("driver",
+                  excmd::description { "Driver to replay through, null only parses the packets." },
+#ifdef PM4_BENCH_GL
+                  excmd::allowed<std::string> { { "null", "gl" } },
+#else
+                  excmd::allowed<std::string> { { "null" } },
+#endif
+                  excmd::default_value<std::string> { "null" })
+      .add_option("time-packets",
+                  excmd::description { "Collect a histogram of how long each opcode takes, this slows down replay." })
+      .add_option("json",
+                  excmd::description { "Also write the results to this file as JSON." },
+                  excmd::value<std::string> { })
+      .add_argument("capture", excmd::value<std::string> { });
+
+   try {
+      options = parser.parse(argc, argv);
+   } catch (excmd::exception ex) {
+      std::cout << "Error parsing command line: " << ex.what() << std::endl;
+      std::exit(-1);
+   }
+
+   if (argc == 1 || options.has("help")) {
+      if (options.has("command")) {
+         std::cout << parser.format_help("pm4-bench", options.get<std::string>("command")) << std::endl;
+      } else {
+         std::cout << parser.format_help("pm4-bench") << std::endl;
+      }
+
+      std::exit(0);
+   }
+
+   decaf::config::log::to_file = false;
+   decaf::config::log::to_stdout = true;
+   decaf::config::log::level = "error";
+   decaf::initialiseLogging("pm4-bench.txt");
+
+   if (options.has("replay")) {
+      auto jsonPath = std::string { };
+
+      if (options.has("json")) {
+         jsonPath = options.get<std::string>("json");
+      }
+
+      return runBenchmark(options.get<std::string>("capture"),
+                          options.get<std::string>("driver"),
+                          options.get<unsigned>("iterations"),
+                          options.has("time-packets"),
+                          jsonPath);
+   }
+
+   return 0;
+}
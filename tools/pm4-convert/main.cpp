@@ -0,0 +1,80 @@
+#include <excmd.h>
+#include <iostream>
+#include <libdecaf/decaf.h>
+#include <libdecaf/decaf_pm4replay.h>
+
+static int
+printInfo(const std::string &path)
+{
+   decaf::pm4::IndexedCapture capture;
+
+   if (!capture.open(path)) {
+      std::cout << path << " is not an indexed pm4 capture" << std::endl;
+      return -1;
+   }
+
+   auto payloadBytes = uint64_t { 0 };
+
+   for (auto i = 0u; i < capture.numPackets(); ++i) {
+      payloadBytes += capture.packet(i).size;
+   }
+
+   std::cout << "Frames: " << capture.numFrames() << std::endl;
+   std::cout << "Packets: " << capture.numPackets() << std::endl;
+   std::cout << "Payload: " << (payloadBytes / (1024.0 * 1024.0)) << " MiB" << std::endl;
+   return 0;
+}
+
+int main(int argc, char **argv)
+{
+   excmd::parser parser;
+   excmd::option_state options;
+
+   parser.global_options()
+      .add_option("h,help", excmd::description { "Show the help." });
+
+   parser.add_command("help")
+      .add_argument("command", excmd::value<std::string> { });
+
+   parser.add_command("convert")
+      .add_argument("src", excmd::value<std::string> { })
+      .add_argument("dst", excmd::value<std::string> { });
+
+   parser.add_command("info")
+      .add_argument("capture", excmd::value<std::string> { });
+
+   try {
+      options = parser.parse(argc, argv);
+   } catch (excmd::exception ex) {
+      std::cout << "Error parsing command line: " << ex.what() << std::endl;
+      std::exit(-1);
+   }
+
+   if (argc == 1 || options.has("help")) {
+      if (options.has("command")) {
+         std::cout << parser.format_help("pm4-convert", options.get<std::string>("command")) << std::endl;
+      } else {
+         std::cout << "Converts pm4 captures to the indexed capture format." << std::endl;
+         std::cout << parser.format_help("pm4-convert") << std::endl;
+      }
+
+      std::exit(0);
+   }
+
+   decaf::config::log::to_file = false;
+   decaf::config::log::to_stdout = true;
+   decaf::config::log::level = "info";
+   decaf::initialiseLogging("pm4-convert.txt");
+
+   if (options.has("convert")) {
+      auto ok = decaf::pm4::convertToIndexedCapture(options.get<std::string>("src"),
+                                                    options.get<std::string>("dst"));
+      return ok ? 0 : -1;
+   }
+
+   if (options.has("info")) {
+      return printInfo(options.get<std::string>("capture"));
+   }
+
+   return 0;
+}
@@ -1,6 +1,34 @@
 #include "replay.h"
 #include <libgpu/latte/latte_enum_as_string.h>
 
+// Compressed and indexed captures can not be used in place, so we read them
+//  into memory in the same layout as an uncompressed capture.
+static std::shared_ptr<ReplayFile>
+openDecodedReplay(const std::string &path)
+{
+   decaf::pm4::CaptureReader reader;
+
+   if (!reader.open(path)) {
+      return nullptr;
+   }
+
+   auto replay = std::make_shared<ReplayFile>();
+   auto &decoded = replay->decoded;
+   auto packet = decaf::pm4::CapturePacket { };
+   auto data = std::vector<uint8_t> { };
+   decoded.insert(decoded.end(), decaf::pm4::CaptureMagic.begin(), decaf::pm4::CaptureMagic.end());
+
+   while (reader.readPacket(packet, data)) {
+      auto header = reinterpret_cast<uint8_t *>(&packet);
+      decoded.insert(decoded.end(), header, header + sizeof(decaf::pm4::CapturePacket));
+      decoded.insert(decoded.end(), data.begin(), data.end());
+   }
+
+   replay->view = decoded.data();
+   replay->size = decoded.size();
+   return replay;
+}
+
 std::shared_ptr<ReplayFile>
 openReplay(const std::string &path)
 {
@@ -22,6 +50,12 @@ openReplay(const std::string &path)
    if (magic != decaf::pm4::CaptureMagic) {
       platform::unmapViewOfFile(fileView, fileSize);
       platform::closeMemoryMappedFile(fileHandle);
+
+      if (magic == decaf::pm4::CaptureMagicCompressed ||
+          magic == decaf::pm4::CaptureMagicIndexed) {
+         return openDecodedReplay(path);
+      }
+
       return nullptr;
    }
 
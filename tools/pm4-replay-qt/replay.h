@@ -47,11 +47,12 @@ struct ReplayFile
 {
    ~ReplayFile()
    {
-      if (view) {
+      if (view && handle != platform::InvalidMapFileHandle) {
          platform::unmapViewOfFile(view, size);
-         view = nullptr;
       }
 
+      view = nullptr;
+
       if (handle != platform::InvalidMapFileHandle) {
          platform::closeMemoryMappedFile(handle);
          handle = platform::InvalidMapFileHandle;
@@ -64,6 +65,9 @@ struct ReplayFile
    uint8_t *view = nullptr;
    size_t size = 0;
    ReplayIndex index;
+
+   //! Decompressed packets of a compressed capture, which view points to
+   std::vector<uint8_t> decoded;
 };
 
 std::shared_ptr<ReplayFile>
@@ -7,5 +7,6 @@ namespace config
 extern bool dump_drc_frames;
 extern bool dump_tv_frames;
 extern std::string dump_frames_dir;
+extern unsigned start_frame;
 
 } // namespace config
@@ -15,6 +15,7 @@ namespace config
 bool dump_drc_frames = false;
 bool dump_tv_frames = false;
 std::string dump_frames_dir = "frames";
+unsigned start_frame = 0;
 
 } // namespace config
 
@@ -46,7 +47,10 @@ getCommandLineParser()
                   description { "Dump rendered TV frames to file." })
       .add_option("dump-frames-dir",
                   description { "Folder to place dumped frames in" },
-                  make_default_value(config::dump_frames_dir));
+                  make_default_value(config::dump_frames_dir))
+      .add_option("frame",
+                  description { "Frame to start replaying from, requires an indexed capture." },
+                  make_default_value(config::start_frame));
 
    parser.add_command("help")
       .add_argument("help-command",
@@ -99,6 +103,10 @@ start(excmd::parser &parser,
       config::dump_frames_dir = options.get<std::string>("dump-frames-dir");
    }
 
+   if (options.has("frame")) {
+      config::start_frame = options.get<unsigned>("frame");
+   }
+
    auto traceFile = options.get<std::string>("trace file");
 
    // Initialise libdecaf logger
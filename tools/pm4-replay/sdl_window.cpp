@@ -3,7 +3,7 @@
 #include "config.h"
 
 #include <array>
-#include <fstream>
+#include <cstring>
 #include <common/teenyheap.h>
 #include <common/platform_dir.h>
 #include <libcpu/mmu.h>
@@ -37,30 +37,61 @@ public:
 
    bool open(const std::string &path)
    {
-      mFile.open(path, std::ifstream::binary);
-
-      if (!mFile.is_open()) {
-         return false;
+      if (mIndexed.open(path)) {
+         mIsIndexed = true;
+         return true;
       }
 
-      std::array<char, 4> magic;
-      mFile.read(magic.data(), 4);
+      return mReader.open(path);
+   }
 
-      if (magic != decaf::pm4::CaptureMagic) {
-         return false;
+   bool eof()
+   {
+      if (mIsIndexed) {
+         return mFrame >= mIndexed.numFrames();
       }
 
-      return true;
+      return mReader.eof();
    }
 
-   bool eof()
+   // Skips to a frame of an indexed capture. Only the memory loads, display
+   // buffers and register snapshots of skipped frames are replayed, which is
+   // enough when the game restores its state from shadow memory every frame.
+   bool seekFrame(uint32_t frame)
    {
-      return mFile.eof();
+      if (!mIsIndexed) {
+         gCliLog->error("Seeking requires an indexed capture, use pm4-convert to create one");
+         return false;
+      }
+
+      if (frame >= mIndexed.numFrames()) {
+         gCliLog->error("Capture only has {} frames", mIndexed.numFrames());
+         return false;
+      }
+
+      for (; mFrame < frame; ++mFrame) {
+         auto &skipped = mIndexed.frame(mFrame);
+
+         for (auto i = 0u; i < skipped.numPackets; ++i) {
+            auto &packet = mIndexed.packet(skipped.firstPacket + i);
+
+            if (packet.type != decaf::pm4::CapturePacket::CommandBuffer) {
+               handleIndexedPacket(packet);
+            }
+         }
+      }
+
+      return true;
    }
 
    bool readFrame()
    {
-      std::vector<char> buffer;
+      if (mIsIndexed) {
+         return readIndexedFrame();
+      }
+
+      decaf::pm4::CapturePacket packet;
+      std::vector<uint8_t> data;
       auto foundSwap = false;
 
       // Free command buffers used from last frame
@@ -71,10 +102,7 @@ public:
       mBuffers.clear();
 
       while (!foundSwap) {
-         decaf::pm4::CapturePacket packet;
-         mFile.read(reinterpret_cast<char *>(&packet), sizeof(decaf::pm4::CapturePacket));
-
-         if (!mFile) {
+         if (!mReader.readPacket(packet, data)) {
             return false;
          }
 
@@ -82,11 +110,7 @@ public:
          case decaf::pm4::CapturePacket::CommandBuffer:
          {
             auto commandBuffer = new uint8_t[packet.size];
-            mFile.read(reinterpret_cast<char *>(commandBuffer), packet.size);
-
-            if (!mFile) {
-               return false;
-            }
+            std::memcpy(commandBuffer, data.data(), packet.size);
 
             foundSwap |= handleCommandBuffer(commandBuffer, packet.size);
             mBuffers.push_back(commandBuffer);
@@ -94,23 +118,13 @@ public:
          }
          case decaf::pm4::CapturePacket::RegisterSnapshot:
          {
-            decaf_check((packet.size % 4) == 0);
-            auto numRegisters = packet.size / 4;
-            mFile.read(reinterpret_cast<char *>(mRegisterStorage), packet.size);
-
-            // Swap it into big endian, so we can write LOAD_ commands
-            for (auto i = 0u; i < numRegisters; ++i) {
-               mRegisterStorage[i] = byte_swap(mRegisterStorage[i]);
-            }
-
-            handleRegisterSnapshot(reinterpret_cast<be_val<uint32_t> *>(mRegisterStorage), numRegisters);
-            gx2::internal::flushCommandBuffer(0x100);
+            handleRegisterSnapshotPacket(data.data(), packet.size);
             break;
          }
          case decaf::pm4::CapturePacket::SetBuffer:
          {
             decaf::pm4::CaptureSetBuffer setBuffer;
-            mFile.read(reinterpret_cast<char *>(&setBuffer), sizeof(decaf::pm4::CaptureSetBuffer));
+            std::memcpy(&setBuffer, data.data(), sizeof(decaf::pm4::CaptureSetBuffer));
 
             handleSetBuffer(setBuffer);
             gx2::internal::flushCommandBuffer(0x100);
@@ -119,24 +133,15 @@ public:
          case decaf::pm4::CapturePacket::MemoryLoad:
          {
             decaf::pm4::CaptureMemoryLoad load;
-            mFile.read(reinterpret_cast<char *>(&load), sizeof(decaf::pm4::CaptureMemoryLoad));
-
-            if (!mFile) {
-               return false;
-            }
-
-            buffer.resize(packet.size - sizeof(decaf::pm4::CaptureMemoryLoad));
-            mFile.read(buffer.data(), buffer.size());
+            std::memcpy(&load, data.data(), sizeof(decaf::pm4::CaptureMemoryLoad));
 
-            if (!mFile) {
-               return false;
-            }
-
-            handleMemoryLoad(load, buffer);
+            handleMemoryLoad(load,
+                             data.data() + sizeof(decaf::pm4::CaptureMemoryLoad),
+                             packet.size - sizeof(decaf::pm4::CaptureMemoryLoad));
             break;
          }
          default:
-            mFile.seekg(packet.size, std::ifstream::cur);
+            break;
          }
       }
 
@@ -144,6 +149,68 @@ public:
    }
 
 private:
+   bool readIndexedFrame()
+   {
+      auto foundSwap = false;
+      auto &frame = mIndexed.frame(mFrame++);
+
+      for (auto i = 0u; i < frame.numPackets; ++i) {
+         foundSwap |= handleIndexedPacket(mIndexed.packet(frame.firstPacket + i));
+      }
+
+      return foundSwap;
+   }
+
+   bool handleIndexedPacket(const decaf::pm4::CaptureIndexPacket &packet)
+   {
+      auto payload = mIndexed.payload(packet);
+
+      switch (packet.type) {
+      case decaf::pm4::CapturePacket::CommandBuffer:
+         // The GPU reads the command buffer straight out of the mapped file
+         return handleCommandBuffer(const_cast<uint8_t *>(payload), packet.size);
+      case decaf::pm4::CapturePacket::RegisterSnapshot:
+         handleRegisterSnapshotPacket(payload, packet.size);
+         break;
+      case decaf::pm4::CapturePacket::SetBuffer:
+      {
+         decaf::pm4::CaptureSetBuffer setBuffer;
+         std::memcpy(&setBuffer, payload, sizeof(decaf::pm4::CaptureSetBuffer));
+
+         handleSetBuffer(setBuffer);
+         gx2::internal::flushCommandBuffer(0x100);
+         break;
+      }
+      case decaf::pm4::CapturePacket::MemoryLoad:
+      {
+         decaf::pm4::CaptureMemoryLoad load;
+         load.type = packet.memoryType;
+         load.address = packet.address;
+         handleMemoryLoad(load, payload, packet.size);
+         break;
+      }
+      default:
+         break;
+      }
+
+      return false;
+   }
+
+   void handleRegisterSnapshotPacket(const uint8_t *data, uint32_t size)
+   {
+      decaf_check((size % 4) == 0);
+      auto numRegisters = size / 4;
+      std::memcpy(mRegisterStorage, data, size);
+
+      // Swap it into big endian, so we can write LOAD_ commands
+      for (auto i = 0u; i < numRegisters; ++i) {
+         mRegisterStorage[i] = byte_swap(mRegisterStorage[i]);
+      }
+
+      handleRegisterSnapshot(reinterpret_cast<be_val<uint32_t> *>(mRegisterStorage), numRegisters);
+      gx2::internal::flushCommandBuffer(0x100);
+   }
+
    bool handleCommandBuffer(void *buffer, uint32_t size)
    {
       decaf::pm4::injectCommandBuffer(buffer, size);
@@ -249,10 +316,10 @@ private:
       });
    }
 
-   void handleMemoryLoad(decaf::pm4::CaptureMemoryLoad &load, std::vector<char> &data)
+   void handleMemoryLoad(decaf::pm4::CaptureMemoryLoad &load, const uint8_t *data, size_t size)
    {
       auto ptr = mem::translate(load.address);
-      std::memcpy(ptr, data.data(), data.size());
+      std::memcpy(ptr, data, size);
    }
 
    bool
@@ -325,7 +392,10 @@ private:
 
 private:
    gpu::GraphicsDriver *mGraphicsDriver = nullptr;
-   std::ifstream mFile;
+   decaf::pm4::CaptureReader mReader;
+   decaf::pm4::IndexedCapture mIndexed;
+   bool mIsIndexed = false;
+   uint32_t mFrame = 0;
    std::vector<uint8_t *> mBuffers;
    uint32_t *mRegisterStorage = nullptr;
 };
@@ -455,6 +525,10 @@ SDLWindow::run(const std::string &tracePath)
       return false;
    }
 
+   if (config::start_frame && !parser.seekFrame(config::start_frame)) {
+      return false;
+   }
+
    while (!shouldQuit && !decaf::hasExited()) {
       SDL_Event event;
 
@@ -0,0 +1,622 @@
+#include <common/platform.h>
+#include <common/platform_dir.h>
+#include <filesystem/filesystem_host_folderhandle.h>
+#include <filesystem/filesystem_host_path.h>
+#include <glsl2/glsl2_translate.h>
+#include <libgfd/gfd.h>
+#include <libgpu/latte/latte_disassembler.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <excmd.h>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <spdlog/spdlog.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+std::shared_ptr<spdlog::logger>
+gLog;
+
+using Clock = std::chrono::high_resolution_clock;
+
+struct ShaderJob
+{
+   //! Where the shader came from, file path plus index for .gsh files
+   std::string name;
+
+   //! Translator input
+   glsl2::Shader::Type type = glsl2::Shader::Invalid;
+   std::array<latte::SQ_TEX_DIM, latte::MaxSamplers> samplerDim;
+   bool uniformBlocks = false;
+   std::vector<uint8_t> binary;
+};
+
+struct ShaderResult
+{
+   bool failed = false;
+   std::string error;
+
+   //! Best time over all iterations, in microseconds
+   double disassembleUs = 0.0;
+   double translateUs = 0.0;
+   double unoptimisedUs = 0.0;
+
+   size_t glslSize = 0;
+   size_t unoptimisedSize = 0;
+
+   bool validated = false;
+   bool valid = false;
+
+   //! Time glslangValidator took to compile the GLSL, in microseconds
+   double compileUs = 0.0;
+   double unoptimisedCompileUs = 0.0;
+};
+
+struct BenchOptions
+{
+   unsigned threads = 1;
+   unsigned iterations = 1;
+   bool compare = false;
+   bool uniformBlocks = false;
+   bool verbose = false;
+   std::string validator;
+   std::string validateDir;
+
+   //! Time glslangValidator takes to start up, taken off compile times
+   double validatorStartupUs = 0.0;
+};
+
+static bool
+endsWith(const std::string &str,
+         const std::string &suffix)
+{
+   return str.size() >= suffix.size()
+      && str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+static void
+collectFiles(const fs::HostPath &path,
+             std::vector<std::string> &files)
+{
+   auto handle = fs::HostFolderHandle { path };
+   auto entry = fs::FolderEntry { };
+
+   if (!handle.open()) {
+      std::cout << "Could not open folder " << path.path() << std::endl;
+      return;
+   }
+
+   while (handle.read(entry)) {
+      if (entry.type == fs::FolderEntry::Folder) {
+         collectFiles(path.join(entry.name), files);
+      } else if (entry.type == fs::FolderEntry::File) {
+         files.push_back(path.join(entry.name).path());
+      }
+   }
+}
+
+static std::array<latte::SQ_TEX_DIM, latte::MaxSamplers>
+getDefaultSamplerDims()
+{
+   auto dims = std::array<latte::SQ_TEX_DIM, latte::MaxSamplers> { };
+   dims.fill(latte::SQ_TEX_DIM::DIM_2D);
+   return dims;
+}
+
+static void
+applySamplerVars(ShaderJob &job,
+                 const std::vector<gfd::GFDSamplerVar> &samplerVars)
+{
+   for (auto &var : samplerVars) {
+      if (var.location >= latte::MaxSamplers) {
+         continue;
+      }
+
+      switch (var.type) {
+      case gx2::GX2SamplerVarType::Sampler1D:
+         job.samplerDim[var.location] = latte::SQ_TEX_DIM::DIM_1D;
+         break;
+      case gx2::GX2SamplerVarType::Sampler3D:
+         job.samplerDim[var.location] = latte::SQ_TEX_DIM::DIM_3D;
+         break;
+      case gx2::GX2SamplerVarType::SamplerCube:
+         job.samplerDim[var.location] = latte::SQ_TEX_DIM::DIM_CUBEMAP;
+         break;
+      default:
+         job.samplerDim[var.location] = latte::SQ_TEX_DIM::DIM_2D;
+      }
+   }
+}
+
+template<typename Type>
+static void
+addGfdShaders(const std::string &path,
+              const char *prefix,
+              glsl2::Shader::Type type,
+              const std::vector<Type> &shaders,
+              std::vector<ShaderJob> &jobs)
+{
+   for (auto i = 0u; i < shaders.size(); ++i) {
+      auto &shader = shaders[i];
+      auto job = ShaderJob { };
+      job.name = path + ":" + prefix + std::to_string(i);
+      job.type = type;
+      job.samplerDim = getDefaultSamplerDims();
+      job.uniformBlocks = (shader.mode == gx2::GX2ShaderMode::UniformBlock);
+      job.binary = shader.data;
+      applySamplerVars(job, shader.samplerVars);
+      jobs.emplace_back(std::move(job));
+   }
+}
+
+static bool
+loadGfdFile(const std::string &path,
+            std::vector<ShaderJob> &jobs)
+{
+   auto file = gfd::GFDFile { };
+
+   try {
+      gfd::readFile(file, path);
+   } catch (gfd::GFDReadException ex) {
+      std::cout << "Error reading " << path << ": " << ex.what() << std::endl;
+      return false;
+   }
+
+   addGfdShaders(path, "vs", glsl2::Shader::VertexShader, file.vertexShaders, jobs);
+   addGfdShaders(path, "gs", glsl2::Shader::GeometryShader, file.geometryShaders, jobs);
+   addGfdShaders(path, "ps", glsl2::Shader::PixelShader, file.pixelShaders, jobs);
+   return true;
+}
+
+/**
+ * Raw shaders dumped by the OpenGL driver with --dump-shaders, named
+ * gpu_<type>_<address>.bin. Fetch shaders are skipped as the translator
+ * never sees them directly.
+ */
+static bool
+loadRawFile(const std::string &path,
+            const BenchOptions &options,
+            std::vector<ShaderJob> &jobs)
+{
+   auto job = ShaderJob { };
+   auto filename = fs::HostPath { path }.filename();
+
+   if (filename.find("gpu_vertex_") == 0) {
+      job.type = glsl2::Shader::VertexShader;
+   } else if (filename.find("gpu_pixel_") == 0) {
+      job.type = glsl2::Shader::PixelShader;
+   } else if (filename.find("gpu_geometry_") == 0) {
+      job.type = glsl2::Shader::GeometryShader;
+   } else {
+      return true;
+   }
+
+   std::ifstream in { path, std::ifstream::binary };
+
+   if (!in.is_open()) {
+      std::cout << "Could not open file " << path << std::endl;
+      return false;
+   }
+
+   job.binary.assign(std::istreambuf_iterator<char> { in }, std::istreambuf_iterator<char> { });
+   job.name = path;
+   job.samplerDim = getDefaultSamplerDims();
+   job.uniformBlocks = options.uniformBlocks;
+   jobs.emplace_back(std::move(job));
+   return true;
+}
+
+static double
+elapsedUs(Clock::time_point start)
+{
+   return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+}
+
+static bool
+translateShader(const ShaderJob &job,
+                bool optimise,
+                glsl2::Shader &shader,
+                std::string &error)
+{
+   shader = glsl2::Shader { };
+   shader.type = job.type;
+   shader.samplerDim = job.samplerDim;
+   shader.uniformRegistersEnabled = !job.uniformBlocks;
+   shader.uniformBlocksEnabled = job.uniformBlocks;
+   shader.optimiseAlu = optimise;
+   return glsl2::translate(shader, gsl::make_span(job.binary), error);
+}
+
+static std::string
+getFullSource(const glsl2::Shader &shader)
+{
+   return shader.fileHeader
+      + "void main()\n{\n"
+      + shader.codeHeader
+      + shader.codeBody
+      + "}\n";
+}
+
+static bool
+runValidator(const BenchOptions &options,
+             const std::string &args)
+{
+#ifdef PLATFORM_WINDOWS
+   auto command = "\"\"" + options.validator + "\" " + args + " > NUL 2>&1\"";
+#else
+   auto command = "\"" + options.validator + "\" " + args + " > /dev/null 2>&1";
+#endif
+
+   return std::system(command.c_str()) == 0;
+}
+
+/**
+ * The best of a few runs of glslangValidator which do not compile anything,
+ * so the process start up can be taken off the compile times.
+ */
+static double
+measureValidatorStartup(const BenchOptions &options)
+{
+   auto best = 0.0;
+
+   for (auto i = 0; i < 3; ++i) {
+      auto start = Clock::now();
+      runValidator(options, "-v");
+      auto time = elapsedUs(start);
+
+      if (i == 0 || time < best) {
+         best = time;
+      }
+   }
+
+   return best;
+}
+
+/**
+ * We do not bundle a GLSL front end, so validation runs an external
+ * glslangValidator over the generated source. Its run time, less its start
+ * up time, is reported as the host compile time. That covers parsing and
+ * checking the GLSL but not a driver's code generation. Sources which fail
+ * to validate are kept in the output directory for inspection.
+ */
+static bool
+validateShader(const BenchOptions &options,
+               const std::string &name,
+               const glsl2::Shader &shader,
+               double &compileUs)
+{
+   auto extension = ".vert";
+
+   if (shader.type == glsl2::Shader::PixelShader) {
+      extension = ".frag";
+   } else if (shader.type == glsl2::Shader::GeometryShader) {
+      extension = ".geom";
+   }
+
+   auto path = options.validateDir + "/" + name + extension;
+
+   {
+      std::ofstream out { path };
+      out << getFullSource(shader);
+   }
+
+   auto start = Clock::now();
+   auto valid = runValidator(options, "\"" + path + "\"");
+   compileUs = std::max(0.0, elapsedUs(start) - options.validatorStartupUs);
+
+   if (!valid) {
+      return false;
+   }
+
+   std::remove(path.c_str());
+   return true;
+}
+
+static void
+runShader(const BenchOptions &options,
+          const ShaderJob &job,
+          size_t index,
+          ShaderResult &result)
+{
+   auto shader = glsl2::Shader { };
+
+   for (auto i = 0u; i < options.iterations; ++i) {
+      auto start = Clock::now();
+      latte::disassemble(gsl::make_span(job.binary), false);
+      auto time = elapsedUs(start);
+
+      if (i == 0 || time < result.disassembleUs) {
+         result.disassembleUs = time;
+      }
+
+      start = Clock::now();
+
+      if (!translateShader(job, true, shader, result.error)) {
+         result.failed = true;
+         return;
+      }
+
+      time = elapsedUs(start);
+
+      if (i == 0 || time < result.translateUs) {
+         result.translateUs = time;
+      }
+   }
+
+   result.glslSize = getFullSource(shader).size();
+
+   if (!options.validator.empty()) {
+      auto name = "shader_" + std::to_string(index);
+      result.validated = true;
+      result.valid = validateShader(options, name, shader, result.compileUs);
+   }
+
+   if (options.compare) {
+      auto unoptimised = glsl2::Shader { };
+
+      for (auto i = 0u; i < options.iterations; ++i) {
+         auto start = Clock::now();
+
+         if (!translateShader(job, false, unoptimised, result.error)) {
+            result.failed = true;
+            return;
+         }
+
+         auto time = elapsedUs(start);
+
+         if (i == 0 || time < result.unoptimisedUs) {
+            result.unoptimisedUs = time;
+         }
+      }
+
+      result.unoptimisedSize = getFullSource(unoptimised).size();
+
+      if (!options.validator.empty()) {
+         // Only the optimised output decides whether the shader is valid
+         auto name = "shader_" + std::to_string(index) + "_unoptimised";
+         validateShader(options, name, unoptimised, result.unoptimisedCompileUs);
+      }
+   }
+}
+
+static bool
+runBench(const BenchOptions &options,
+         const std::vector<ShaderJob> &jobs)
+{
+   auto results = std::vector<ShaderResult>(jobs.size());
+   auto next = std::atomic<size_t> { 0 };
+   auto threads = std::vector<std::thread> { };
+   auto start = Clock::now();
+
+   for (auto i = 0u; i < options.threads; ++i) {
+      threads.emplace_back([&]() {
+         while (true) {
+            auto index = next++;
+
+            if (index >= jobs.size()) {
+               break;
+            }
+
+            runShader(options, jobs[index], index, results[index]);
+         }
+      });
+   }
+
+   for (auto &thread : threads) {
+      thread.join();
+   }
+
+   auto wallUs = elapsedUs(start);
+   auto numFailed = size_t { 0 };
+   auto numInvalid = size_t { 0 };
+   auto totalDisassembleUs = 0.0;
+   auto totalTranslateUs = 0.0;
+   auto totalUnoptimisedUs = 0.0;
+   auto totalCompileUs = 0.0;
+   auto totalUnoptimisedCompileUs = 0.0;
+   auto totalSize = size_t { 0 };
+   auto totalUnoptimisedSize = size_t { 0 };
+   auto slowest = std::vector<size_t> { };
+
+   for (auto i = 0u; i < jobs.size(); ++i) {
+      auto &result = results[i];
+
+      if (result.failed) {
+         std::cout << "FAILED " << jobs[i].name << ": " << result.error << std::endl;
+         ++numFailed;
+         continue;
+      }
+
+      if (result.validated && !result.valid) {
+         std::cout << "INVALID " << jobs[i].name << ": see "
+                   << options.validateDir << "/shader_" << i << std::endl;
+         ++numInvalid;
+      }
+
+      if (options.verbose) {
+         std::cout << jobs[i].name
+                   << " disassemble " << result.disassembleUs << "us"
+                   << " translate " << result.translateUs << "us"
+                   << " size " << result.glslSize;
+
+         if (result.validated) {
+            std::cout << " compile " << result.compileUs << "us";
+         }
+
+         if (options.compare) {
+            std::cout << " (unoptimised " << result.unoptimisedUs << "us"
+                      << " size " << result.unoptimisedSize;
+
+            if (result.validated) {
+               std::cout << " compile " << result.unoptimisedCompileUs << "us";
+            }
+
+            std::cout << ")";
+         }
+
+         std::cout << std::endl;
+      }
+
+      totalDisassembleUs += result.disassembleUs;
+      totalTranslateUs += result.translateUs;
+      totalUnoptimisedUs += result.unoptimisedUs;
+      totalCompileUs += result.compileUs;
+      totalUnoptimisedCompileUs += result.unoptimisedCompileUs;
+      totalSize += result.glslSize;
+      totalUnoptimisedSize += result.unoptimisedSize;
+      slowest.push_back(i);
+   }
+
+   std::sort(slowest.begin(), slowest.end(),
+             [&](size_t lhs, size_t rhs) {
+                return results[lhs].translateUs > results[rhs].translateUs;
+             });
+
+   if (slowest.size() > 10) {
+      slowest.resize(10);
+   }
+
+   auto numPassed = jobs.size() - numFailed;
+   std::cout << std::fixed << std::setprecision(2);
+   std::cout << "Shaders:      " << jobs.size() << " (" << numFailed << " failed";
+
+   if (!options.validator.empty()) {
+      std::cout << ", " << numInvalid << " invalid";
+   }
+
+   std::cout << ")" << std::endl;
+   std::cout << "Wall time:    " << wallUs / 1000.0 << "ms on " << options.threads << " threads" << std::endl;
+
+   if (numPassed) {
+      std::cout << "Disassemble:  " << totalDisassembleUs / 1000.0 << "ms total, "
+                << totalDisassembleUs / numPassed << "us mean" << std::endl;
+      std::cout << "Translate:    " << totalTranslateUs / 1000.0 << "ms total, "
+                << totalTranslateUs / numPassed << "us mean" << std::endl;
+      std::cout << "GLSL size:    " << totalSize << " bytes" << std::endl;
+
+      if (!options.validator.empty()) {
+         std::cout << "Compile:      " << totalCompileUs / 1000.0 << "ms total, "
+                   << totalCompileUs / numPassed << "us mean" << std::endl;
+      }
+
+      if (options.compare) {
+         std::cout << "Unoptimised:  " << totalUnoptimisedUs / 1000.0 << "ms total, "
+                   << totalUnoptimisedSize << " bytes" << std::endl;
+
+         if (!options.validator.empty()) {
+            std::cout << "Unoptimised compile: " << totalUnoptimisedCompileUs / 1000.0 << "ms total" << std::endl;
+         }
+
+         if (totalUnoptimisedSize) {
+            std::cout << "Size ratio:   "
+                      << 100.0 * totalSize / totalUnoptimisedSize << "%" << std::endl;
+         }
+      }
+
+      std::cout << "Slowest translations:" << std::endl;
+
+      for (auto index : slowest) {
+         std::cout << "  " << results[index].translateUs << "us " << jobs[index].name << std::endl;
+      }
+   }
+
+   return numFailed == 0 && numInvalid == 0;
+}
+
+int main(int argc, char **argv)
+{
+   excmd::parser parser;
+   excmd::option_state options;
+
+   // Setup command line options
+   parser.global_options()
+      .add_option("h,help", excmd::description { "Show the help." })
+      .add_option("threads",
+                  excmd::description { "Number of worker threads, 0 uses every core." },
+                  excmd::default_value<unsigned> { 0 })
+      .add_option("iterations",
+                  excmd::description { "Translate each shader this many times and keep the best time." },
+                  excmd::default_value<unsigned> { 1 })
+      .add_option("compare",
+                  excmd::description { "Also translate without the ALU clause optimiser and compare." })
+      .add_option("uniform-blocks",
+                  excmd::description { "Translate raw .bin shaders with uniform blocks instead of registers." })
+      .add_option("validate",
+                  excmd::description { "Path to glslangValidator to check and time compiling the generated GLSL with." },
+                  excmd::value<std::string> { })
+      .add_option("validate-dir",
+                  excmd::description { "Where to write generated GLSL for validation." },
+                  excmd::default_value<std::string> { "shader-bench-out" })
+      .add_option("v,verbose",
+                  excmd::description { "Print timings for every shader." })
+      .add_argument("path", excmd::value<std::string> { });
+
+   // Parse command line
+   try {
+      options = parser.parse(argc, argv);
+   } catch (excmd::exception ex) {
+      std::cout << "Error parsing command line: " << ex.what() << std::endl;
+      std::exit(-1);
+   }
+
+   // Print help
+   if (argc == 1 || options.has("help")) {
+      std::cout << "Benchmarks the Latte to GLSL shader translator over .gsh files and raw shader dumps." << std::endl;
+      std::cout << parser.format_help("shader-bench") << std::endl;
+      std::exit(0);
+   }
+
+   gLog = std::make_shared<spdlog::logger>("shader-bench", spdlog::sinks::stdout_sink_mt::instance());
+   gLog->set_level(spdlog::level::warn);
+
+   auto benchOptions = BenchOptions { };
+   benchOptions.threads = options.get<unsigned>("threads");
+   benchOptions.iterations = std::max(1u, options.get<unsigned>("iterations"));
+   benchOptions.compare = options.has("compare");
+   benchOptions.uniformBlocks = options.has("uniform-blocks");
+   benchOptions.verbose = options.has("verbose");
+   benchOptions.validateDir = options.get<std::string>("validate-dir");
+
+   if (options.has("validate")) {
+      benchOptions.validator = options.get<std::string>("validate");
+      benchOptions.validatorStartupUs = measureValidatorStartup(benchOptions);
+      platform::createDirectory(benchOptions.validateDir);
+   }
+
+   if (benchOptions.threads == 0) {
+      benchOptions.threads = std::max(1u, std::thread::hardware_concurrency());
+   }
+
+   // Gather shaders
+   auto path = options.get<std::string>("path");
+   auto files = std::vector<std::string> { };
+   auto jobs = std::vector<ShaderJob> { };
+
+   if (platform::isDirectory(path)) {
+      collectFiles(fs::HostPath { path }, files);
+      std::sort(files.begin(), files.end());
+   } else {
+      files.push_back(path);
+   }
+
+   for (auto &file : files) {
+      if (endsWith(file, ".gsh")) {
+         loadGfdFile(file, jobs);
+      } else if (endsWith(file, ".bin")) {
+         loadRawFile(file, benchOptions, jobs);
+      }
+   }
+
+   if (jobs.empty()) {
+      std::cout << "No shaders found in " << path << std::endl;
+      return -1;
+   }
+
+   return runBench(benchOptions, jobs) ? 0 : -1;
+}
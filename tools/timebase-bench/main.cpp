@@ -0,0 +1,128 @@
+#include <common/bitutils.h>
+#include <libcpu/cpu.h>
+#include <libcpu/cpu_config.h>
+#include <libcpu/state.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <excmd.h>
+#include <iomanip>
+#include <iostream>
+#include <spdlog/spdlog.h>
+#include <thread>
+
+std::shared_ptr<spdlog::logger>
+gLog;
+
+using Clock = std::chrono::high_resolution_clock;
+
+// Stops the compiler from optimising away the values we read
+static volatile uint64_t
+sSink;
+
+template<typename Func>
+static double
+measure(const char *name,
+        uint64_t iterations,
+        Func func)
+{
+   auto sum = uint64_t { 0 };
+   auto start = Clock::now();
+
+   for (auto i = 0ull; i < iterations; ++i) {
+      sum += func();
+   }
+
+   auto end = Clock::now();
+   sSink = sum;
+
+   auto ns = std::chrono::duration<double, std::nano> { end - start }.count() / iterations;
+   std::cout << std::left << std::setw(32) << name
+             << std::right << std::setw(10) << std::fixed << std::setprecision(2) << ns
+             << " ns/read" << std::endl;
+   return ns;
+}
+
+int main(int argc, char **argv)
+{
+   excmd::parser parser;
+   excmd::option_state options;
+
+   parser.global_options()
+      .add_option("h,help",
+                  excmd::description { "Show the help." })
+      .add_option("iterations",
+                  excmd::description { "Number of timebase reads to time for each method." },
+                  excmd::default_value<uint64_t> { 10000000 })
+      .add_option("time-scale",
+                  excmd::description { "Time scale to apply in the scaled read benchmarks." },
+                  excmd::default_value<double> { 1.5 })
+      .add_option("drift-ms",
+                  excmd::description { "How long to compare the timebase against steady_clock for." },
+                  excmd::default_value<unsigned> { 1000 })
+      .add_option("no-tsc",
+                  excmd::description { "Do not use the host TSC for the timebase." });
+
+   try {
+      options = parser.parse(argc, argv);
+   } catch (excmd::exception ex) {
+      std::cout << "Error parsing command line: " << ex.what() << std::endl;
+      std::exit(-1);
+   }
+
+   if (options.has("help")) {
+      std::cout << "Benchmarks the cost of reading the emulated timebase." << std::endl;
+      std::cout << parser.format_help("timebase-bench") << std::endl;
+      std::exit(0);
+   }
+
+   gLog = std::make_shared<spdlog::logger>("timebase-bench", spdlog::sinks::stdout_sink_mt::instance());
+   gLog->set_level(spdlog::level::info);
+
+   if (options.has("no-tsc")) {
+      cpu::config::timing::use_tsc = false;
+   }
+
+   cpu::initialiseTimebase();
+
+   auto iterations = options.get<uint64_t>("iterations");
+   auto timeScale = options.get<double>("time-scale");
+   auto timeScaleFixed = static_cast<uint64_t>(timeScale * 4294967296.0);
+   auto core = cpu::Core { };
+   auto start = std::chrono::steady_clock::now();
+
+   // How Core::tb() used to read the timebase
+   auto steady = measure("steady_clock", iterations, [&]() {
+      auto ticks = std::chrono::duration_cast<cpu::TimerDuration>(std::chrono::steady_clock::now() - start);
+      return ticks.count();
+   });
+
+   auto tb = measure("Core::tb", iterations, [&]() {
+      return core.tb();
+   });
+
+   measure("steady_clock * time_scale", iterations, [&]() {
+      auto ticks = std::chrono::duration_cast<cpu::TimerDuration>(std::chrono::steady_clock::now() - start);
+      return static_cast<uint64_t>(static_cast<double>(ticks.count()) * timeScale);
+   });
+
+   measure("Core::tb * fixed time_scale", iterations, [&]() {
+      return mul_fixed32(core.tb(), timeScaleFixed);
+   });
+
+   std::cout << "Core::tb is " << std::setprecision(1) << (steady / tb) << "x faster than steady_clock" << std::endl;
+
+   // Check the timebase keeps up with steady_clock
+   auto driftMs = options.get<unsigned>("drift-ms");
+   auto tbStart = core.tb();
+   auto steadyStart = std::chrono::steady_clock::now();
+   std::this_thread::sleep_for(std::chrono::milliseconds { driftMs });
+   auto tbTicks = core.tb() - tbStart;
+   auto steadyTicks = std::chrono::duration_cast<cpu::TimerDuration>(std::chrono::steady_clock::now() - steadyStart).count();
+   auto drift = (static_cast<double>(tbTicks) - static_cast<double>(steadyTicks)) / static_cast<double>(steadyTicks);
+
+   std::cout << "Drift from steady_clock over " << driftMs << " ms: "
+             << std::setprecision(2) << (drift * 1000000.0) << " ppm" << std::endl;
+   return 0;
+}